@@ -68,6 +68,9 @@ main(int argc, char *argv[])
     dwiGenerator->SetNoiseSigma( _NoiseSigma );
   
   utlGlobalException(_SNRArg.isSet() && _NoiseSigmaArg.isSet(), "Only one of these is allowed: --snr or --noisesigma");
+  dwiGenerator->SetRandomSeed(_RandomSeed);
+  if (_NumberOfThreads>0)
+    dwiGenerator->SetNumberOfThreads(_NumberOfThreads);
   
   dwiGenerator->GetSamplingSchemeQSpace()->SetTau(_Tau);
   dwiGenerator->GetSamplingSchemeRSpace()->SetTau(_Tau);
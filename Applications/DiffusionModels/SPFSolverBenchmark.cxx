@@ -0,0 +1,313 @@
+/**
+ *       @file  SPFSolverBenchmark.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "SPFSolverBenchmarkCLP.h"
+
+#include "itkMultiThreader.h"
+#include "itkRealTimeClock.h"
+
+#include "itkSphericalPolarFourierImageFilter.h"
+#include "itkDWISingleVoxelGenerator.h"
+#include "itkL2RegularizedLeastSquaresSolver.h"
+#include "itkL1RegularizedLeastSquaresFISTASolver.h"
+#include "itkSpamsWeightedLassoSolver.h"
+#include "utlProximalOperators.h"
+
+#include "utl.h"
+
+typedef itk::VectorImage<float, 3>  DWIImageType;
+typedef itk::Image<float, 3>        B0ImageType;
+typedef itk::SphericalPolarFourierImageFilter<DWIImageType, DWIImageType> SPFIFilterType;
+
+typedef SPFIFilterType::MatrixType     MatrixType;
+typedef SPFIFilterType::VectorType     VectorType;
+typedef SPFIFilterType::MatrixPointer  MatrixPointer;
+typedef SPFIFilterType::VectorPointer  VectorPointer;
+
+typedef itk::L2RegularizedLeastSquaresSolver<double>      L2SolverType;
+typedef itk::L1RegularizedLeastSquaresFISTASolver<double> FISTASolverType;
+typedef itk::SpamsWeightedLassoSolver<double>             SpamsSolverType;
+
+/** data shared by all threads in one run  */
+struct BenchmarkThreadData
+{
+  std::string SolverType;
+  int NumberOfThreads;
+
+  const MatrixType* DWIMatrix;
+  MatrixPointer A;
+  VectorPointer w;
+
+  L2SolverType::Pointer L2Solver;
+  FISTASolverType::Pointer FISTASolver;
+  SpamsSolverType::Pointer SpamsSolver;
+
+  /** results for each voxel  */
+  std::vector<double> Latency;
+  std::vector<double> Iterations;
+  std::vector<double> Cost;
+};
+
+/** ||Ax-b||^2 + ||w.*x||_1, which is the same cost function for all solvers  */
+double
+ComputeCostFunction(const MatrixType& A, const double* b, const VectorType& w, const VectorType& x)
+{
+  VectorType e;
+  utl::ProductUtlMv(A, x, e);
+  utl::vSub(e.Size(), e.GetData(), b, e.GetData());
+  double eNorm = utl::cblas_nrm2(e.Size(), e.GetData(), 1);
+  return eNorm*eNorm + utl::WeightedL1Norm<double>(x.Size(), x.GetData(), w.GetData());
+}
+
+ITK_THREAD_RETURN_TYPE
+BenchmarkThreadedMethod(void* arg)
+{
+  const itk::MultiThreader::ThreadInfoStruct* threadInfo = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  utlGlobalException(!threadInfo, "arg was not of type itk::MultiThreader::ThreadInfoStruct*");
+  const unsigned int threadId = threadInfo->ThreadID;
+  BenchmarkThreadData* data = static_cast<BenchmarkThreadData*>(threadInfo->UserData);
+  utlGlobalException(!data, "UserData was not of type BenchmarkThreadData*");
+
+  // solvers are cloned in each thread, in the same way as in SphericalPolarFourierImageFilter
+  L2SolverType::Pointer l2Solver;
+  FISTASolverType::Pointer fistaSolver;
+  SpamsSolverType::Pointer spamsSolver;
+  if (data->SolverType=="LS")
+    l2Solver = data->L2Solver->Clone();
+  else if (data->SolverType=="FISTA_LS")
+    fistaSolver = data->FISTASolver->Clone();
+  else
+    spamsSolver = data->SpamsSolver->Clone();
+
+  itk::RealTimeClock::Pointer clock = itk::RealTimeClock::New();
+  const MatrixType& dwiMatrix = *data->DWIMatrix;
+  int numberOfSamples = dwiMatrix.Columns();
+  VectorType x;
+  for ( int i = threadId; i < dwiMatrix.Rows(); i += data->NumberOfThreads )
+    {
+    const double* b = dwiMatrix.GetData() + i*numberOfSamples;
+    int iter = 0;
+    double timeStart = clock->GetTimeInSeconds();
+    if (l2Solver)
+      {
+      l2Solver->SetbFromData(b, numberOfSamples);
+      l2Solver->Solve();
+      x = l2Solver->Getx();
+      }
+    else if (fistaSolver)
+      {
+      fistaSolver->SetbFromData(b, numberOfSamples);
+      fistaSolver->Solve();
+      x = fistaSolver->Getx();
+      iter = fistaSolver->GetNumberOfIterations();
+      }
+    else
+      {
+      spamsSolver->Setb(VectorPointer(new VectorType(b, numberOfSamples)));
+      spamsSolver->Solve();
+      x = spamsSolver->Getx();
+      }
+    data->Latency[i] = clock->GetTimeInSeconds() - timeStart;
+    data->Iterations[i] = iter;
+    data->Cost[i] = ComputeCostFunction(*data->A, b, *data->w, x);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+double
+GetMean(const std::vector<double>& vec)
+{
+  double sum=0;
+  for ( int i = 0; i < vec.size(); i += 1 )
+    sum += vec[i];
+  return vec.size()>0 ? sum/vec.size() : 0;
+}
+
+/** percentile in [0,1]  */
+double
+GetPercentile(std::vector<double> vec, const double p)
+{
+  if (vec.size()==0)
+    return 0;
+  std::sort(vec.begin(), vec.end());
+  int index = utl::min<int>((int)(p*(vec.size()-1)+0.5), vec.size()-1);
+  return vec[index];
+}
+
+/**
+ * \brief  Benchmark of LS, FISTA_LS and SPAMS solvers for SPF estimation
+ */
+int
+main (int argc, char const* argv[])
+{
+  // GenerateCLP
+  PARSE_ARGS;
+
+  utlGlobalException(_NumberOfVoxels<=0, "need to set a positive --voxels");
+  utlGlobalException(_BValues.size()==0, "need to set --bvalues");
+  for ( int i = 0; i < _Solvers.size(); i += 1 )
+    utlSAGlobalException(_Solvers[i]!="LS" && _Solvers[i]!="FISTA_LS" && _Solvers[i]!="SPAMS")(_Solvers[i]).msg("wrong solver type");
+
+  int maxNumberOfThreads = _NumberOfThreads>0 ? _NumberOfThreads : itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  if (itk::MultiThreader::GetGlobalMaximumNumberOfThreads()<maxNumberOfThreads)
+    itk::MultiThreader::SetGlobalMaximumNumberOfThreads(maxNumberOfThreads);
+
+  // multi-shell scheme with the same orientations in all shells
+  typedef itk::DWISingleVoxelGenerator<DWIImageType, B0ImageType> GeneratorType;
+  GeneratorType::Pointer dwiGenerator = GeneratorType::New();
+  MatrixPointer qMatrix = utl::ReadGrad<double>(_TessellationOrder, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+  GeneratorType::STDVectorPointer bVector(new GeneratorType::STDVectorType(_BValues));
+  utl::MatchBVectorAndGradientMatrix(*bVector, *qMatrix);
+  dwiGenerator->GetSamplingSchemeQSpace()->SetTau(_Tau);
+  dwiGenerator->GetSamplingSchemeQSpace()->SetOrientationsCartesian(qMatrix);
+  dwiGenerator->GetSamplingSchemeQSpace()->SetBVector(bVector);
+
+  // DWI samples with random rotations in voxels
+  dwiGenerator->SetDiffusionParameterValues(_DiffusionParameters);
+  dwiGenerator->SetModelType(GeneratorType::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS);
+  dwiGenerator->SetRandomType(GeneratorType::UNIFORM);
+  dwiGenerator->SetIsOutputDWI(true);
+  if (_SNR>0)
+    dwiGenerator->SetSNR(_SNR);
+  GeneratorType::OutputImageSizeType size;
+  size[0]=_NumberOfVoxels, size[1]=1, size[2]=1;
+  dwiGenerator->SetOutputSize(size);
+  std::cout << "Generating DWI samples in " << _NumberOfVoxels << " voxels" << std::endl << std::flush;
+  dwiGenerator->Update();
+
+  DWIImageType::Pointer dwiImage = dwiGenerator->GetDWIImage();
+  int numberOfSamples = qMatrix->Rows();
+  MatrixType dwiMatrix(_NumberOfVoxels, numberOfSamples);
+  DWIImageType::IndexType index;
+  index[1]=0, index[2]=0;
+  for ( int i = 0; i < _NumberOfVoxels; i += 1 )
+    {
+    index[0]=i;
+    DWIImageType::PixelType pixel = dwiImage->GetPixel(index);
+    for ( int j = 0; j < numberOfSamples; j += 1 )
+      dwiMatrix(i,j) = pixel[j];
+    }
+
+  // SPF basis matrix and regularization weights. B0 is not analytical, thus the basis matrix is used directly in solvers.
+  SPFIFilterType::Pointer spfiFilter = SPFIFilterType::New();
+  spfiFilter->SetSamplingSchemeQSpace(dwiGenerator->GetSamplingSchemeQSpace());
+  spfiFilter->SetSHRank(_SHRank);
+  spfiFilter->SetRadialRank(_RadialRank);
+  spfiFilter->SetMD0(_MD0);
+  spfiFilter->SetBasisScale(-1.0);
+  spfiFilter->SetIsAnalyticalB0(false);
+  spfiFilter->SetEstimationType(SPFIFilterType::L1_2);
+  spfiFilter->SetLambdaSpherical(_LambdaSpherical);
+  spfiFilter->SetLambdaRadial(_LambdaRadial);
+  spfiFilter->ComputeBasisMatrix();
+  spfiFilter->ComputeRegularizationWeight();
+  MatrixPointer A = spfiFilter->GetBasisMatrix();
+  VectorPointer w = spfiFilter->GetRegularizationWeight();
+  std::cout << "SPF basis matrix: " << A->Rows() << " x " << A->Columns() << std::endl << std::flush;
+
+  BenchmarkThreadData data;
+  data.DWIMatrix = &dwiMatrix;
+  data.A = A;
+  data.w = w;
+
+  data.L2Solver = L2SolverType::New();
+  data.L2Solver->SetA(A);
+  MatrixPointer lamMat(new MatrixType());
+  *lamMat = w->GetDiagonalMatrix();
+  data.L2Solver->SetLambda(lamMat);
+  // the pseudo-inverse is computed once, then it is copied to the solver in each thread
+  data.L2Solver->Initialize();
+
+  data.FISTASolver = FISTASolverType::New();
+  data.FISTASolver->SetUseL2SolverForInitialization(true);
+  data.FISTASolver->SetMaxNumberOfIterations(_MaxIter);
+  data.FISTASolver->SetMinRelativeChangeOfCostFunction(_MinChange);
+  data.FISTASolver->SetMinRelativeChangeOfPrimalResidual(_MinChange);
+  data.FISTASolver->SetUseGapSafeScreening(_UseGapSafeScreening);
+  data.FISTASolver->SetUseActiveSet(_UseActiveSet);
+  data.FISTASolver->SetA(A);
+  data.FISTASolver->Setw(w);
+  data.FISTASolver->SetwForInitialization(w);
+
+  data.SpamsSolver = SpamsSolverType::New();
+  data.SpamsSolver->SetA(A);
+  data.SpamsSolver->Setw(w);
+  // OMP_NUM_THREAD=1 in spams, see SphericalPolarFourierEstimationImageFilter::InitializeThreadedLibraries()
+  data.SpamsSolver->SetNumberOfThreads(1);
+
+  std::ostringstream json;
+  json << "{" << std::endl;
+  json << "  \"problem\": {\"shRank\": " << _SHRank << ", \"radialRank\": " << _RadialRank
+       << ", \"numberOfSamples\": " << A->Rows() << ", \"numberOfCoefficients\": " << A->Columns()
+       << ", \"numberOfShells\": " << _BValues.size() << ", \"numberOfVoxels\": " << _NumberOfVoxels
+       << ", \"snr\": " << _SNR << ", \"lambdaSH\": " << _LambdaSpherical << ", \"lambdaRA\": " << _LambdaRadial
+       << ", \"simd\": " << utl::GetSIMDTypeSupportedByCPU() << "}," << std::endl;
+  json << "  \"results\": [" << std::endl;
+
+  itk::RealTimeClock::Pointer clock = itk::RealTimeClock::New();
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  bool isFirst = true;
+  for ( int s = 0; s < _Solvers.size(); s += 1 )
+    {
+    for ( int numberOfThreads = 1; numberOfThreads <= maxNumberOfThreads; numberOfThreads += 1 )
+      {
+      data.SolverType = _Solvers[s];
+      data.NumberOfThreads = numberOfThreads;
+      data.Latency.assign(_NumberOfVoxels, 0.0);
+      data.Iterations.assign(_NumberOfVoxels, 0.0);
+      data.Cost.assign(_NumberOfVoxels, 0.0);
+      utl::InitializeThreadedLibraries(numberOfThreads);
+
+      threader->SetNumberOfThreads(numberOfThreads);
+      threader->SetSingleMethod(BenchmarkThreadedMethod, &data);
+      double timeStart = clock->GetTimeInSeconds();
+      threader->SingleMethodExecute();
+      double wallTime = clock->GetTimeInSeconds() - timeStart;
+
+      double latencyMean = GetMean(data.Latency);
+      double latencyMedian = GetPercentile(data.Latency, 0.5);
+      double latencyP95 = GetPercentile(data.Latency, 0.95);
+      double iterMean = GetMean(data.Iterations);
+      double costMean = GetMean(data.Cost);
+      double throughput = _NumberOfVoxels/wallTime;
+
+      std::cout << _Solvers[s] << ", " << numberOfThreads << " threads: " << throughput << " voxels/s, latency " << latencyMean*1e3 << " ms (median "
+                << latencyMedian*1e3 << " ms, p95 " << latencyP95*1e3 << " ms), " << iterMean << " iterations, cost " << costMean << std::endl << std::flush;
+
+      if (!isFirst)
+        json << "," << std::endl;
+      isFirst = false;
+      json << "    {\"solver\": \"" << _Solvers[s] << "\", \"threads\": " << numberOfThreads
+           << ", \"wallTime\": " << wallTime << ", \"throughput\": " << throughput
+           << ", \"latencyMean\": " << latencyMean << ", \"latencyMedian\": " << latencyMedian << ", \"latencyP95\": " << latencyP95
+           << ", \"iterationsMean\": " << iterMean << ", \"costMean\": " << costMean << "}";
+      }
+    }
+  json << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+  if (_OutputFileArg.isSet())
+    {
+    std::ofstream out(_OutputFile.c_str());
+    utlGlobalException(!out, "cannot write to " << _OutputFile);
+    out << json.str();
+    out.close();
+    }
+  else
+    std::cout << json.str() << std::flush;
+
+  return EXIT_SUCCESS;
+}
@@ -30,56 +30,51 @@
 #include "itkSamplingScheme3D.h"
 
 #include "itkCommandProgressUpdate.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
 
 #include "utl.h"
 
+typedef itk::Image<double, 3>  ImageType;
+
 /**
- * \brief  general SPFI using SPF basis
+ * \brief  Pipeline of SPF estimation in the given precision. Basis matrices are in double, solvers use PrecisionType. 
+ * Only the information of DWIs is read, DWIs are read when the pipeline is updated.
  */
-int 
-main (int argc, char const* argv[])
+template <class PrecisionType>
+typename itk::SphericalPolarFourierImageFilter<itk::VectorImage<PrecisionType, 3>, itk::VectorImage<PrecisionType, 3> >::Pointer
+CreateSPFPipeline(int argc, char const* argv[], const ImageType::Pointer& mdImage, const ImageType::Pointer& maskImage)
 {
   // GenerateCLP
   PARSE_ARGS;
-  
-  utl::LogLevel = _Verbose;
-  bool _Debug = _Verbose>=LOG_DEBUG;
-
-  utlGlobalException(!_OutputEAPProfileFileArg.isSet() && !_OutputODFFileArg.isSet() && !_OutputSPFFileArg.isSet(), "no output");
 
-  typedef double PrecisionType; 
   typedef itk::VectorImage<PrecisionType, 3>  VectorImageType;
-  typedef itk::Image<PrecisionType, 3>  ImageType;
-
   typedef itk::DWIReader<PrecisionType>  DWIReaderType;
-  
-  ImageType::Pointer mdImage=NULL, maskImage=NULL;
-  if (_MDImageFileArg.isSet())
-    itk::ReadImage<ImageType>(_MDImageFile, mdImage);
-  if (_MaskFileArg.isSet())
-    itk::ReadImage<ImageType>(_MaskFile, maskImage);
 
-  // read DWI, mdImage, mask
-  DWIReaderType::Pointer reader = DWIReaderType::New();
+  // read DWI
+  typename DWIReaderType::Pointer reader = DWIReaderType::New();
   reader->GetSamplingSchemeQSpace()->SetTau(_Tau);
   reader->SetConfigurationFile(_InputFile);
   if (_MaskFileArg.isSet())
     reader->SetMaskImage(maskImage);
-  reader->Update();
-
-
+  // a quarter of the memory limit is used for chunks of volumes in 4D DWI files
+  if (_MemoryLimit>0)
+    reader->SetStreamingChunkSizeInMB(0.25*_MemoryLimit);
+  reader->UpdateOutputInformation();
 
   // SPFI
-  VectorImageType::Pointer spf;
   typedef itk::SphericalPolarFourierEstimationImageFilter<VectorImageType, VectorImageType> SPFIFilterBaseType;
-  SPFIFilterBaseType::Pointer spfiFilter=NULL;
-    typedef itk::SphericalPolarFourierImageFilter<VectorImageType, VectorImageType> SPFIFilterType;
-    spfiFilter = SPFIFilterType::New();
-    std::cout << "Use SPF basis" << std::endl << std::flush;
+  typedef itk::SphericalPolarFourierImageFilter<VectorImageType, VectorImageType> SPFIFilterType;
+  typename SPFIFilterType::Pointer spfiFilter = SPFIFilterType::New();
+  std::cout << "Use SPF basis" << std::endl << std::flush;
 
   utl::InitializeThreadedLibraries(_NumberOfThreads);
   if (_NumberOfThreads>0)
     spfiFilter->SetNumberOfThreads(_NumberOfThreads);
+  if (_VoxelChunkSize>0)
+    {
+    spfiFilter->SetUseVoxelList(true);
+    spfiFilter->SetVoxelChunkSize(_VoxelChunkSize);
+    }
   if (_MaskFileArg.isSet())
     spfiFilter->SetMaskImage(maskImage);
   spfiFilter->SetInput(reader->GetOutput());
@@ -106,32 +101,32 @@ main (int argc, char const* argv[])
   spfiFilter->SetLambdaSpherical(_LambdaSpherical);
   spfiFilter->SetLambdaRadial(_LambdaRadial);
   spfiFilter->SetLambdaL1(_LambdaL1);
+  spfiFilter->SetNumberOfVoxelsPerBatch(_NumberOfVoxelsPerBatch);
+  spfiFilter->SetScaleTolerance(_ScaleTolerance);
+  spfiFilter->SetMaxCacheMemorySize(_MaxCacheMemorySize);
 
   if (_SolverType=="FISTA_LS")
     {
-    typedef itk::L1RegularizedLeastSquaresFISTASolver<double> L1SolverType;
-    L1SolverType::Pointer l1Solver = L1SolverType::New();
+    typedef typename SPFIFilterBaseType::L1FISTASolverType L1SolverType;
+    typename L1SolverType::Pointer l1Solver = L1SolverType::New();
     l1Solver->SetUseL2SolverForInitialization(_SolverType=="FISTA_LS");
     l1Solver->SetMaxNumberOfIterations(_MaxIter);
     l1Solver->SetMinRelativeChangeOfCostFunction(_MinChange);
     l1Solver->SetMinRelativeChangeOfPrimalResidual(_MinChange);
+    l1Solver->SetUseGapSafeScreening(_UseGapSafeScreening);
+    l1Solver->SetUseActiveSet(_UseActiveSet);
     spfiFilter->SetL1FISTASolver(l1Solver);
+    spfiFilter->SetUseWarmStart(_UseWarmStart);
     spfiFilter->SetL1SolverType(SPFIFilterBaseType::FISTA_LS);
     }
   if (_SolverType=="SPAMS")
     {
-    typedef itk::SpamsWeightedLassoSolver<double> L1SolverType;
-    L1SolverType::Pointer l1Solver = L1SolverType::New();
+    typedef typename SPFIFilterBaseType::L1SpamsSolverType L1SolverType;
+    typename L1SolverType::Pointer l1Solver = L1SolverType::New();
     spfiFilter->SetL1SpamsSolver(l1Solver);
     spfiFilter->SetL1SolverType(SPFIFilterBaseType::SPAMS);
     }
 
-
-  typedef SPFIFilterBaseType::SamplingSchemeQSpaceType  SamplingSchemeQSpaceType;
-  typedef SPFIFilterBaseType::SamplingSchemeRSpaceType  SamplingSchemeRSpaceType;
-  SamplingSchemeQSpaceType::Pointer samplingQSpace = SamplingSchemeQSpaceType::New();
-  SamplingSchemeRSpaceType::Pointer samplingRSpace = SamplingSchemeRSpaceType::New();
-
   if (_MDImageFileArg.isSet())
     spfiFilter->SetMDImage(mdImage);
 
@@ -142,13 +137,155 @@ main (int argc, char const* argv[])
     spfiFilter->AddObserver( itk::ProgressEvent(), observer );
   spfiFilter->SetDebug(_Verbose>=LOG_DEBUG);
   spfiFilter->SetLogLevel(utl::LogLevel);
+  return spfiFilter;
+}
 
+/**
+ * \brief  SPF estimation in the given precision. 
+ */
+template <class PrecisionType>
+typename itk::SphericalPolarFourierImageFilter<itk::VectorImage<PrecisionType, 3>, itk::VectorImage<PrecisionType, 3> >::Pointer
+EstimateSPF(int argc, char const* argv[], const ImageType::Pointer& mdImage, const ImageType::Pointer& maskImage)
+{
+  typedef itk::SphericalPolarFourierImageFilter<itk::VectorImage<PrecisionType, 3>, itk::VectorImage<PrecisionType, 3> > SPFIFilterType;
+  typename SPFIFilterType::Pointer spfiFilter = CreateSPFPipeline<PrecisionType>(argc, argv, mdImage, maskImage);
   std::cout << "SPF estimation starts" << std::endl << std::flush;
   spfiFilter->Update();
   std::cout << "SPF estimation ends" << std::endl << std::flush;
-  spf = spfiFilter->GetOutput();
+  return spfiFilter;
+}
+
+/**
+ * \brief  Update the pipeline of image and save it. 
+ * If memoryLimit (MB) is positive, the image is generated and written in slabs, 
+ * and the number of slabs is set such that streamed images (numberOfStreamedComponents values per voxel) and images which are not streamed (fixedMemory MB) are in memoryLimit.
+ */
+template <class ImageType>
+void
+SaveImageWithMemoryLimit(const typename ImageType::Pointer& image, const std::string& file, const double memoryLimit, const int numberOfStreamedComponents, const double fixedMemory)
+{
+  if (memoryLimit<=0)
+    {
+    image->Update();
+    itk::SaveImage<ImageType>(image, file);
+    return;
+    }
+
+  image->UpdateOutputInformation();
+  const double numberOfVoxels = image->GetLargestPossibleRegion().GetNumberOfPixels();
+  const double memoryOfStreamedImages = numberOfVoxels*numberOfStreamedComponents*sizeof(typename ImageType::InternalPixelType)/(1024.0*1024.0);
+  utlGlobalException(memoryLimit<=fixedMemory, "memory limit " << memoryLimit << " MB is too small. Images which are not streamed use " << fixedMemory << " MB.");
+  const int numberOfStreamDivisions = utl::max(1, (int)std::ceil(memoryOfStreamedImages/(memoryLimit-fixedMemory)));
+  itk::SaveImageInStreams<ImageType>(image, file, numberOfStreamDivisions);
+}
+
+/**
+ * \brief  Report the maximal deviation of SPF coefficients in spf from the coefficients in spfDouble estimated in double. 
+ */
+template <class VectorImageType, class DoubleVectorImageType>
+void
+ReportPrecisionDeviation(const VectorImageType* spf, const DoubleVectorImageType* spfDouble)
+{
+  itk::ImageRegionConstIteratorWithIndex<VectorImageType> it(spf, spf->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<DoubleVectorImageType> itDouble(spfDouble, spfDouble->GetLargestPossibleRegion());
+  const int numberOfCoefficients = spf->GetNumberOfComponentsPerPixel();
+  utlGlobalException(numberOfCoefficients!=spfDouble->GetNumberOfComponentsPerPixel(), "wrong number of coefficients");
+
+  double maxDiff=0, maxRelativeDiff=0;
+  typename VectorImageType::IndexType maxRelativeIndex;
+  maxRelativeIndex.Fill(0);
+  for (it.GoToBegin(), itDouble.GoToBegin(); !it.IsAtEnd(); ++it, ++itDouble) 
+    {
+    typename VectorImageType::PixelType coef = it.Get();
+    typename DoubleVectorImageType::PixelType coefDouble = itDouble.Get();
+    double diffNorm=0, norm=0;
+    for ( int i = 0; i < numberOfCoefficients; i += 1 ) 
+      {
+      double diff = std::abs((double)coef[i] - coefDouble[i]);
+      maxDiff = utl::max(maxDiff, diff);
+      diffNorm += diff*diff;
+      norm += coefDouble[i]*coefDouble[i];
+      }
+    if (norm>0 && std::sqrt(diffNorm/norm)>maxRelativeDiff)
+      {
+      maxRelativeDiff = std::sqrt(diffNorm/norm);
+      maxRelativeIndex = it.GetIndex();
+      }
+    }
+  std::cout << "Maximal absolute deviation of coefficients from double precision: " << maxDiff << std::endl;
+  std::cout << "Maximal relative deviation of coefficients in one voxel from double precision: " << maxRelativeDiff << ", in voxel " << maxRelativeIndex << std::endl << std::flush;
+}
+
+/**
+ * \brief  general SPFI using SPF basis
+ */
+template <class PrecisionType>
+int 
+SphericalPolarFourierImaging(int argc, char const* argv[])
+{
+  // GenerateCLP
+  PARSE_ARGS;
+  
+  bool _Debug = _Verbose>=LOG_DEBUG;
+
+  typedef itk::VectorImage<PrecisionType, 3>  VectorImageType;
+  typedef itk::VectorImage<double, 3>  DoubleVectorImageType;
+  
+  ImageType::Pointer mdImage=NULL, maskImage=NULL;
+  if (_MDImageFileArg.isSet())
+    itk::ReadImage<ImageType>(_MDImageFile, mdImage);
+  if (_MaskFileArg.isSet())
+    itk::ReadImage<ImageType>(_MaskFile, maskImage);
+
+  typedef itk::SphericalPolarFourierImageFilter<VectorImageType, VectorImageType> SPFIFilterType;
+  typename SPFIFilterType::Pointer spfiFilter=NULL;
+  typename VectorImageType::Pointer spf=NULL;
+  typedef itk::ImageFileReader<VectorImageType> SPFReaderType;
+  typename SPFReaderType::Pointer spfReader = SPFReaderType::New();
+  // mask, MD and scale images are not streamed
+  double fixedMemory = 0;
+  if (_MaskFileArg.isSet())
+    fixedMemory += maskImage->GetLargestPossibleRegion().GetNumberOfPixels()*sizeof(double)/(1024.0*1024.0);
+  if (_MDImageFileArg.isSet())
+    fixedMemory += 2*mdImage->GetLargestPossibleRegion().GetNumberOfPixels()*sizeof(double)/(1024.0*1024.0);
+
+  if (_MemoryLimit>0)
+    {
+    // DWIs, B0 and SPF coefficients are generated and written in slabs. EAP and ODF are computed from the saved SPF file. 
+    utlGlobalException(!_OutputSPFFileArg.isSet(), "--memory-limit needs --signal, because SPF coefficients are not kept in memory");
+    utlGlobalException(_ValidatePrecision, "--validatePrecision cannot be used with --memory-limit");
+    spfiFilter = CreateSPFPipeline<PrecisionType>(argc, argv, mdImage, maskImage);
+    spfiFilter->UpdateOutputInformation();
+    const int numberOfDWIs = spfiFilter->GetInput()->GetNumberOfComponentsPerPixel();
+    const int numberOfSPFs = spfiFilter->GetOutput()->GetNumberOfComponentsPerPixel();
+    std::cout << "SPF estimation starts" << std::endl << std::flush;
+    SaveImageWithMemoryLimit<VectorImageType>(spfiFilter->GetOutput(), _OutputSPFFile, 0.75*_MemoryLimit, numberOfDWIs+1+numberOfSPFs, fixedMemory);
+    std::cout << "SPF estimation ends" << std::endl << std::flush;
+    // SPF coefficients are read in slabs when features are computed
+    spfReader->SetFileName(_OutputSPFFile);
+    spfReader->UpdateOutputInformation();
+    spf = spfReader->GetOutput();
+    }
+  else
+    {
+    spfiFilter = EstimateSPF<PrecisionType>(argc, argv, mdImage, maskImage);
+    spf = spfiFilter->GetOutput();
+    }
+
+  if (_ValidatePrecision)
+    {
+    if (std::is_same<PrecisionType, double>::value)
+      std::cout << "Estimation is in double precision. Use --float to validate single precision." << std::endl << std::flush;
+    else
+      {
+      std::cout << "Estimation in double precision for validation" << std::endl << std::flush;
+      typename DoubleVectorImageType::Pointer spfDouble = EstimateSPF<double>(argc, argv, mdImage, maskImage)->GetOutput();
+      ReportPrecisionDeviation<VectorImageType, DoubleVectorImageType>(spf, spfDouble);
+      }
+    }
+
   // save SPF coefficients if needed 
-  if (_OutputSPFFileArg.isSet())
+  if (_OutputSPFFileArg.isSet() && _MemoryLimit<=0)
     {
     itk::SaveImage<VectorImageType>(spf, _OutputSPFFile);
     }
@@ -161,11 +298,16 @@ main (int argc, char const* argv[])
   if (_OutputEAPProfileFileArg.isSet())
     {
     typedef itk::ProfileFromSPFImageFilter<VectorImageType, VectorImageType> ProfileFromSPFFilterType;
-    ProfileFromSPFFilterType::Pointer featureFromSPFFilter = ProfileFromSPFFilterType::New();
+    typename ProfileFromSPFFilterType::Pointer featureFromSPFFilter = ProfileFromSPFFilterType::New();
     if (_MaskFileArg.isSet())
       featureFromSPFFilter->SetMaskImage(maskImage);
     if (_NumberOfThreads>0)
       featureFromSPFFilter->SetNumberOfThreads(_NumberOfThreads);
+    if (_VoxelChunkSize>0)
+      {
+      featureFromSPFFilter->SetUseVoxelList(true);
+      featureFromSPFFilter->SetVoxelChunkSize(_VoxelChunkSize);
+      }
     featureFromSPFFilter->SetSHRank(_SHRank);
     featureFromSPFFilter->SetRadialRank(_RadialRank);
     featureFromSPFFilter->SetMD0(spfiFilter->GetMD0());
@@ -183,21 +325,25 @@ main (int argc, char const* argv[])
     featureFromSPFFilter->SetIsFourier(true);
     featureFromSPFFilter->SetIsInQSpace(true);
     std::cout << "EAP profile estimation starts" << std::endl << std::flush;
-    featureFromSPFFilter->Update();
+    SaveImageWithMemoryLimit<VectorImageType>(featureFromSPFFilter->GetOutput(), _OutputEAPProfileFile, _MemoryLimit, 
+      spf->GetNumberOfComponentsPerPixel()+featureFromSPFFilter->GetOutput()->GetNumberOfComponentsPerPixel(), fixedMemory);
     std::cout << "EAP profile estimation ends" << std::endl << std::flush;
-    VectorImageType::Pointer eap = featureFromSPFFilter->GetOutput();
-    itk::SaveImage<VectorImageType>(eap, _OutputEAPProfileFile);
     }
 
   // output ODF
   if (_OutputODFFileArg.isSet())
     {
     typedef itk::ODFFromSPFImageFilter<VectorImageType, VectorImageType> ODFFromSPFFilterType;
-    ODFFromSPFFilterType::Pointer featureFromSPFFilter = ODFFromSPFFilterType::New();
+    typename ODFFromSPFFilterType::Pointer featureFromSPFFilter = ODFFromSPFFilterType::New();
     if (_MaskFileArg.isSet())
       featureFromSPFFilter->SetMaskImage(maskImage);
     if (_NumberOfThreads>0)
       featureFromSPFFilter->SetNumberOfThreads(_NumberOfThreads);
+    if (_VoxelChunkSize>0)
+      {
+      featureFromSPFFilter->SetUseVoxelList(true);
+      featureFromSPFFilter->SetVoxelChunkSize(_VoxelChunkSize);
+      }
     featureFromSPFFilter->SetSHRank(_SHRank);
     featureFromSPFFilter->SetRadialRank(_RadialRank);
     featureFromSPFFilter->SetMD0(spfiFilter->GetMD0());
@@ -216,12 +362,26 @@ main (int argc, char const* argv[])
     featureFromSPFFilter->SetIsFourier(true);
     featureFromSPFFilter->SetIsInQSpace(true);
     std::cout << "ODF estimation starts" << std::endl << std::flush;
-    featureFromSPFFilter->Update();
+    SaveImageWithMemoryLimit<VectorImageType>(featureFromSPFFilter->GetOutput(), _OutputODFFile, _MemoryLimit, 
+      spf->GetNumberOfComponentsPerPixel()+featureFromSPFFilter->GetOutput()->GetNumberOfComponentsPerPixel(), fixedMemory);
     std::cout << "ODF estimation ends" << std::endl << std::flush;
-    VectorImageType::Pointer odf = featureFromSPFFilter->GetOutput();
-    itk::SaveImage<VectorImageType>(odf, _OutputODFFile);
     }
 
   return 0;
 }
 
+int 
+main (int argc, char const* argv[])
+{
+  // GenerateCLP
+  PARSE_ARGS;
+  
+  utl::LogLevel = _Verbose;
+
+  utlGlobalException(!_OutputEAPProfileFileArg.isSet() && !_OutputODFFileArg.isSet() && !_OutputSPFFileArg.isSet(), "no output");
+
+  if (_UseSinglePrecision)
+    return SphericalPolarFourierImaging<float>(argc, argv);
+  else
+    return SphericalPolarFourierImaging<double>(argc, argv);
+}
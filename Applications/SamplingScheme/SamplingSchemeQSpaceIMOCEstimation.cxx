@@ -32,6 +32,8 @@ main (int argc, char const* argv[])
   
   PARSE_ARGS;
 
+  utl::InitializeOpenMP(_NumberOfThreads);
+
   typedef itk::SamplingSchemeQSpace<double>  SamplingType;
   typedef SamplingType::Pointer  SamplingPointer;
   typedef itk::SamplingSchemeQSpaceIMOCEstimationFilter<SamplingType> EstimationType;
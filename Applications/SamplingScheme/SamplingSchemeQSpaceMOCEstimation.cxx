@@ -0,0 +1,82 @@
+/**
+ *       @file  SamplingSchemeQSpaceMOCEstimation.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "itkSamplingSchemeQSpaceMOCEstimationFilter.h"
+#include "utl.h"
+#include "itkSamplingSchemeQSpaceWriter.h"
+#include "itkSamplingSchemeQSpace.h"
+
+#include "SamplingSchemeQSpaceMOCEstimationCLP.h"
+
+/**
+ * \brief  exact estimation for single and multiple shell sampling scheme using branch-and-bound
+ * \author  Jian Cheng (jian.cheng.1983@gmail.com)
+ */
+int 
+main (int argc, char const* argv[])
+{
+  
+  PARSE_ARGS;
+
+  typedef itk::SamplingSchemeQSpace<double>  SamplingType;
+  typedef SamplingType::Pointer  SamplingPointer;
+  typedef itk::SamplingSchemeQSpaceMOCEstimationFilter<SamplingType> EstimationType;
+  EstimationType::Pointer estimator = EstimationType::New();
+
+  utlGlobalException(_NumberOfSamples.size()==0, "should give the numbers of samples in shells");
+  EstimationType::IndexVectorType numbers(_NumberOfSamples.size());
+  for ( unsigned int i = 0; i < _NumberOfSamples.size(); i += 1 ) 
+    numbers[i] = _NumberOfSamples[i];
+
+  EstimationType::MatrixPointer fineOrientations(new EstimationType::MatrixType());
+
+  estimator->SetDebug(_Debug);
+  estimator->SetNumbersInShell(numbers);
+  estimator->SetTessellationOrder(_Order);
+  if(_FineOrientationsArg.isSet())
+    {
+    fineOrientations = utl::ReadGrad<double>(_FineOrientations, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+    estimator->SetFineOrientations(fineOrientations);
+    }
+  estimator->SetAngleMinChange(_MinChange);
+  estimator->SetTimeLimit(_TimeLimit);
+  estimator->SetStepTimeLimit(_StepTimeLimit);
+  estimator->SetNumberOfThreads(_NumberOfThreads);
+
+  itk::TimeProbe clock;
+  clock.Start();
+  estimator->UpdateOutputData();
+  clock.Stop();
+  std::cout << "Elapsed time : " << clock.GetTotal() << std::endl;
+  utl::PrintVector(estimator->GetAngles(), "separation angles (radian)");
+  if (estimator->GetIsTimeOut())
+    std::cout << "A time limit is reached. The output is the best scheme found, and it may not have the maximal separation angles." << std::endl;
+
+  SamplingPointer output = estimator->GetOutputOrientations();
+  // output->Print(std::cout<<"output");
+
+  typedef itk::SamplingSchemeQSpaceWriter<SamplingType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetSampling(output);
+  writer->SetOrientationFile(_OutputOrientations);
+  writer->SaveSingleShellOn();
+  writer->SaveAllShellsInOneFileOff();
+  writer->Update();
+  
+  return 0;
+}
+
@@ -0,0 +1,91 @@
+/**
+ *       @file  GenerateStoredTables.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "GenerateStoredTablesCLP.h"
+#include "utl.h"
+#include "utlStoredTableFile.h"
+
+/**
+ * \brief  generate the binary file of stored tables used by utl::StoredTableFile
+ */
+int
+main (int argc, char const* argv[])
+{
+  PARSE_ARGS;
+
+  utlGlobalException(_MaxTessOrder<1 || _MaxTessOrder>7, "tess should be in [1,7]");
+  utlGlobalException(_SHRank<0 || _SHRank%2!=0, "sh should be a non-negative even number");
+
+  const std::string directions[7] = {utl::DirectionsT1, utl::DirectionsT2, utl::DirectionsT3, utl::DirectionsT4, utl::DirectionsT5, utl::DirectionsT6, utl::DirectionsT7};
+
+  utl::StoredTableFileWriter writer;
+  std::vector<unsigned> shape;
+  for ( int tess = 1; tess <= 7; ++tess )
+    {
+    std::string file = utl::CreateExpandedPath(directions[tess-1]);
+    if (!utl::IsFileExist(file))
+      {
+      std::cout << "skip " << file << std::endl << std::flush;
+      continue;
+      }
+    // always read text tables, not the stored table file
+    utl_shared_ptr<utl::NDArray<double,2> > grad = utl::ReadGrad<double>(file, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+    shape.resize(2);
+    shape[0] = grad->Rows(), shape[1] = grad->Columns();
+    writer.AddTable(std::string("DirectionsT")+utl::ConvertNumberToString(tess), grad->GetData(), shape);
+    std::cout << "DirectionsT" << tess << ": " << shape[0] << " x " << shape[1] << std::endl << std::flush;
+
+    if (tess<=_MaxTessOrder)
+      {
+      utl_shared_ptr<utl::NDArray<double,2> > shMatrix = utl::ComputeSHMatrix(_SHRank, *grad, CARTESIAN_TO_SPHERICAL);
+      shape[0] = shMatrix->Rows(), shape[1] = shMatrix->Columns();
+      writer.AddTable(std::string("SHMatrixT")+utl::ConvertNumberToString(tess), shMatrix->GetData(), shape);
+      std::cout << "SHMatrixT" << tess << ": " << shape[0] << " x " << shape[1] << std::endl << std::flush;
+      }
+    }
+
+  if (utl::IsFileExist(utl::SH3Itegralhdr))
+    {
+    typedef itk::Image<double,3> ImageType;
+    ImageType::Pointer image = ImageType::New();
+    itk::ReadImage<ImageType>(utl::SH3Itegralhdr, image);
+    ImageType::SizeType size = image->GetLargestPossibleRegion().GetSize();
+    ImageType::IndexType pixelIndex;
+    shape.resize(3);
+    for ( int i = 0; i < 3; ++i ) 
+      shape[i] = size[i];
+    // row-major order, the same as utl::SH3IntegralTable
+    std::vector<double> table(shape[0]*shape[1]*shape[2]);
+    for ( int i = 0, n=0; i < shape[0]; ++i ) 
+      for ( int j = 0; j < shape[1]; ++j ) 
+        for ( int k = 0; k < shape[2]; ++k, ++n ) 
+          {
+          pixelIndex[0]=i, pixelIndex[1]=j, pixelIndex[2]=k;
+          table[n] = image->GetPixel(pixelIndex);
+          }
+    writer.AddTable("SH3Integral", &table[0], shape);
+    std::cout << "SH3Integral: " << shape[0] << " x " << shape[1] << " x " << shape[2] << std::endl << std::flush;
+    }
+  else
+    std::cout << "skip " << utl::SH3Itegralhdr << std::endl << std::flush;
+
+  std::string outFile = _OutputFileArg.isSet() ? _OutputFile : utl::StoredTableFile::GetDefaultFileName();
+  writer.Write(outFile);
+  std::cout << "stored tables are written in " << outFile << std::endl << std::flush;
+
+  return 0;
+}
@@ -20,6 +20,7 @@
 
 #include "itkImageToImageFilter.h"
 #include "itkThreadLogger.h"
+#include "itkVoxelChunkScheduler.h"
 #include "utlSTDHeaders.h"
 #include "utlITKMacro.h"
 
@@ -70,6 +71,10 @@ public:
   typedef TMaskImage                            MaskImageType;
   typedef typename MaskImageType::Pointer       MaskImagePointer;
 
+  typedef VoxelChunkScheduler<OutputImageRegionType>  VoxelChunkSchedulerType;
+  typedef typename VoxelChunkSchedulerType::Pointer   VoxelChunkSchedulerPointer;
+  typedef VoxelChunkIterator<OutputImageRegionType>   VoxelChunkIteratorType;
+
   /** ImageDimension constants */
   itkStaticConstMacro(InputImageDimension, unsigned int,  TInputImage::ImageDimension);
   itkStaticConstMacro(OutputImageDimension, unsigned int, TOutputImage::ImageDimension);
@@ -92,11 +97,22 @@ public:
 
   itkSetGetMacro(LogLevel, int);
 
+  /** If it is true, voxels in the mask are compacted into a list, and processed by threads in chunks of VoxelChunkSize voxels with work stealing.
+   * Voxels out of the mask are set as zero. It is only used in filters which implement ThreadedGenerateDataInVoxels(). */
+  itkSetGetBooleanMacro(UseVoxelList);
+  itkSetGetMacro(VoxelChunkSize, int);
+
   bool IsMaskUsed()
     {
     return !IsImageEmpty(this->m_MaskImage);
     }
 
+  /** Return true if the mask is not used, or the voxel is in the mask using the threshold in IsVoxelInMask.  */
+  bool IsInMask(const typename MaskImageType::IndexType& index)
+    {
+    return !IsMaskUsed() || IsVoxelInMask(this->m_MaskImage->GetPixel(index));
+    }
+
 
 protected:
   MaskedImageToImageFilter();
@@ -124,6 +140,31 @@ protected:
 
   std::string ThreadIDToString() const;
 
+  /** In voxel list mode, voxels in the mask are processed in ThreadedGenerateDataInVoxels() with chunks stolen by threads. 
+   * Otherwise it is the same as ImageSource::GenerateData(). */
+  virtual void GenerateData() ITK_OVERRIDE;
+
+  /** Process voxels in the region of the thread using ThreadedGenerateDataInVoxels().  */
+  virtual void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType threadId) ITK_OVERRIDE;
+
+  /** Process voxels visited by voxelIt. It is the per-voxel loop in both region based threading and voxel list mode.  */
+  virtual void ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId);
+
+  static ITK_THREAD_RETURN_TYPE VoxelListThreaderCallback(void *arg);
+
+  /** Create clones of the filter for all threads if they are not valid. 
+   * It is called at the end of BeforeThreadedGenerateData() in subclasses, after the state shared by clones is computed.
+   * Clones are reused in all regions or chunks of threads, and in following updates (e.g. streamed slabs) if the filter is not modified. 
+   * Return true if clones are created, then subclasses initialize per-thread state in clones. */
+  bool CreateThreadClones();
+
+  /** Clones are valid if they are created for the current number of threads after the last modification of the filter, 
+   * the mask image, and the pipelines of inputs. Subclasses add objects whose state is copied into clones.  */
+  virtual bool IsThreadClonesValid() const;
+
+  /** The clone of the filter for the thread. It should be only used in the thread.  */
+  LightObject* GetThreadClone(ThreadIdType threadId) const;
+
   MaskImagePointer m_MaskImage;
 
   LoggerPointer        m_Logger;
@@ -138,6 +179,15 @@ protected:
    * If it is LOG_LARGE, print some large matrix etc.*/
   int m_LogLevel;
 
+  bool m_UseVoxelList;
+  int m_VoxelChunkSize;
+  /** voxels and chunks in voxel list mode, shared by clones  */
+  VoxelChunkSchedulerPointer m_VoxelChunkScheduler;
+
+  /** per-thread clones, which are not copied into clones  */
+  std::vector<typename LightObject::Pointer> m_ThreadClones;
+  TimeStamp m_ThreadClonesTime;
+
 private:
   MaskedImageToImageFilter(const Self &); //purposely not implemented
   void operator=(const Self &);     //purposely not implemented
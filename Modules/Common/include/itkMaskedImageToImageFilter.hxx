@@ -38,6 +38,9 @@ MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
 
   m_LogLevel= LOG_NORMAL;
 
+  m_UseVoxelList = false;
+  m_VoxelChunkSize = 64;
+
   // NOTE: m_Logger makes the estimation a little bit slower once it is newed, even though it is not used. 
   // m_Logger = itk::ThreadLogger::New();
   // m_LoggerVector= LoggerVectorPointer(new LoggerVectorType())
@@ -87,6 +90,9 @@ MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
   rval->m_LoggerVector = m_LoggerVector;
   rval->m_ThreadID = m_ThreadID;
   rval->m_LogLevel = m_LogLevel;
+  rval->m_UseVoxelList = m_UseVoxelList;
+  rval->m_VoxelChunkSize = m_VoxelChunkSize;
+  rval->m_VoxelChunkScheduler = m_VoxelChunkScheduler;
   rval->SetNumberOfThreads(this->GetNumberOfThreads());
   rval->SetDebug(this->GetDebug());
   return loPtr;
@@ -153,12 +159,135 @@ MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
   utl::InitializeThreadedLibraries(this->GetNumberOfThreads());
 }
 
+template< class TInputImage, class TOutputImage, class TMaskImage >
+void
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::GenerateData()
+{
+  if (!m_UseVoxelList)
+    {
+    Superclass::GenerateData();
+    return;
+    }
+
+  this->AllocateOutputs();
+  this->BeforeThreadedGenerateData();
+
+  OutputImagePointer outputPtr = this->GetOutput();
+  OutputImageRegionType region = outputPtr->GetRequestedRegion();
+  int numberOfThreads = this->GetNumberOfThreads();
+  m_VoxelChunkScheduler = VoxelChunkSchedulerPointer(new VoxelChunkSchedulerType());
+  m_VoxelChunkScheduler->Initialize(region, this->IsMaskUsed() ? this->m_MaskImage.GetPointer() : NULL, numberOfThreads, m_VoxelChunkSize);
+
+  // voxels out of the mask are not visited
+  OutputImagePixelType outputZero;
+  NumericTraits<OutputImagePixelType>::SetLength(outputZero, outputPtr->GetNumberOfComponentsPerPixel());
+  outputZero = NumericTraits<OutputImagePixelType>::ZeroValue(outputZero);
+  outputPtr->FillBuffer(outputZero);
+
+  if (this->GetDebug())
+    std::cout << m_VoxelChunkScheduler->GetNumberOfVoxels() << " voxels in " << region.GetNumberOfPixels() << " voxels are processed by " << numberOfThreads << " threads in chunks of " << m_VoxelChunkSize << " voxels" << std::endl << std::flush;
+
+  this->GetMultiThreader()->SetNumberOfThreads(numberOfThreads);
+  this->GetMultiThreader()->SetSingleMethod(this->VoxelListThreaderCallback, this);
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  if (this->GetDebug())
+    std::cout << m_VoxelChunkScheduler->GetNumberOfStolenChunks() << " chunks are stolen" << std::endl << std::flush;
+
+  this->AfterThreadedGenerateData();
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+ITK_THREAD_RETURN_TYPE
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::VoxelListThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct* info = (MultiThreader::ThreadInfoStruct *)(arg);
+  Self* filter = (Self *)(info->UserData);
+  ThreadIdType threadId = info->ThreadID;
+  VoxelChunkIteratorType voxelIt(filter->m_VoxelChunkScheduler.get(), threadId);
+  filter->ThreadedGenerateDataInVoxels(voxelIt, threadId);
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+void
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType threadId)
+{
+  VoxelChunkIteratorType voxelIt(outputRegionForThread);
+  this->ThreadedGenerateDataInVoxels(voxelIt, threadId);
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+void
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId)
+{
+  itkExceptionMacro(<< "ThreadedGenerateDataInVoxels is not implemented in " << this->GetNameOfClass());
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+bool
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::IsThreadClonesValid() const
+{
+  if (m_ThreadClones.size()!=this->GetNumberOfThreads() || m_ThreadClonesTime.GetMTime()<=this->GetMTime())
+    return false;
+  if (m_MaskImage && m_MaskImage->GetMTime()>=m_ThreadClonesTime.GetMTime())
+    return false;
+  // NOTE: the pipeline MTime of an input is not changed when the data is regenerated for another requested region (e.g. streamed slabs), 
+  // but it is changed when filters in the upstream pipeline are modified.
+  for ( unsigned int i = 0; i < this->GetNumberOfIndexedInputs(); ++i )
+    {
+    const DataObject* input = this->ProcessObject::GetInput(i);
+    if (!input)
+      continue;
+    ModifiedTimeType mtime = input->GetSource() ? input->GetPipelineMTime() : input->GetMTime();
+    if (mtime>=m_ThreadClonesTime.GetMTime())
+      return false;
+    }
+  return true;
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+bool
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::CreateThreadClones()
+{
+  if (this->IsThreadClonesValid())
+    return false;
+
+  int numberOfThreads = this->GetNumberOfThreads();
+  m_ThreadClones.resize(numberOfThreads);
+  for ( int i = 0; i < numberOfThreads; ++i )
+    {
+    // InternalClone() of the subclass is used
+    typename Self::Pointer selfClone = this->Clone();
+    selfClone->m_ThreadID = i;
+    m_ThreadClones[i] = selfClone.GetPointer();
+    }
+  m_ThreadClonesTime.Modified();
+  return true;
+}
+
+template< class TInputImage, class TOutputImage, class TMaskImage >
+LightObject*
+MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
+::GetThreadClone(ThreadIdType threadId) const
+{
+  utlSAException(threadId>=m_ThreadClones.size())(threadId)(m_ThreadClones.size()).msg("need to call CreateThreadClones() in BeforeThreadedGenerateData()");
+  return m_ThreadClones[threadId].GetPointer();
+}
+
 template< class TInputImage, class TOutputImage, class TMaskImage >
 void
 MaskedImageToImageFilter< TInputImage, TOutputImage, TMaskImage >
 ::PrintSelf(std::ostream& os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
+  PrintVar2(true, m_UseVoxelList, m_VoxelChunkSize, os<<indent);
   if (!IsImageEmpty(m_MaskImage))
     os << indent << "MaskImage = " << m_MaskImage << std::endl << std::flush;
 }
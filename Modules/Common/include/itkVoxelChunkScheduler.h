@@ -0,0 +1,302 @@
+/**
+ *       @file  itkVoxelChunkScheduler.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkVoxelChunkScheduler_h
+#define __itkVoxelChunkScheduler_h
+
+#include <vector>
+#include "itkImageRegionConstIterator.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+#include "utlSTDHeaders.h"
+#include "utlCore.h"
+
+namespace itk
+{
+
+/** Voxels with mask values larger than 1e-8 are in the mask. 
+ * It is used by VoxelChunkScheduler and by voxel loops of filters (see MaskedImageToImageFilter::IsInMask), so that both paths process the same voxels.  */
+template <class TValue>
+inline bool
+IsVoxelInMask(const TValue& maskValue)
+{
+  return maskValue>1e-8;
+}
+
+/**
+ *   \class   VoxelChunkScheduler
+ *   \brief   Compacted list of voxels in a mask, which are processed by threads in chunks with work stealing.
+ *
+ *   Voxels in the mask are stored as linear offsets in the region, and split into chunks with ChunkSize voxels.
+ *   Each thread initially owns a contiguous range of chunks, which keeps neighboring voxels in the same thread (e.g. for warm starts).
+ *   A thread takes chunks from the front of its own range.
+ *   When its range is empty, it steals one chunk from the back of the range with the most remaining chunks.
+ *   Thus the load balance depends neither on the geometry of the mask nor on the cost of voxels.
+ *
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *   \ingroup Common
+ */
+template <class TRegion>
+class VoxelChunkScheduler
+{
+public:
+  typedef VoxelChunkScheduler                 Self;
+  typedef utl_shared_ptr<Self>                Pointer;
+
+  typedef TRegion                             RegionType;
+  typedef typename RegionType::IndexType      IndexType;
+  typedef typename RegionType::SizeType       SizeType;
+  typedef std::vector<OffsetValueType>        VoxelListType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, RegionType::ImageDimension);
+
+  VoxelChunkScheduler() : m_ChunkSize(64) {}
+
+  /** Compact voxels in region where IsVoxelInMask() is true (all voxels if mask is NULL), and assign chunks to numberOfThreads threads.  */
+  template <class TMaskImage>
+  void Initialize(const RegionType& region, const TMaskImage* mask, const int numberOfThreads, const int chunkSize)
+    {
+    utlSAGlobalException(numberOfThreads<=0 || chunkSize<=0)(numberOfThreads)(chunkSize).msg("wrong number of threads or chunk size");
+    m_Region = region;
+    m_ChunkSize = chunkSize;
+    m_Voxels.clear();
+    if (mask)
+      {
+      ImageRegionConstIterator<TMaskImage> maskIt(mask, region);
+      OffsetValueType offset=0;
+      for ( maskIt.GoToBegin(); !maskIt.IsAtEnd(); ++maskIt, ++offset )
+        {
+        if (IsVoxelInMask(maskIt.Get()))
+          m_Voxels.push_back(offset);
+        }
+      }
+    else
+      {
+      m_Voxels.resize(region.GetNumberOfPixels());
+      for ( OffsetValueType i = 0; i < m_Voxels.size(); ++i )
+        m_Voxels[i] = i;
+      }
+
+    long numberOfChunks = (m_Voxels.size()+m_ChunkSize-1)/m_ChunkSize;
+    m_Queues.resize(numberOfThreads);
+    for ( int i = 0; i < numberOfThreads; ++i )
+      {
+      m_Queues[i] = utl_shared_ptr<QueueType>(new QueueType());
+      m_Queues[i]->Front = numberOfChunks*i/numberOfThreads;
+      m_Queues[i]->Back = numberOfChunks*(i+1)/numberOfThreads;
+      m_Queues[i]->NumberOfStolenChunks = 0;
+      }
+    }
+
+  /** Get the next chunk of voxels [begin, end) for the thread. Return false if all chunks are taken. Thread-safe.  */
+  bool GetNextChunk(const int threadId, SizeValueType& begin, SizeValueType& end)
+    {
+    long chunk = -1;
+      {
+      QueueType& queue = *m_Queues[threadId];
+      MutexLockHolder<SimpleFastMutexLock> holder(queue.Mutex);
+      if (queue.Front<queue.Back)
+        chunk = queue.Front++;
+      }
+    if (chunk<0)
+      chunk = StealChunk(threadId);
+    if (chunk<0)
+      return false;
+    begin = chunk*m_ChunkSize;
+    end = utl::min<SizeValueType>(begin+m_ChunkSize, (SizeValueType)m_Voxels.size());
+    return true;
+    }
+
+  /** index of the i-th voxel in the list */
+  IndexType GetIndex(const SizeValueType i) const
+    {
+    return ComputeIndex(m_Region, m_Voxels[i]);
+    }
+
+  /** index of the voxel with the linear offset in region */
+  static IndexType ComputeIndex(const RegionType& region, OffsetValueType offset)
+    {
+    IndexType index = region.GetIndex();
+    const SizeType& size = region.GetSize();
+    for ( int d = 0; d < ImageDimension; ++d )
+      {
+      index[d] += offset % size[d];
+      offset /= size[d];
+      }
+    return index;
+    }
+
+  SizeValueType GetNumberOfVoxels() const {return m_Voxels.size();}
+  int GetNumberOfThreads() const {return m_Queues.size();}
+  int GetChunkSize() const {return m_ChunkSize;}
+  const RegionType& GetRegion() const {return m_Region;}
+
+  long GetNumberOfStolenChunks() const
+    {
+    long num=0;
+    for ( int i = 0; i < m_Queues.size(); ++i )
+      {
+      MutexLockHolder<SimpleFastMutexLock> holder(m_Queues[i]->Mutex);
+      num += m_Queues[i]->NumberOfStolenChunks;
+      }
+    return num;
+    }
+
+protected:
+  /** chunks [Front, Back) owned by a thread  */
+  struct QueueType
+    {
+    long Front;
+    long Back;
+    long NumberOfStolenChunks;
+    SimpleFastMutexLock Mutex;
+    };
+
+  long StealChunk(const int threadId)
+    {
+    while (true)
+      {
+      int victim=-1;
+      long maxRemaining=0;
+      for ( int i = 0; i < m_Queues.size(); ++i )
+        {
+        if (i==threadId)
+          continue;
+        MutexLockHolder<SimpleFastMutexLock> holder(m_Queues[i]->Mutex);
+        long remaining = m_Queues[i]->Back - m_Queues[i]->Front;
+        if (remaining>maxRemaining)
+          {
+          maxRemaining = remaining;
+          victim = i;
+          }
+        }
+      if (victim<0)
+        return -1;
+
+      QueueType& queue = *m_Queues[victim];
+      MutexLockHolder<SimpleFastMutexLock> holder(queue.Mutex);
+      // the victim or other thieves may have taken the chunks meanwhile, then try again
+      if (queue.Front<queue.Back)
+        {
+        queue.NumberOfStolenChunks++;
+        return --queue.Back;
+        }
+      }
+    }
+
+  RegionType m_Region;
+  VoxelListType m_Voxels;
+  int m_ChunkSize;
+  std::vector<utl_shared_ptr<QueueType> > m_Queues;
+
+private:
+  VoxelChunkScheduler(const Self&);  //purposely not implemented
+  void operator=(const Self&);  //purposely not implemented
+};
+
+
+/**
+ *   \class   VoxelChunkIterator
+ *   \brief   Iterate voxels in a region, or voxels in the chunks which a thread gets from VoxelChunkScheduler.
+ *
+ *   It is used in per-voxel filters, so that the same loop is used in region based threading and in voxel list mode.
+ *
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *   \ingroup Common
+ */
+template <class TRegion>
+class VoxelChunkIterator
+{
+public:
+  typedef VoxelChunkIterator                  Self;
+  typedef VoxelChunkScheduler<TRegion>        SchedulerType;
+  typedef TRegion                             RegionType;
+  typedef typename RegionType::IndexType      IndexType;
+
+  /** iterate all voxels in region  */
+  VoxelChunkIterator(const RegionType& region) : m_Scheduler(NULL), m_ThreadID(0), m_Region(region), m_Begin(0), m_Current(0), m_End(0)
+    {
+    }
+
+  /** iterate voxels in chunks of the scheduler for the thread  */
+  VoxelChunkIterator(SchedulerType* scheduler, const int threadId) : m_Scheduler(scheduler), m_ThreadID(threadId), m_Begin(0), m_Current(0), m_End(0)
+    {
+    }
+
+  void GoToBegin()
+    {
+    if (m_Scheduler)
+      {
+      if (!m_Scheduler->GetNextChunk(m_ThreadID, m_Current, m_End))
+        m_Current = m_End = 0;
+      }
+    else
+      {
+      m_Current = 0;
+      m_End = m_Region.GetNumberOfPixels();
+      }
+    m_Begin = m_Current;
+    }
+
+  bool IsAtEnd() const
+    {
+    return m_Current>=m_End;
+    }
+
+  Self& operator++()
+    {
+    ++m_Current;
+    if (m_Scheduler && m_Current>=m_End)
+      {
+      if (!m_Scheduler->GetNextChunk(m_ThreadID, m_Current, m_End))
+        m_Current = m_End = 0;
+      m_Begin = m_Current;
+      }
+    return *this;
+    }
+
+  /** true for the first voxel of a chunk (or of the region). 
+   * Chunks may be stolen by other threads, thus state carried between voxels (e.g. warm starts) should be reset here 
+   * to make results independent of thread scheduling. */
+  bool IsAtChunkBegin() const
+    {
+    return m_Current==m_Begin;
+    }
+
+  IndexType GetIndex() const
+    {
+    return m_Scheduler ? m_Scheduler->GetIndex(m_Current) : SchedulerType::ComputeIndex(m_Region, m_Current);
+    }
+
+  /** expected number of voxels visited by the iterator, which is used for progress report.  */
+  SizeValueType GetNumberOfVoxels() const
+    {
+    return m_Scheduler ? (m_Scheduler->GetNumberOfVoxels()+m_Scheduler->GetNumberOfThreads()-1)/m_Scheduler->GetNumberOfThreads() : m_Region.GetNumberOfPixels();
+    }
+
+private:
+  SchedulerType* m_Scheduler;
+  int m_ThreadID;
+  RegionType m_Region;
+  SizeValueType m_Begin;
+  SizeValueType m_Current;
+  SizeValueType m_End;
+};
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ *       @file  itkVoxelChunkSchedulerGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+#include "itksys/SystemTools.hxx"
+#include "itkVoxelChunkScheduler.h"
+
+namespace
+{
+typedef itk::Image<double,3>                         MaskImageType;
+typedef MaskImageType::RegionType                    RegionType;
+typedef itk::VoxelChunkScheduler<RegionType>         SchedulerType;
+typedef itk::VoxelChunkIterator<RegionType>          IteratorType;
+
+/** mask of a ball in a 20x16x10 image  */
+MaskImageType::Pointer
+CreateMaskImage()
+{
+  MaskImageType::Pointer mask = MaskImageType::New();
+  MaskImageType::SizeType size;
+  size[0]=20, size[1]=16, size[2]=10;
+  MaskImageType::IndexType start;
+  start[0]=2, start[1]=-3, start[2]=0;
+  mask->SetRegions(RegionType(start, size));
+  mask->Allocate();
+  itk::ImageRegionIteratorWithIndex<MaskImageType> it(mask, mask->GetLargestPossibleRegion());
+  for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+    MaskImageType::IndexType index = it.GetIndex();
+    double x=index[0]-12, y=index[1]-5, z=index[2]-5;
+    it.Set(x*x+y*y+z*z<=25 ? 1.0 : 0.0);
+    }
+  return mask;
+}
+
+struct VisitStruct
+  {
+  SchedulerType* Scheduler;
+  MaskImageType* Visits;
+  };
+
+ITK_THREAD_RETURN_TYPE
+VisitThreaderCallback(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* info = (itk::MultiThreader::ThreadInfoStruct *)(arg);
+  VisitStruct* str = (VisitStruct *)(info->UserData);
+  IteratorType voxelIt(str->Scheduler, info->ThreadID);
+  // thread 0 is slow, other threads steal its chunks
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt )
+    {
+    if (info->ThreadID==0)
+      itksys::SystemTools::Delay(1);
+    // each voxel is visited by only one thread, then there is no race
+    str->Visits->SetPixel(voxelIt.GetIndex(), str->Visits->GetPixel(voxelIt.GetIndex())+1);
+    }
+  return ITK_THREAD_RETURN_VALUE;
+}
+}
+
+TEST(itkVoxelChunkScheduler, ComputeIndex)
+{
+  MaskImageType::Pointer mask = CreateMaskImage();
+  RegionType region = mask->GetLargestPossibleRegion();
+  IteratorType voxelIt(region);
+  itk::ImageRegionIteratorWithIndex<MaskImageType> it(mask, region);
+  int num=0;
+  for ( voxelIt.GoToBegin(), it.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt, ++it, ++num )
+    EXPECT_EQ(it.GetIndex(), voxelIt.GetIndex());
+  EXPECT_EQ(region.GetNumberOfPixels(), (itk::SizeValueType)num);
+  EXPECT_EQ(region.GetNumberOfPixels(), voxelIt.GetNumberOfVoxels());
+}
+
+TEST(itkVoxelChunkScheduler, SingleThreadStealsAllChunks)
+{
+  MaskImageType::Pointer mask = CreateMaskImage();
+  SchedulerType scheduler;
+  scheduler.Initialize(mask->GetLargestPossibleRegion(), mask.GetPointer(), 4, 7);
+
+  int numberOfVoxelsInMask=0;
+  itk::ImageRegionIteratorWithIndex<MaskImageType> it(mask, mask->GetLargestPossibleRegion());
+  for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    numberOfVoxelsInMask += it.Get()>0 ? 1 : 0;
+  EXPECT_EQ(numberOfVoxelsInMask, (int)scheduler.GetNumberOfVoxels());
+
+  std::vector<int> visits(scheduler.GetNumberOfVoxels(), 0);
+  itk::SizeValueType begin, end;
+  while (scheduler.GetNextChunk(0, begin, end))
+    {
+    EXPECT_LE(end-begin, 7u);
+    for ( itk::SizeValueType i = begin; i < end; ++i )
+      {
+      visits[i]++;
+      EXPECT_GT(mask->GetPixel(scheduler.GetIndex(i)), 0);
+      }
+    }
+  for ( int i = 0; i < visits.size(); ++i )
+    EXPECT_EQ(1, visits[i]);
+  // chunks of threads 1,2,3 are stolen by thread 0
+  EXPECT_GT(scheduler.GetNumberOfStolenChunks(), 0);
+  EXPECT_FALSE(scheduler.GetNextChunk(2, begin, end));
+}
+
+TEST(itkVoxelChunkScheduler, MultiThreads)
+{
+  MaskImageType::Pointer mask = CreateMaskImage();
+  MaskImageType::Pointer visits = MaskImageType::New();
+  visits->CopyInformation(mask);
+  visits->SetRegions(mask->GetLargestPossibleRegion());
+  visits->Allocate();
+  visits->FillBuffer(0.0);
+
+  int numberOfThreads = 4;
+  SchedulerType scheduler;
+  scheduler.Initialize(mask->GetLargestPossibleRegion(), mask.GetPointer(), numberOfThreads, 5);
+
+  VisitStruct str;
+  str.Scheduler = &scheduler;
+  str.Visits = visits.GetPointer();
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(VisitThreaderCallback, &str);
+  threader->SingleMethodExecute();
+
+  itk::ImageRegionIteratorWithIndex<MaskImageType> it(mask, mask->GetLargestPossibleRegion());
+  for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    EXPECT_EQ(it.Get()>0 ? 1.0 : 0.0, visits->GetPixel(it.GetIndex()));
+}
+
+TEST(itkVoxelChunkScheduler, MaskThreshold)
+{
+  // small positive mask values are out of the mask, which is the same as mask checks in voxel loops of filters
+  MaskImageType::Pointer mask = CreateMaskImage();
+  MaskImageType::IndexType index;
+  index[0]=12, index[1]=5, index[2]=5;
+  mask->SetPixel(index, 1e-9);
+  EXPECT_FALSE(itk::IsVoxelInMask(mask->GetPixel(index)));
+
+  SchedulerType scheduler;
+  scheduler.Initialize(mask->GetLargestPossibleRegion(), mask.GetPointer(), 2, 5);
+
+  int numberOfVoxelsInMask=0;
+  itk::ImageRegionIteratorWithIndex<MaskImageType> it(mask, mask->GetLargestPossibleRegion());
+  for ( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    numberOfVoxelsInMask += itk::IsVoxelInMask(it.Get()) ? 1 : 0;
+  EXPECT_EQ(numberOfVoxelsInMask, (int)scheduler.GetNumberOfVoxels());
+  for ( itk::SizeValueType i = 0; i < scheduler.GetNumberOfVoxels(); ++i )
+    EXPECT_NE(index, scheduler.GetIndex(i));
+}
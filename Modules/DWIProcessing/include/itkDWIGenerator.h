@@ -16,6 +16,7 @@
 
 
 #include "itkDWIGeneratorBase.h"
+#include "itkVoxelChunkScheduler.h"
 
 namespace itk
 {
@@ -23,6 +24,11 @@ namespace itk
 /** \class DWIGenerator
  *  \brief Generate DWI data based on provided parameter file.
  *
+ *  Signals are computed once for each distinct parameter set in the parameter file, and for the background, in multiple threads.
+ *  Then voxels are filled in multiple threads. If there are more than MaxNumberOfStoredSignals distinct parameter sets, 
+ *  signals are not stored, and they are computed in each voxel when voxels are filled. Rician noise in a voxel uses a counter-based random stream keyed by RandomSeed and the voxel offset,
+ *  thus the output is the same for any number of threads.
+ *
  *  \ingroup DWIProcessing
  *  \author  Pew-Thian Yap, Jian Cheng
  */
@@ -77,6 +83,18 @@ public:
   itkSetNDebugMacro( BackgroundDiffusionParameterValues, STDVectorType );
   itkGetMacro( BackgroundDiffusionParameterValues, STDVectorType );
     
+  /** Seed of the noise. If it is negative, the current time is used.  */
+  itkSetGetMacro( RandomSeed, long );
+
+  /** Maximal number of distinct parameter sets whose signals are stored and shared by voxels.  */
+  itkSetGetMacro( MaxNumberOfStoredSignals, int );
+
+  typedef Image<int, OutputImageDimension>                SignalIDImageType;
+  typedef typename SignalIDImageType::Pointer             SignalIDImagePointer;
+  
+  typedef VoxelChunkScheduler<OutputImageRegionType>      VoxelChunkSchedulerType;
+  typedef utl_shared_ptr<VoxelChunkSchedulerType>         VoxelChunkSchedulerPointer;
+  typedef VoxelChunkIterator<OutputImageRegionType>       VoxelChunkIteratorType;
 
   /** Specify the files to read. */
   itkSetStringMacro(FileName);
@@ -92,10 +110,59 @@ protected:
   /** Does the real work. */
   void GenerateData();
   
+  /** Noise free signals of a parameter set, shared by all voxels with the same parameters.  */
+  struct SignalType
+    {
+    /** parameter sets without the voxel index  */
+    DiffusionParameterValuesType Parameters;
+    double B0;
+    OutputImagePixelType DWI;
+    OutputImagePixelType ODF;
+    OutputImagePixelType EAP;
+    OutputImagePixelType Peak;
+    double RTO;
+    double MSD;
+    /** sigma of Rician noise. No noise if it is not positive.  */
+    double NoiseSigma;
+    };
+
+  /** numbers of components in a parameter set of m_ModelType, including the volume fraction */
+  void GetParameterSetSize(int& numberOfOrientationComponents, int& numberOfDiffusivityComponents, int& numberOfComponents) const;
+
+  /** compute signals and the sigma of noise from signal.Parameters and signal.B0. Thread-safe if different cylinder models are used. */
+  void ComputeSignal(SignalType& signal, CylinderModelType* cylinder) const;
+
+  static ITK_THREAD_RETURN_TYPE SignalThreaderCallback(void *arg);
+  static ITK_THREAD_RETURN_TYPE VoxelThreaderCallback(void *arg);
+
+  /** fill voxels from m_Signals. Signals are computed in voxels using cylinder if they are not stored.  */
+  void ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId, CylinderModelType* cylinder);
+  
   std::string m_FileName;
   
   STDVectorType m_BackgroundDiffusionParameterValues;
 
+  long m_RandomSeed;
+
+  int m_MaxNumberOfStoredSignals;
+
+  /** distinct parameter sets in the parameter file, and the background  */
+  std::vector<SignalType> m_Signals;
+  /** true if signals of all parameter sets are stored in m_Signals. Otherwise only parameters are stored, except the background.  */
+  bool m_IsSignalStored;
+  /** index in m_Signals of the background, -1 if there is no background  */
+  int m_BackgroundSignalID;
+  /** index in m_Signals of voxels, -1 for background voxels  */
+  SignalIDImagePointer m_SignalIDImage;
+  
+  VoxelChunkSchedulerPointer m_VoxelChunkScheduler;
+
+  /** seed used in the current update  */
+  unsigned long long m_NoiseSeed;
+  /** sigma and SNR of Rician noise used in the current update  */
+  double m_RicianNoiseSigma;
+  double m_RicianNoiseSNR;
+
 private:
   DWIGenerator(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
@@ -20,6 +20,7 @@
 #include "itkDiffusionTensor.h"
 #include "utlRotationMatrixFromVectors.h"
 #include "itksys/SystemTools.hxx"
+#include <map>
 
 #include "utl.h"
 
@@ -30,6 +31,13 @@ template <class TOutputImage, class TScalarImage>
 DWIGenerator<TOutputImage, TScalarImage>
 ::DWIGenerator() : Superclass()
 {
+  m_RandomSeed = -1;
+  m_MaxNumberOfStoredSignals = 100000;
+  m_IsSignalStored = true;
+  m_BackgroundSignalID = -1;
+  m_NoiseSeed = 0;
+  m_RicianNoiseSigma = -1;
+  m_RicianNoiseSNR = -1;
 }
 
 template <class TOutputImage, class TScalarImage>
@@ -44,6 +52,7 @@ void DWIGenerator<TOutputImage, TScalarImage>
 {
   Superclass::PrintSelf(os, indent);
   os << indent << "FileName: " << m_FileName << std::endl;
+  PrintVar4(true, m_RandomSeed, m_MaxNumberOfStoredSignals, m_Signals.size(), m_IsSignalStored, os<<indent);
 }
 
 template <class TOutputImage, class TScalarImage>
@@ -61,6 +70,8 @@ DWIGenerator<TOutputImage, TScalarImage>
   
   rval->m_BackgroundDiffusionParameterValues = m_BackgroundDiffusionParameterValues;
   rval->m_FileName = m_FileName;
+  rval->m_RandomSeed = m_RandomSeed;
+  rval->m_MaxNumberOfStoredSignals = m_MaxNumberOfStoredSignals;
   return loPtr;
 }
 
@@ -72,24 +83,9 @@ void DWIGenerator<TOutputImage, TScalarImage>
   
   this->Initialization();
 
-  bool isOutputPeak = this->m_MaxNumberOfPeaks>0;
-  
-  MatrixPointer qSpaceOrientationMatrix = this->m_SamplingSchemeQSpace->GetOrientationsCartesian();
-  STDVectorPointer bVector = this->m_SamplingSchemeQSpace->GetBVector();
-  MatrixPointer rSpaceOrientationMatrix = this->m_SamplingSchemeRSpace->GetOrientationsCartesian();
-  STDVectorPointer rVector = this->m_SamplingSchemeRSpace->GetRadiusVector();
-  double tau = this->m_SamplingSchemeQSpace->GetTau();
   if (this->GetDebug())
-    std::cout << "tau = " << tau << std::endl << std::flush;
+    std::cout << "tau = " << this->m_SamplingSchemeQSpace->GetTau() << std::endl << std::flush;
   
-  int numberOfComponentsPerPixel4Peak = isOutputPeak?PeakContainerHelper::GetDimension(this->m_PeakType,this->m_MaxNumberOfPeaks):-1;
-  // utlSAGlobalException(isOutputPeak && numberOfParameterSets>PeakContainerHelper::GetNumberOfPeaks(this->m_PeakType,numberOfComponentsPerPixel4Peak))(numberOfParameterSets)(numberOfComponentsPerPixel4Peak).msg("wrong peak size");
-  OutputImagePixelType pixelPeak;
-  if (isOutputPeak)
-    {
-    pixelPeak.SetSize(numberOfComponentsPerPixel4Peak);
-    }
-      
   // Parse parameter file
   // This section should be rewritten to support generic image dimension
 //  char * pch;
@@ -222,92 +218,246 @@ void DWIGenerator<TOutputImage, TScalarImage>
   // allocate all outputs
   this->AllocateOutputs();
 
-  // typename OutputImageType::Pointer outputPtr = this->GetOutput();
-  OutputImagePointer outputDWI=this->GetDWIImage(), outputODF=this->GetODFImage(), outputEAP=this->GetEAPImage(), outputPeak=this->GetPeakImage();
-  ScalarImagePointer b0Image = this->GetB0Image(), outputRTO = this->GetRTOImage(), outputMSD = this->GetMSDImage();
-  OutputImagePixelType pixelDWI, tempPixelDWI, pixelEAP, tempPixelEAP, pixelODF, tempPixelODF;
-  double pixelRTO=0, tempPixelRTO=0, pixelMSD=0, tempPixelMSD=0;  
-  unsigned int numberOfComponentsPerPixel4DWI = this->GetNumberOfQSpaceSamples();
-  unsigned int numberOfComponentsPerPixel4EAP = this->GetNumberOfRSpaceSamples();
-  unsigned int numberOfComponentsPerPixel4ODF = this->GetNumberOfRSpaceSamples();
-  OutputImagePixelType zeroPixel;
-  if (this->m_IsOutputDWI)
+  int numberOfOrientationComponentsPerParameterSet=-1, numberOfDiffusivityComponentsPerParameterSet=-1, numberOfComponentsPerParameterSet=-1;
+  GetParameterSetSize(numberOfOrientationComponentsPerParameterSet, numberOfDiffusivityComponentsPerParameterSet, numberOfComponentsPerParameterSet);
+  bool isCylinderModel = this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL;
+  
+  if (m_BackgroundDiffusionParameterValues.size()>0)
+    backgroundDiffusionParameterValues = m_BackgroundDiffusionParameterValues;
+
+  utlGlobalException(isCylinderModel && diffusionParameterContainer.size()>0 && (this->m_IsOutputODF || this->m_IsOutputEAP || this->m_IsOutputRTO || this->m_IsOutputMSD), 
+    "TODO: to be implemented. Only DWI and peaks are supported in cylinder model.");
+  
+  // Distinct parameter sets. Voxels with the same parameters (e.g. the same tissue label) share the signals.
+  typedef std::map<DiffusionParameterValuesType, int> SignalIDMapType;
+  SignalIDMapType signalIDMap;
+  m_Signals.clear();
+  m_BackgroundSignalID = -1;
+
+  OutputImageRegionType outputRegion;
+  OutputImageIndexType outputStartIndex;
+  outputStartIndex.Fill(0);
+  outputRegion.SetIndex( outputStartIndex );
+  outputRegion.SetSize( this->m_OutputSize );  
+  m_SignalIDImage = SignalIDImageType::New();
+  m_SignalIDImage->SetRegions( outputRegion );
+  m_SignalIDImage->Allocate();
+  m_SignalIDImage->FillBuffer( -1 );
+  
+  OutputImageIndexType index;
+  SignalType signal;
+  for ( unsigned int k=0; k<diffusionParameterContainer.size(); k++ )
     {
-    pixelDWI.SetSize( numberOfComponentsPerPixel4DWI );
-    pixelDWI.Fill( 0 );
-    tempPixelDWI.SetSize( numberOfComponentsPerPixel4DWI );
-    tempPixelDWI.Fill( 0 );
+    diffusionParameterValues = diffusionParameterContainer[k];
+
+    for ( unsigned int dim=0; dim<ndims; dim++ )
+      {
+      index[dim] = diffusionParameterValues[dim];
+      }
+    if (this->GetDebug())
+      {
+      std::cout << "index = " << index << std::endl << std::flush;
+      utl::PrintVector(diffusionParameterValues, "diffusionParameterValues");
+      }
+    utlSAGlobalException(!outputRegion.IsInside(index))(index).msg("the voxel is out of the image");
+    
+    // 3 elements for directions, 2 elements for diffusivities
+    utlSAGlobalException(!utl::IsInt( (1.0*diffusionParameterValues.size()-ndims)/numberOfComponentsPerParameterSet) )(diffusionParameterValues.size())(ndims)(numberOfComponentsPerParameterSet).msg("wrong diffusion parameter size");
+
+    signal.Parameters = DiffusionParameterValuesType(diffusionParameterValues.begin()+ndims, diffusionParameterValues.end());
+    typename SignalIDMapType::const_iterator iter = signalIDMap.find(signal.Parameters);
+    if (iter!=signalIDMap.end())
+      m_SignalIDImage->SetPixel(index, iter->second);
+    else
+      {
+      signal.B0 = scale;
+      m_Signals.push_back(signal);
+      signalIDMap[signal.Parameters] = m_Signals.size()-1;
+      m_SignalIDImage->SetPixel(index, m_Signals.size()-1);
+      }
     }
-  if (this->m_IsOutputEAP)
+    
+  // Background      
+  if ( backgroundDiffusionParameterValues.size() > 0 )
     {
-    pixelEAP.SetSize( numberOfComponentsPerPixel4EAP );
-    pixelEAP.Fill( 0 );
-    tempPixelEAP.SetSize( numberOfComponentsPerPixel4EAP );
-    tempPixelEAP.Fill( 0 );
+    signal.Parameters = backgroundDiffusionParameterValues;
+    signal.B0 = backgroundScale;
+    m_Signals.push_back(signal);
+    m_BackgroundSignalID = m_Signals.size()-1;
     }
-  if (this->m_IsOutputODF)
+  
+  // if most parameter sets are different, signals are computed in each voxel, instead of storing signals of all sets
+  m_IsSignalStored = (int)m_Signals.size()<=m_MaxNumberOfStoredSignals;
+  if (this->GetDebug())
+    std::cout << m_Signals.size() << " distinct parameter sets in " << diffusionParameterContainer.size() << " voxels, signals are " << (m_IsSignalStored?"":"not ") << "stored" << std::endl << std::flush;
+
+  for ( int i = 0; i < m_Signals.size(); ++i )
     {
-    pixelODF.SetSize( numberOfComponentsPerPixel4ODF );
-    pixelODF.Fill( 0 );
-    tempPixelODF.SetSize( numberOfComponentsPerPixel4ODF );
-    tempPixelODF.Fill( 0 );
+    int numberOfParameterSets = m_Signals[i].Parameters.size()/numberOfComponentsPerParameterSet;
+    PrecisionType sumPartialVolumeWeight=0.0;
+    for ( int s = 0; s < numberOfParameterSets; ++s )
+      sumPartialVolumeWeight += m_Signals[i].Parameters[s*numberOfComponentsPerParameterSet + numberOfOrientationComponentsPerParameterSet + numberOfDiffusivityComponentsPerParameterSet];
+    utlException(sumPartialVolumeWeight<1e-9, "wrong partialVolumeWeight");
+    }
+  
+  if (isCylinderModel)
+    {
+    this->m_CylinderModel->SetDebug(this->GetDebug());
+    this->m_CylinderModel->SetSamplingSchemeQSpace(this->m_SamplingSchemeQSpace);
+    this->m_CylinderModel->SetSamplingSchemeRSpace(this->m_SamplingSchemeRSpace);
+    this->m_CylinderModel->BuildTable();
     }
 
-  OutputImageIndexType index;
+  m_RicianNoiseSigma = sigma;
+  m_RicianNoiseSNR = snr;
 
-    
-  // Convenient variables
-  int numberOfParameterSets = -1;
-  unsigned int numberOfOrientationComponentsPerParameterSet = 3;
-  int numberOfComponentsPerParameterSet = -1; // Added partial volume fractions
-  int numberOfDiffusivityComponentsPerParameterSet = -1;
-  
-  bool isTensorModel=false;
-  DiffusionTensor<double> tensor;
+  int numberOfThreads = this->GetNumberOfThreads();
+  this->GetMultiThreader()->SetNumberOfThreads(numberOfThreads);
+  this->GetMultiThreader()->SetSingleMethod(this->SignalThreaderCallback, this);
+  this->GetMultiThreader()->SingleMethodExecute();
 
-  bool isCylinderModel=false;
-  typename CylinderModelType::PointType cylinderAxis;
-  typename CylinderModelType::VectorPointer tempPixelDWIVec, tempPixelODFVec, tempPixelEAPVec;
+  m_NoiseSeed = m_RandomSeed>=0 ? m_RandomSeed : std::time(NULL);
+  if (this->GetDebug())
+    std::cout << "random seed = " << m_NoiseSeed << std::endl << std::flush;
+
+  // Set pixels
+  m_VoxelChunkScheduler = VoxelChunkSchedulerPointer(new VoxelChunkSchedulerType());
+  m_VoxelChunkScheduler->Initialize(outputRegion, (const SignalIDImageType*)NULL, numberOfThreads, 1024);
+  this->GetMultiThreader()->SetSingleMethod(this->VoxelThreaderCallback, this);
+  this->GetMultiThreader()->SingleMethodExecute();
+
+  m_VoxelChunkScheduler = VoxelChunkSchedulerPointer();
+  m_SignalIDImage = NULL;
+}
 
+template <class TOutputImage, class TScalarImage>
+void 
+DWIGenerator<TOutputImage, TScalarImage>
+::GetParameterSetSize(int& numberOfOrientationComponents, int& numberOfDiffusivityComponents, int& numberOfComponents) const
+{
   if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_CARTESIAN_COORDS)
     {
-    numberOfDiffusivityComponentsPerParameterSet=2;
-    numberOfOrientationComponentsPerParameterSet = 3;
-    numberOfComponentsPerParameterSet = 6;
-    isTensorModel = true;
+    numberOfDiffusivityComponents=2;
+    numberOfOrientationComponents = 3;
+    numberOfComponents = 6;
     }
   else if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS)
     {
-    numberOfDiffusivityComponentsPerParameterSet=2;
-    numberOfOrientationComponentsPerParameterSet = 2;
-    numberOfComponentsPerParameterSet = 5;
-    isTensorModel = true;
+    numberOfDiffusivityComponents=2;
+    numberOfOrientationComponents = 2;
+    numberOfComponents = 5;
     }
   else if (this->m_ModelType==Superclass::TENSOR_IN_EULER_ANGLES)
     {
-    numberOfDiffusivityComponentsPerParameterSet=3;
-    numberOfOrientationComponentsPerParameterSet = 3;
-    numberOfComponentsPerParameterSet = 7;
-    isTensorModel = true;
+    numberOfDiffusivityComponents=3;
+    numberOfOrientationComponents = 3;
+    numberOfComponents = 7;
     utlGlobalException(true, "TODO");
     }
   else if (this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
     {
-    numberOfDiffusivityComponentsPerParameterSet=0;
-    numberOfOrientationComponentsPerParameterSet = 2;
-    numberOfComponentsPerParameterSet = 3;
-    isCylinderModel = true;
+    numberOfDiffusivityComponents=0;
+    numberOfOrientationComponents = 2;
+    numberOfComponents = 3;
+    }
+  else
+    utlGlobalException(true, "wrong model type");
+}
+
+template <class TOutputImage, class TScalarImage>
+ITK_THREAD_RETURN_TYPE
+DWIGenerator<TOutputImage, TScalarImage>
+::SignalThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct* info = (MultiThreader::ThreadInfoStruct *)(arg);
+  Self* filter = (Self *)(info->UserData);
+  ThreadIdType threadId = info->ThreadID;
+  ThreadIdType numberOfThreads = info->NumberOfThreads;
+
+  // cylinder model has states, then each thread uses a clone which shares the series terms
+  CylinderModelPointer cylinder;
+  if (filter->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
+    cylinder = filter->m_CylinderModel->Clone();
+  for ( int i = threadId; i < filter->m_Signals.size(); i += numberOfThreads )
+    {
+    if (filter->m_IsSignalStored || i==filter->m_BackgroundSignalID)
+      filter->ComputeSignal(filter->m_Signals[i], cylinder);
     }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+template <class TOutputImage, class TScalarImage>
+ITK_THREAD_RETURN_TYPE
+DWIGenerator<TOutputImage, TScalarImage>
+::VoxelThreaderCallback(void *arg)
+{
+  MultiThreader::ThreadInfoStruct* info = (MultiThreader::ThreadInfoStruct *)(arg);
+  Self* filter = (Self *)(info->UserData);
+  ThreadIdType threadId = info->ThreadID;
+  VoxelChunkIteratorType voxelIt(filter->m_VoxelChunkScheduler.get(), threadId);
+  CylinderModelPointer cylinder;
+  if (!filter->m_IsSignalStored && filter->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
+    cylinder = filter->m_CylinderModel->Clone();
+  filter->ThreadedGenerateDataInVoxels(voxelIt, threadId, cylinder);
+  return ITK_THREAD_RETURN_VALUE;
+}
 
-  utlGlobalException(!isTensorModel && !isCylinderModel, "wrong model type");
+template <class TOutputImage, class TScalarImage>
+void 
+DWIGenerator<TOutputImage, TScalarImage>
+::ComputeSignal(SignalType& signal, CylinderModelType* cylinder) const
+{
+  bool isOutputPeak = this->m_MaxNumberOfPeaks>0;
   
-  if (isCylinderModel)
+  MatrixPointer qSpaceOrientationMatrix = this->m_SamplingSchemeQSpace->GetOrientationsCartesian();
+  STDVectorPointer bVector = this->m_SamplingSchemeQSpace->GetBVector();
+  MatrixPointer rSpaceOrientationMatrix = this->m_SamplingSchemeRSpace->GetOrientationsCartesian();
+  STDVectorPointer rVector = this->m_SamplingSchemeRSpace->GetRadiusVector();
+  double tau = this->m_SamplingSchemeQSpace->GetTau();
+  
+  int numberOfOrientationComponentsPerParameterSet=-1, numberOfDiffusivityComponentsPerParameterSet=-1, numberOfComponentsPerParameterSet=-1;
+  GetParameterSetSize(numberOfOrientationComponentsPerParameterSet, numberOfDiffusivityComponentsPerParameterSet, numberOfComponentsPerParameterSet);
+  bool isTensorModel = this->m_ModelType!=Superclass::CYLINDER_SPHERICAL_MODEL;
+  bool isCylinderModel = this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL;
+
+  const DiffusionParameterValuesType& diffusionParameterValues = signal.Parameters;
+  const double scale = signal.B0;
+  
+  OutputImagePixelType tempPixelDWI, tempPixelEAP, tempPixelODF;
+  double tempPixelRTO=0, tempPixelMSD=0;  
+  OutputImagePixelType& pixelDWI=signal.DWI, &pixelEAP=signal.EAP, &pixelODF=signal.ODF, &pixelPeak=signal.Peak;
+  double& pixelRTO=signal.RTO, &pixelMSD=signal.MSD;
+  if (this->m_IsOutputDWI)
     {
-    this->m_CylinderModel->SetDebug(this->GetDebug());
-    this->m_CylinderModel->BuildTable();
-    this->m_CylinderModel->SetSamplingSchemeQSpace(this->m_SamplingSchemeQSpace);
-    this->m_CylinderModel->SetSamplingSchemeRSpace(this->m_SamplingSchemeRSpace);
+    pixelDWI.SetSize( this->GetNumberOfQSpaceSamples() );
+    pixelDWI.Fill( 0 );
+    tempPixelDWI.SetSize( this->GetNumberOfQSpaceSamples() );
+    tempPixelDWI.Fill( 0 );
+    }
+  if (this->m_IsOutputEAP)
+    {
+    pixelEAP.SetSize( this->GetNumberOfRSpaceSamples() );
+    pixelEAP.Fill( 0 );
+    tempPixelEAP.SetSize( this->GetNumberOfRSpaceSamples() );
+    tempPixelEAP.Fill( 0 );
+    }
+  if (this->m_IsOutputODF)
+    {
+    pixelODF.SetSize( this->GetNumberOfRSpaceSamples() );
+    pixelODF.Fill( 0 );
+    tempPixelODF.SetSize( this->GetNumberOfRSpaceSamples() );
+    tempPixelODF.Fill( 0 );
+    }
+  if (isOutputPeak)
+    {
+    pixelPeak.SetSize(PeakContainerHelper::GetDimension(this->m_PeakType,this->m_MaxNumberOfPeaks));
+    pixelPeak.Fill( 0 );
     }
+  pixelMSD=0, pixelRTO=0;
+  
+  DiffusionTensor<double> tensor;
+  typename CylinderModelType::PointType cylinderAxis;
+  typename CylinderModelType::VectorPointer tempPixelDWIVec;
   
   Vector<PrecisionType, 3> principalDirection(0.0);
   STDVectorType diffusivities;
@@ -316,459 +466,196 @@ void DWIGenerator<TOutputImage, TScalarImage>
   Vector<PrecisionType, 3> e1;
   e1[0]=1.0, e1[1]=0.0, e1[2]=0.0;
   double partialVolumeWeight = 0;
-
   double norm;
-//  double temp;
-  
-  // std::cout << "scale = " << scale << std::endl;
-  // std::cout << "backgroundScale = " << backgroundScale << std::endl;
-  // utlPrintVar1(true, numberOfDiffusivityComponentsPerParameterSet);
 
-  // Simulated DWI data
-  for ( unsigned int k=0; k<diffusionParameterContainer.size(); k++ )
+  int numberOfParameterSets = diffusionParameterValues.size() /numberOfComponentsPerParameterSet;
+  PrecisionType sumPartialVolumeWeight=0.0;
+  int numberOfPeaks=0;
+  for ( unsigned int s=0; s<numberOfParameterSets; s++ )
     {
-    diffusionParameterValues = diffusionParameterContainer[k];
+    for ( unsigned int d=0; d<numberOfOrientationComponentsPerParameterSet; d++ )
+      principalDirection[d] = diffusionParameterValues[s* numberOfComponentsPerParameterSet + d];
 
-    for ( unsigned int dim=0; dim<ndims; dim++ )
+    norm = principalDirection.GetNorm();
+    if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS || this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
       {
-      index[dim] = diffusionParameterValues[dim];
+      principalDirection *= vnl_math::pi/180.0;
+      double theta=principalDirection[0], phi=principalDirection[1];
+      utl::spherical2Cartesian(1.0,theta,phi,principalDirection[0],principalDirection[1],principalDirection[2]);
       }
-    if (this->GetDebug())
+    else
       {
-      std::cout << "index = " << index << std::endl << std::flush;
-      utl::PrintVector(diffusionParameterValues, "diffusionParameterValues");
+      for ( unsigned int d=0; d<3; d++ )
+        principalDirection[d] /= norm;
+      }
+
+    for ( unsigned int d=0; d<numberOfDiffusivityComponentsPerParameterSet; d++ )
+      {
+      diffusivities[d] = diffusionParameterValues[s* numberOfComponentsPerParameterSet 
+          + numberOfOrientationComponentsPerParameterSet + d ];
       }
+    if (diffusivities.size()>0)
+      std::sort(diffusivities.begin(), diffusivities.end(), std::greater<double>());
     
-    // 3 elements for directions, 2 elements for diffusivities
-    utlSAGlobalException(!utl::IsInt( (1.0*diffusionParameterValues.size()-ndims)/numberOfComponentsPerParameterSet) )(diffusionParameterValues.size())(ndims)(numberOfComponentsPerParameterSet).msg("wrong diffusion parameter size");
-    numberOfParameterSets = ( diffusionParameterValues.size() - ndims ) /numberOfComponentsPerParameterSet;
-    if (this->m_IsOutputDWI)
-      pixelDWI.Fill( 0 );
-    if (this->m_IsOutputEAP)
-      pixelEAP.Fill( 0 );
-    if (this->m_IsOutputODF)
-      pixelODF.Fill( 0 );
-    if (isOutputPeak)
-      pixelPeak.Fill( 0 );
-    pixelMSD=0, pixelRTO=0;
+    partialVolumeWeight = diffusionParameterValues[s* numberOfComponentsPerParameterSet 
+        + numberOfOrientationComponentsPerParameterSet 
+        + numberOfDiffusivityComponentsPerParameterSet];
 
-    // std::cout << "k = "<< k << ", pixel = " << pixel << std::endl << std::flush;
-    // utlPrintVar4(true, numberOfParameterSets, diffusionParameterValues.size(), ndims, numberOfComponentsPerParameterSet);
-    PrecisionType sumPartialVolumeWeight=0.0;
-    int numberOfPeaks=0;
-    for ( unsigned int s=0; s<numberOfParameterSets; s++ )
+    sumPartialVolumeWeight += partialVolumeWeight;
+
+    if (isOutputPeak)
       {
-      for ( unsigned int d=0; d<numberOfOrientationComponentsPerParameterSet; d++ )
-        principalDirection[d] = diffusionParameterValues[ndims + s* numberOfComponentsPerParameterSet + d];
+      PeakContainerHelper::SetPeak<Vector<double,3>, OutputImagePixelType >(principalDirection, pixelPeak, s, this->m_PeakType);
+      if (this->m_PeakType==NXYZV || this->m_PeakType==XYZV)
+        PeakContainerHelper::SetPeakValue<OutputImagePixelType >(partialVolumeWeight, pixelPeak, s, this->m_PeakType);
+      numberOfPeaks++;
+      }
 
-      norm = principalDirection.GetNorm();
-      if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS || this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
-        {
-        principalDirection *= vnl_math::pi/180.0;
-        double theta=principalDirection[0], phi=principalDirection[1];
-        utl::spherical2Cartesian(1.0,theta,phi,principalDirection[0],principalDirection[1],principalDirection[2]);
-        }
-      else
+    if (isTensorModel)
+      {
+      std::vector<double> vec(3,1);
+      if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_CARTESIAN_COORDS || this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS)
+        vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[1];
+      else if (this->m_ModelType==Superclass::TENSOR_IN_EULER_ANGLES)
+        vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[2];
+      tensor.Fill(0.0);
+      tensor.SetEigenValues(vec);
+      Matrix<double,3,3> rotation;
+      utl::RotationMatrixFromVectors<Vector<double,3>, Matrix<double,3> >(e1, principalDirection, rotation); 
+      tensor.Rotate(rotation);
+
+      if ( this->m_IsOutputDWI )
         {
-        for ( unsigned int d=0; d<3; d++ )
-          principalDirection[d] /= norm;
+        tensor.GetDWISamples(tempPixelDWI, *qSpaceOrientationMatrix, *bVector);
+        pixelDWI += tempPixelDWI*scale*partialVolumeWeight;
         }
-
-      for ( unsigned int d=0; d<numberOfDiffusivityComponentsPerParameterSet; d++ )
+      if ( this->m_IsOutputODF )
         {
-        diffusivities[d] = diffusionParameterValues[ndims + s 
-            * numberOfComponentsPerParameterSet 
-            + numberOfOrientationComponentsPerParameterSet + d ];
+        tensor.GetODFSamples(tempPixelODF, *rSpaceOrientationMatrix,this->m_ODFOrder, false);
+        pixelODF += tempPixelODF*partialVolumeWeight;
         }
-      if (diffusivities.size()>0)
-        std::sort(diffusivities.begin(), diffusivities.end(), std::greater<double>());
-      
-      partialVolumeWeight = diffusionParameterValues[ndims + s 
-          * numberOfComponentsPerParameterSet 
-          + numberOfOrientationComponentsPerParameterSet 
-          + numberOfDiffusivityComponentsPerParameterSet];
-
-      sumPartialVolumeWeight += partialVolumeWeight;
-  
-      // utlPrintVar4(true, k, index[0], index[1], index[2]);
-      // utl::PrintVector(diffusivities, "diffusivities");
-
-      if (isOutputPeak)
+      if ( this->m_IsOutputEAP)
         {
-        PeakContainerHelper::SetPeak<Vector<double,3>, OutputImagePixelType >(principalDirection, pixelPeak, s, this->m_PeakType);
-        if (this->m_PeakType==NXYZV || this->m_PeakType==XYZV)
-          PeakContainerHelper::SetPeakValue<OutputImagePixelType >(partialVolumeWeight, pixelPeak, s, this->m_PeakType);
-        numberOfPeaks++;
+        tensor.GetEAPSamples(tempPixelEAP, *rSpaceOrientationMatrix, *rVector,tau);
+        pixelEAP += tempPixelEAP*partialVolumeWeight;
         }
-
-      if (isTensorModel)
+      if ( this->m_IsOutputRTO)
         {
-        std::vector<double> vec(3,1);
-        if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_CARTESIAN_COORDS || this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS)
-          vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[1];
-        else if (this->m_ModelType==Superclass::TENSOR_IN_EULER_ANGLES)
-          vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[2];
-        tensor.Fill(0.0);
-        tensor.SetEigenValues(vec);
-        // utlPrintVar2(true, "before", tensor);
-        Matrix<double,3,3> rotation;
-        utl::RotationMatrixFromVectors<Vector<double,3>, Matrix<double,3> >(e1, principalDirection, rotation); 
-        tensor.Rotate(rotation);
-        // utlPrintVar2(true, "after", tensor);
-
-        if ( this->m_IsOutputDWI )
-          {
-          tensor.GetDWISamples(tempPixelDWI, *qSpaceOrientationMatrix, *bVector);
-          // utlPrintVar1(true, tempPixel);
-          // utlPrintVar1(true, tempPixel*scale*partialVolumeWeight);
-          pixelDWI += tempPixelDWI*scale*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputODF )
-          {
-          tensor.GetODFSamples(tempPixelODF, *rSpaceOrientationMatrix,this->m_ODFOrder, false);
-          pixelODF += tempPixelODF*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputEAP)
-          {
-          tensor.GetEAPSamples(tempPixelEAP, *rSpaceOrientationMatrix, *rVector,tau);
-          pixelEAP += tempPixelEAP*partialVolumeWeight;
-          // std::cout << "\n\nindex = " << index << std::endl << std::flush;
-          }
-        if ( this->m_IsOutputRTO)
-          {
-          tempPixelRTO = tensor.GetReturnToOrigin(tau);
-          pixelRTO += tempPixelRTO*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputMSD)
-          {
-          tempPixelMSD = tensor.GetMeanSquaredDisplacement(tau);
-          pixelMSD += tempPixelMSD*partialVolumeWeight;
-          }
+        tempPixelRTO = tensor.GetReturnToOrigin(tau);
+        pixelRTO += tempPixelRTO*partialVolumeWeight;
         }
-      else if (isCylinderModel)
+      if ( this->m_IsOutputMSD)
         {
-        cylinderAxis[0] = principalDirection[0];
-        cylinderAxis[1] = principalDirection[1];
-        cylinderAxis[2] = principalDirection[2];
-        this->m_CylinderModel->SetCylinderAxis(cylinderAxis);
-        if (this->m_IsOutputDWI)
-          {
-          if (this->GetDebug())
-            this->m_CylinderModel->Print(std::cout<<"this->m_CylinderModel=");
-          this->m_CylinderModel->ComputeDWISamples();
-          tempPixelDWIVec = this->m_CylinderModel->GetDWISamples();
-          for ( int i = 0; i < tempPixelDWIVec->size(); i += 1 ) 
-            pixelDWI[i] += (*tempPixelDWIVec)[i]*scale*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputODF )
-          {
-          utlGlobalException(true, "TODO: to be implemented");
-          }
-        if ( this->m_IsOutputEAP )
-          {
-          utlGlobalException(true, "TODO: to be implemented");
-          }
-        if ( this->m_IsOutputRTO )
-          {
-          utlGlobalException(true, "TODO: to be implemented");
-          }
-        if ( this->m_IsOutputMSD )
-          {
-          utlGlobalException(true, "TODO: to be implemented");
-          }
+        tempPixelMSD = tensor.GetMeanSquaredDisplacement(tau);
+        pixelMSD += tempPixelMSD*partialVolumeWeight;
         }
-
-      }
-    if (isOutputPeak)
-      {
-      if (this->m_PeakType==NXYZ || this->m_PeakType==NXYZV)
-        pixelPeak[0] = numberOfPeaks;
-      }
-
-    utlException(sumPartialVolumeWeight<1e-9, "wrong partialVolumeWeight");
-    if ( this->m_IsOutputDWI )
-      pixelDWI /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputODF )
-      pixelODF /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputEAP )
-      pixelEAP /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputRTO )
-      pixelRTO /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputMSD )
-      pixelMSD /= sumPartialVolumeWeight;
-    if (this->m_IsOutputODF && this->m_ODFOrder!=2)
-      {
-      PrecisionType normFactor = 4*vnl_math::pi*utl::GetSumOfVector<OutputImagePixelType>(pixelODF,pixelODF.Size()) / pixelODF.Size();
-      if (normFactor!=0)
-        pixelODF /= normFactor;
       }
-
-    // Add Rician noise
-    if ( this->m_IsOutputDWI && (sigma>0 || snr>0)  && pixelDWI.GetSquaredNorm()>0 )
+    else if (isCylinderModel)
       {
-      PrecisionType sigma_real = -1;
-      if ( snr > 0 && sigma <= 0)
+      cylinderAxis[0] = principalDirection[0];
+      cylinderAxis[1] = principalDirection[1];
+      cylinderAxis[2] = principalDirection[2];
+      cylinder->SetCylinderAxis(cylinderAxis);
+      if (this->m_IsOutputDWI)
         {
-        double mean = 0;
-        for ( unsigned int k=0; k<numberOfComponentsPerPixel4DWI; k++ )
-          mean += pixelDWI[k];
-        mean /= numberOfComponentsPerPixel4DWI;
-        sigma_real = mean/snr;
+        cylinder->ComputeDWISamples();
+        tempPixelDWIVec = cylinder->GetDWISamples();
+        for ( int i = 0; i < tempPixelDWIVec->size(); i += 1 ) 
+          pixelDWI[i] += (*tempPixelDWIVec)[i]*scale*partialVolumeWeight;
         }
-      else if ( snr <= 0 && sigma > 0)
-//        sigma_real = scale * sigma;
-        sigma_real = sigma;
-      pixelDWI = utl::AddNoise<OutputImagePixelType>(pixelDWI, pixelDWI.GetSize(), sigma_real, true);
-      }
-    
-    if ( isOutputPeak )
-      {
-      outputPeak->SetPixel(index, pixelPeak);
-      }
-    if ( this->m_IsOutputDWI )
-      {
-      outputDWI->SetPixel(index, pixelDWI); 
-      b0Image->SetPixel(index, scale);
       }
-    if ( this->m_IsOutputODF )
-      outputODF->SetPixel(index, pixelODF); 
-    if ( this->m_IsOutputEAP )
-      outputEAP->SetPixel(index, pixelEAP); 
-    if ( this->m_IsOutputRTO )
-      outputRTO->SetPixel(index, pixelRTO); 
-    if ( this->m_IsOutputMSD )
-      outputMSD->SetPixel(index, pixelMSD); 
     }
-    
-  ImageRegionIteratorWithIndex<OutputImageType> outputDWIIt, outputODFIt, outputEAPIt, outputPeakIt;
-  ImageRegionIteratorWithIndex<ScalarImageType> b0It, outputRTOIt, outputMSDIt;
-  if ( this->m_IsOutputDWI )
+
+  if (isOutputPeak)
     {
-    outputDWIIt = ImageRegionIteratorWithIndex<OutputImageType>( outputDWI, outputDWI->GetRequestedRegion() );
-    b0It = ImageRegionIteratorWithIndex<ScalarImageType>( b0Image, outputDWI->GetRequestedRegion() );
+    if (this->m_PeakType==NXYZ || this->m_PeakType==NXYZV)
+      pixelPeak[0] = numberOfPeaks;
     }
+
+  if ( this->m_IsOutputDWI )
+    pixelDWI /= sumPartialVolumeWeight;
   if ( this->m_IsOutputODF )
-    outputODFIt = ImageRegionIteratorWithIndex<OutputImageType>( outputODF, outputODF->GetRequestedRegion() );
+    pixelODF /= sumPartialVolumeWeight;
   if ( this->m_IsOutputEAP )
-    outputEAPIt = ImageRegionIteratorWithIndex<OutputImageType>( outputEAP, outputEAP->GetRequestedRegion() );
-  if ( isOutputPeak )
-    outputPeakIt = ImageRegionIteratorWithIndex<OutputImageType>( outputPeak, outputPeak->GetRequestedRegion() );
+    pixelEAP /= sumPartialVolumeWeight;
   if ( this->m_IsOutputRTO )
-    outputRTOIt = ImageRegionIteratorWithIndex<ScalarImageType>( outputRTO, outputRTO->GetRequestedRegion() );
+    pixelRTO /= sumPartialVolumeWeight;
   if ( this->m_IsOutputMSD )
-    outputMSDIt = ImageRegionIteratorWithIndex<ScalarImageType>( outputMSD, outputMSD->GetRequestedRegion() );
-        
-      
-  if (m_BackgroundDiffusionParameterValues.size()>0)
-    backgroundDiffusionParameterValues = m_BackgroundDiffusionParameterValues;
-
-  // Background      
-  if ( backgroundDiffusionParameterValues.size() > 0 )
-  {
-    numberOfParameterSets = backgroundDiffusionParameterValues.size() /numberOfComponentsPerParameterSet;
-    // utl::PrintVector(backgroundDiffusionParameterValues, "backgroundDiffusionParameterValues");
-    // utlPrintVar3(true, numberOfComponentsPerParameterSet, numberOfParameterSets, numberOfOrientationComponentsPerParameterSet);
-    if (this->m_IsOutputDWI)
-      pixelDWI.Fill( 0 );
-    if (this->m_IsOutputEAP)
-      pixelEAP.Fill( 0 );
-    if (this->m_IsOutputODF)
-      pixelODF.Fill( 0 );
-    pixelRTO=0, pixelMSD=0;
-    PrecisionType sumPartialVolumeWeight=0.0;
-
-    for ( unsigned int s=0; s<numberOfParameterSets; s++ )
-      {
-      for ( unsigned int d=0; d<numberOfOrientationComponentsPerParameterSet; d++ )
-        principalDirection[d] = backgroundDiffusionParameterValues[s* numberOfComponentsPerParameterSet + d];
-
-      // std::cout << "principalDirection = " << principalDirection << std::endl << std::flush;
-      // utlException (std::abs(norm)<1e-8, "directions have zero norm");
-      norm = principalDirection.GetNorm();
-      if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS || this->m_ModelType==Superclass::CYLINDER_SPHERICAL_MODEL)
-        {
-        principalDirection *= vnl_math::pi/180.0;
-        double theta=principalDirection[0], phi=principalDirection[1];
-        utl::spherical2Cartesian(1.0,theta,phi,principalDirection[0],principalDirection[1],principalDirection[2]);
-        }
-      else
-        {
-        for ( unsigned int d=0; d<3; d++ )
-          principalDirection[d] /= norm;
-        }
-
-      for ( unsigned int d=0; d<numberOfDiffusivityComponentsPerParameterSet; d++ )
-        {
-        diffusivities[d] = backgroundDiffusionParameterValues[s* numberOfComponentsPerParameterSet 
-            + numberOfOrientationComponentsPerParameterSet + d ];
-        }
-      if (diffusivities.size()>0)
-        std::sort(diffusivities.begin(), diffusivities.end(), std::greater<double>());
-      
-      partialVolumeWeight = backgroundDiffusionParameterValues[s* numberOfComponentsPerParameterSet 
-          + numberOfOrientationComponentsPerParameterSet 
-          + numberOfDiffusivityComponentsPerParameterSet];
-
-      sumPartialVolumeWeight += partialVolumeWeight;
-
-      if (isTensorModel)
-        {
-        std::vector<double> vec(3,1);
-        if (this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_CARTESIAN_COORDS || this->m_ModelType==Superclass::SYMMETRICAL_TENSOR_IN_SPHERICAL_COORDS)
-          vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[1];
-        else if (this->m_ModelType==Superclass::TENSOR_IN_EULER_ANGLES)
-          vec[0]=diffusivities[0], vec[1]=diffusivities[1], vec[2]=diffusivities[2];
-        tensor.Fill(0.0);
-        tensor.SetEigenValues(vec);
-        // tensor.Print(std::cout<<"tensor = ");
-        Matrix<double,3,3> rotation;
-        utl::RotationMatrixFromVectors<Vector<double,3>, Matrix<double,3> >(e1, principalDirection, rotation); 
-        tensor.Rotate(rotation);
-        // tensor.Print(std::cout<<"tensor = ");
-
-        if ( this->m_IsOutputDWI )
-          {
-          tensor.GetDWISamples(tempPixelDWI, *qSpaceOrientationMatrix, *bVector);
-          pixelDWI += tempPixelDWI*backgroundScale*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputODF )
-          {
-          tensor.GetODFSamples(tempPixelODF, *rSpaceOrientationMatrix,this->m_ODFOrder, false);
-          pixelODF += tempPixelODF*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputEAP)
-          {
-          tensor.GetEAPSamples(tempPixelEAP, *rSpaceOrientationMatrix, *rVector,tau);
-          pixelEAP += tempPixelEAP*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputRTO)
-          {
-          tempPixelRTO = tensor.GetReturnToOrigin(tau);
-          pixelRTO += tempPixelRTO*partialVolumeWeight;
-          }
-        if ( this->m_IsOutputMSD)
-          {
-          tempPixelMSD = tensor.GetMeanSquaredDisplacement(tau);
-          pixelMSD += tempPixelMSD*partialVolumeWeight;
-          }
-        }
-      else if (isCylinderModel)
-        {
-        cylinderAxis[0] = principalDirection[0];
-        cylinderAxis[1] = principalDirection[1];
-        cylinderAxis[2] = principalDirection[2];
-        this->m_CylinderModel->SetCylinderAxis(cylinderAxis);
-        if (this->m_IsOutputDWI)
-          {
-          // cyl->Print(std::cout<<"cy1=");
-          this->m_CylinderModel->ComputeDWISamples();
-          tempPixelDWIVec = this->m_CylinderModel->GetDWISamples();
-          for ( int i = 0; i < tempPixelDWIVec->size(); i += 1 ) 
-            pixelDWI[i] += (*tempPixelDWIVec)[i]*backgroundScale*partialVolumeWeight;
-          }
-
-        }
+    pixelMSD /= sumPartialVolumeWeight;
+  if (this->m_IsOutputODF && this->m_ODFOrder!=2)
+    {
+    PrecisionType normFactor = 4*vnl_math::pi*utl::GetSumOfVector<OutputImagePixelType>(pixelODF,pixelODF.Size()) / pixelODF.Size();
+    if (normFactor!=0)
+      pixelODF /= normFactor;
+    }
 
-      }
-    utlException(sumPartialVolumeWeight<1e-9, "wrong partialVolumeWeight");
-    if ( this->m_IsOutputDWI )
-      pixelDWI /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputODF )
-      pixelODF /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputEAP )
-      pixelEAP /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputRTO )
-      pixelRTO /= sumPartialVolumeWeight;
-    if ( this->m_IsOutputMSD )
-      pixelMSD /= sumPartialVolumeWeight;
-    if (this->m_IsOutputODF && this->m_ODFOrder!=2)
-      {
-      PrecisionType normFactor = 4*vnl_math::pi*utl::GetSumOfVector<OutputImagePixelType>(pixelODF,pixelODF.Size()) / pixelODF.Size();
-      if (normFactor!=0)
-        pixelODF /= normFactor;
-      }
-  
-    // Add Rician noise
-    PrecisionType sigma_real = -1;
-    if ( this->m_IsOutputDWI && (sigma>0 || snr>0)  && pixelDWI.GetSquaredNorm()>0 )
+  // Rician noise
+  const double sigma = m_RicianNoiseSigma, snr = m_RicianNoiseSNR;
+  signal.NoiseSigma = -1;
+  if ( this->m_IsOutputDWI && (sigma>0 || snr>0)  && pixelDWI.GetSquaredNorm()>0 )
+    {
+    unsigned int numberOfComponentsPerPixel4DWI = this->GetNumberOfQSpaceSamples();
+    if ( snr > 0 && sigma <= 0)
       {
-      if ( snr > 0 && sigma <= 0)
-        {
-        double mean = 0;
-        for ( unsigned int k=0; k<numberOfComponentsPerPixel4DWI; k++ )
-          mean += pixelDWI[k];
-        mean /= numberOfComponentsPerPixel4DWI;
-        sigma_real = mean/snr;
-        }
-      else if ( snr <= 0 && sigma > 0)
-//        sigma_real = backgroundScale * sigma;
-        sigma_real = sigma;
+      double mean = 0;
+      for ( unsigned int k=0; k<numberOfComponentsPerPixel4DWI; k++ )
+        mean += pixelDWI[k];
+      mean /= numberOfComponentsPerPixel4DWI;
+      signal.NoiseSigma = mean/snr;
       }
+    else if ( snr <= 0 && sigma > 0)
+      signal.NoiseSigma = sigma;
+    }
+}
 
-    // Set pixels
-    if (this->m_IsOutputDWI)
-      {
-      b0It.GoToBegin();
-      outputDWIIt.GoToBegin();
-      OutputImagePixelType pixel_noise=pixelDWI;
-      while ( !b0It.IsAtEnd() )
-        {
-        if ( outputDWIIt.Get().GetNorm() == 0 )
-          {
-          if (sigma_real>0)
-            pixel_noise = utl::AddNoise<OutputImagePixelType>(pixelDWI, pixelDWI.GetSize(), sigma_real, true);
-          outputDWIIt.Set( pixel_noise );
-          b0It.Set( backgroundScale );
-          }
-        ++outputDWIIt;
-        ++b0It;
-        }
-      }
+template <class TOutputImage, class TScalarImage>
+void 
+DWIGenerator<TOutputImage, TScalarImage>
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId, CylinderModelType* cylinder)
+{
+  bool isOutputPeak = this->m_MaxNumberOfPeaks>0;
+  OutputImagePointer outputDWI=this->GetDWIImage(), outputODF=this->GetODFImage(), outputEAP=this->GetEAPImage(), outputPeak=this->GetPeakImage();
+  ScalarImagePointer b0Image = this->GetB0Image(), outputRTO = this->GetRTOImage(), outputMSD = this->GetMSDImage();
+  SignalType signalInVoxel;
 
-    if (this->m_IsOutputODF)
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt )
+    {
+    OutputImageIndexType index = voxelIt.GetIndex();
+    int signalID = m_SignalIDImage->GetPixel(index);
+    bool isBackground = signalID<0;
+    if (isBackground)
+      signalID = m_BackgroundSignalID;
+    if (signalID<0)
+      continue;
+    const SignalType* signal = &m_Signals[signalID];
+    if (!m_IsSignalStored && !isBackground)
       {
-      outputODFIt.GoToBegin();
-      while ( !outputODFIt.IsAtEnd() )
-        {
-        if ( outputODFIt.Get().GetNorm() == 0 )
-          outputODFIt.Set( pixelODF );
-        ++outputODFIt;
-        }
+      signalInVoxel.Parameters = signal->Parameters;
+      signalInVoxel.B0 = signal->B0;
+      ComputeSignal(signalInVoxel, cylinder);
+      signal = &signalInVoxel;
       }
 
-    if (this->m_IsOutputEAP)
-      {
-      outputEAPIt.GoToBegin();
-      while ( !outputEAPIt.IsAtEnd() )
-        {
-        if ( outputEAPIt.Get().GetNorm() == 0 )
-          outputEAPIt.Set( pixelEAP );
-        ++outputEAPIt;
-        }
-      }
-    
-    if (this->m_IsOutputRTO)
-      {
-      outputRTOIt.GoToBegin();
-      while ( !outputRTOIt.IsAtEnd() )
-        {
-        if ( outputRTOIt.Get() == 0 )
-          outputRTOIt.Set( pixelRTO );
-        ++outputRTOIt;
-        }
-      }
-    if (this->m_IsOutputMSD)
+    if ( isOutputPeak && !isBackground )
+      outputPeak->SetPixel(index, signal->Peak);
+    if ( this->m_IsOutputDWI )
       {
-      outputMSDIt.GoToBegin();
-      while ( !outputMSDIt.IsAtEnd() )
-        {
-        if ( outputMSDIt.Get() == 0 )
-          outputMSDIt.Set( pixelMSD );
-        ++outputMSDIt;
-        }
+      // the random stream of a voxel is determined by its offset, not by the thread
+      if (signal->NoiseSigma>0)
+        outputDWI->SetPixel(index, utl::AddNoiseCounterBased<OutputImagePixelType>(signal->DWI, signal->DWI.GetSize(), signal->NoiseSigma, true, m_NoiseSeed, m_SignalIDImage->ComputeOffset(index)));
+      else
+        outputDWI->SetPixel(index, signal->DWI);
+      b0Image->SetPixel(index, signal->B0);
       }
-  }
-
+    if ( this->m_IsOutputODF )
+      outputODF->SetPixel(index, signal->ODF); 
+    if ( this->m_IsOutputEAP )
+      outputEAP->SetPixel(index, signal->EAP); 
+    if ( this->m_IsOutputRTO )
+      outputRTO->SetPixel(index, signal->RTO); 
+    if ( this->m_IsOutputMSD )
+      outputMSD->SetPixel(index, signal->MSD); 
+    }
 }
 
 
@@ -21,6 +21,7 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkImageSource.h"
+#include "itkMultiThreader.h"
 #include "utlITK.h"
 #include <tr1/memory>
 
@@ -101,8 +102,17 @@ public:
   itkSetObjectMacro(MaskImage, MaskImageType);
   itkGetConstObjectMacro(MaskImage, MaskImageType);
   
-  /** Set/Get the mask image. */
-  itkSetObjectMacro(B0Image, B0ImageType);
+  /** Set/Get the b0 image. If b0 image is set, the configuration file should not have b0 images. 
+   * If it is not set, b0 image is computed from the configuration file in the region of the output.  */
+  void SetB0Image(B0ImageType* b0Image)
+    {
+    if (m_B0Image!=b0Image)
+      {
+      m_B0Image = b0Image;
+      m_IsB0ImageComputed = false;
+      this->Modified();
+      }
+    }
   itkGetObjectMacro(B0Image, B0ImageType);
   
   itkSetObjectMacro(SamplingSchemeQSpace, SamplingSchemeQSpaceType);
@@ -141,6 +151,12 @@ public:
   itkGetMacro(ShowWarnings, bool);
   itkBooleanMacro(ShowWarnings);
   
+  /** Maximal memory (in MB) of volumes read at once from a 4D file. 
+   * If the ImageIO supports streamed reading, a 4D file is read in chunks of volumes, so the whole 4D image is never in memory. 
+   * If it is not positive, each 4D file is read at once.  */
+  itkSetMacro(StreamingChunkSizeInMB, double);
+  itkGetMacro(StreamingChunkSizeInMB, double);
+  
   /** 
    *   The data format has two types: 
    *
@@ -162,6 +178,10 @@ public:
    * b.txt and grad.txt should have the same dimension
    * */
   void ReadFromConfigurationFile(const std::string& file);
+
+  /** Read gradients, b values and image information from the configuration file, without reading DWI data.
+   * It sets the sampling scheme and the information (including the number of components) of the output. */
+  void ReadConfigurationInformation(const std::string& file);
   
   // void ReadBGradDWI(const std::string& bFile, const std::string& gradFile, const std::string& imageFile, const std::string& indexFile="");
   
@@ -178,9 +198,36 @@ protected:
   virtual ~DWIReader(){}
  
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** Set the image information and the sampling scheme from the configuration file, so that downstream filters can request a region of the output.  */
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
  
-  /** Does the real work. */
+  /** Does the real work. Only the requested region of the output is read and processed. */
   virtual void GenerateData() ITK_OVERRIDE;
+
+  /** Data shared by threads which gather a chunk of volumes of a 4D file into the output.  */
+  struct GatherVolumesStruct
+    {
+    /** volume-major chunk, the value of volume k at voxel n is Chunk[k*NumberOfVoxels+n] */
+    const TPixelType* Chunk;
+    int NumberOfVolumes;
+    long NumberOfVoxels;
+    /** gather index of volumes in the chunk, component index in the output (>=0), b0 volume (-1), or not used (-2) */
+    const int* GatherIndex;
+    /** voxel-major output, NumberOfComponents values per voxel  */
+    TPixelType* Output;
+    int NumberOfComponents;
+    TPixelType* B0;
+    double B0Weight;
+    /** NULL if there is no mask  */
+    const double* Mask;
+    double* SumSquareB0;
+    double* SumSquareDWI;
+    int* NumberOfZeroValues;
+    };
+
+  /** Transpose a chunk of volumes into the voxel-major output in tiles of voxels and volumes. Threads work on disjoint ranges of voxels.  */
+  static ITK_THREAD_RETURN_TYPE GatherVolumesThreaderCallback(void* arg);
  
 private:
   DWIReader(const Self &); //purposely not implemented
@@ -197,6 +244,26 @@ private:
   
   bool m_ShowWarnings;
 
+  double m_StreamingChunkSizeInMB;
+
+  /** information of a DWI file in the configuration file  */
+  struct DWIFileInformationType
+    {
+    std::string DataFile;
+    int NumberOfVolumes;
+    /** gather index of volumes in the file, component index in the output (>=0), b0 volume (-1), or not used (-2) */
+    std::vector<int> GatherIndex;
+    std::string Message;
+    };
+  std::vector<DWIFileInformationType> m_DWIFileInformation;
+  int m_NumberOfB0;
+  int m_NumberOfDWIsWithoutB0;
+  /** time when the configuration file is read  */
+  TimeStamp m_ConfigurationInformationTime;
+
+  /** true if m_B0Image is computed by this reader, false if it is set by users  */
+  bool m_IsB0ImageComputed;
+
   typename MaskImageType::Pointer m_MaskImage;
   typename B0ImageType::Pointer m_B0Image;
 };
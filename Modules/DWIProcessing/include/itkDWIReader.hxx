@@ -21,6 +21,7 @@
 
 #include "itkDWIReader.h"
 #include "itkImageFileReader.h"
+#include "itkImageRegionIterator.h"
 #include "itkImageRegionIteratorWithIndex.h"
 #include "utl.h"
 
@@ -37,6 +38,10 @@ DWIReader<TPixelType, VImageDimension>
   m_IsInput4DImage = true;
   m_CorrectDWIValues = true;
   m_ShowWarnings = true;
+  m_StreamingChunkSizeInMB = 512;
+  m_NumberOfB0 = 0;
+  m_NumberOfDWIsWithoutB0 = 0;
+  m_IsB0ImageComputed = false;
 
   m_MaskImage = MaskImageType::New();
   m_B0Image = B0ImageType::New();
@@ -71,7 +76,7 @@ DWIReader<TPixelType, VImageDimension>
 template <class TPixelType, unsigned int VImageDimension>
 void
 DWIReader<TPixelType, VImageDimension>
-::ReadFromConfigurationFile(const std::string& file)
+::ReadConfigurationInformation(const std::string& file)
 {
   utlShowPosition(this->GetDebug());
 
@@ -99,13 +104,13 @@ DWIReader<TPixelType, VImageDimension>
   typedef ImageFileReader<DWI4DImageType> DWI4DReaderType;
   typename DWI4DImageType::Pointer dwi4DTempImage;
 
-  bool isB0Set = !IsImageEmpty(m_B0Image);
+  bool isB0Set = !IsImageEmpty(m_B0Image) && !m_IsB0ImageComputed;
   double bThresholdSingleShell = m_SamplingSchemeQSpace->GetBThresholdSingleShell();
 
   // Read Input File Info
+  m_DWIFileInformation.clear();
   int numberOfDWIsWithoutB0=0;
   int numberOfB0=0;
-  std::vector<std::string> ossStr;
   std::string dataStr0;
   for ( int i = 0; i < stringMatrix.size(); i += 1 ) 
     {
@@ -180,7 +185,6 @@ DWIReader<TPixelType, VImageDimension>
     if (stringMatrix[i].size()==4)
       oss << ", index=" << indexStr;
     // oss << std::endl << std::flush;
-    ossStr.push_back(oss.str());
 
 
     int numberOfDWI;
@@ -214,6 +218,35 @@ DWIReader<TPixelType, VImageDimension>
     // numDWInob0 records the start index for i-th dwi file
     if (i>0)
       numDWINob0[i] += numDWINob0[i-1];
+
+    // gather index table, which is built once to avoid searching b0IndexVec and selectIndexVec for every voxel
+    std::vector<char> isSelected(gradStrTempMatrix.size(), stringMatrix[i].size()==3);
+    if (stringMatrix[i].size()==4)
+      {
+      for ( int j = 0; j < selectIndexVec[i].size(); j += 1 ) 
+        {
+        if (selectIndexVec[i][j]>=0 && selectIndexVec[i][j]<gradStrTempMatrix.size())
+          isSelected[selectIndexVec[i][j]] = 1;
+        }
+      }
+    std::vector<int> gatherIndex(numberOfDWI, -2);
+    for ( int kk = 0; kk < additionalB0[i]; kk += 1 ) 
+      gatherIndex[kk] = -1;
+    for ( int kk = 0; kk < b0IndexTemp.size(); kk += 1 ) 
+      gatherIndex[b0IndexTemp[kk]+additionalB0[i]] = -1;
+    int jj = i==0 ? 0 : numDWINob0[i-1];
+    for ( int j = 0; j < gradStrTempMatrix.size(); j += 1 ) 
+      {
+      if (isSelected[j] && gatherIndex[j+additionalB0[i]]!=-1)
+        gatherIndex[j+additionalB0[i]] = jj++;
+      }
+    utlGlobalException(jj!=numDWINob0[i], "wrong index file " << indexStr << ". It has repeated or out of range indices.");
+    DWIFileInformationType info;
+    info.DataFile = dataStr;
+    info.NumberOfVolumes = numberOfDWI;
+    info.GatherIndex = gatherIndex;
+    info.Message = oss.str();
+    m_DWIFileInformation.push_back(info);
     }
 
   // utlGlobalException( !this->GetB0Image() && numberOfB0==0, "no b0 images in " << file);
@@ -226,31 +259,18 @@ DWIReader<TPixelType, VImageDimension>
       utl::PrintVector(b0IndexVec[jj], "b0IndexVec[jj]");
     }
 
-  // Read data in input file 
-  typename DWIImageType::Pointer dwiImage = this->GetOutput();
+  // b vector, gradients
   STDVectorPointer bVector = m_SamplingSchemeQSpace->GetBVector();
   MatrixPointer orientationsCartesian = m_SamplingSchemeQSpace->GetOrientationsCartesian();
   bVector->clear();
   orientationsCartesian->ReSize(numberOfDWIsWithoutB0, 3);
-  typename B0ImageType::IndexType  b0Index;
-  typename B0ImageType::PixelType  b0Pixel;
-  PixelType dwiPixel, dwiZeroPixel;
-  dwiPixel.SetSize(numberOfDWIsWithoutB0);
-  dwiZeroPixel.SetSize(numberOfDWIsWithoutB0);
-  dwiZeroPixel.Fill(0.0);
-
   for ( int i = 0; i < stringMatrix.size(); i += 1 ) 
     {
-    if (stringMatrix.size()==1)
-      std::cout << "loading the " << i+1 << "th DWI data from total " << stringMatrix.size() << " DWI data" << std::endl;
-    std::cout << ossStr[i] << std::endl << std::flush;
-    dataStr = utl::IsFileExist(stringMatrix[i][2]) ? stringMatrix[i][2] : dwiPath+stringMatrix[i][2];
-
-    // b vector, gradients
     // utl::PrintVector(bVec[i], "bVec[i]");
+    const std::vector<int>& gatherIndex = m_DWIFileInformation[i].GatherIndex;
     for ( int j = 0; j < bVec[i].size(); j += 1 ) 
       {
-      if (!utl::IsInVector(b0IndexVec[i], j) && ( stringMatrix[i].size()==3 || (stringMatrix[i].size()==4 && utl::IsInVector(selectIndexVec[i],j))) )
+      if (gatherIndex[j+additionalB0[i]]>=0)
         {
         // utlPrintVar1(true, j);
         bVector->push_back(bVec[i][j]);
@@ -264,155 +284,239 @@ DWIReader<TPixelType, VImageDimension>
         // utlPrintVar3(true, (*orientationsCartesian)(bVector->size()-1,0), (*orientationsCartesian)(bVector->size()-1,1), (*orientationsCartesian)(bVector->size()-1,2));
         }
       }
+    }
+  m_SamplingSchemeQSpace->SetOrientationsCartesian(orientationsCartesian);
+  m_SamplingSchemeQSpace->SetBVector(bVector);
+  if (m_SamplingSchemeQSpace->GetBThresholdSingleShell()>0)
+    m_SamplingSchemeQSpace->CorrectBValues();
 
-    // read individual dwi
-    int numberOfDWI;
-    if (m_IsInput4DImage)
-      {
-      itk::ReadImage<DWI4DImageType>(dataStr, dwi4DTempImage);
-      typename DWI4DImageType::SizeType size = dwi4DTempImage->GetLargestPossibleRegion().GetSize();
-      numberOfDWI = size[3];
-      }
-    else
-      {
-      itk::ReadImage<DWIImageType>(dataStr, dwiTempImage);
-      numberOfDWI = dwiTempImage->GetNumberOfComponentsPerPixel();
-      }
+  // output information. Only the largest region is set, because the requested region is set by downstream filters.
+  typename B0ImageType::Pointer infoImage = B0ImageType::New();
+  if (m_IsInput4DImage)
+    {
+    itk::ReadImageInformation<DWI4DImageType>(dataStr0, dwi4DTempImage);
+    itk::CopyImageInformation<DWI4DImageType, B0ImageType>( dwi4DTempImage, infoImage);
+    }
+  else
+    {
+    itk::ReadImageInformation<DWIImageType>(dataStr0, dwiTempImage);
+    itk::CopyImageInformation<DWIImageType, B0ImageType>( dwiTempImage, infoImage);
+    }
+  typename DWIImageType::Pointer dwiImage = this->GetOutput();
+  dwiImage->SetLargestPossibleRegion(infoImage->GetLargestPossibleRegion());
+  dwiImage->SetSpacing(infoImage->GetSpacing());
+  dwiImage->SetOrigin(infoImage->GetOrigin());
+  dwiImage->SetDirection(infoImage->GetDirection());
+  dwiImage->SetNumberOfComponentsPerPixel(numberOfDWIsWithoutB0);
+
+  m_NumberOfB0 = numberOfB0;
+  m_NumberOfDWIsWithoutB0 = numberOfDWIsWithoutB0;
+  m_ConfigurationInformationTime.Modified();
+}
 
-    // allocate b0, dwi
-    if (i==0)
+template <class TPixelType, unsigned int VImageDimension>
+void
+DWIReader<TPixelType, VImageDimension>
+::ReadFromConfigurationFile(const std::string& file)
+{
+  utlShowPosition(this->GetDebug());
+  if (m_DWIFileInformation.size()==0 || m_ConfigurationInformationTime.GetMTime()<this->GetMTime())
+    ReadConfigurationInformation(file);
+
+  typedef ImageFileReader<DWIImageType> DWIReaderType;
+  typedef Image<TPixelType, 4>  DWI4DImageType;
+  typedef ImageFileReader<DWI4DImageType> DWI4DReaderType;
+
+  const int numberOfB0 = m_NumberOfB0;
+  const int numberOfDWIsWithoutB0 = m_NumberOfDWIsWithoutB0;
+
+  // only the requested region is read. It is the largest region if the reader is not streamed. 
+  typename DWIImageType::Pointer dwiImage = this->GetOutput();
+  RegionType region = dwiImage->GetRequestedRegion();
+  if (region.GetNumberOfPixels()==0)
+    {
+    region = dwiImage->GetLargestPossibleRegion();
+    dwiImage->SetRequestedRegion(region);
+    }
+  utlGlobalException(!dwiImage->GetLargestPossibleRegion().IsInside(region), "the requested region is outside of the DWI image");
+  utlGlobalException( !IsImageEmpty(m_MaskImage) && !m_MaskImage->GetBufferedRegion().IsInside(region), "m_MaskImage does not have the requested region");
+  PixelType dwiPixel, dwiZeroPixel;
+  dwiPixel.SetSize(numberOfDWIsWithoutB0);
+  dwiZeroPixel.SetSize(numberOfDWIsWithoutB0);
+  dwiZeroPixel.Fill(0.0);
+  dwiImage->SetBufferedRegion(region);
+  dwiImage->Allocate();
+  dwiImage->FillBuffer(dwiZeroPixel);
+
+  // allocate b0 in the region
+  if (IsImageEmpty(m_B0Image) || m_IsB0ImageComputed)
+    {
+    m_B0Image = B0ImageType::New();
+    itk::CopyImageInformation<DWIImageType, B0ImageType>( dwiImage, m_B0Image);
+    m_B0Image->SetRequestedRegion(region);
+    m_B0Image->SetBufferedRegion(region);
+    m_B0Image->Allocate();
+    m_IsB0ImageComputed = true;
+    if (numberOfB0>0)
+      m_B0Image->FillBuffer(0);
+    else 
       {
-      if (IsImageEmpty(m_B0Image))
-        {
-        m_B0Image = B0ImageType::New();
-        if (m_IsInput4DImage)
-          itk::CopyImageInformation<DWI4DImageType, B0ImageType>( dwi4DTempImage, m_B0Image);
-        else
-          itk::CopyImageInformation<DWIImageType, B0ImageType>( dwiTempImage, m_B0Image);
-        m_B0Image->Allocate();
-        if (numberOfB0>0)
-          m_B0Image->FillBuffer(0);
-        else 
-          {
-          std::cout << "b0=1 is used" << std::endl << std::flush;
-          m_B0Image->FillBuffer(1.0);  // assume b0=1.0, if there is no b0 images.
-          }
-        }
-      if (m_IsInput4DImage)
-        itk::CopyImageInformation<DWI4DImageType, DWIImageType>( dwi4DTempImage, dwiImage);
-      else
-        itk::CopyImageInformation<DWIImageType, DWIImageType>( dwiTempImage, dwiImage);
-      dwiImage->SetNumberOfComponentsPerPixel( numberOfDWIsWithoutB0 );
-      dwiImage->Allocate();
-      dwiImage->FillBuffer(dwiZeroPixel);
+      std::cout << "b0=1 is used" << std::endl << std::flush;
+      m_B0Image->FillBuffer(1.0);  // assume b0=1.0, if there is no b0 images.
       }
-    
-    // concatenate dwi
-    ImageRegionIteratorWithIndex<B0ImageType> b0It(m_B0Image, m_B0Image->GetLargestPossibleRegion());
-    ImageRegionIteratorWithIndex<DWIImageType> dwiIt(dwiImage, dwiImage->GetLargestPossibleRegion());
-    ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-    if (!IsImageEmpty(m_MaskImage))
-      maskIt = ImageRegionIteratorWithIndex<MaskImageType>(m_MaskImage, m_MaskImage->GetLargestPossibleRegion());
-    IndexType dwiIndex;
+    }
+  else
+    utlGlobalException(!m_B0Image->GetBufferedRegion().IsInside(region), "m_B0Image does not have the requested region");
+
+  typename B0ImageType::IndexType  b0Index;
+  typename B0ImageType::PixelType  b0Pixel;
+  for ( int i = 0; i < m_DWIFileInformation.size(); i += 1 ) 
+    {
+    const DWIFileInformationType& info = m_DWIFileInformation[i];
+    const std::vector<int>& gatherIndex = info.GatherIndex;
+    const int numberOfDWI = info.NumberOfVolumes;
+    if (m_DWIFileInformation.size()==1)
+      std::cout << "loading the " << i+1 << "th DWI data from total " << m_DWIFileInformation.size() << " DWI data" << std::endl;
+    std::cout << info.Message << std::endl << std::flush;
 
     if (m_IsInput4DImage)
       {
-      typename DWI4DImageType::IndexType dwi4DTempIndex;
-      for (b0It.GoToBegin(), dwiIt.GoToBegin(), maskIt.GoToBegin(); 
-        !b0It.IsAtEnd(); 
-        ++b0It, ++dwiIt, ++maskIt) 
+      // Volumes in the region are read in chunks and transposed into the voxel-major output, so the whole 4D image is not kept in memory. 
+      typename DWI4DReaderType::Pointer dwi4DReader = DWI4DReaderType::New();
+      dwi4DReader->SetFileName(info.DataFile);
+      dwi4DReader->UpdateOutputInformation();
+      typename DWI4DImageType::Pointer dwi4DTempImage = dwi4DReader->GetOutput();
+      utlGlobalException(dwi4DTempImage->GetLargestPossibleRegion().GetSize(VImageDimension)!=numberOfDWI, "the number of volumes in " << info.DataFile << " is changed");
+
+      typename DWI4DImageType::RegionType region4D;
+      for ( int d = 0; d < VImageDimension; d += 1 ) 
         {
-        if (!IsImageEmpty(m_MaskImage) && maskIt.Get()<=1e-10)
-          {
-          dwiIt.Set(dwiZeroPixel);
-          b0It.Set(0.0);
-          continue;
-          }
-
-        b0Index = b0It.GetIndex();
-        if (this->GetDebug())
-          std::cout << "index = " << b0Index << std::endl << std::flush;
-        for ( int kk = 0; kk < VImageDimension; kk += 1 ) 
-          dwi4DTempIndex[kk] = b0Index[kk];
+        region4D.SetIndex(d, region.GetIndex(d));
+        region4D.SetSize(d, region.GetSize(d));
+        }
+      region4D.SetIndex(VImageDimension, dwi4DTempImage->GetLargestPossibleRegion().GetIndex(VImageDimension));
+      region4D.SetSize(VImageDimension, numberOfDWI);
+      const long numberOfVoxels = region.GetNumberOfPixels();
+      int numberOfVolumesPerChunk = numberOfDWI;
+      if (m_StreamingChunkSizeInMB>0 && dwi4DReader->GetImageIO()->CanStreamRead())
+        numberOfVolumesPerChunk = utl::max(1, utl::min(numberOfDWI, (int)(m_StreamingChunkSizeInMB*1024.0*1024.0/(numberOfVoxels*sizeof(TPixelType)))));
+
+      // b0 and mask in the region, in the same order as voxels in the chunk
+      std::vector<TPixelType> b0Region(numberOfVoxels);
+      std::vector<double> maskRegion;
+      ImageRegionIterator<B0ImageType> b0It(m_B0Image, region);
+      long n=0;
+      for (b0It.GoToBegin(); !b0It.IsAtEnd(); ++b0It, ++n) 
+        b0Region[n] = b0It.Get();
+      if (!IsImageEmpty(m_MaskImage))
+        {
+        maskRegion.resize(numberOfVoxels);
+        ImageRegionConstIterator<MaskImageType> maskIt(m_MaskImage, region);
+        n=0;
+        for (maskIt.GoToBegin(); !maskIt.IsAtEnd(); ++maskIt, ++n) 
+          maskRegion[n] = maskIt.Get();
+        }
 
-        std::ostringstream ossWarn, ossWarnTmp;
-        // additional b0
-        double sumPixelb=0;
-        for ( int kk = 0; kk < additionalB0[i]; kk += 1 ) 
+      std::vector<double> sumSquareB0(numberOfVoxels,0.0), sumSquareDWI(numberOfVoxels,0.0);
+      std::vector<int> numberOfZeroValues(numberOfVoxels,0);
+      std::vector<TPixelType> chunkCopy;
+      GatherVolumesStruct str;
+      str.NumberOfVoxels = numberOfVoxels;
+      str.Output = dwiImage->GetBufferPointer();
+      str.NumberOfComponents = numberOfDWIsWithoutB0;
+      str.B0 = &b0Region[0];
+      str.B0Weight = numberOfB0>0 ? 1.0/numberOfB0 : 0.0;
+      str.Mask = maskRegion.size()>0 ? &maskRegion[0] : NULL;
+      str.SumSquareB0 = &sumSquareB0[0];
+      str.SumSquareDWI = &sumSquareDWI[0];
+      str.NumberOfZeroValues = &numberOfZeroValues[0];
+
+      for ( int k0 = 0; k0 < numberOfDWI; k0 += numberOfVolumesPerChunk ) 
+        {
+        const int k1 = utl::min(k0+numberOfVolumesPerChunk, numberOfDWI);
+        typename DWI4DImageType::RegionType chunkRegion = region4D;
+        chunkRegion.SetIndex(VImageDimension, region4D.GetIndex(VImageDimension)+k0);
+        chunkRegion.SetSize(VImageDimension, k1-k0);
+        dwi4DTempImage->SetRequestedRegion(chunkRegion);
+        dwi4DReader->Update();
+
+        // ImageIO may read a larger region than the requested one. Then the chunk is copied. 
+        if (dwi4DTempImage->GetBufferedRegion()==chunkRegion)
+          str.Chunk = dwi4DTempImage->GetBufferPointer();
+        else
           {
-          dwi4DTempIndex[VImageDimension] = kk;
-          double dwi4DTempPixel = dwi4DTempImage->GetPixel(dwi4DTempIndex);
-          sumPixelb += dwi4DTempPixel*dwi4DTempPixel;
-          if (dwi4DTempPixel<1e-10)
-            ossWarnTmp << "zero b0 at "<< dwi4DTempIndex <<", " << "b0=" << dwi4DTempPixel << ", ";
-          if (numberOfB0>0)
-            {
-            b0Pixel = b0It.Get() + dwi4DTempPixel/((double)numberOfB0);
-            b0It.Set(b0Pixel);
-            }
+          chunkCopy.resize(chunkRegion.GetNumberOfPixels());
+          ImageRegionConstIterator<DWI4DImageType> chunkIt(dwi4DTempImage, chunkRegion);
+          n=0;
+          for (chunkIt.GoToBegin(); !chunkIt.IsAtEnd(); ++chunkIt, ++n) 
+            chunkCopy[n] = chunkIt.Get();
+          str.Chunk = &chunkCopy[0];
           }
+        str.NumberOfVolumes = k1-k0;
+        str.GatherIndex = &gatherIndex[k0];
 
-        // b0 in gradients
-        for ( int kk = 0; kk < b0IndexVec[i].size(); kk += 1 ) 
-          {
-          dwi4DTempIndex[VImageDimension] = b0IndexVec[i][kk]+additionalB0[i];
-          double dwi4DTempPixel = dwi4DTempImage->GetPixel(dwi4DTempIndex);
-          sumPixelb += dwi4DTempPixel*dwi4DTempPixel;
-          if (dwi4DTempPixel<1e-10)
-            ossWarnTmp << "zero b0 at "<< dwi4DTempIndex <<", " << "b0=" << dwi4DTempPixel << ", ";
-          if (numberOfB0>0)
-            {
-            b0Pixel = b0It.Get() + dwi4DTempPixel/((double)numberOfB0);
-            b0It.Set(b0Pixel);
-            }
-          }
+        MultiThreader::Pointer threader = this->GetMultiThreader();
+        threader->SetNumberOfThreads(this->GetNumberOfThreads());
+        threader->SetSingleMethod(Self::GatherVolumesThreaderCallback, &str);
+        threader->SingleMethodExecute();
+        }
+      // release the chunk before reading the next file
+      dwi4DReader = NULL;
+      dwi4DTempImage = NULL;
+      chunkCopy.clear();
 
-        if (b0It.Get()<1e-10)
+      TPixelType* dwiBuffer = dwiImage->GetBufferPointer();
+      for ( n = 0; n < numberOfVoxels; n += 1 ) 
+        {
+        TPixelType* dwiVoxel = dwiBuffer + n*numberOfDWIsWithoutB0;
+        if (str.Mask && str.Mask[n]<=1e-10)
           {
-          dwiIt.Set(dwiZeroPixel);
+          std::fill(dwiVoxel, dwiVoxel+numberOfDWIsWithoutB0, TPixelType(0));
+          b0Region[n] = 0.0;
           continue;
           }
 
-        // dwi without b0
-        double sumPixeldwi=0;
-        dwiPixel = dwiIt.Get();
-        int jj=0;
-        for ( int kk = additionalB0[i]; kk < numberOfDWI; kk += 1 ) 
+        if (b0Region[n]<1e-10)
           {
-          if (!utl::IsInVector(b0IndexVec[i], kk-additionalB0[i]) && ( stringMatrix[i].size()==3 || (stringMatrix[i].size()==4 && utl::IsInVector(selectIndexVec[i],kk-additionalB0[i]))) )
-            {
-            dwi4DTempIndex[VImageDimension] = kk;
-            double dwi4DTempPixel = dwi4DTempImage->GetPixel(dwi4DTempIndex);
-            sumPixeldwi += dwi4DTempPixel*dwi4DTempPixel;
-            if (dwi4DTempPixel<1e-10)
-              ossWarnTmp << "zero dwi at "<< dwi4DTempIndex <<", ";
-            dwiPixel[jj + (i==0?0:numDWINob0[i-1])] = dwi4DTempPixel;
-            jj++;
-            }
+          std::fill(dwiVoxel, dwiVoxel+numberOfDWIsWithoutB0, TPixelType(0));
+          continue;
           }
-        if (ossWarnTmp.str()!="" && sumPixelb>0 && sumPixeldwi>0)
-          ossWarn << ossWarnTmp.str();
 
-        if (m_ShowWarnings && (b0It.Get()>1e-10 || dwiPixel.GetSquaredNorm()>1e-10) && ossWarn.str()!="")
+        if (m_ShowWarnings && numberOfZeroValues[n]>0 && sumSquareB0[n]>0 && sumSquareDWI[n]>0)
           {
-          // utlWarning(true, "Warning: " << ossWarn.str() << "dwiPixel=" << dwiPixel<<";");
-          std::cout << "Warning: " << ossWarn.str() << std::endl << std::flush;
+          b0Index = dwiImage->ComputeIndex(n);
+          std::cout << "Warning: " << numberOfZeroValues[n] << " zero b0 or dwi values at "<< b0Index << " in " << info.DataFile << std::endl << std::flush;
           }
 
         if (this->GetDebug())
           {
-          utlPrintVar(true, b0It.Get());
-          itk::PrintVariableLengthVector(dwiPixel, "dwiPixel");
+          b0Index = dwiImage->ComputeIndex(n);
+          std::cout << "index = " << b0Index << std::endl << std::flush;
+          utlPrintVar(true, b0Region[n]);
+          utl::PrintContainer(dwiVoxel, dwiVoxel+numberOfDWIsWithoutB0, "dwiPixel");
           }
-
-        dwiIt.Set(dwiPixel);
-
         }
 
+      n=0;
+      for (b0It.GoToBegin(); !b0It.IsAtEnd(); ++b0It, ++n) 
+        b0It.Set(b0Region[n]);
       }
     else
       {
-      ImageRegionIteratorWithIndex<DWIImageType> dwiTempIt(dwiTempImage, dwiTempImage->GetLargestPossibleRegion());
+      typename DWIReaderType::Pointer dwiReader = DWIReaderType::New();
+      dwiReader->SetFileName(info.DataFile);
+      dwiReader->UpdateOutputInformation();
+      typename DWIImageType::Pointer dwiTempImage = dwiReader->GetOutput();
+      utlGlobalException(dwiTempImage->GetNumberOfComponentsPerPixel()!=numberOfDWI, "the number of volumes in " << info.DataFile << " is changed");
+      dwiTempImage->SetRequestedRegion(region);
+      dwiReader->Update();
+
+      ImageRegionIteratorWithIndex<B0ImageType> b0It(m_B0Image, region);
+      ImageRegionIteratorWithIndex<DWIImageType> dwiIt(dwiImage, region);
+      ImageRegionIteratorWithIndex<MaskImageType> maskIt;
+      if (!IsImageEmpty(m_MaskImage))
+        maskIt = ImageRegionIteratorWithIndex<MaskImageType>(m_MaskImage, region);
+      ImageRegionIteratorWithIndex<DWIImageType> dwiTempIt(dwiTempImage, region);
       PixelType dwiTempPixel;
       for (b0It.GoToBegin(), dwiIt.GoToBegin(), dwiTempIt.GoToBegin(), maskIt.GoToBegin(); 
         !b0It.IsAtEnd(); 
@@ -431,9 +535,11 @@ DWIReader<TPixelType, VImageDimension>
 
         dwiTempPixel = dwiTempIt.Get();
         std::ostringstream ossWarn;
-        // additional b0
-        for ( int kk = 0; kk < additionalB0[i]; kk += 1 ) 
+        // additional b0 and b0 in gradients
+        for ( int kk = 0; kk < numberOfDWI; kk += 1 ) 
           {
+          if (gatherIndex[kk]!=-1)
+            continue;
           if (dwiTempPixel[kk]<1e-10)
             ossWarn << "zero b0 at ["<< b0Index[0]<<","<<b0Index[1]<<","<<b0Index[2]<<","<<kk <<"], b0=" << dwiTempPixel[kk] << "\n";
           if (numberOfB0>0)
@@ -442,17 +548,6 @@ DWIReader<TPixelType, VImageDimension>
             b0It.Set(b0Pixel);
             }
           }
-        // b0 in gradients
-        for ( int kk = 0; kk < b0IndexVec[i].size(); kk += 1 ) 
-          {
-          if (dwiTempPixel[kk]<1e-10)
-            ossWarn << "zero b0 at ["<< b0Index[0]<<","<<b0Index[1]<<","<<b0Index[2]<<","<<kk <<"], b0=" << dwiTempPixel[kk] << "\n";
-          if (numberOfB0>0)
-            {
-            b0Pixel = b0It.Get() + dwiTempPixel[ b0IndexVec[i][kk]+additionalB0[i] ]/((double)numberOfB0);
-            b0It.Set(b0Pixel);
-            }
-          }
 
         if (b0It.Get()<1e-10)
           {
@@ -462,15 +557,13 @@ DWIReader<TPixelType, VImageDimension>
 
         // dwi without b0
         dwiPixel = dwiIt.Get();
-        int jj=0;
-        for ( int kk = additionalB0[i]; kk < numberOfDWI; kk += 1 ) 
+        for ( int kk = 0; kk < numberOfDWI; kk += 1 ) 
           {
-          if (!utl::IsInVector(b0IndexVec[i], kk-additionalB0[i]) && ( stringMatrix[i].size()==3 || (stringMatrix[i].size()==4 && utl::IsInVector(selectIndexVec[i],kk-additionalB0[i]))) )
+          if (gatherIndex[kk]>=0)
             {
             if (dwiTempPixel[kk]<1e-10)
               ossWarn << "zero dwi at ["<< b0Index[0]<<","<<b0Index[1]<<","<<b0Index[2]<<","<<kk <<"], dwi value=" << dwiTempPixel[kk] << "\n";
-            dwiPixel[jj + (i==0?0:numDWINob0[i-1])] = dwiTempPixel[kk];
-            jj++;
+            dwiPixel[gatherIndex[kk]] = dwiTempPixel[kk];
             }
           }
 
@@ -491,9 +584,58 @@ DWIReader<TPixelType, VImageDimension>
       }
 
     }
+}
 
-  m_SamplingSchemeQSpace->SetOrientationsCartesian(orientationsCartesian);
-  m_SamplingSchemeQSpace->SetBVector(bVector);
+template <class TPixelType, unsigned int VImageDimension>
+ITK_THREAD_RETURN_TYPE
+DWIReader<TPixelType, VImageDimension>
+::GatherVolumesThreaderCallback(void* arg)
+{
+  const MultiThreader::ThreadInfoStruct* threadInfo = static_cast<MultiThreader::ThreadInfoStruct*>(arg);
+  const GatherVolumesStruct* str = static_cast<GatherVolumesStruct*>(threadInfo->UserData);
+
+  // a tile of 64 voxels x 16 volumes reads 16 contiguous rows of the chunk, and writes 64 short runs of the output which stay in cache
+  const long tileVoxels = 64;
+  const int tileVolumes = 16;
+  const long numberOfTiles = (str->NumberOfVoxels+tileVoxels-1)/tileVoxels;
+  const long tileStart = numberOfTiles*threadInfo->ThreadID/threadInfo->NumberOfThreads;
+  const long tileEnd = numberOfTiles*(threadInfo->ThreadID+1)/threadInfo->NumberOfThreads;
+
+  for ( long tile = tileStart; tile < tileEnd; tile += 1 ) 
+    {
+    const long n0 = tile*tileVoxels;
+    const long n1 = utl::min(n0+tileVoxels, str->NumberOfVoxels);
+    for ( int k0 = 0; k0 < str->NumberOfVolumes; k0 += tileVolumes ) 
+      {
+      const int k1 = utl::min(k0+tileVolumes, str->NumberOfVolumes);
+      for ( long n = n0; n < n1; n += 1 ) 
+        {
+        if (str->Mask && str->Mask[n]<=1e-10)
+          continue;
+        TPixelType* out = str->Output + n*str->NumberOfComponents;
+        for ( int k = k0; k < k1; k += 1 ) 
+          {
+          const int index = str->GatherIndex[k];
+          if (index==-2)
+            continue;
+          const TPixelType value = str->Chunk[k*str->NumberOfVoxels+n];
+          if (index>=0)
+            {
+            out[index] = value;
+            str->SumSquareDWI[n] += value*value;
+            }
+          else
+            {
+            str->B0[n] += value*str->B0Weight;
+            str->SumSquareB0[n] += value*value;
+            }
+          if (value<1e-10)
+            str->NumberOfZeroValues[n]++;
+          }
+        }
+      }
+    }
+  return ITK_THREAD_RETURN_VALUE;
 }
 
 template <class TPixelType, unsigned int VImageDimension>
@@ -508,11 +650,12 @@ DWIReader<TPixelType, VImageDimension>
   utlGlobalException(!dwiImage, "no dwi images");
   utlGlobalException(!(itk::VerifyImageSize<DWIImageType, B0ImageType>(dwiImage, m_B0Image, true)), "dwi image and b0 image have different information");
 
-  ImageRegionIteratorWithIndex<B0ImageType> b0It(m_B0Image, m_B0Image->GetLargestPossibleRegion());
-  ImageRegionIteratorWithIndex<DWIImageType> dwiIt(dwiImage, dwiImage->GetLargestPossibleRegion());
+  // only the buffered region is processed, which is the requested region when the reader is streamed
+  ImageRegionIteratorWithIndex<B0ImageType> b0It(m_B0Image, dwiImage->GetBufferedRegion());
+  ImageRegionIteratorWithIndex<DWIImageType> dwiIt(dwiImage, dwiImage->GetBufferedRegion());
   ImageRegionIteratorWithIndex<MaskImageType> maskIt;
   if (!IsImageEmpty(m_MaskImage))
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, m_MaskImage->GetLargestPossibleRegion());
+    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, dwiImage->GetBufferedRegion());
   typename B0ImageType::IndexType  b0Index;
   typename B0ImageType::PixelType  b0Pixel;
   PixelType dwiPixel;
@@ -602,8 +745,8 @@ DWIReader<TPixelType, VImageDimension>
   utlGlobalException(!dwiImage, "no dwi images");
   utlGlobalException(!(itk::VerifyImageSize<DWIImageType, B0ImageType>(dwiImage, m_B0Image, true)), "dwi image and b0 image have different information");
 
-  ImageRegionIterator<B0ImageType> b0It(m_B0Image, m_B0Image->GetLargestPossibleRegion());
-  ImageRegionIterator<DWIImageType> dwiIt(dwiImage, dwiImage->GetLargestPossibleRegion());
+  ImageRegionIterator<B0ImageType> b0It(m_B0Image, dwiImage->GetBufferedRegion());
+  ImageRegionIterator<DWIImageType> dwiIt(dwiImage, dwiImage->GetBufferedRegion());
   typename B0ImageType::PixelType  b0Pixel;
   PixelType dwiPixel;
   dwiPixel.SetSize(dwiImage->GetNumberOfComponentsPerPixel());
@@ -622,6 +765,16 @@ DWIReader<TPixelType, VImageDimension>
   this->Modified();
 }
 
+template <class TPixelType, unsigned int VImageDimension>
+void
+DWIReader<TPixelType, VImageDimension>
+::GenerateOutputInformation()
+{
+  utlGlobalException(m_ConfigurationFile=="", "unknown format! ");
+  if (m_DWIFileInformation.size()==0 || m_ConfigurationInformationTime.GetMTime()<this->GetMTime())
+    ReadConfigurationInformation(m_ConfigurationFile);
+}
+
 template <class TPixelType, unsigned int VImageDimension>
 void
 DWIReader<TPixelType, VImageDimension>
@@ -632,9 +785,6 @@ DWIReader<TPixelType, VImageDimension>
   else
     utlGlobalException(true, "unknown format! ");
   
-  if (m_SamplingSchemeQSpace->GetBThresholdSingleShell()>0)
-    m_SamplingSchemeQSpace->CorrectBValues();
-
   // correct values if needed
   if (m_CorrectDWIValues)
     CorrectDWI();
@@ -642,6 +792,9 @@ DWIReader<TPixelType, VImageDimension>
   // normalize values if needed
   if (m_NormalizeDWI)
     NormalizeDWI();
+
+  // CorrectDWI() and NormalizeDWI() modify the filter, which should not read the configuration file again for the next requested region. 
+  m_ConfigurationInformationTime.Modified();
 }
 
 template <class TPixelType, unsigned int VImageDimension>
@@ -651,7 +804,8 @@ DWIReader<TPixelType, VImageDimension>
 {
   Superclass::PrintSelf(os, indent);
   PrintVar3(true, m_IsInput4DImage, m_NormalizeDWI, m_CorrectDWIValues, os<<indent );
-  PrintVar1(true, m_ConfigurationFile, os<<indent);
+  PrintVar2(true, m_ConfigurationFile, m_StreamingChunkSizeInMB, os<<indent);
+  PrintVar3(true, m_NumberOfB0, m_NumberOfDWIsWithoutB0, m_IsB0ImageComputed, os<<indent);
   os << indent << "m_SamplingSchemeQSpace = " << m_SamplingSchemeQSpace << std::endl << std::flush;
   if (!IsImageEmpty(m_MaskImage))
     os << indent << "m_MaskImage = " << m_MaskImage << std::endl << std::flush;
@@ -0,0 +1,140 @@
+/**
+ *       @file  itkDWIGeneratorGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "itkVectorImage.h"
+#include "itkDWIGenerator.h"
+#include "utl.h"
+
+namespace
+{
+typedef itk::VectorImage<float, 3>                                OutputImageType;
+typedef itk::Image<float, 3>                                      ScalarImageType;
+typedef itk::DWIGenerator<OutputImageType, ScalarImageType>       GeneratorType;
+
+/** Write a 4x4x2 phantom with one-fiber and two-fiber tensors.
+ * Voxels in the first slice share 3 parameter sets, voxels in the second slice have different parameters,
+ * and two voxels are not in the file (background).  */
+std::string
+WritePhantomFile()
+{
+  std::string fileName = ::testing::TempDir() + "itkDWIGeneratorGTest_phantom.txt";
+  std::ofstream out(fileName.c_str());
+  out << "NDims = 3\n";
+  out << "DimSize = 4 4 2\n";
+  out << "ElementSpacing = 1 1 1\n";
+  out << "ModelType = SYMMETRICAL_TENSOR_IN_CARTESIAN_COORDS\n";
+  for ( int k = 0; k < 2; ++k )
+    for ( int j = 0; j < 4; ++j )
+      for ( int i = 0; i < 4; ++i )
+        {
+        if (k==1 && j==3 && i>=2)
+          continue;
+        out << "DiffusionParameters = " << i << " " << j << " " << k;
+        int label = k==0 ? (i+j)%3 : 4*j+i;
+        double angle = 0.2*label;
+        out << " " << std::cos(angle) << " " << std::sin(angle) << " 0 1.7e-3 0.3e-3 1";
+        if (label%2==1)
+          out << " 0 " << std::cos(angle) << " " << std::sin(angle) << " 1.5e-3 0.2e-3 0.5";
+        out << "\n";
+        }
+  return fileName;
+}
+
+/** DWI image and b0 image generated with a fixed seed.  */
+void
+GenerateDWI(const std::string& fileName, const int numberOfThreads, const int maxNumberOfStoredSignals, const long seed,
+  OutputImageType::Pointer& dwi, ScalarImageType::Pointer& b0)
+{
+  // 30 orientations on a spiral, in two shells with b=1000 and b=2000
+  const int numberOfOrientations = 30;
+  GeneratorType::MatrixPointer qMatrix(new GeneratorType::MatrixType(2*numberOfOrientations, 3));
+  GeneratorType::STDVectorPointer bVector(new GeneratorType::STDVectorType(2*numberOfOrientations));
+  for ( int n = 0; n < numberOfOrientations; ++n )
+    {
+    double z = 1.0 - (n+0.5)/numberOfOrientations;
+    double r = std::sqrt(1.0-z*z), phi = 2.399963*n;
+    for ( int s = 0; s < 2; ++s )
+      {
+      (*qMatrix)(s*numberOfOrientations+n,0) = r*std::cos(phi);
+      (*qMatrix)(s*numberOfOrientations+n,1) = r*std::sin(phi);
+      (*qMatrix)(s*numberOfOrientations+n,2) = z;
+      (*bVector)[s*numberOfOrientations+n] = 1000.0*(s+1);
+      }
+    }
+
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetFileName(fileName);
+  generator->SetIsOutputDWI(true);
+  generator->SetNoiseSigma(0.05);
+  generator->SetRandomSeed(seed);
+  generator->SetNumberOfThreads(numberOfThreads);
+  generator->SetMaxNumberOfStoredSignals(maxNumberOfStoredSignals);
+  generator->GetSamplingSchemeQSpace()->SetOrientationsCartesian(qMatrix);
+  generator->GetSamplingSchemeQSpace()->SetBVector(bVector);
+  GeneratorType::STDVectorType background(6);
+  background[0]=1, background[1]=0, background[2]=0, background[3]=3e-3, background[4]=3e-3, background[5]=1;
+  generator->SetBackgroundDiffusionParameterValues(background);
+  generator->SetCylinderModel(GeneratorType::CylinderModelType::New());
+  generator->Update();
+
+  dwi = generator->GetDWIImage();
+  b0 = generator->GetB0Image();
+}
+
+/** number of different values in the buffers of two images  */
+template <class ImageType>
+int
+NumberOfDifferentValues(const ImageType* image1, const ImageType* image2)
+{
+  int size1 = image1->GetPixelContainer()->Size(), size2 = image2->GetPixelContainer()->Size();
+  if (size1!=size2)
+    return std::max(size1, size2);
+  int numberOfDifferences = 0;
+  for ( int i = 0; i < size1; ++i )
+    {
+    if (image1->GetBufferPointer()[i]!=image2->GetBufferPointer()[i])
+      numberOfDifferences++;
+    }
+  return numberOfDifferences;
+}
+}
+
+TEST(itkDWIGenerator, SameOutputInThreads)
+{
+  std::string fileName = WritePhantomFile();
+
+  OutputImageType::Pointer dwi1, dwiN, dwiNotStored, dwiSeed;
+  ScalarImageType::Pointer b01, b0N, b0NotStored, b0Seed;
+  GenerateDWI(fileName, 1, 100000, 123, dwi1, b01);
+  GenerateDWI(fileName, 4, 100000, 123, dwiN, b0N);
+  // signals are computed in voxels if they are not stored
+  GenerateDWI(fileName, 4, 0, 123, dwiNotStored, b0NotStored);
+  GenerateDWI(fileName, 4, 100000, 124, dwiSeed, b0Seed);
+
+  EXPECT_EQ(4*4*2*60, dwi1->GetPixelContainer()->Size());
+  EXPECT_EQ(0, NumberOfDifferentValues<OutputImageType>(dwi1, dwiN));
+  EXPECT_EQ(0, NumberOfDifferentValues<ScalarImageType>(b01, b0N));
+  EXPECT_EQ(0, NumberOfDifferentValues<OutputImageType>(dwi1, dwiNotStored));
+  EXPECT_EQ(0, NumberOfDifferentValues<ScalarImageType>(b01, b0NotStored));
+
+  // noise depends on the seed
+  EXPECT_GT(NumberOfDifferentValues<OutputImageType>(dwi1, dwiSeed), 0);
+
+  std::remove(fileName.c_str());
+}
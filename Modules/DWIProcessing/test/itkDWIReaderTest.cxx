@@ -48,6 +48,7 @@ main (int argc, char const* argv[])
     reader->SetNormalizeDWI(false);
   if (_IsVectorImageArg.isSet())
     reader->SetIsInput4DImage(false);
+  reader->SetStreamingChunkSizeInMB(_ChunkSize);
   if (_B0FileArg.isSet())
     {
     typedef DWIReaderType::B0ImageType B0ImageType;
@@ -33,6 +33,10 @@ namespace itk
  *
  *   Reference: 
  *   Resolution of complex tissue microarchitecture using the diffusion orientation transform (DOT), Evren Ozarslan, NeuroImage 2006
+ *
+ *   The exponential terms of the series only depend on the length, the radius, D0 and DeltaBig, and they are separable in n and (m,k).
+ *   They are computed once in SeriesTermsType, and reused for all axes and samples until the geometry is changed.
+ *   ComputeDWISamplesInBatch() computes DWI samples of many axes and many geometries in one call.
  *    
  * \ingroup DiffusionModels
  *
@@ -70,9 +74,6 @@ public:
   typedef Image<double>  Image3DType;
   typedef typename Image3DType::Pointer  Image3DPointer;
   
-  typedef UnaryFunctorLookUpTable<utl::Functor::Exp<double> >                   LUTExpType;
-  typedef typename LUTExpType::Pointer                         LUTExpPointer;
-  
   itkSetMacro(CylinderAxis, PointType);
   itkGetMacro(CylinderAxis, PointType);
 
@@ -89,10 +90,22 @@ public:
 
   void ComputeDWISamples ();
 
+  /** DWI samples of cylinders with the current geometry and different axes. 
+   * axes is a (numberOfAxes x 3) matrix. dwiSamples is a (numberOfAxes x numberOfSamples) matrix.  */
+  void ComputeDWISamplesInBatch (const MatrixType& axes, MatrixType& dwiSamples);
+
+  /** DWI samples of cylinders with different geometries and axes. 
+   * Each row of parameters is (length, radius, D0). axes is a (numberOfAxes x 3) matrix. 
+   * dwiSamples is a (numberOfParameterSets*numberOfAxes x numberOfSamples) matrix, the row p*numberOfAxes+a is for the p-th geometry and the a-th axis. 
+   * The geometry of the generator is not changed.  */
+  void ComputeDWISamplesInBatch (const MatrixType& parameters, const MatrixType& axes, MatrixType& dwiSamples);
+
   void ComputeEAPSamples ();
   
   void ComputeODFSamples ();
   
+  /** build the series terms for the current geometry and DeltaBig in m_SamplingSchemeQSpace. 
+   * It is optional, because ComputeDWISamples() builds them if needed. Clones created after it share the terms. */
   void BuildTable ();
   
   // void VerifyInputParameters() const;
@@ -109,13 +122,40 @@ protected:
 
   typename LightObject::Pointer InternalClone() const;
 
+  /** Terms of the series in DWI samples, which depend on the length, the radius, D0 and DeltaBig, but not on the axis and samples.  */
+  struct SeriesTermsType
+    {
+    double Length;
+    double Radius;
+    double D0;
+    double DeltaBig;
+    /** \f$ (n\pi/L)^2 \f$, n=0,...,nMax  */
+    STDVectorType NPiLength2;
+    /** \f$ K_n \exp(-(n\pi/L)^2 D_0 \Delta) \f$, \f$ K_0=1, K_n=2 \f$  */
+    STDVectorType NTerms;
+    /** \f$ \gamma_{km}^2 \f$, (mMax+1) x kMax  */
+    MatrixType Gamma2;
+    /** \f$ K_m \frac{\gamma_{km}^2}{\gamma_{km}^2-m^2} \exp(-\gamma_{km}^2 D_0 \Delta/R^2) \f$, \f$ K_0=1, K_m=2 \f$, (mMax+1) x kMax  */
+    MatrixType MKTerms;
+    };
+  typedef utl_shared_ptr<SeriesTermsType>   SeriesTermsPointer;
+
+  static SeriesTermsPointer ComputeSeriesTerms(const double length, const double radius, const double d0, const double deltaBig);
+
+  /** series terms of the current geometry, which are rebuilt only when the geometry or DeltaBig is changed.  */
+  SeriesTermsPointer GetSeriesTerms();
+
+  /** DWI signal of the sample with q value qq, for a cylinder with the axis  */
+  static double ComputeDWISample(const SeriesTermsType& terms, const PointType& axis, const PointType& sample, const double qq);
+
   double m_Length;
   double m_Radius;
   double m_D0;
 
   PointType m_CylinderAxis;
 
-  LUTExpPointer m_LUTExp;
+  /** it is not modified after it is built, thus it is shared by clones  */
+  SeriesTermsPointer m_SeriesTerms;
 
   Image3DPointer m_EAPVolumeForZAxis;
   Image3DPointer m_ODFVolumeForZAxis;
@@ -37,12 +37,6 @@ CylinderModelGenerator<PreciseType>
   m_CylinderAxis[0]=0;
   m_CylinderAxis[1]=0;
   m_CylinderAxis[2]=1.0;
-  
-  m_LUTExp = LUTExpType::New();
-  m_LUTExp->SetVariableMax(0);
-  m_LUTExp->SetVariableMin(-30);
-  m_LUTExp->SetNumberOfBins(30*1e3);
-  // m_LUTExp->BuildLUT();
 }
 
 template <class PreciseType>
@@ -62,7 +56,7 @@ CylinderModelGenerator<PreciseType>
   rval->m_Radius = m_Radius;
   rval->m_D0 = m_D0;
   rval->m_CylinderAxis = m_CylinderAxis;
-  rval->m_LUTExp = m_LUTExp->Clone();
+  rval->m_SeriesTerms = m_SeriesTerms;
 
   return loPtr;
 }
@@ -72,7 +66,7 @@ void
 CylinderModelGenerator<PreciseType>
 ::BuildTable()
 {
-  m_LUTExp->BuildTable();
+  GetSeriesTerms();
 }
 
 template <class PreciseType>
@@ -104,111 +98,196 @@ CylinderModelGenerator<PreciseType>
 }
 
 template <class PreciseType>
-void
+typename CylinderModelGenerator<PreciseType>::SeriesTermsPointer
 CylinderModelGenerator<PreciseType>
-::ComputeDWISamples ()
+::ComputeSeriesTerms(const double length, const double radius, const double d0, const double deltaBig)
 {
-  utlShowPosition(this->GetDebug());
-  this->VerifyInputParameters();
-  utlGlobalException(this->m_SamplingSchemeQSpace->GetNumberOfSamples()==0, "need to set m_SamplingSchemeQSpace");
-  utlGlobalException(!m_LUTExp->IsTableBuilt(), "need to build m_LUTExp first");
-
   const int nMax = 1000, mMax = 10, kMax = 10;
-  int N = this->m_SamplingSchemeQSpace->GetNumberOfSamples();
-  STDVectorPointer qVector = this->m_SamplingSchemeQSpace->GetRadiusVector();
+  SeriesTermsPointer terms(new SeriesTermsType());
+  terms->Length = length;
+  terms->Radius = radius;
+  terms->D0 = d0;
+  terms->DeltaBig = deltaBig;
+
+  double d0DeltaBig = d0*deltaBig;
+  double radius2 = radius*radius;
+
+  // exp(-(gamma_km^2/R^2 + (n pi/L)^2) D0 Delta) = exp(-gamma_km^2/R^2 D0 Delta) * exp(-(n pi/L)^2 D0 Delta)
+  terms->NPiLength2.resize(nMax+1);
+  terms->NTerms.resize(nMax+1);
+  for ( int n = 0; n <= nMax; n += 1 ) 
+    {
+    terms->NPiLength2[n] = std::pow(n*M_PI/length,2);
+    terms->NTerms[n] = (n>0?2:1) * std::exp(-d0DeltaBig*terms->NPiLength2[n]);
+    }
 
+  terms->Gamma2.set_size(mMax+1, kMax);
+  terms->MKTerms.set_size(mMax+1, kMax);
+  for ( int m = 0; m <= mMax; m += 1 ) 
+    {
+    for ( int k = 1; k <= kMax; k += 1 ) 
+      {
+      double gamma_km = utl::BesselJPrimeZerosTable[kMax*m+k-1];
+      double gamma_km2 = gamma_km * gamma_km;
+      double mkTerm = (m>0?2:1) * std::exp(-gamma_km2/radius2 * d0DeltaBig);
+      if (m!=0)
+        mkTerm *= gamma_km2 / (gamma_km2-m*m);
+      terms->Gamma2(m,k-1) = gamma_km2;
+      terms->MKTerms(m,k-1) = mkTerm;
+      }
+    }
+  return terms;
+}
+
+template <class PreciseType>
+typename CylinderModelGenerator<PreciseType>::SeriesTermsPointer
+CylinderModelGenerator<PreciseType>
+::GetSeriesTerms()
+{
   double deltaBig = this->m_SamplingSchemeQSpace->GetDeltaBig();
-  double d0DeltaBig = m_D0*deltaBig;
-  double radius2 = m_Radius*m_Radius;
+  if (!m_SeriesTerms || m_SeriesTerms->Length!=m_Length || m_SeriesTerms->Radius!=m_Radius || m_SeriesTerms->D0!=m_D0 || m_SeriesTerms->DeltaBig!=deltaBig)
+    m_SeriesTerms = ComputeSeriesTerms(m_Length, m_Radius, m_D0, deltaBig);
+  return m_SeriesTerms;
+}
 
-  std::vector<double> nPiLength2(nMax+1);
-  std::vector<double> nPiLength2D0Delta(nMax+1);
+template <class PreciseType>
+double
+CylinderModelGenerator<PreciseType>
+::ComputeDWISample(const SeriesTermsType& terms, const PointType& axis, const PointType& sample, const double qq)
+{
+  const int nMax = terms.NTerms.size()-1, mMax = terms.Gamma2.rows()-1, kMax = terms.Gamma2.cols();
+  const double length = terms.Length, radius = terms.Radius;
+
+  double dott = sample[0]*axis[0] + sample[1]*axis[1] + sample[2]*axis[2];
+  double angle = std::acos( dott>=1?1:(dott<=-1?-1:dott) );
+  if (angle>M_PI/2) // only in [0,90]
+    angle = M_PI - angle;
+  if (M_PI/2-angle<1.0e-5) // NOTE: 0 and 90 is a sigular point
+    angle = M_PI/2 - 1.0e-5;
+  if (angle<1e-5)
+    angle = 1e-5;
+  double angle2sin = std::sin(2*angle);
+
+  double pi2qcos = 2.0*M_PI*qq*std::cos(angle);
+  double pi2qsin = 2.0*M_PI*qq*std::sin(angle);
+  double pi2qsinRadius = pi2qsin*radius;
+  double pi2qsinRadius2 = pi2qsinRadius*pi2qsinRadius;
+  double pi2qcos2 = pi2qcos*pi2qcos;
+  double pi2qcosLengthcos = std::cos(pi2qcos*length);
+  double first_temp = 2.0*radius*radius *std::pow(2*M_PI*qq,4)*angle2sin*angle2sin / (length*length);
+
+  // terms in n do not depend on m and k
+  double sumN = 0;
   for ( int n = 0; n <= nMax; n += 1 ) 
     {
-    nPiLength2[n] = std::pow(n*M_PI/m_Length,2);
-    nPiLength2D0Delta[n] = d0DeltaBig *nPiLength2[n];
+    double num2 = (n%2 ? (1+pi2qcosLengthcos) : (1-pi2qcosLengthcos));
+    double tmp1 = terms.NPiLength2[n] - pi2qcos2;
+    sumN += num2 * terms.NTerms[n] / (tmp1*tmp1);
     }
 
-  this->m_DWISamples = VectorPointer(new VectorType(N));
+  std::vector<double> besselJnVec(mMax+2);
+  for ( int m = 0; m <= mMax+1; m += 1 ) 
+    besselJnVec[m] = gsl_sf_bessel_Jn(m,pi2qsinRadius);
+
+  double sumMK = 0;
+  for ( int m = 0; m <=mMax; m += 1 ) 
+    {
+    double J_m_d = m/(pi2qsinRadius)*besselJnVec[m] - besselJnVec[m+1];
+    double J_m_d2 = J_m_d*J_m_d;
+    for ( int k = 0; k < kMax; k += 1 ) 
+      {
+      double tmp2 = terms.Gamma2(m,k) - pi2qsinRadius2;
+      sumMK += J_m_d2 * terms.MKTerms(m,k) / (tmp2*tmp2);
+      }
+    }
+  return first_temp*sumMK*sumN;
+}
+
+template <class PreciseType>
+void
+CylinderModelGenerator<PreciseType>
+::ComputeDWISamples ()
+{
+  utlShowPosition(this->GetDebug());
+  this->VerifyInputParameters();
+  utlGlobalException(this->m_SamplingSchemeQSpace->GetNumberOfSamples()==0, "need to set m_SamplingSchemeQSpace");
 
-  // m_LUTExp->Print(std::cout<<"lut = ");
+  int N = this->m_SamplingSchemeQSpace->GetNumberOfSamples();
+  STDVectorPointer qVector = this->m_SamplingSchemeQSpace->GetRadiusVector();
+  SeriesTermsPointer terms = GetSeriesTerms();
 
+  this->m_DWISamples = VectorPointer(new VectorType(N));
 
   int i=0;
 #pragma omp parallel for private (i) 
   for(i=0; i < N; i++) 
     {
-
     PointType sample = (*this->m_SamplingSchemeQSpace)[i];
-    double dott = sample[0]*m_CylinderAxis[0] + sample[1]*m_CylinderAxis[1] + sample[2]*m_CylinderAxis[2];
-    double angle = std::acos( dott>=1?1:(dott<=-1?-1:dott) );
-    if (angle>M_PI/2) // only in [0,90]
-      angle = M_PI - angle;
-    if (M_PI/2-angle<1.0e-5) // NOTE: 0 and 90 is a sigular point
-      angle = M_PI/2 - 1.0e-5;
-    if (angle<1e-5)
-      angle = 1e-5;
-    double angle2sin = std::sin(2*angle);
-
-    double signal_temp=0;
-    double qq = (*qVector)[i];
-    double pi2qcos = 2.0*M_PI*qq*std::cos(angle);
-    double pi2qsin = 2.0*M_PI*qq*std::sin(angle);
-    double pi2qsinRadius = pi2qsin*m_Radius;
-    double pi2qcosLengthcos = std::cos(pi2qcos*m_Length);
-    double first_temp = 2.0*std::pow(m_Radius,2) *std::pow(2*M_PI*qq,4)*angle2sin*angle2sin / (m_Length*m_Length);
-    MatrixType third_temp(mMax+1, nMax+1);
-    for ( int n = 0; n <= nMax; n += 1 ) 
-      {
-      double num2 = (n%2 ? (1+pi2qcosLengthcos) : (1-pi2qcosLengthcos));
-      double tmp1 = std::pow( nPiLength2[n] - std::pow(pi2qcos,2), 2 );
-      for ( int m = 0; m <= mMax; m += 1 ) 
-        {
-        // utlPrintVar2(true, m, n);
-        double K_mn = m>0? (n>0?4:2) : (n>0?2:1);
-        third_temp(m,n) = num2 *K_mn / tmp1;
-        }
-      }
-
-    std::vector<double> besselJnVec(mMax+2);
-    for ( int m = 0; m <= mMax; m += 1 ) 
-      besselJnVec[m] = gsl_sf_bessel_Jn(m,pi2qsinRadius);
-
-    for ( int m = 0; m <=mMax; m += 1 ) 
-      {
-      double J_m_d = m/(pi2qsinRadius)*besselJnVec[m] - besselJnVec[m+1];
-      double J_m_d2 = J_m_d*J_m_d;
-      for ( int k = 1; k <=kMax; k += 1 ) 
-        {
-        double gamma_km = utl::BesselJPrimeZerosTable[kMax*m+k-1];
-        double gamma_km2 = gamma_km * gamma_km;
-        // utlPrintVar4(true, m,k, gamma_km, J_m_d2);
-        double gamma_km_Radius2_D0Delta = gamma_km2/radius2 * d0DeltaBig;
-        double second_temp = J_m_d2 / std::pow(gamma_km2-std::pow(pi2qsinRadius,2) ,2) ;
-        if (m!=0)
-          second_temp *= gamma_km2 / (gamma_km2-m*m);
-        for ( int n = 0; n <=nMax; n += 1 ) 
-          {
-          // double fourth_temp = std::exp(- (gamma_km_Radius2_D0Delta+nPiLength2D0Delta[n]) ); 
-          // double fourth_temp = utl::ExpNegtiveLUT(gamma_km_Radius2_D0Delta + nPiLength2D0Delta[n], 30.0, 1e3); 
-          double fourth_temp = m_LUTExp->GetFunctionValue( - (gamma_km_Radius2_D0Delta+nPiLength2D0Delta[n])); 
-          // double val = (gamma_km_Radius2_D0Delta+nPiLength2D0Delta[n]);
-          // utlPrintVar3(true, val, utl::ExpNegtiveLUT(val, 30.0, 1e3), m_LUTExp->GetFunctionValue(-val));
-          signal_temp += first_temp*second_temp*third_temp(m,n)*fourth_temp;
-          }
-        }
-      }
+    double signal_temp = ComputeDWISample(*terms, m_CylinderAxis, sample, (*qVector)[i]);
     (*this->m_DWISamples)[i] = signal_temp;
     if (this->GetDebug())
       {
       std::cout << "i = " << i << std::endl << std::flush;
       std::cout << "sample = " << sample << std::endl << std::flush;
-      std::cout << "qq = " << qq << std::endl << std::flush;
+      std::cout << "qq = " << (*qVector)[i] << std::endl << std::flush;
       std::cout << "signal_temp = " << signal_temp << std::endl << std::flush;
       }
     }
 }
 
+template <class PreciseType>
+void
+CylinderModelGenerator<PreciseType>
+::ComputeDWISamplesInBatch (const MatrixType& axes, MatrixType& dwiSamples)
+{
+  MatrixType parameters(1,3);
+  parameters(0,0) = m_Length, parameters(0,1) = m_Radius, parameters(0,2) = m_D0;
+  ComputeDWISamplesInBatch(parameters, axes, dwiSamples);
+}
+
+template <class PreciseType>
+void
+CylinderModelGenerator<PreciseType>
+::ComputeDWISamplesInBatch (const MatrixType& parameters, const MatrixType& axes, MatrixType& dwiSamples)
+{
+  utlShowPosition(this->GetDebug());
+  this->VerifyInputParameters();
+  utlGlobalException(this->m_SamplingSchemeQSpace->GetNumberOfSamples()==0, "need to set m_SamplingSchemeQSpace");
+  utlSAGlobalException(parameters.columns()!=3 || axes.columns()!=3)(parameters.columns())(axes.columns()).msg("wrong size of parameters (length, radius, D0) or axes");
+
+  int N = this->m_SamplingSchemeQSpace->GetNumberOfSamples();
+  int numberOfAxes = axes.rows();
+  int numberOfParameterSets = parameters.rows();
+  STDVectorPointer qVector = this->m_SamplingSchemeQSpace->GetRadiusVector();
+  double deltaBig = this->m_SamplingSchemeQSpace->GetDeltaBig();
+
+  std::vector<SeriesTermsPointer> termsVec(numberOfParameterSets);
+  for ( int p = 0; p < numberOfParameterSets; p += 1 ) 
+    {
+    if (parameters(p,0)==m_Length && parameters(p,1)==m_Radius && parameters(p,2)==m_D0)
+      termsVec[p] = GetSeriesTerms();
+    else
+      termsVec[p] = ComputeSeriesTerms(parameters(p,0), parameters(p,1), parameters(p,2), deltaBig);
+    }
+
+  std::vector<PointType> samples(N);
+  for ( int i = 0; i < N; i += 1 ) 
+    samples[i] = (*this->m_SamplingSchemeQSpace)[i];
+
+  dwiSamples.set_size(numberOfParameterSets*numberOfAxes, N);
+  int row=0;
+#pragma omp parallel for private (row) 
+  for(row=0; row < numberOfParameterSets*numberOfAxes; row++) 
+    {
+    const SeriesTermsType& terms = *termsVec[row/numberOfAxes];
+    PointType axis;
+    for ( int d = 0; d < 3; d += 1 ) 
+      axis[d] = axes(row%numberOfAxes, d);
+    for ( int i = 0; i < N; i += 1 ) 
+      dwiSamples(row, i) = ComputeDWISample(terms, axis, samples[i], (*qVector)[i]);
+    }
+}
+
 template <class PreciseType>
 void
 CylinderModelGenerator<PreciseType>
@@ -94,6 +94,9 @@ protected:
   
   virtual void VerifyInputParameters() const;
 
+  /** Clones are also invalid if the sampling scheme is modified  */
+  virtual bool IsThreadClonesValid() const ITK_OVERRIDE;
+
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
   typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
   
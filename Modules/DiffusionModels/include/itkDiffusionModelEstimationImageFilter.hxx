@@ -77,6 +77,16 @@ DiffusionModelEstimationImageFilter< TInputImage, TOutputImage >
   utlGlobalException(m_SamplingSchemeQSpace->GetRadiusVector()->size()!=m_SamplingSchemeQSpace->GetNumberOfSamples(), "the size of gradients and the size of b values are not the same");
 }
 
+template< class TInputImage, class TOutputImage >
+bool
+DiffusionModelEstimationImageFilter< TInputImage, TOutputImage >
+::IsThreadClonesValid() const
+{
+  if (!Superclass::IsThreadClonesValid())
+    return false;
+  return !m_SamplingSchemeQSpace || m_SamplingSchemeQSpace->GetMTime()<this->m_ThreadClonesTime.GetMTime();
+}
+
 template< class TInputImage, class TOutputImage >
 void
 DiffusionModelEstimationImageFilter< TInputImage, TOutputImage >
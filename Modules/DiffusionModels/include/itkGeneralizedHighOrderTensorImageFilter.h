@@ -57,6 +57,12 @@ public:
   typedef typename Superclass::STDVectorType    STDVectorType;
   typedef typename Superclass::STDVectorPointer STDVectorPointer;
 
+  typedef typename Superclass::SolverPrecisionType   SolverPrecisionType;
+  typedef typename Superclass::SolverMatrixType      SolverMatrixType;
+  typedef typename Superclass::SolverVectorType      SolverVectorType;
+  typedef typename Superclass::SolverMatrixPointer   SolverMatrixPointer;
+  typedef typename Superclass::SolverVectorPointer   SolverVectorPointer;
+
   typedef typename Superclass::L2SolverType     L2SolverType;
   typedef typename Superclass::EstimationType   EstimationType;
   
@@ -81,7 +87,7 @@ protected:
 
   void BeforeThreadedGenerateData () ITK_OVERRIDE;
 
-  void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,ThreadIdType threadId ) ITK_OVERRIDE;
+  void ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId ) ITK_OVERRIDE;
 
 
 private:
@@ -255,14 +255,15 @@ GeneralizedHighOrderTensorImageFilter< TInputImage, TOutputImage >
   ComputeBasisMatrix();
   this->VerifyInputParameters();
   this->m_L2Solver = L2SolverType::New();
-  this->m_L2Solver->SetA(this->m_BasisMatrix);
+  this->m_L2Solver->SetA(utl::ConvertNDArrayPointer<SolverPrecisionType>(this->m_BasisMatrix));
   if (this->m_LambdaSpherical>0 || this->m_LambdaRadial>0)
     {
     this->ComputeRegularizationWeight();
-    MatrixPointer mat(new MatrixType(this->m_RegularizationWeight->Size(), this->m_RegularizationWeight->Size()));
+    SolverMatrixPointer mat(new SolverMatrixType(this->m_RegularizationWeight->Size(), this->m_RegularizationWeight->Size()));
     mat->SetDiagonal(*this->m_RegularizationWeight);
     this->m_L2Solver->SetLambda(mat);
     }
+  this->CreateThreadClones();
   // if (this->GetDebug())
   //   {
   //   this->m_L2Solver->Initialize();
@@ -274,25 +275,18 @@ GeneralizedHighOrderTensorImageFilter< TInputImage, TOutputImage >
 template< class TInputImage, class TOutputImage >
 void
 GeneralizedHighOrderTensorImageFilter< TInputImage, TOutputImage >
-::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,ThreadIdType threadId )
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId )
 {
   utlShowPosition(this->GetDebug());
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
   // Pointers
   InputImageConstPointer inputPtr = this->GetInput();
   OutputImagePointer outputPtr = this->GetOutput();
   
-  Pointer selfClone = this->Clone();
-
-  // iterator for the output image      
-  ImageRegionIteratorWithIndex<OutputImageType> outputIt(outputPtr, outputRegionForThread );
-  ImageRegionConstIteratorWithIndex<InputImageType> inputIt(inputPtr, outputRegionForThread );
-  ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-  if (this->IsMaskUsed())
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, outputRegionForThread);
-  
+  Pointer selfClone = static_cast<Self*>(this->GetThreadClone(threadId));
+
   InputImagePixelType inputPixel;
-  // OutputImageIndexType outputIndex;
+  OutputImageIndexType index;
   OutputImagePixelType outputPixel;
   
   unsigned int numberOfCoeffcients = outputPtr->GetNumberOfComponentsPerPixel();;
@@ -300,19 +294,17 @@ GeneralizedHighOrderTensorImageFilter< TInputImage, TOutputImage >
   unsigned int numberofDWIs = inputPtr->GetNumberOfComponentsPerPixel();
   inputPixel.SetSize(numberofDWIs);
   
-  inputIt.GoToBegin();
-  outputIt.GoToBegin();
   VectorType dwiPixel(numberofDWIs), coef(numberOfCoeffcients);
-  while( !inputIt.IsAtEnd() )
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt )
     {
-    if (!this->IsMaskUsed() || (this->IsMaskUsed() && maskIt.Get()>0))
+    index = voxelIt.GetIndex();
+    if (this->IsInMask(index))
       {
-      inputPixel=inputIt.Get();
+      inputPixel=inputPtr->GetPixel(index);
       for ( int i = 0; i < numberofDWIs; i += 1 ) 
         dwiPixel[i] = -std::log(inputPixel[i]);
-      selfClone->m_L2Solver->Setb(VectorPointer(new VectorType(dwiPixel)));
-      // outputIndex=outputIt.GetIndex();
-      // std::cout << "index="<<outputIndex << std::endl << std::flush;
+      selfClone->m_L2Solver->Setb(SolverVectorPointer(new SolverVectorType(dwiPixel)));
+      // std::cout << "index="<<index << std::endl << std::flush;
       selfClone->m_L2Solver->Solve();
       coef = selfClone->m_L2Solver->Getx();
       for ( int i = 0; i < numberOfCoeffcients; i += 1 ) 
@@ -323,13 +315,8 @@ GeneralizedHighOrderTensorImageFilter< TInputImage, TOutputImage >
     else
       outputPixel.Fill(0.0);
 
-    outputIt.Set(outputPixel);
+    outputPtr->SetPixel(index, outputPixel);
     progress.CompletedPixel();    
-
-    if (this->IsMaskUsed())
-      ++maskIt;
-    ++outputIt;
-    ++inputIt;
     }
 }
 
@@ -80,7 +80,7 @@ protected:
   void GenerateOutputInformation() ITK_OVERRIDE;
   
   void BeforeThreadedGenerateData () ITK_OVERRIDE;
-  void ThreadedGenerateData(const typename TOutputImage::RegionType& outputRegionForThread,ThreadIdType threadId ) ITK_OVERRIDE;
+  void ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId ) ITK_OVERRIDE;
   
   typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
 
@@ -227,25 +227,19 @@ ODFFromSPFImageFilter< TInputImage, TOutputImage >
   // utl::PrintUtlVector(m_L,"m_L");
   // utl::PrintUtlVector(m_P,"m_P");
   Superclass::BeforeThreadedGenerateData();
+  this->CreateThreadClones();
 }
 
 template <class TInputImage, class TOutputImage>
 void
 ODFFromSPFImageFilter<TInputImage,TOutputImage>
-::ThreadedGenerateData( const typename TOutputImage::RegionType &outputRegionForThread, ThreadIdType threadId)
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId)
 {
   // utlShowPosition(true);
   typename TInputImage::ConstPointer  inputPtr = this->GetInput();
   typename TOutputImage::Pointer outputPtr = this->GetOutput();
 
-  // Define the iterators
-  ImageRegionConstIteratorWithIndex<TInputImage>  inputIt(inputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<TOutputImage> outputIt(outputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-  if (this->IsMaskUsed())
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, outputRegionForThread);
-
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
   typename TInputImage::PixelType inputPixel;
   typename TInputImage::IndexType inputIndex;
   typename TOutputImage::PixelType outputPixel;
@@ -255,20 +249,18 @@ ODFFromSPFImageFilter<TInputImage,TOutputImage>
   unsigned int inputDim = inputPtr->GetNumberOfComponentsPerPixel();
   inputPixel.SetSize(inputDim);
 
-  inputIt.GoToBegin();
-  outputIt.GoToBegin();
   VectorType spfVec, result;
   
-  Pointer selfClone = this->Clone();
+  Pointer selfClone = static_cast<Self*>(this->GetThreadClone(threadId));
 
-  while( !inputIt.IsAtEnd() ) 
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt ) 
     {
-    if (!this->IsMaskUsed() || (this->IsMaskUsed() && maskIt.Get()>0))
+    inputIndex = voxelIt.GetIndex();
+    if (this->IsInMask(inputIndex))
       {
-      inputPixel = inputIt.Get();
+      inputPixel = inputPtr->GetPixel(inputIndex);
       if (inputPixel.GetSquaredNorm()>1e-8)
         {
-        inputIndex = inputIt.GetIndex();
         if (this->GetDebug())
           std::cout << "index = " << inputIndex << std::endl << std::flush;
 
@@ -323,12 +315,7 @@ ODFFromSPFImageFilter<TInputImage,TOutputImage>
     else
       outputPixel.Fill(0.0);
 
-    outputIt.Set(outputPixel);
-    progress.CompletedPixel();    
-    if (this->IsMaskUsed())
-      ++maskIt;
-    ++inputIt;
-    ++outputIt;
+    outputPtr->SetPixel(inputIndex, outputPixel);
     progress.CompletedPixel();  // potential exception thrown here
     }
 }
@@ -23,6 +23,7 @@
 #include "itkProfileFromSPFImageFilter.h"
 #include "itkSphericalPolarFourierGenerator.h"
 #include "utl.h"
+#include "itkSpecialFunctionBatch.h"
 #include "itkSphericalPolarFourierImageFilter.h"
 
 namespace itk
@@ -111,12 +112,12 @@ ProfileFromSPFImageFilter< TInputImage, TOutputImage >
 
       if ( (this->m_BasisType==Superclass::SPF && !this->m_IsFourier) || (this->m_BasisType==Superclass::DSPF && this->m_IsFourier) )
         {
-        spf->SetSPFType(SPFGenerator::SPF);
-        spf->SetScale(this->m_BasisScale);
+        // all radial orders in one batch
+        std::vector<double> spfValues(n_b_ra);
+        utl::SPFRadialBatch(this->m_RadialRank, this->m_BasisScale, 1, &radius, &spfValues[0], 1);
         for ( int n = 0; n <= this->m_RadialRank; n += 1 ) 
           {
-          spf->SetN(n);
-          double spfValue = spf->Evaluate(radius);
+          double spfValue = spfValues[n];
           int jj=0; 
           for ( int l = 0; l <= this->m_SHRank; l += 2 ) 
             {
@@ -206,25 +207,19 @@ ProfileFromSPFImageFilter<TInputImage,TOutputImage>
   // this->m_SPFIEstimator->Print(std::cout<<"m_SPFIEstimator: ");
   
   Superclass::BeforeThreadedGenerateData();
+  this->CreateThreadClones();
 }
 
 template <class TInputImage, class TOutputImage>
 void
 ProfileFromSPFImageFilter<TInputImage,TOutputImage>
-::ThreadedGenerateData( const typename TOutputImage::RegionType &outputRegionForThread, ThreadIdType threadId)
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId)
 {
   utlShowPosition(this->GetDebug());
   typename TInputImage::ConstPointer  inputPtr = this->GetInput();
   typename TOutputImage::Pointer outputPtr = this->GetOutput();
-  
-  // Define the iterators
-  ImageRegionConstIteratorWithIndex<TInputImage>  inputIt(inputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<TOutputImage> outputIt(outputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-  if (this->IsMaskUsed())
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, outputRegionForThread);
 
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
   typename TInputImage::PixelType inputPixel;
   typename TInputImage::IndexType inputIndex;
   typename TOutputImage::PixelType outputPixel;
@@ -234,20 +229,18 @@ ProfileFromSPFImageFilter<TInputImage,TOutputImage>
   unsigned int inputDim = inputPtr->GetNumberOfComponentsPerPixel();
   inputPixel.SetSize(inputDim);
 
-  inputIt.GoToBegin();
-  outputIt.GoToBegin();
   VectorType spfVec, temp;
 
-  Pointer selfClone = this->Clone();
+  Pointer selfClone = static_cast<Self*>(this->GetThreadClone(threadId));
 
-  while( !inputIt.IsAtEnd() ) 
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt ) 
     {
-    if (!this->IsMaskUsed() || (this->IsMaskUsed() && maskIt.Get()>0))
+    inputIndex = voxelIt.GetIndex();
+    if (this->IsInMask(inputIndex))
       {
-      inputPixel = inputIt.Get();
+      inputPixel = inputPtr->GetPixel(inputIndex);
       if (inputPixel.GetSquaredNorm()>1e-8)
         {
-        inputIndex = inputIt.GetIndex();
         if (this->GetDebug())
           std::cout << "inputIndex = " << inputIndex << std::endl << std::flush;
         if (!IsImageEmpty(this->m_ScaleImage))
@@ -274,12 +267,7 @@ ProfileFromSPFImageFilter<TInputImage,TOutputImage>
     else
       outputPixel.Fill(0.0);
 
-    outputIt.Set(outputPixel);
-    progress.CompletedPixel();    
-    if (this->IsMaskUsed())
-      ++maskIt;
-    ++inputIt;
-    ++outputIt;
+    outputPtr->SetPixel(inputIndex, outputPixel);
     progress.CompletedPixel();  // potential exception thrown here
     }
 }
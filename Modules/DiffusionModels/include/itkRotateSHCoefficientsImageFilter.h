@@ -52,7 +52,7 @@ public:
   typedef SHCoefficientsRotation<double>  SHRotationFilter;
   typedef typename SHRotationFilter::Pointer   SHRotationPointer;
 
-  RotateSHCoefficients() : m_RotationMatrix(MatrixType(3,3))
+  RotateSHCoefficients() : m_RotationMatrix(MatrixType(3,3)), m_WignerMatrices(new std::vector<MatrixType>())
     {
     m_RotationMatrix.SetIdentity();
     m_SHRotate = SHRotationFilter::New();
@@ -72,15 +72,28 @@ public:
     {
     const int N = A.GetSize();
     TOutput output(A);
-    VectorType vec(N);
+    VectorType vec(N), vecRotated(N);
     utl::VectorToVector<TInput, VectorType >(A, vec, N);
-    VectorType vecRotated = m_SHRotate->GetRotatedSHCoefficients(vec, m_RotationMatrix);
+    if (utl::DimToRankSH(N)/2<m_WignerMatrices->size())
+      SHRotationFilter::RotateSHCoefficientsWithWignerMatrices(*m_WignerMatrices, vec.GetData(), vecRotated.GetData(), N);
+    else
+      vecRotated = m_SHRotate->GetRotatedSHCoefficients(vec, m_RotationMatrix);
     utl::VectorToVector<VectorType, TInput>(vecRotated, output, N);
     return output;
     }
 
   void SetRotationMatrix(const MatrixType& mat) 
-    { this->m_RotationMatrix = mat; }
+    { 
+    this->m_RotationMatrix = mat; 
+    m_WignerMatrices = utl_shared_ptr<std::vector<MatrixType> >(new std::vector<MatrixType>());
+    }
+
+  /** Wigner-D matrices are computed only once for all pixels  */
+  void ComputeWignerMatrices(const int rank)
+    {
+    m_WignerMatrices = utl_shared_ptr<std::vector<MatrixType> >(new std::vector<MatrixType>());
+    SHRotationFilter::ComputeWignerMatrices(m_RotationMatrix, rank, *m_WignerMatrices);
+    }
 
   const MatrixType & GetRotationMatrix() const 
     { return m_RotationMatrix; }
@@ -93,6 +106,8 @@ public:
   
   MatrixType m_RotationMatrix;
   SHRotationPointer m_SHRotate;
+  /** Wigner-D matrices of m_RotationMatrix, shared by copies of the functor */
+  utl_shared_ptr<std::vector<MatrixType> > m_WignerMatrices;
 };
 }
 
@@ -128,9 +143,8 @@ public:
 
   void BeforeThreadedGenerateData() ITK_OVERRIDE
     {
-    this->GetFunctor().GetSHRotate()->SetTessOrder(3);
-    this->GetFunctor().GetSHRotate()->SetMaxRank(10);
-    this->GetFunctor().GetSHRotate()->Initialize();
+    int rank = utl::DimToRankSH(this->GetInput()->GetNumberOfComponentsPerPixel());
+    this->GetFunctor().ComputeWignerMatrices(rank);
     }
   
   /** Set the sigma of Rician noise distribution */
@@ -0,0 +1,260 @@
+/**
+ *       @file  itkSPFBasisMatrixCache.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkSPFBasisMatrixCache_h
+#define __itkSPFBasisMatrixCache_h
+
+#include <map>
+#include <deque>
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+
+#include "utlCore.h"
+#include "utlNDArray.h"
+#include "itkL1RegularizedLeastSquaresFISTASolver.h"
+
+namespace itk
+{
+
+/**
+ *   \class   SPFBasisMatrixCache
+ *   \brief   thread-safe cache of SPF basis matrices keyed by the quantized scale.
+ *
+ *   When the scale is adaptive, voxels whose scales fall into the same bin share one entry,
+ *   which contains the basis matrix, the matrix for B0, the radial vectors for E(0)=1,
+ *   the matrix used in the solver, the pseudo-inverse for LS estimation, and the problem context for FISTA.
+ *   Bins are uniform in log(scale) with width log(1+tolerance),
+ *   thus the relative difference between a scale and the scale of its bin is at most tolerance/2.
+ *
+ *   The cache is shared by all threads. Entries are immutable once they are inserted.
+ *   If the total memory exceeds m_MaxMemorySize, the oldest entries are released.
+ *   Basis matrices are in double. Matrices used in solvers are in TPrecision.
+ *
+ *   \ingroup DiffusionModels
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ */
+template <class TPrecision=double>
+class SPFBasisMatrixCache : public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef SPFBasisMatrixCache                Self;
+  typedef LightObject                        Superclass;
+  typedef SmartPointer<Self>                 Pointer;
+  typedef SmartPointer<const Self>           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods) */
+  itkTypeMacro(SPFBasisMatrixCache, LightObject);
+
+  typedef utl::NDArray<double,2>                  MatrixType;
+  typedef utl::NDArray<double,1>                  VectorType;
+  typedef utl_shared_ptr<MatrixType>              MatrixPointer;
+  typedef utl_shared_ptr<VectorType>              VectorPointer;
+  typedef std::vector<double>                     STDVectorType;
+  typedef utl_shared_ptr<STDVectorType >          STDVectorPointer;
+
+  typedef TPrecision                                 SolverPrecisionType;
+  typedef utl::NDArray<SolverPrecisionType,2>        SolverMatrixType;
+  typedef utl_shared_ptr<SolverMatrixType>           SolverMatrixPointer;
+
+  typedef typename L1RegularizedLeastSquaresFISTASolver<SolverPrecisionType>::ProblemContextPointer  FISTAProblemContextPointer;
+
+  typedef long                                    KeyType;
+
+  /** matrices for one quantized scale  */
+  struct EntryType
+    {
+    double Scale;
+    MatrixPointer BasisMatrix;
+    MatrixPointer BasisMatrixForB0;
+    STDVectorPointer Gn0;
+    VectorPointer G0DWI;
+    /** matrix used in solvers  */
+    SolverMatrixPointer SolverMatrix;
+    /** pseudo-inverse of the L2 solver (for LS, or for the L2 initialization of FISTA), empty if not used  */
+    SolverMatrixPointer LS;
+    /** At, AtA and the step size of FISTA, empty if not used */
+    FISTAProblemContextPointer FISTAContext;
+
+    EntryType() : Scale(-1)
+      {
+      }
+
+    /** memory size in bytes  */
+    double GetMemorySize() const
+      {
+      double num=0;
+      if (BasisMatrix) num += BasisMatrix->Size();
+      if (BasisMatrixForB0) num += BasisMatrixForB0->Size();
+      if (Gn0) num += Gn0->size();
+      if (G0DWI) num += G0DWI->Size();
+      double numSolver=0;
+      if (SolverMatrix) numSolver += SolverMatrix->Size();
+      if (LS) numSolver += LS->Size();
+      // FISTAContext->A is SolverMatrix
+      if (FISTAContext) numSolver += FISTAContext->At->Size() + FISTAContext->AtA->Size();
+      return num*sizeof(double) + numSolver*sizeof(SolverPrecisionType);
+      }
+    };
+  typedef utl_shared_ptr<EntryType>               EntryPointer;
+
+  /** relative tolerance of scales in the same bin  */
+  void SetTolerance(const double tol)
+    {
+    utlGlobalException(tol<=0, "tolerance should be positive");
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    if (std::fabs(tol-m_Tolerance)>1e-15)
+      {
+      m_Tolerance = tol;
+      m_LogBinWidth = std::log(1.0+tol);
+      ClearWithoutLock();
+      }
+    }
+  double GetTolerance() const { return m_Tolerance; }
+
+  /** maximal memory size in MB. If it is not positive, there is no limitation.  */
+  void SetMaxMemorySize(const double mb)
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    m_MaxMemorySize = mb;
+    ReleaseWithoutLock();
+    }
+  double GetMaxMemorySize() const { return m_MaxMemorySize; }
+
+  KeyType GetKey(const double scale) const
+    {
+    utlException(scale<=0, "scale should be positive");
+    return (KeyType)std::floor(std::log(scale)/m_LogBinWidth + 0.5);
+    }
+
+  /** the representative scale of a bin. All voxels in the bin use this scale. */
+  double GetScale(const KeyType key) const
+    {
+    return std::exp(key*m_LogBinWidth);
+    }
+
+  /** return an empty pointer if the key is not in the cache  */
+  EntryPointer Find(const KeyType key) const
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    typename std::map<KeyType, EntryPointer>::const_iterator iter = m_Entries.find(key);
+    if (iter!=m_Entries.end())
+      {
+      m_NumberOfHits++;
+      return iter->second;
+      }
+    m_NumberOfMisses++;
+    return EntryPointer();
+    }
+
+  /** Insert an entry computed by one thread.
+   * If another thread has inserted the same key, the existing entry is returned, such that all threads use the same matrices. */
+  EntryPointer Insert(const KeyType key, const EntryPointer& entry)
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    typename std::map<KeyType, EntryPointer>::const_iterator iter = m_Entries.find(key);
+    if (iter!=m_Entries.end())
+      return iter->second;
+    m_Entries[key] = entry;
+    m_Keys.push_back(key);
+    m_MemorySize += entry->GetMemorySize()/(1024.0*1024.0);
+    ReleaseWithoutLock();
+    return entry;
+    }
+
+  void Clear()
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    ClearWithoutLock();
+    }
+
+  /** number of entries  */
+  int GetNumberOfEntries() const
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    return m_Entries.size();
+    }
+  /** memory size in MB  */
+  double GetMemorySize() const
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_Mutex);
+    return m_MemorySize;
+    }
+  long GetNumberOfHits() const { return m_NumberOfHits; }
+  long GetNumberOfMisses() const { return m_NumberOfMisses; }
+
+protected:
+  SPFBasisMatrixCache() : m_Tolerance(0.01), m_MaxMemorySize(-1), m_MemorySize(0), m_NumberOfHits(0), m_NumberOfMisses(0)
+    {
+    m_LogBinWidth = std::log(1.0+m_Tolerance);
+    }
+  virtual ~SPFBasisMatrixCache() {}
+
+  void ClearWithoutLock()
+    {
+    m_Entries.clear();
+    m_Keys.clear();
+    m_MemorySize = 0;
+    m_NumberOfHits = 0;
+    m_NumberOfMisses = 0;
+    }
+
+  /** release the oldest entries until the memory is below m_MaxMemorySize. The newest entry is always kept. */
+  void ReleaseWithoutLock()
+    {
+    if (m_MaxMemorySize<=0)
+      return;
+    while (m_MemorySize>m_MaxMemorySize && m_Keys.size()>1)
+      {
+      KeyType key = m_Keys.front();
+      m_Keys.pop_front();
+      typename std::map<KeyType, EntryPointer>::iterator iter = m_Entries.find(key);
+      // entries still used in threads are kept alive by shared_ptr
+      m_MemorySize -= iter->second->GetMemorySize()/(1024.0*1024.0);
+      m_Entries.erase(iter);
+      }
+    }
+
+  double m_Tolerance;
+  double m_LogBinWidth;
+  double m_MaxMemorySize;
+  double m_MemorySize;
+
+  std::map<KeyType, EntryPointer> m_Entries;
+  /** keys in the order of insertion  */
+  std::deque<KeyType> m_Keys;
+
+  mutable long m_NumberOfHits;
+  mutable long m_NumberOfMisses;
+
+  mutable SimpleFastMutexLock m_Mutex;
+
+private:
+  SPFBasisMatrixCache(const Self&);  //purposely not implemented
+  void operator=(const Self&);  //purposely not implemented
+};
+
+}
+
+
+#endif
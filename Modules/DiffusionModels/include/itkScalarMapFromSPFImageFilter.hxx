@@ -86,20 +86,13 @@ ScalarMapFromSPFImageFilter< TInputImage, TOutputImage >
 template <class TInputImage, class TOutputImage>
 void
 ScalarMapFromSPFImageFilter<TInputImage,TOutputImage>
-::ThreadedGenerateData( const typename TOutputImage::RegionType &outputRegionForThread, ThreadIdType threadId)
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId)
 {
   // utlShowPosition(true);
   typename TInputImage::ConstPointer  inputPtr = this->GetInput();
   typename TOutputImage::Pointer outputPtr = this->GetOutput();
 
-  // Define the iterators
-  ImageRegionConstIteratorWithIndex<TInputImage>  inputIt(inputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<TOutputImage> outputIt(outputPtr, outputRegionForThread);
-  ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-  if (this->IsMaskUsed())
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, outputRegionForThread);
-
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
   typename TInputImage::PixelType inputPixel;
   typename TInputImage::IndexType inputIndex;
   typename TOutputImage::PixelType outputPixel;
@@ -108,20 +101,17 @@ ScalarMapFromSPFImageFilter<TInputImage,TOutputImage>
   unsigned int inputDim = inputPtr->GetNumberOfComponentsPerPixel();
   inputPixel.SetSize(inputDim);
 
-  inputIt.GoToBegin();
-  outputIt.GoToBegin();
-
   double scale = this->m_BasisScale;
   int dimSH = utl::RankToDimSH(this->m_SHRank);
 
-  while( !inputIt.IsAtEnd() ) 
+  for ( voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt ) 
     {
-    if (!this->IsMaskUsed() || (this->IsMaskUsed() && maskIt.Get()>0))
+    inputIndex = voxelIt.GetIndex();
+    if (this->IsInMask(inputIndex))
       {
-      inputPixel = inputIt.Get();
+      inputPixel = inputPtr->GetPixel(inputIndex);
       if (inputPixel.GetSquaredNorm()>1e-8)
         {
-        inputIndex = inputIt.GetIndex();
         if (this->GetDebug())
           std::cout << "index = " << inputIndex << std::endl << std::flush;
 
@@ -162,12 +152,7 @@ ScalarMapFromSPFImageFilter<TInputImage,TOutputImage>
     else
       outputPixel=0;
 
-    outputIt.Set(outputPixel);
-    progress.CompletedPixel();    
-    if (this->IsMaskUsed())
-      ++maskIt;
-    ++inputIt;
-    ++outputIt;
+    outputPtr->SetPixel(inputIndex, outputPixel);
     progress.CompletedPixel();  // potential exception thrown here
     }
 }
@@ -80,9 +80,17 @@ public:
     SPAMS
     } L1SolverType;
 
-  typedef L2RegularizedLeastSquaresSolver<double> L2SolverType;
-  typedef L1RegularizedLeastSquaresFISTASolver<double> L1FISTASolverType;
-  typedef SpamsWeightedLassoSolver<double> L1SpamsSolverType;
+  /** Precision in solvers, which is the value type of the output image. 
+   * Basis matrices are always computed in double, then they are converted for single precision solvers. */
+  typedef typename NumericTraits<OutputImagePixelType>::ValueType  SolverPrecisionType;
+  typedef utl::NDArray<SolverPrecisionType,2>     SolverMatrixType;
+  typedef utl::NDArray<SolverPrecisionType,1>     SolverVectorType;
+  typedef utl_shared_ptr<SolverMatrixType>        SolverMatrixPointer;
+  typedef utl_shared_ptr<SolverVectorType>        SolverVectorPointer;
+
+  typedef L2RegularizedLeastSquaresSolver<SolverPrecisionType> L2SolverType;
+  typedef L1RegularizedLeastSquaresFISTASolver<SolverPrecisionType> L1FISTASolverType;
+  typedef SpamsWeightedLassoSolver<SolverPrecisionType> L1SpamsSolverType;
 
   itkSetMacro(EstimationType, EstimationType);
   itkGetMacro(EstimationType, EstimationType);
@@ -135,6 +143,16 @@ public:
   
   itkSetMacro(L1FISTASolver, typename L1FISTASolverType::Pointer);
   itkSetMacro(L1SpamsSolver, typename L1SpamsSolverType::Pointer);
+  
+  itkSetMacro(NumberOfVoxelsPerBatch, int);
+  itkGetMacro(NumberOfVoxelsPerBatch, int);
+  
+  itkSetMacro(ScaleTolerance, double);
+  itkGetMacro(ScaleTolerance, double);
+  itkSetMacro(MaxCacheMemorySize, double);
+  itkGetMacro(MaxCacheMemorySize, double);
+  
+  itkSetGetBooleanMacro(UseWarmStart);
 
   /** from dimension to rank */
   virtual std::vector<int> DimToRank(const int dimm) const 
@@ -171,8 +189,15 @@ protected:
    * the output information accordingly. */
   void GenerateOutputInformation() ITK_OVERRIDE;
 
+  /** The estimation is voxel-wise, thus the input requested region is the output requested region, and the filter can be streamed. 
+   * m_MaskImage and m_MDImage are not streamed, and they should have the requested region.  */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
   void BeforeThreadedGenerateData () ITK_OVERRIDE;
 
+  /** Clones are also invalid if solvers or m_MDImage are modified, because solvers are cloned with their A, w and Lambda.  */
+  virtual bool IsThreadClonesValid() const ITK_OVERRIDE;
+
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
   typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
   
@@ -217,6 +242,20 @@ protected:
   /** Original SPF basis or dual SPF basis  */
   bool m_IsOriginalBasis;
 
+  /** If it is larger than 1, voxels in each thread are gathered into batches and solved together in one gemm. 
+   * It is only used for LS estimation with a fixed scale, because all voxels share the same basis matrix. */
+  int m_NumberOfVoxelsPerBatch;
+
+  /** Relative tolerance of scales for adaptive scale. 
+   * If it is positive, voxels with scales in the same quantized bin reuse the cached basis matrices. */
+  double m_ScaleTolerance;
+  /** Maximal memory size (MB) of the cached basis matrices. If it is not positive, there is no limitation. */
+  double m_MaxCacheMemorySize;
+
+  /** If true, FISTA in each voxel is initialized by the solution of the previous voxel in the same thread, 
+   * if it is better than the L2 initialization. */
+  bool m_UseWarmStart;
+
 private:
   SphericalPolarFourierEstimationImageFilter(const Self&);//purposely not implemented
   void operator=(const Self&);//purposely not implemented
@@ -53,6 +53,10 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
 
   m_IsOriginalBasis = true;
 
+  m_NumberOfVoxelsPerBatch = 0;
+  m_ScaleTolerance = 0;
+  m_MaxCacheMemorySize = -1;
+  m_UseWarmStart = false;
 }
 
 template< class TInputImage, class TOutputImage >
@@ -81,6 +85,20 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
   outputPtr->SetNumberOfComponentsPerPixel(numberOfComponentsPerPixel);
 }
 
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion()
+{
+  itkShowPositionThreadedLogger(this->GetDebug());
+  // copy the output requested region to the input requested region
+  Superclass::GenerateInputRequestedRegion();
+
+  OutputImageRegionType outputRegion = this->GetOutput()->GetRequestedRegion();
+  utlGlobalException(this->IsMaskUsed() && !this->m_MaskImage->GetBufferedRegion().IsInside(outputRegion), "m_MaskImage does not have the requested region");
+  utlGlobalException(!IsImageEmpty(m_MDImage) && !m_MDImage->GetBufferedRegion().IsInside(outputRegion), "m_MDImage does not have the requested region");
+}
+
 template< class TInputImage, class TOutputImage >
 double
 SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
@@ -112,6 +130,25 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
     }
 }
 
+template< class TInputImage, class TOutputImage >
+bool
+SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
+::IsThreadClonesValid() const
+{
+  if (!Superclass::IsThreadClonesValid())
+    return false;
+  ModifiedTimeType time = this->m_ThreadClonesTime.GetMTime();
+  if (m_MDImage && m_MDImage->GetMTime()>=time)
+    return false;
+  if (m_L2Solver && m_L2Solver->GetMTime()>=time)
+    return false;
+  if (m_L1FISTASolver && m_L1FISTASolver->GetMTime()>=time)
+    return false;
+  if (m_L1SpamsSolver && m_L1SpamsSolver->GetMTime()>=time)
+    return false;
+  return true;
+}
+
 template< class TInputImage, class TOutputImage >
 typename LightObject::Pointer
 SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
@@ -138,6 +175,10 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
   // NOTE: shared_ptr is thread safe, if the data is read in threads (not modified), thus do not need to copy the data block
   rval->m_BasisMatrixForB0 = m_BasisMatrixForB0;
   rval->m_IsOriginalBasis = m_IsOriginalBasis;
+  rval->m_NumberOfVoxelsPerBatch = m_NumberOfVoxelsPerBatch;
+  rval->m_ScaleTolerance = m_ScaleTolerance;
+  rval->m_MaxCacheMemorySize = m_MaxCacheMemorySize;
+  rval->m_UseWarmStart = m_UseWarmStart;
   
   rval->m_BasisCombinationMatrix = m_BasisCombinationMatrix;
   rval->m_BasisEnergyDL = m_BasisEnergyDL;
@@ -179,6 +220,9 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
   if (!IsImageEmpty(this->m_MaskImage))
     std::cout << "Use a mask" << std::endl << std::flush;
   
+  if (!std::is_same<SolverPrecisionType, double>::value)
+    std::cout << "Use single precision in solvers" << std::endl << std::flush;
+
   if (this->m_EstimationType==Self::LS)
     {
     std::cout << "Use Least Square Estimation" << std::endl << std::flush;
@@ -243,6 +287,7 @@ SphericalPolarFourierEstimationImageFilter< TInputImage, TOutputImage >
   else if (m_EstimationType==L1_DL)
     os << indent << "L1 Estimation with learned dictionary is used " << std::endl;
   PrintVar4(true, m_LambdaSpherical, m_LambdaRadial, m_LambdaL1, m_LambdaL2, os<<indent);
+  PrintVar4(true, m_NumberOfVoxelsPerBatch, m_ScaleTolerance, m_MaxCacheMemorySize, m_UseWarmStart, os<<indent);
 
 }
 
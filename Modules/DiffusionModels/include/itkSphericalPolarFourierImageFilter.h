@@ -20,6 +20,7 @@
 
 #include "itkSphericalPolarFourierEstimationImageFilter.h"
 #include "itkSphericalPolarFourierGenerator.h"
+#include "itkSPFBasisMatrixCache.h"
 
 
 namespace itk
@@ -58,6 +59,12 @@ public:
   typedef typename Superclass::STDVectorType    STDVectorType;
   typedef typename Superclass::STDVectorPointer   STDVectorPointer;
 
+  typedef typename Superclass::SolverPrecisionType    SolverPrecisionType;
+  typedef typename Superclass::SolverMatrixType       SolverMatrixType;
+  typedef typename Superclass::SolverVectorType       SolverVectorType;
+  typedef typename Superclass::SolverMatrixPointer    SolverMatrixPointer;
+  typedef typename Superclass::SolverVectorPointer    SolverVectorPointer;
+
   typedef typename Superclass::L2SolverType     L2SolverType;
   typedef typename Superclass::L1FISTASolverType     L1FISTASolverType;
   typedef typename Superclass::EstimationType   EstimationType;
@@ -69,6 +76,10 @@ public:
   
   itkGetMacro(Gn0, STDVectorPointer);
   
+  typedef SPFBasisMatrixCache<SolverPrecisionType>     BasisMatrixCacheType;
+  typedef typename BasisMatrixCacheType::EntryPointer   BasisMatrixCacheEntryPointer;
+  itkGetObjectMacro(BasisMatrixCache, BasisMatrixCacheType);
+  
   std::vector<int> GetIndexNLM(const int index) const ITK_OVERRIDE;
   int GetIndexJ(const int n, const int l, const int m) const ITK_OVERRIDE;
   
@@ -85,6 +96,29 @@ public:
   void ComputeRadialVectorForE0InDWI ( );
   
   void SetBasisScale(const double scale) ITK_OVERRIDE;
+  
+  /** Batched solving is used for LS estimation with a fixed scale and m_NumberOfVoxelsPerBatch>1  */
+  bool IsBatchSolveUsed() const;
+  
+  /** Cached basis matrices are used for adaptive scale and m_ScaleTolerance>0  */
+  bool IsBasisMatrixCacheUsed() const;
+
+  /** number of iterations of FISTA with warm start or with L2 initialization. 
+   * The warm start is used only in voxels where it has a lower cost than L2 initialization, 
+   * thus the two averages are from different voxels, and their difference is not the number of saved iterations.  */
+  struct FISTAIterationStatisticsType
+    {
+    long NumberOfWarmStarts;
+    long NumberOfIterationsInWarmStarts;
+    long NumberOfL2Starts;
+    long NumberOfIterationsInL2Starts;
+    FISTAIterationStatisticsType() : NumberOfWarmStarts(0), NumberOfIterationsInWarmStarts(0), NumberOfL2Starts(0), NumberOfIterationsInL2Starts(0)
+      {
+      }
+    };
+
+  /** sum of the statistics in all threads, only available after Update() with m_UseWarmStart  */
+  FISTAIterationStatisticsType GetFISTAIterationStatistics() const;
 
 protected:
   SphericalPolarFourierImageFilter();
@@ -92,17 +126,55 @@ protected:
   
   void ComputeBasisMatrixForB0 ();
   
+  /** Compute the coefficients with n=0 from the coefficients with n>0, such that E(0)=1. 
+   * It is used when m_IsAnalyticalB0 is true. T is double or SolverPrecisionType. */
+  template <class T>
+  void ComputeCoefficientsForE0(T* coef) const;
+
+  /** Estimate the coefficients for all voxels in dwiBatch using one gemm. 
+   * Each row in dwiBatch is a DWI signal, each row in coefBatch is the coefficients. */
+  void ComputeCoefficientsInBatch(const SolverMatrixType& dwiBatch, SolverMatrixType& coefBatch);
+
+  /** Compute the matrix used in solvers from m_BasisMatrix, m_BasisMatrixForB0 and m_Gn0 in the current scale. 
+   * basisMatrix is reused if its size is correct. */
+  void ComputeBasisMatrixInSolver(MatrixPointer& basisMatrix) const;
+  
+  /** Set basisMatrix in the solver for m_EstimationType. 
+   * The precomputed pseudo-inverse for LS estimation, or the problem context for FISTA, is used if it is not empty. */
+  void SetBasisMatrixInSolver(const SolverMatrixPointer& basisMatrix, const SolverMatrixPointer& ls=SolverMatrixPointer(), 
+    const typename L1FISTASolverType::ProblemContextPointer& fistaContext=typename L1FISTASolverType::ProblemContextPointer());
+
+  /** Compute all matrices for the given scale, which are stored in m_BasisMatrixCache.  */
+  BasisMatrixCacheEntryPointer ComputeBasisMatrixCacheEntry(const double scale);
+  
+  /** Use the matrices in the cached entry in the current scale  */
+  void SetBasisMatrixCacheEntry(const BasisMatrixCacheEntryPointer& entry);
+
+  /** Solve the problem in solver (b is set) which is used in the thread threadId. 
+   * If m_UseWarmStart, xPrevious is used for warm start, then it is updated by the solution x. */
+  void SolveUsingL1FISTASolver(L1FISTASolverType* solver, VectorType& x, SolverVectorType& xPrevious, ThreadIdType threadId);
+  
   // void VerifyInputParameters() const;
 
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
   typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
   
   void BeforeThreadedGenerateData () ITK_OVERRIDE;
-  void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,ThreadIdType threadId ) ITK_OVERRIDE;
+  void ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId ) ITK_OVERRIDE;
+  void AfterThreadedGenerateData () ITK_OVERRIDE;
+  
+  /** gather voxels into batches, solve each batch using ComputeCoefficientsInBatch, then scatter the coefficients to the output */
+  void ThreadedGenerateDataInBatch(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId );
   
   STDVectorPointer m_Gn0;
   VectorPointer m_G0DWI;
 
+  /** shared by all threads  */
+  typename BasisMatrixCacheType::Pointer m_BasisMatrixCache;
+
+  /** statistics for each thread  */
+  std::vector<FISTAIterationStatisticsType> m_FISTAIterationStatistics;
+
 private:
   SphericalPolarFourierImageFilter(const Self&);  //purposely not implemented
   void operator=(const Self&);  //purposely not implemented
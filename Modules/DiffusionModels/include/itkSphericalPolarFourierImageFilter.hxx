@@ -23,6 +23,7 @@
 #include "itkSPFScaleFromMeanDiffusivityImageFilter.h"
 #include "utlVNLBlas.h"
 #include "utl.h"
+#include "itkSpecialFunctionBatch.h"
 
 #include <itkProgressReporter.h>
 
@@ -33,7 +34,8 @@ template< class TInputImage, class TOutputImage >
 SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 ::SphericalPolarFourierImageFilter() : Superclass(), 
   m_Gn0(new STDVectorType()),
-  m_G0DWI(new VectorType())
+  m_G0DWI(new VectorType()),
+  m_BasisMatrixCache(NULL)
 {
   // NOTE: ComputeScale is a virtual function, thus it must be called in derived calss, not in base class
   this->ComputeScale(true);
@@ -79,6 +81,8 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
   
   rval->m_Gn0 = m_Gn0;
   rval->m_G0DWI = m_G0DWI;
+  // NOTE: the cache is shared by all clones
+  rval->m_BasisMatrixCache = m_BasisMatrixCache;
   return loPtr;
 }
 
@@ -265,14 +269,19 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 
     B = MatrixPointer(new MatrixType(n_s,n_b));
 
+    // evaluate all radial orders for all shells in one batch, radialShell[ib*numberOfShells+shell]
+    const int numberOfShells = indices->size();
+    std::vector<double> qShell(numberOfShells), radialShell(n_b*numberOfShells);
+    for ( int shell = 0; shell < numberOfShells; shell += 1 ) 
+      qShell[shell] = (*qVector)[ (*indices)[shell][0] ];
+    utl::SPFRadialBatch(this->m_RadialRank, this->m_BasisScale, numberOfShells, &qShell[0], &radialShell[0], numberOfShells);
+
     for ( int ib = 0; ib < n_b; ib += 1 ) 
       {
-      spf->SetN(ib);
-      for ( int shell = 0; shell < indices->size(); shell += 1 ) 
+      for ( int shell = 0; shell < numberOfShells; shell += 1 ) 
         {
-        typename Superclass::SamplingSchemeQSpaceType::IndexVectorType indexTemp = (*indices)[shell];
-        double qq = (*qVector)[ indexTemp[0] ];
-        double spfVal = spf->Evaluate(qq,false);
+        const typename Superclass::SamplingSchemeQSpaceType::IndexVectorType& indexTemp = (*indices)[shell];
+        double spfVal = radialShell[ib*numberOfShells+shell];
         for ( int js = 0; js < indexTemp.size(); js += 1 ) 
           (*B)(indexTemp[js],ib) = spfVal;
         }
@@ -490,6 +499,241 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
   this->m_BasisMatrixForB0 = selfClone->GetBasisMatrix();
 }    // -----  end of method EAP<T>::<method>  -----
 
+template< class TInputImage, class TOutputImage >
+bool
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::IsBatchSolveUsed() const
+{
+  return this->m_NumberOfVoxelsPerBatch>1 && this->m_EstimationType==Self::LS && !this->IsAdaptiveScale();
+}
+
+template< class TInputImage, class TOutputImage >
+template <class T>
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::ComputeCoefficientsForE0(T* coef) const
+{
+  int jj=0;
+  for ( int l = 0; l <= this->m_SHRank; l += 2 ) 
+    {
+    for ( int m = -l; m <= l; m += 1 ) 
+      {
+      double sum_tmp = 0;
+      for ( int nn = 1; nn <= this->m_RadialRank; nn += 1 ) 
+        {
+        int index_j = this->GetIndexJ(nn,l,m);
+        sum_tmp += coef[index_j] * (*m_Gn0)[nn];
+        }
+      if (l==0)
+        coef[jj] = (std::sqrt(4*M_PI) - sum_tmp)/(*m_Gn0)[0];
+      else
+        coef[jj] = -sum_tmp/(*m_Gn0)[0];
+      jj++;
+      }
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::ComputeCoefficientsInBatch(const SolverMatrixType& dwiBatch, SolverMatrixType& coefBatch)
+{
+  utlException(!this->IsBatchSolveUsed(), "batch solving is only for LS estimation with a fixed scale");
+  if (this->m_IsAnalyticalB0)
+    {
+    int n_b_sh = (this->m_SHRank+1)*(this->m_SHRank+2)/2;
+    int numberOfCoeffcients = this->RankToDim();
+    SolverMatrixType coefBatch_first;
+    this->m_L2Solver->SolveBatch(dwiBatch, coefBatch_first);
+    utlException(coefBatch_first.Columns()+n_b_sh!=numberOfCoeffcients, "wrong size of coefBatch_first");
+
+    coefBatch.ReSize(dwiBatch.Rows(), numberOfCoeffcients);
+    for ( int i = 0; i < dwiBatch.Rows(); i += 1 ) 
+      {
+      SolverPrecisionType* coef = coefBatch.GetData() + i*numberOfCoeffcients;
+      utl::cblas_copy<SolverPrecisionType>(coefBatch_first.Columns(), coefBatch_first.GetData()+i*coefBatch_first.Columns(), 1, coef+n_b_sh, 1);
+      ComputeCoefficientsForE0(coef);
+      }
+    }
+  else
+    this->m_L2Solver->SolveBatch(dwiBatch, coefBatch);
+}
+
+template< class TInputImage, class TOutputImage >
+bool
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::IsBasisMatrixCacheUsed() const
+{
+  return this->IsAdaptiveScale() && this->m_ScaleTolerance>0;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::ComputeBasisMatrixInSolver(MatrixPointer& basisMatrix) const
+{
+  int n_b_sh = (this->m_SHRank+1)*(this->m_SHRank+2)/2;
+  int n_b_ra = this->m_RadialRank + 1;
+  if (!this->m_IsAnalyticalB0)
+    {
+    basisMatrix=MatrixPointer( new MatrixType() );
+    *basisMatrix = utl::ConnectUtlMatrix(*this->m_BasisMatrix, *utl::ToMatrix<double>((*this->m_BasisMatrixForB0)%this->m_B0Weight), true);
+    }
+  else
+    {
+    if (basisMatrix->Size()==0 || this->m_EstimationType==Self::L1_DL) // resize it for L1_DL
+      basisMatrix=MatrixPointer( new MatrixType(this->m_BasisMatrix->Rows(), n_b_sh*(n_b_ra-1)) );
+    utlException((*this->m_Gn0)[0]==0, "it should be not zero!, (*this->m_Gn0)[0]="<< (*this->m_Gn0)[0]);
+    // utlPrintVar2 (this->_is_b0_analytical, this->m_RadialRank, R_N_0);
+
+
+    // utl::Tic(std::cout<<"index start 1");
+    double *selfBasisMatrix_data = this->m_BasisMatrix->GetData();
+    double *basisMatrix_data = basisMatrix->GetData();
+    int index_B=0, index_selfB=0, index_selfB_0=0;
+    for ( int ss = 0; ss < basisMatrix->Rows(); ss += 1 ) 
+      {
+      for ( int i = 0; i < this->m_RadialRank; i += 1 ) 
+        {
+        if (i==0)
+          index_selfB += n_b_sh;
+        else
+          index_selfB_0 -= n_b_sh;
+        for ( int j = 0; j < n_b_sh; j += 1 ) 
+          {
+          basisMatrix_data[index_B] = selfBasisMatrix_data[index_selfB] - (*this->m_Gn0)[i+1]/(*this->m_Gn0)[0] * selfBasisMatrix_data[index_selfB_0];
+          // basisMatrix(ss,i*n_b_sh+j) = (*this->m_BasisMatrix)(ss,(i+1)*n_b_sh+j) - (*this->m_Gn0)[i+1]/(*this->m_Gn0)[0] * (*this->m_BasisMatrix)(ss,j);
+          index_B++;
+          index_selfB++;
+          index_selfB_0++;
+          }
+        }
+      index_selfB_0 += n_b_sh*this->m_RadialRank;
+      }
+    // utl::Toc();
+
+    // utl::Tic(std::cout<<"() start 1");
+    // for ( int i = 0; i < this->m_RadialRank; i += 1 ) 
+    //   {
+    //   double firstTerm = (*this->m_Gn0)[i+1]/(*this->m_Gn0)[0];
+    //   for ( int j = 0; j < n_b_sh; j += 1 ) 
+    //     {
+    //     int index_B = i*n_b_sh+j;
+    //     int index_selfB = (i+1)*n_b_sh+j;
+    //     for ( int ss = 0; ss < basisMatrix->Rows(); ss += 1 ) 
+    //       {
+    //       (*basisMatrix)(ss,index_B) = (*this->m_BasisMatrix)(ss,index_selfB) - firstTerm * (*this->m_BasisMatrix)(ss,j);
+    //       }
+    //     }
+    //   }
+    // utl::Toc();
+
+    }
+
+  if (this->m_EstimationType==Self::L1_DL)
+    {
+    MatrixPointer tmpMat (new MatrixType());
+    utl::ProductUtlMM(*basisMatrix, *this->m_BasisCombinationMatrix, *tmpMat);
+    *basisMatrix = *tmpMat;
+    // utl::MatrixCopy(*tmpMat, *basisMatrix, 1.0, 'N');
+    // basisMatrix = tmpMat;
+    // basisMatrix *= (*this->m_BasisCombinationMatrix);
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::SetBasisMatrixInSolver(const SolverMatrixPointer& basisMatrix, const SolverMatrixPointer& ls, const typename L1FISTASolverType::ProblemContextPointer& fistaContext)
+{
+  if (this->m_EstimationType==Self::LS)
+    {
+    this->m_L2Solver->SetA(basisMatrix);
+    if (ls && ls->Size()>0)
+      this->m_L2Solver->SetLS(ls);
+    }
+  else if (this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL)
+    {
+    if (this->m_L1SolverType==Self::FISTA_LS)
+      {
+      if (fistaContext)
+        {
+        this->m_L1FISTASolver->SetProblemContext(fistaContext);
+        // SetProblemContext resets the pseudo-inverse of the L2 solver for initialization
+        if (ls && ls->Size()>0 && this->m_L1FISTASolver->GetUseL2SolverForInitialization())
+          this->m_L1FISTASolver->GetL2Solver()->SetLS(ls);
+        }
+      else
+        this->m_L1FISTASolver->SetA(basisMatrix);
+      }
+    else if (this->m_L1SolverType==Self::SPAMS)
+      this->m_L1SpamsSolver->SetA(basisMatrix);
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+typename SphericalPolarFourierImageFilter< TInputImage, TOutputImage >::BasisMatrixCacheEntryPointer
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::ComputeBasisMatrixCacheEntry(const double scale)
+{
+  this->SetBasisScale(scale);
+  if (this->m_BasisMatrix->Rows()==0)
+    {
+    this->ComputeBasisMatrix();
+    if (!this->m_IsAnalyticalB0)
+      this->ComputeBasisMatrixForB0();
+    else 
+      {
+      this->ComputeRadialVectorForE0InDWI();
+      this->ComputeRadialVectorForE0InBasis();
+      }
+    }
+
+  BasisMatrixCacheEntryPointer entry(new typename BasisMatrixCacheType::EntryType());
+  entry->Scale = this->m_BasisScale;
+  entry->BasisMatrix = this->m_BasisMatrix;
+  entry->BasisMatrixForB0 = this->m_BasisMatrixForB0;
+  entry->Gn0 = m_Gn0;
+  entry->G0DWI = m_G0DWI;
+  // a new matrix, because it is shared by threads
+  MatrixPointer solverMatrix(new MatrixType());
+  ComputeBasisMatrixInSolver(solverMatrix);
+  entry->SolverMatrix = utl::ConvertNDArrayPointer<SolverPrecisionType>(solverMatrix);
+
+  if (this->m_EstimationType==Self::LS)
+    {
+    // the factorization is computed once for each entry
+    this->m_L2Solver->SetA(entry->SolverMatrix);
+    this->m_L2Solver->Initialize();
+    entry->LS = this->m_L2Solver->GetLS();
+    }
+  else if ((this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL) && this->m_L1SolverType==Self::FISTA_LS)
+    {
+    entry->FISTAContext = L1FISTASolverType::CreateProblemContext(entry->SolverMatrix);
+    if (this->m_L1FISTASolver->GetUseL2SolverForInitialization())
+      {
+      // the factorization for the L2 initialization is also computed once for each entry
+      this->m_L1FISTASolver->SetProblemContext(entry->FISTAContext);
+      this->m_L1FISTASolver->GetL2Solver()->Initialize();
+      entry->LS = this->m_L1FISTASolver->GetL2Solver()->GetLS();
+      }
+    }
+  return entry;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::SetBasisMatrixCacheEntry(const BasisMatrixCacheEntryPointer& entry)
+{
+  // NOTE: matrices in the entry are not modified, because all matrices are re-allocated when the scale is changed
+  this->m_BasisScale = entry->Scale;
+  this->m_BasisMatrix = entry->BasisMatrix;
+  this->m_BasisMatrixForB0 = entry->BasisMatrixForB0;
+  m_Gn0 = entry->Gn0;
+  m_G0DWI = entry->G0DWI;
+}
+
 template< class TInputImage, class TOutputImage >
 void
 SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
@@ -643,19 +887,20 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
     if (this->GetDebug())
       utl::PrintUtlMatrix(*basisMatrix, "basisMatrix_InSolver");
 
+    SolverMatrixPointer basisMatrixSolver = utl::ConvertNDArrayPointer<SolverPrecisionType>(basisMatrix);
     if (this->m_EstimationType==Self::LS)
       {
-      this->m_L2Solver->SetA(basisMatrix);
+      this->m_L2Solver->SetA(basisMatrixSolver);
       }
     else if (this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL)
       {
       if (this->m_L1SolverType==Self::FISTA_LS)
         {
-        this->m_L1FISTASolver->SetA(basisMatrix);
+        this->m_L1FISTASolver->SetA(basisMatrixSolver);
         // this->m_L1FISTASolver->Print(std::cout<<"this->m_L1FISTASolver 0 = ");
         }
       else if (this->m_L1SolverType==Self::SPAMS)
-        this->m_L1SpamsSolver->SetA(basisMatrix);
+        this->m_L1SpamsSolver->SetA(basisMatrixSolver);
       else 
         utlException(true, "wrong m_L1SolverType");
       }
@@ -673,6 +918,16 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
     scaleFromMDfilter->SetInPlace(false); // no inplace
     scaleFromMDfilter->Update();
     this->m_ScaleImage = scaleFromMDfilter->GetOutput();
+
+    if (this->IsBasisMatrixCacheUsed())
+      {
+      std::cout << "Use cached basis matrices for scales with relative tolerance " << this->m_ScaleTolerance << std::endl << std::flush;
+      m_BasisMatrixCache = BasisMatrixCacheType::New();
+      m_BasisMatrixCache->SetTolerance(this->m_ScaleTolerance);
+      m_BasisMatrixCache->SetMaxMemorySize(this->m_MaxCacheMemorySize);
+      }
+    else
+      m_BasisMatrixCache = NULL;
     }
 
   this->ComputeRegularizationWeight();
@@ -684,21 +939,27 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
     {
     if (this->m_LambdaSpherical>0 || this->m_LambdaRadial>0)
       {
-      MatrixPointer lamMat (new MatrixType());
-      *lamMat = this->m_RegularizationWeight->GetDiagonalMatrix();
+      SolverMatrixPointer lamMat (new SolverMatrixType(this->m_RegularizationWeight->GetDiagonalMatrix()));
       this->m_L2Solver->SetLambda(lamMat);
       }
+    if (this->IsBatchSolveUsed())
+      {
+      std::cout << "Solve " << this->m_NumberOfVoxelsPerBatch << " voxels in each batch!" << std::endl << std::flush;
+      // compute the pseudo-inverse only once, then it is copied to the solver in each thread
+      this->m_L2Solver->Initialize();
+      }
     }
   else if (this->m_EstimationType==Self::L1_2)
     {
     if (this->m_L1SolverType==Self::FISTA_LS)
       {
-      this->m_L1FISTASolver->SetwForInitialization(this->m_RegularizationWeight);
-      this->m_L1FISTASolver->Setw(this->m_RegularizationWeight);
+      SolverVectorPointer w = utl::ConvertNDArrayPointer<SolverPrecisionType>(this->m_RegularizationWeight);
+      this->m_L1FISTASolver->SetwForInitialization(w);
+      this->m_L1FISTASolver->Setw(w);
       // this->m_L1FISTASolver->Setw(*this->m_RegularizationWeight * qVector->size());
       }
     else if (this->m_L1SolverType==Self::SPAMS)
-      this->m_L1SpamsSolver->Setw(this->m_RegularizationWeight);
+      this->m_L1SpamsSolver->Setw(utl::ConvertNDArrayPointer<SolverPrecisionType>(this->m_RegularizationWeight));
     }
   else if (this->m_EstimationType==Self::L1_DL)
     {
@@ -706,16 +967,34 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
       {
       // give a small regularization for the initialization in L2Solver
       // this->m_L1FISTASolver->SetwForInitialization(*this->m_RegularizationWeight/this->m_RegularizationWeight->two_norm()*1e-7);
-      this->m_L1FISTASolver->SetwForInitialization(utl::ToVector<double> (*this->m_RegularizationWeight % qVector->size()) );
+      this->m_L1FISTASolver->SetwForInitialization(utl::ToVector<SolverPrecisionType> (*this->m_RegularizationWeight % qVector->size()) );
       // tune the weight based on the size of DWI samples
-      this->m_L1FISTASolver->Setw(utl::ToVector<double>(*this->m_RegularizationWeight % qVector->size()) );
+      this->m_L1FISTASolver->Setw(utl::ToVector<SolverPrecisionType>(*this->m_RegularizationWeight % qVector->size()) );
       }
     else if (this->m_L1SolverType==Self::SPAMS)
-      this->m_L1SpamsSolver->Setw(utl::ToVector<double>(*this->m_RegularizationWeight % qVector->size()));
+      this->m_L1SpamsSolver->Setw(utl::ToVector<SolverPrecisionType>(*this->m_RegularizationWeight % qVector->size()));
+    }
+
+  if (this->m_UseWarmStart && (this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL) && this->m_L1SolverType==Self::FISTA_LS)
+    {
+    utlGlobalException(!this->m_L1FISTASolver->GetUseL2SolverForInitialization(), "warm start needs L2 initialization in m_L1FISTASolver");
+    std::cout << "Use warm start from the previous voxel in FISTA!" << std::endl << std::flush;
     }
+  m_FISTAIterationStatistics = std::vector<FISTAIterationStatisticsType>(this->GetNumberOfThreads());
 
   this->InitializeThreadedLibraries();
 
+  if (this->CreateThreadClones() && !this->IsAdaptiveScale())
+    {
+    // radial vectors of E(0) only depend on the fixed scale, and are computed once for each clone
+    for ( int i = 0; i < this->GetNumberOfThreads(); i += 1 ) 
+      {
+      Self* selfClone = static_cast<Self*>(this->GetThreadClone(i));
+      selfClone->ComputeRadialVectorForE0InDWI();
+      selfClone->ComputeRadialVectorForE0InBasis();
+      }
+    }
+
   // this->m_L2Solver->Initialize();
   // MatrixType ls = this->m_L2Solver->GetLS();
   // utl::PrintUtlMatrix(ls,"LS");
@@ -724,23 +1003,19 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 template< class TInputImage, class TOutputImage >
 void
 SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
-::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,ThreadIdType threadId )
+::ThreadedGenerateDataInVoxels(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId )
 {
   itkShowPositionThreadedLogger(this->GetDebug());
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+  if (this->IsBatchSolveUsed())
+    {
+    this->ThreadedGenerateDataInBatch(voxelIt, threadId);
+    return;
+    }
+
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
   // Pointers
   InputImageConstPointer inputPtr = this->GetInput();
   OutputImagePointer outputPtr = this->GetOutput();
-
-  // iterator for the output image      
-  ImageRegionIteratorWithIndex<OutputImageType> outputIt(outputPtr, outputRegionForThread );
-  ImageRegionConstIteratorWithIndex<InputImageType> inputIt(inputPtr, outputRegionForThread );
-  ImageRegionIteratorWithIndex<MaskImageType> maskIt;
-  ImageRegionIteratorWithIndex<ScalarImageType> scaleIt;
-  if (this->IsMaskUsed())
-    maskIt = ImageRegionIteratorWithIndex<MaskImageType>(this->m_MaskImage, outputRegionForThread);
-  if (!IsImageEmpty(this->m_ScaleImage))
-    scaleIt = ImageRegionIteratorWithIndex<ScalarImageType>(this->m_ScaleImage, outputRegionForThread);
   
   InputImagePixelType inputPixel;
   // OutputImageIndexType outputIndex;
@@ -755,13 +1030,13 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
   int n_b_ra = this->m_RadialRank + 1;
   int n_b =  n_b_ra * n_b_sh;
   
-  VectorType dwiPixel(numberOfDWIs+this->m_BasisMatrixForB0->Rows()), dwiPixel_est(numberOfDWIs+this->m_BasisMatrixForB0->Rows()), dwiPixel_first(numberOfDWIs), coef(numberOfCoeffcients), coef_first;
+  VectorType dwiPixel(numberOfDWIs+this->m_BasisMatrixForB0->Rows()), dwiPixel_est(numberOfDWIs+this->m_BasisMatrixForB0->Rows()), dwiPixel_first(numberOfDWIs), coef(numberOfCoeffcients), coef_first, coef_first_tmp;
+  // DWI signal and the previous solution in the precision of solvers
+  SolverVectorType dwiPixelInSolver, coef_previous;
   InputImageIndexType index;
 
 
-  Pointer selfClone = this->Clone();
-  // change selfClone->m_ThreadID and generate threadIDStr
-  selfClone->m_ThreadID = threadId;
+  Pointer selfClone = static_cast<Self*>(this->GetThreadClone(threadId));
   std::string threadIDStr =  selfClone->ThreadIDToString();
   if (this->GetDebug())
     {
@@ -771,37 +1046,34 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
     }
   
 
-  STDVectorPointer qVector = selfClone->m_SamplingSchemeQSpace->GetRadiusVector();
-
-  if (!this->IsAdaptiveScale())
-    {
-    selfClone->ComputeRadialVectorForE0InDWI();
-    selfClone->ComputeRadialVectorForE0InBasis();
-    }
-
   MatrixPointer basisMatrix(new MatrixType());
-  if (!this->m_IsAnalyticalB0 && !this->IsAdaptiveScale())
+  BasisMatrixCacheEntryPointer cacheEntry;
+  typename BasisMatrixCacheType::KeyType cacheKey=0;
+  // the basis matrix with B0 is only used for debug if the scale is fixed
+  if (this->GetDebug() && !this->m_IsAnalyticalB0 && !this->IsAdaptiveScale())
     *basisMatrix = utl::ConnectUtlMatrix(*selfClone->m_BasisMatrix, *utl::ToMatrix<double>(*selfClone->m_BasisMatrixForB0 % selfClone->m_B0Weight), true);
   
-  for (inputIt.GoToBegin(), outputIt.GoToBegin(), maskIt.GoToBegin(), scaleIt.GoToBegin();
-    !inputIt.IsAtEnd(); 
-    progress.CompletedPixel(), ++inputIt, ++outputIt, ++maskIt, ++scaleIt) 
+  for (voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); progress.CompletedPixel(), ++voxelIt) 
     {
+    index = voxelIt.GetIndex();
+
+    // the warm start does not cross chunks, which may be taken by any thread
+    if (voxelIt.IsAtChunkBegin())
+      coef_previous.Clear();
 
-    if (this->IsMaskUsed() && maskIt.Get()<=1e-8)
+    if (!this->IsInMask(index))
       {
-      outputIt.Set(outputZero);
+      outputPtr->SetPixel(index, outputZero);
       continue;
       }
 
-    inputPixel=inputIt.Get();
+    inputPixel=inputPtr->GetPixel(index);
     if (inputPixel.GetSquaredNorm()<=1e-8)
       {
-      outputIt.Set(outputZero);
+      outputPtr->SetPixel(index, outputZero);
       continue;
       }
 
-    index = inputIt.GetIndex();
     if (this->GetDebug())
       {
       std::ostringstream msg;
@@ -814,123 +1086,73 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 
     if (this->IsAdaptiveScale())
       {
-      double scale = scaleIt.Get();
+      double scale = this->m_ScaleImage->GetPixel(index);
       if (scale<=0)
         {
         // use scaleImage as a mask
-        outputIt.Set(outputZero);
+        outputPtr->SetPixel(index, outputZero);
         continue;
         }
 
-      selfClone->SetBasisScale(scale);
-      if (selfClone->m_BasisMatrix->Rows()==0)
+      if (this->m_BasisMatrixCache)
         {
-        selfClone->ComputeBasisMatrix();
-        if (!selfClone->m_IsAnalyticalB0)
-          selfClone->ComputeBasisMatrixForB0();
-        else 
+        typename BasisMatrixCacheType::KeyType key = this->m_BasisMatrixCache->GetKey(scale);
+        // neighboring voxels often have the same key, then the matrices in solvers are not changed
+        if (!cacheEntry || key!=cacheKey)
           {
-          selfClone->ComputeRadialVectorForE0InDWI();
-          selfClone->ComputeRadialVectorForE0InBasis();
+          cacheKey = key;
+          cacheEntry = this->m_BasisMatrixCache->Find(key);
+          if (!cacheEntry)
+            cacheEntry = this->m_BasisMatrixCache->Insert(key, selfClone->ComputeBasisMatrixCacheEntry(this->m_BasisMatrixCache->GetScale(key)));
+          selfClone->SetBasisMatrixCacheEntry(cacheEntry);
+          selfClone->SetBasisMatrixInSolver(cacheEntry->SolverMatrix, cacheEntry->LS, cacheEntry->FISTAContext);
+          // the basis matrix in double is only used for debug
+          if (this->GetDebug())
+            selfClone->ComputeBasisMatrixInSolver(basisMatrix);
           }
         }
-
-      if (!this->m_IsAnalyticalB0)
-        {
-        basisMatrix=MatrixPointer( new MatrixType() );
-        *basisMatrix = utl::ConnectUtlMatrix(*selfClone->m_BasisMatrix, *utl::ToMatrix<double>((*selfClone->m_BasisMatrixForB0)%this->m_B0Weight), true);
-        }
       else
         {
-        if (basisMatrix->Size()==0 || this->m_EstimationType==Self::L1_DL) // resize it for L1_DL
-          basisMatrix=MatrixPointer( new MatrixType(selfClone->m_BasisMatrix->Rows(), n_b_sh*(n_b_ra-1)) );
-        utlException((*selfClone->m_Gn0)[0]==0, "it should be not zero!, (*selfClone->m_Gn0)[0]="<< (*selfClone->m_Gn0)[0]);
-        // utlPrintVar2 (selfClone->_is_b0_analytical, selfClone->m_RadialRank, R_N_0);
-
-
-        // utl::Tic(std::cout<<"index start 1");
-        double *selfBasisMatrix_data = selfClone->m_BasisMatrix->GetData();
-        double *basisMatrix_data = basisMatrix->GetData();
-        int index_B=0, index_selfB=0, index_selfB_0=0;
-        for ( int ss = 0; ss < basisMatrix->Rows(); ss += 1 ) 
+        selfClone->SetBasisScale(scale);
+        if (selfClone->m_BasisMatrix->Rows()==0)
           {
-          for ( int i = 0; i < this->m_RadialRank; i += 1 ) 
+          selfClone->ComputeBasisMatrix();
+          if (!selfClone->m_IsAnalyticalB0)
+            selfClone->ComputeBasisMatrixForB0();
+          else 
             {
-            if (i==0)
-              index_selfB += n_b_sh;
-            else
-              index_selfB_0 -= n_b_sh;
-            for ( int j = 0; j < n_b_sh; j += 1 ) 
-              {
-              basisMatrix_data[index_B] = selfBasisMatrix_data[index_selfB] - (*selfClone->m_Gn0)[i+1]/(*selfClone->m_Gn0)[0] * selfBasisMatrix_data[index_selfB_0];
-              // basisMatrix(ss,i*n_b_sh+j) = (*selfClone->m_BasisMatrix)(ss,(i+1)*n_b_sh+j) - (*selfClone->m_Gn0)[i+1]/(*selfClone->m_Gn0)[0] * (*selfClone->m_BasisMatrix)(ss,j);
-              index_B++;
-              index_selfB++;
-              index_selfB_0++;
-              }
+            selfClone->ComputeRadialVectorForE0InDWI();
+            selfClone->ComputeRadialVectorForE0InBasis();
             }
-          index_selfB_0 += n_b_sh*this->m_RadialRank;
           }
-        // utl::Toc();
-
-        // utl::Tic(std::cout<<"() start 1");
-        // for ( int i = 0; i < this->m_RadialRank; i += 1 ) 
-        //   {
-        //   double firstTerm = (*selfClone->m_Gn0)[i+1]/(*selfClone->m_Gn0)[0];
-        //   for ( int j = 0; j < n_b_sh; j += 1 ) 
-        //     {
-        //     int index_B = i*n_b_sh+j;
-        //     int index_selfB = (i+1)*n_b_sh+j;
-        //     for ( int ss = 0; ss < basisMatrix->Rows(); ss += 1 ) 
-        //       {
-        //       (*basisMatrix)(ss,index_B) = (*selfClone->m_BasisMatrix)(ss,index_selfB) - firstTerm * (*selfClone->m_BasisMatrix)(ss,j);
-        //       }
-        //     }
-        //   }
-        // utl::Toc();
-
-        }
 
-      if (this->m_EstimationType==Self::L1_DL)
-        {
-        MatrixPointer tmpMat (new MatrixType());
-        utl::ProductUtlMM(*basisMatrix, *this->m_BasisCombinationMatrix, *tmpMat);
-        *basisMatrix = *tmpMat;
-        // utl::MatrixCopy(*tmpMat, *basisMatrix, 1.0, 'N');
-        // basisMatrix = tmpMat;
-        // basisMatrix *= (*this->m_BasisCombinationMatrix);
-        }
+        selfClone->ComputeBasisMatrixInSolver(basisMatrix);
 
-      if (this->GetDebug())
-        {
-        std::ostringstream msg;
-        utl::PrintUtlMatrix(*basisMatrix, "basisMatrix_InSolver", " ", msg << threadIDStr);
-        this->WriteLogger(msg.str());
-        }
+        if (this->GetDebug())
+          {
+          std::ostringstream msg;
+          utl::PrintUtlMatrix(*basisMatrix, "basisMatrix_InSolver", " ", msg << threadIDStr);
+          this->WriteLogger(msg.str());
+          }
 
-      if (this->m_EstimationType==Self::LS)
-        {
-        selfClone->m_L2Solver->SetA(basisMatrix);
-        }
-      else if (this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL)
-        {
-        if (this->m_L1SolverType==Self::FISTA_LS)
-          selfClone->m_L1FISTASolver->SetA(basisMatrix);
-        else if (this->m_L1SolverType==Self::SPAMS)
-          selfClone->m_L1SpamsSolver->SetA(basisMatrix);
+        selfClone->SetBasisMatrixInSolver(utl::ConvertNDArrayPointer<SolverPrecisionType>(basisMatrix));
         }
       }
 
     if (this->m_IsAnalyticalB0)
       {
-      for ( int i = 0; i < dwiPixel.Size(); i += 1 ) 
+      dwiPixelInSolver.ReSize(numberOfDWIs);
+      for ( int i = 0; i < numberOfDWIs; i += 1 ) 
+        {
         dwiPixel_first[i] = dwiPixel[i] - (*selfClone->m_G0DWI)[i];
+        dwiPixelInSolver[i] = dwiPixel_first[i];
+        }
 
       if (this->m_EstimationType==Self::LS)
         {
-        selfClone->m_L2Solver->Setb(VectorPointer(new VectorType(dwiPixel_first)));
+        selfClone->m_L2Solver->SetbFromData(dwiPixelInSolver.GetData(), dwiPixelInSolver.Size());
         selfClone->m_L2Solver->Solve();
-        coef_first = selfClone->m_L2Solver->Getx();
+        utl::CopyUtlVector(selfClone->m_L2Solver->Getx(), coef_first);
         // MatrixType ls = selfClone->m_L2Solver->GetLS();
         // utl::PrintUtlMatrix(ls, "LS");
         // VectorType coef_test = ls*dwiPixel_first;
@@ -940,17 +1162,16 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
         {
         if (this->m_L1SolverType==Self::FISTA_LS)
           {
-          selfClone->m_L1FISTASolver->Setb(VectorPointer(new VectorType(dwiPixel_first)));
+          selfClone->m_L1FISTASolver->SetbFromData(dwiPixelInSolver.GetData(), dwiPixelInSolver.Size());
           // selfClone->m_L1FISTASolver->SetDebug(this->GetDebug());
           // selfClone->m_L1FISTASolver->Print(std::cout<<"selfClone->m_L1FISTASolver = ");
-          selfClone->m_L1FISTASolver->Solve();
-          coef_first = selfClone->m_L1FISTASolver->Getx();
+          this->SolveUsingL1FISTASolver(selfClone->m_L1FISTASolver, coef_first, coef_previous, threadId);
           }
         else if (this->m_L1SolverType==Self::SPAMS)
           {
-          selfClone->m_L1SpamsSolver->Setb(VectorPointer(new VectorType(dwiPixel_first)));
+          selfClone->m_L1SpamsSolver->Setb(SolverVectorPointer(new SolverVectorType(dwiPixelInSolver)));
           selfClone->m_L1SpamsSolver->Solve();
-          coef_first = selfClone->m_L1SpamsSolver->Getx();
+          utl::CopyUtlVector(selfClone->m_L1SpamsSolver->Getx(), coef_first);
           }
 
         if (this->GetDebug())
@@ -967,7 +1188,7 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
             {
             msg << threadIDStr << "use m_L1FISTASolver" << std::endl << std::flush;
             selfClone->m_L1FISTASolver->Print(msg << threadIDStr<<"this->m_L1FISTASolver = ");
-            std::vector<double> funcVec = selfClone->m_L1FISTASolver->GetCostFunction();
+            typename L1FISTASolverType::ValueContainerType funcVec = selfClone->m_L1FISTASolver->GetCostFunction();
             utl::PrintVector(funcVec, "func FISTA", " ", msg << threadIDStr);
             }
           this->WriteLogger(msg.str());
@@ -976,7 +1197,6 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 
       if (this->m_EstimationType==Self::L1_DL)
         {
-        VectorType coef_first_tmp;
         utl::ProductUtlMv(*this->m_BasisCombinationMatrix, coef_first,coef_first_tmp);
         for ( int i = 0; i < coef_first_tmp.Size(); i += 1 ) 
           coef[i+n_b_sh] = coef_first_tmp[i];
@@ -987,25 +1207,7 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
           coef[i+n_b_sh] = coef_first[i];
         }
 
-      int jj=0;
-      for ( int l = 0; l <= this->m_SHRank; l += 2 ) 
-        {
-        for ( int m = -l; m <= l; m += 1 ) 
-          {
-          double sum_tmp = 0;
-          for ( int nn = 1; nn <= this->m_RadialRank; nn += 1 ) 
-            {
-            int index_j = this->GetIndexJ(nn,l,m);
-            sum_tmp += coef[index_j] * (*selfClone->m_Gn0)[nn];
-            }
-          if (l==0)
-            coef[jj] = (std::sqrt(4*M_PI) - sum_tmp)/(*selfClone->m_Gn0)[0];
-          else
-            coef[jj] = -sum_tmp/(*selfClone->m_Gn0)[0];
-          jj++;
-          }
-        }
-
+      selfClone->ComputeCoefficientsForE0(coef.GetData());
       }
     else
       {
@@ -1013,26 +1215,26 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
         dwiPixel[i+numberOfDWIs] = selfClone->m_B0Weight;
       // utl::PrintUtlVector(dwiPixel, "dwiPixel");
       // utl::PrintUtlMatrix(selfClone->m_BasisMatrixForB0, "selfClone->m_BasisMatrixForB0");
+      utl::CopyUtlVector(dwiPixel, dwiPixelInSolver);
 
       if (this->m_EstimationType==Self::LS)
         {
-        selfClone->m_L2Solver->Setb(VectorPointer(new VectorType(dwiPixel)));
+        selfClone->m_L2Solver->SetbFromData(dwiPixelInSolver.GetData(), dwiPixelInSolver.Size());
         selfClone->m_L2Solver->Solve();
-        coef = selfClone->m_L2Solver->Getx();
+        utl::CopyUtlVector(selfClone->m_L2Solver->Getx(), coef);
         }
       else if (this->m_EstimationType==Self::L1_2 || this->m_EstimationType==Self::L1_DL)
         {
         if (this->m_L1SolverType==Self::FISTA_LS)
           {
-          selfClone->m_L1FISTASolver->Setb(VectorPointer(new VectorType(dwiPixel)));
-          selfClone->m_L1FISTASolver->Solve();
-          coef = selfClone->m_L1FISTASolver->Getx();
+          selfClone->m_L1FISTASolver->SetbFromData(dwiPixelInSolver.GetData(), dwiPixelInSolver.Size());
+          this->SolveUsingL1FISTASolver(selfClone->m_L1FISTASolver, coef, coef_previous, threadId);
           }
         else if (this->m_L1SolverType==Self::SPAMS)
           {
-          selfClone->m_L1SpamsSolver->Setb(VectorPointer(new VectorType(dwiPixel)));
+          selfClone->m_L1SpamsSolver->Setb(SolverVectorPointer(new SolverVectorType(dwiPixelInSolver)));
           selfClone->m_L1SpamsSolver->Solve();
-          coef = selfClone->m_L1SpamsSolver->Getx();
+          utl::CopyUtlVector(selfClone->m_L1SpamsSolver->Getx(), coef);
           }
         }
 
@@ -1067,7 +1269,157 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
     for ( int i = 0; i < numberOfCoeffcients; i += 1 ) 
       outputPixel[i] = coef[i];
 
-    outputIt.Set(outputPixel);
+    outputPtr->SetPixel(index, outputPixel);
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::ThreadedGenerateDataInBatch(VoxelChunkIteratorType& voxelIt, ThreadIdType threadId )
+{
+  itkShowPositionThreadedLogger(this->GetDebug());
+  ProgressReporter progress(this, threadId, voxelIt.GetNumberOfVoxels());
+  // Pointers
+  InputImageConstPointer inputPtr = this->GetInput();
+  OutputImagePointer outputPtr = this->GetOutput();
+  OutputImageIndexType index;
+  
+  InputImagePixelType inputPixel;
+  OutputImagePixelType outputPixel, outputZero;
+  
+  unsigned int numberOfCoeffcients = outputPtr->GetNumberOfComponentsPerPixel();;
+  outputPixel.SetSize(numberOfCoeffcients);
+  outputZero.SetSize(numberOfCoeffcients), outputZero.Fill(0.0);
+  unsigned int numberOfDWIs = inputPtr->GetNumberOfComponentsPerPixel();
+  inputPixel.SetSize(numberOfDWIs);
+  int numberOfB0 = this->m_IsAnalyticalB0 ? 0 : this->m_BasisMatrixForB0->Rows();
+  int numberOfVoxelsPerBatch = this->m_NumberOfVoxelsPerBatch;
+
+  Pointer selfClone = static_cast<Self*>(this->GetThreadClone(threadId));
+
+  // each row is the DWI signal in one voxel
+  SolverMatrixType dwiBatch(numberOfVoxelsPerBatch, numberOfDWIs+numberOfB0), coefBatch;
+  std::vector<OutputImageIndexType> indexBatch;
+  indexBatch.reserve(numberOfVoxelsPerBatch);
+
+  for (voxelIt.GoToBegin(); !voxelIt.IsAtEnd(); ++voxelIt) 
+    {
+    index = voxelIt.GetIndex();
+    if (!this->IsInMask(index))
+      {
+      outputPtr->SetPixel(index, outputZero);
+      progress.CompletedPixel();
+      continue;
+      }
+
+    inputPixel=inputPtr->GetPixel(index);
+    if (inputPixel.GetSquaredNorm()<=1e-8)
+      {
+      outputPtr->SetPixel(index, outputZero);
+      progress.CompletedPixel();
+      continue;
+      }
+
+    SolverPrecisionType* dwiRow = dwiBatch.GetData() + indexBatch.size()*dwiBatch.Columns();
+    if (this->m_IsAnalyticalB0)
+      {
+      for ( int i = 0; i < numberOfDWIs; i += 1 ) 
+        dwiRow[i] = inputPixel[i] - (*selfClone->m_G0DWI)[i];
+      }
+    else
+      {
+      for ( int i = 0; i < numberOfDWIs; i += 1 ) 
+        dwiRow[i] = inputPixel[i];
+      for ( int i = 0; i < numberOfB0; i += 1 ) 
+        dwiRow[i+numberOfDWIs] = selfClone->m_B0Weight;
+      }
+    indexBatch.push_back(index);
+
+    if (indexBatch.size()==numberOfVoxelsPerBatch)
+      {
+      selfClone->ComputeCoefficientsInBatch(dwiBatch, coefBatch);
+      for ( int j = 0; j < indexBatch.size(); j += 1 ) 
+        {
+        for ( int i = 0; i < numberOfCoeffcients; i += 1 ) 
+          outputPixel[i] = coefBatch(j,i);
+        outputPtr->SetPixel(indexBatch[j], outputPixel);
+        progress.CompletedPixel();
+        }
+      indexBatch.clear();
+      }
+    }
+
+  // the last batch which is not full
+  if (indexBatch.size()>0)
+    {
+    SolverMatrixType dwiBatchLast = dwiBatch.GetNRows(0, indexBatch.size());
+    selfClone->ComputeCoefficientsInBatch(dwiBatchLast, coefBatch);
+    for ( int j = 0; j < indexBatch.size(); j += 1 ) 
+      {
+      for ( int i = 0; i < numberOfCoeffcients; i += 1 ) 
+        outputPixel[i] = coefBatch(j,i);
+      outputPtr->SetPixel(indexBatch[j], outputPixel);
+      progress.CompletedPixel();
+      }
+    }
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::SolveUsingL1FISTASolver(L1FISTASolverType* solver, VectorType& x, SolverVectorType& xPrevious, ThreadIdType threadId)
+{
+  if (this->m_UseWarmStart)
+    {
+    bool isWarmStartUsed = solver->SolveWithWarmStart(xPrevious);
+    FISTAIterationStatisticsType& stat = m_FISTAIterationStatistics[threadId];
+    if (isWarmStartUsed)
+      {
+      stat.NumberOfWarmStarts++;
+      stat.NumberOfIterationsInWarmStarts += solver->GetNumberOfIterations();
+      }
+    else
+      {
+      stat.NumberOfL2Starts++;
+      stat.NumberOfIterationsInL2Starts += solver->GetNumberOfIterations();
+      }
+    // the solution is kept for the warm start in the next voxel
+    utl::CopyUtlVector(solver->Getx(), xPrevious);
+    }
+  else
+    solver->Solve();
+  utl::CopyUtlVector(solver->Getx(), x);
+}
+
+template< class TInputImage, class TOutputImage >
+typename SphericalPolarFourierImageFilter< TInputImage, TOutputImage >::FISTAIterationStatisticsType
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::GetFISTAIterationStatistics() const
+{
+  FISTAIterationStatisticsType stat;
+  for ( int i = 0; i < m_FISTAIterationStatistics.size(); i += 1 ) 
+    {
+    stat.NumberOfWarmStarts += m_FISTAIterationStatistics[i].NumberOfWarmStarts;
+    stat.NumberOfIterationsInWarmStarts += m_FISTAIterationStatistics[i].NumberOfIterationsInWarmStarts;
+    stat.NumberOfL2Starts += m_FISTAIterationStatistics[i].NumberOfL2Starts;
+    stat.NumberOfIterationsInL2Starts += m_FISTAIterationStatistics[i].NumberOfIterationsInL2Starts;
+    }
+  return stat;
+}
+
+template< class TInputImage, class TOutputImage >
+void
+SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
+::AfterThreadedGenerateData()
+{
+  FISTAIterationStatisticsType stat = GetFISTAIterationStatistics();
+  if (this->m_UseWarmStart && stat.NumberOfWarmStarts+stat.NumberOfL2Starts>0)
+    {
+    double iterWarm = stat.NumberOfWarmStarts>0 ? double(stat.NumberOfIterationsInWarmStarts)/stat.NumberOfWarmStarts : 0;
+    double iterL2 = stat.NumberOfL2Starts>0 ? double(stat.NumberOfIterationsInL2Starts)/stat.NumberOfL2Starts : 0;
+    std::cout << "FISTA warm start is used in " << stat.NumberOfWarmStarts << " voxels with " << iterWarm << " iterations per voxel, "
+              << "L2 initialization is used in " << stat.NumberOfL2Starts << " voxels with " << iterL2 << " iterations per voxel" << std::endl << std::flush;
     }
 }
 
@@ -1077,6 +1429,11 @@ SphericalPolarFourierImageFilter< TInputImage, TOutputImage >
 ::PrintSelf(std::ostream& os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
+  if (m_BasisMatrixCache)
+    {
+    os << indent << "m_BasisMatrixCache: " << m_BasisMatrixCache->GetNumberOfEntries() << " entries, " << m_BasisMatrixCache->GetMemorySize() << " MB, " 
+       << m_BasisMatrixCache->GetNumberOfHits() << " hits, " << m_BasisMatrixCache->GetNumberOfMisses() << " misses" << std::endl;
+    }
 }
 
 }
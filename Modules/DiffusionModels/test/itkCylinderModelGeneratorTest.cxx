@@ -0,0 +1,146 @@
+/**
+ *       @file  itkCylinderModelGeneratorTest.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "itkCylinderModelGenerator.h"
+#include "utl.h"
+
+typedef itk::CylinderModelGenerator<double> CylinderType;
+
+/** direct evaluation of the triple sum over (m,k,n) in the cylinder model, without factorization of the series  */
+double
+ComputeDWISampleUsingTripleSum(const double length, const double radius, const double d0, const double deltaBig, const CylinderType::PointType& axis, const CylinderType::PointType& sample, const double qq)
+{
+  const int nMax = 1000, mMax = 10, kMax = 10;
+  double d0DeltaBig = d0*deltaBig;
+  double radius2 = radius*radius;
+
+  double dott = sample[0]*axis[0] + sample[1]*axis[1] + sample[2]*axis[2];
+  double angle = std::acos( dott>=1?1:(dott<=-1?-1:dott) );
+  if (angle>M_PI/2) 
+    angle = M_PI - angle;
+  if (M_PI/2-angle<1.0e-5) 
+    angle = M_PI/2 - 1.0e-5;
+  if (angle<1e-5)
+    angle = 1e-5;
+  double angle2sin = std::sin(2*angle);
+
+  double pi2qcos = 2.0*M_PI*qq*std::cos(angle);
+  double pi2qsin = 2.0*M_PI*qq*std::sin(angle);
+  double pi2qsinRadius = pi2qsin*radius;
+  double pi2qcosLengthcos = std::cos(pi2qcos*length);
+  double first_temp = 2.0*std::pow(radius,2) *std::pow(2*M_PI*qq,4)*angle2sin*angle2sin / (length*length);
+
+  double signal=0;
+  for ( int m = 0; m <=mMax; m += 1 ) 
+    {
+    double J_m_d = m/(pi2qsinRadius)*gsl_sf_bessel_Jn(m,pi2qsinRadius) - gsl_sf_bessel_Jn(m+1,pi2qsinRadius);
+    for ( int k = 1; k <=kMax; k += 1 ) 
+      {
+      double gamma_km = utl::BesselJPrimeZerosTable[kMax*m+k-1];
+      double gamma_km2 = gamma_km * gamma_km;
+      double second_temp = J_m_d*J_m_d / std::pow(gamma_km2-std::pow(pi2qsinRadius,2) ,2) ;
+      if (m!=0)
+        second_temp *= gamma_km2 / (gamma_km2-m*m);
+      for ( int n = 0; n <=nMax; n += 1 ) 
+        {
+        double nPiLength2 = std::pow(n*M_PI/length,2);
+        double num2 = (n%2 ? (1+pi2qcosLengthcos) : (1-pi2qcosLengthcos));
+        double K_mn = m>0? (n>0?4:2) : (n>0?2:1);
+        double third_temp = num2 *K_mn / std::pow( nPiLength2 - std::pow(pi2qcos,2), 2 );
+        double fourth_temp = std::exp(-(gamma_km2/radius2 + nPiLength2)*d0DeltaBig);
+        signal += first_temp*second_temp*third_temp*fourth_temp;
+        }
+      }
+    }
+  return signal;
+}
+
+/**
+ * \brief  test \ref itk::CylinderModelGenerator. DWI samples should be the same as the direct evaluation of the triple sum, 
+ * and DWI samples in batch should be the same as samples of each cylinder.
+ */
+int 
+main (int argc, char const* argv[])
+{
+  typedef CylinderType::SamplingSchemeQSpaceType SamplingSchemeType;
+  typedef CylinderType::MatrixType MatrixType;
+
+  // 3 shells with b=1000,2000,3000 and 4 orientations
+  SamplingSchemeType::Pointer scheme = SamplingSchemeType::New();
+  double tau = scheme->GetTau();
+  for ( int s = 1; s <= 3; s += 1 ) 
+    {
+    double q = std::sqrt(s*1000.0/(4*M_PI*M_PI*tau));
+    scheme->AppendOrientationAndRadiusValue(1, 0, 0, q);
+    scheme->AppendOrientationAndRadiusValue(0, 1, 0, q);
+    scheme->AppendOrientationAndRadiusValue(0, 0, 1, q);
+    scheme->AppendOrientationAndRadiusValue(1/std::sqrt(3.0), 1/std::sqrt(3.0), 1/std::sqrt(3.0), q);
+    }
+  int N = scheme->GetNumberOfSamples();
+
+  CylinderType::Pointer cylinder = CylinderType::New();
+  cylinder->SetSamplingSchemeQSpace(scheme);
+  cylinder->BuildTable();
+
+  MatrixType axes(3,3,0.0);
+  axes(0,2) = 1.0;
+  axes(1,0) = 0.6, axes(1,1) = 0.8;
+  axes(2,0) = 0.48, axes(2,1) = 0.64, axes(2,2) = 0.6;
+
+  MatrixType parameters(3,3);
+  parameters(0,0) = cylinder->GetLength(), parameters(0,1) = cylinder->GetRadius(), parameters(0,2) = cylinder->GetD0();
+  parameters(1,0) = 3.0, parameters(1,1) = 0.008, parameters(1,2) = 1.5e-3;
+  parameters(2,0) = 0.5, parameters(2,1) = 0.003, parameters(2,2) = 2.0e-3;
+
+  MatrixType dwiBatch;
+  cylinder->ComputeDWISamplesInBatch(parameters, axes, dwiBatch);
+  utlGlobalException(dwiBatch.rows()!=9 || dwiBatch.columns()!=N, "wrong size");
+
+  // the geometry of cylinder is not changed in batch
+  utlGlobalException(cylinder->GetLength()!=parameters(0,0), "the geometry should not be changed");
+
+  for ( int p = 0; p < parameters.rows(); p += 1 ) 
+    {
+    CylinderType::Pointer cylinder_p = cylinder->Clone();
+    cylinder_p->SetLength(parameters(p,0));
+    cylinder_p->SetRadius(parameters(p,1));
+    cylinder_p->SetD0(parameters(p,2));
+    for ( int a = 0; a < axes.rows(); a += 1 ) 
+      {
+      CylinderType::PointType axis;
+      axis[0]=axes(a,0), axis[1]=axes(a,1), axis[2]=axes(a,2);
+      cylinder_p->SetCylinderAxis(axis);
+      cylinder_p->ComputeDWISamples();
+      CylinderType::VectorPointer dwi = cylinder_p->GetDWISamples();
+      for ( int i = 0; i < N; i += 1 ) 
+        {
+        utlSAGlobalException((*dwi)[i]!=(*dwi)[i])(p)(a)(i).msg("nan in DWI signal");
+        double dwiTripleSum = ComputeDWISampleUsingTripleSum(parameters(p,0), parameters(p,1), parameters(p,2), scheme->GetDeltaBig(), axis, (*scheme)[i], (*scheme->GetRadiusVector())[i]);
+        utlSAGlobalException(std::fabs((*dwi)[i]-dwiTripleSum)>1e-10*std::fabs(dwiTripleSum)+1e-14)(p)(a)(i)((*dwi)[i])(dwiTripleSum).msg("different from the triple sum");
+        utlSAGlobalException(std::fabs((*dwi)[i]-dwiBatch(p*axes.rows()+a,i))>1e-12)(p)(a)(i)((*dwi)[i])(dwiBatch(p*axes.rows()+a,i)).msg("batch is different");
+        }
+      }
+    }
+
+  // batch with the current geometry uses the series terms built in BuildTable()
+  MatrixType dwiOneGeometry;
+  cylinder->ComputeDWISamplesInBatch(axes, dwiOneGeometry);
+  for ( int i = 0; i < N; i += 1 ) 
+    utlGlobalException(dwiOneGeometry(0,i)!=dwiBatch(0,i), "batch with the current geometry is different");
+
+  return 0;
+}
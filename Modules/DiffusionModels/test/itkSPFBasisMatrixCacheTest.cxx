@@ -0,0 +1,75 @@
+/**
+ *       @file  itkSPFBasisMatrixCacheTest.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "itkSPFBasisMatrixCache.h"
+#include "utl.h"
+
+/**
+ * \brief  test \ref itk::SPFBasisMatrixCache
+ */
+int 
+main (int argc, char const* argv[])
+{
+  typedef itk::SPFBasisMatrixCache<double> CacheType;
+  CacheType::Pointer cache = CacheType::New();
+  cache->SetTolerance(0.01);
+
+  // scales in the same bin share the same key, and the scale of the bin is close to them
+  double scale = 1000.0;
+  CacheType::KeyType key = cache->GetKey(scale);
+  utlGlobalException(cache->GetKey(scale*1.001)!=key, "wrong key");
+  utlGlobalException(cache->GetKey(scale*1.02)==key, "wrong key");
+  utlGlobalException(std::fabs(cache->GetScale(key)-scale)/scale>0.005+1e-10, "wrong scale of the bin");
+
+  utlGlobalException(cache->Find(key), "the cache should be empty");
+
+  CacheType::EntryPointer entry(new CacheType::EntryType());
+  entry->Scale = cache->GetScale(key);
+  entry->BasisMatrix = CacheType::MatrixPointer(new CacheType::MatrixType(100, 100));
+  CacheType::EntryPointer entry_in = cache->Insert(key, entry);
+  utlGlobalException(entry_in!=entry, "wrong inserted entry");
+
+  // the first inserted entry is kept
+  CacheType::EntryPointer entry2(new CacheType::EntryType());
+  entry2->BasisMatrix = CacheType::MatrixPointer(new CacheType::MatrixType(100, 100));
+  utlGlobalException(cache->Insert(key, entry2)!=entry, "wrong inserted entry");
+  utlGlobalException(cache->Find(key)!=entry, "wrong found entry");
+  utlGlobalException(cache->GetNumberOfEntries()!=1, "wrong number of entries");
+
+  // each entry has 100*100*8 bytes, about 0.076 MB. Only 2 entries are kept in 0.16 MB.
+  cache->SetMaxMemorySize(0.16);
+  for ( int i = 1; i < 5; i += 1 ) 
+    {
+    CacheType::EntryPointer entry_i(new CacheType::EntryType());
+    entry_i->BasisMatrix = CacheType::MatrixPointer(new CacheType::MatrixType(100, 100));
+    cache->Insert(key+i, entry_i);
+    }
+  utlPrintVar3(true, cache->GetNumberOfEntries(), cache->GetMemorySize(), cache->GetMaxMemorySize());
+  utlGlobalException(cache->GetNumberOfEntries()!=2, "wrong number of entries");
+  utlGlobalException(cache->GetMemorySize()>cache->GetMaxMemorySize(), "wrong memory size");
+  utlGlobalException(cache->Find(key), "the oldest entry should be released");
+  utlGlobalException(!cache->Find(key+4), "the newest entry should be kept");
+
+  // matrices in single precision solvers use half of the memory
+  typedef itk::SPFBasisMatrixCache<float> FloatCacheType;
+  FloatCacheType::EntryType entryFloat;
+  entryFloat.BasisMatrix = FloatCacheType::MatrixPointer(new FloatCacheType::MatrixType(100, 100));
+  entryFloat.SolverMatrix = FloatCacheType::SolverMatrixPointer(new FloatCacheType::SolverMatrixType(100, 100));
+  utlGlobalException(std::fabs(entryFloat.GetMemorySize()-100*100*(8+4))>1e-8, "wrong memory size in single precision");
+
+  return 0;
+}
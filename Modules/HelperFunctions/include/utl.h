@@ -50,6 +50,7 @@
 #include "utlDMRI.h"
 
 #include "itkSphericalHarmonicsGenerator.h"
+#include "itkSHBasisEvaluator.h"
 #include "utlDMRIStoredTables.h"
 
 #include "itkMultiVolumeImageToVectorImageFilter.h"
@@ -173,15 +174,24 @@ ComputeSHMatrix ( const unsigned int rank, const NDArray<T,2>& grad, const int m
   utlException(grad.Rows()==0 || grad.Columns()!=3, "wrong size of gradients!");
   int numberOfBasisFunctions = (rank + 1)*(rank + 2)/2;
   int numberOfDirections = grad.Rows();
+  utlGlobalException(mode!=CARTESIAN_TO_SPHERICAL && mode!=SPHERICAL_TO_SPHERICAL, "wrong mode");
+
+  utl_shared_ptr<NDArray<T,2> > BMatrix (new NDArray<T,2>(numberOfDirections, numberOfBasisFunctions));
+
+  // all basis functions of one direction are evaluated in one pass for ranks with a specialized SHBasisEvaluator
+  if (rank%2==0)
+    {
+    // SoA layout of directions
+    std::vector<T> x0(numberOfDirections), x1(numberOfDirections), x2(numberOfDirections);
+    for ( int k = 0; k < numberOfDirections; k++ )
+      x0[k] = grad(k,0), x1[k] = grad(k,1), x2[k] = grad(k,2);
+    if (EvaluateSHBasisBatch<T>(rank, numberOfDirections, &x0[0], &x1[0], &x2[0], mode==CARTESIAN_TO_SPHERICAL, BMatrix->GetData(), numberOfBasisFunctions))
+      return BMatrix;
+    }
+
   NDArray<T,2> gradSpherical;
   if (mode==CARTESIAN_TO_SPHERICAL)
     gradSpherical = CartesianToSpherical(grad);
-  else if (mode==SPHERICAL_TO_SPHERICAL)
-    ;
-  else
-    utlGlobalException(true, "wrong mode");
-
-  utl_shared_ptr<NDArray<T,2> > BMatrix (new NDArray<T,2>(numberOfDirections, numberOfBasisFunctions));
 
   // itk::SphericalHarmonicsGenerator<double>::Pointer sh = itk::SphericalHarmonicsGenerator<double>::New();
   int jj=0;
@@ -201,6 +211,31 @@ ComputeSHMatrix ( const unsigned int rank, const NDArray<T,2>& grad, const int m
   return BMatrix;
 }
 
+/** SH matrix of the stored gradient table with tess order tess (no duplicated directions).
+ * It is read from the stored table file if the file has the table "SHMatrixT<tess>" with at least RankToDimSH(rank) columns.
+ * Otherwise it is computed using ComputeSHMatrix. */
+inline utl_shared_ptr<NDArray<double,2> >
+ReadSHMatrix ( const int tess, const unsigned int rank )
+{
+  const utl::StoredTableFile::Pointer& store = utl::StoredTableFile::GetInstance();
+  const int dimSH = utl::RankToDimSH(rank);
+  if (store)
+    {
+    std::vector<unsigned> shape;
+    const double* data = store->GetTable(std::string("SHMatrixT")+utl::ConvertNumberToString(tess), shape);
+    if (data && shape.size()==2 && shape[1]>=dimSH)
+      {
+      utl_shared_ptr<NDArray<double,2> > BMatrix (new NDArray<double,2>(shape[0], dimSH));
+      for ( int i = 0; i < shape[0]; ++i )
+        utl::cblas_copy(dimSH, data+i*shape[1], 1, BMatrix->GetData()+i*dimSH, 1);
+      return BMatrix;
+      }
+    }
+  utl::GradientTable<double>::Initialize(tess);
+  utl_shared_ptr<NDArray<double,2> > grad = utl::GradientTable<double>::GetGrad(tess, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+  return ComputeSHMatrix(rank, *grad, CARTESIAN_TO_SPHERICAL);
+}
+
 // template < class T >
 // void
 // MatchBVectorAndGradientMatrix (const T& br, std::vector<T>& vec, const vnl_matrix<T>& grad )
@@ -1572,6 +1572,76 @@ AddNoise( const std::vector<T>& signal, const double sigma, const bool is_rician
   return AddNoise(signal, signal.size(), sigma, is_rician);
 }
 
+/** SplitMix64 finalizer, which maps consecutive integers to uncorrelated 64 bits. */
+inline unsigned long long
+MixBits64 ( unsigned long long z )
+{
+  z ^= z >> 30;
+  z *= 0xBF58476D1CE4E5B9ULL;
+  z ^= z >> 27;
+  z *= 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z;
+}
+
+/** Counter-based random number in (0,1).
+ * The value only depends on (seed, stream, counter), not on the order of calls.
+ * Thus the random numbers are reproducible in multiple threads, e.g. stream is the voxel offset, counter is the index of the component.  */
+inline double
+RandomCounterBased ( const unsigned long long seed, const unsigned long long stream, const unsigned long long counter )
+{
+  const unsigned long long golden = 0x9E3779B97F4A7C15ULL;
+  unsigned long long key = MixBits64(seed + golden*(stream+1));
+  unsigned long long bits = MixBits64(key + golden*(counter+1));
+  // 53 bits in mantissa, 0 and 1 are excluded
+  return ((bits >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+/** Gaussian random value using counters 2*counter and 2*counter+1 in RandomCounterBased(). */
+template < typename T >
+inline T
+GaussRandCounterBased ( const T value, const double sigma, const unsigned long long seed, const unsigned long long stream, const unsigned long long counter )
+{
+  if (sigma<=0)
+    return value;
+  double U1 = RandomCounterBased(seed, stream, 2*counter);
+  double U2 = RandomCounterBased(seed, stream, 2*counter+1);
+  double A = std::sqrt(-2*std::log(U1))*std::cos(2*M_PI*U2);
+  return (value + sigma*A);
+}
+
+/** Rician random value using counters 2*counter and 2*counter+1 in GaussRandCounterBased(). */
+template < typename T >
+inline T
+RicianRandCounterBased ( const T value, const double sigma, const unsigned long long seed, const unsigned long long stream, const unsigned long long counter )
+{
+  if (sigma<=0)
+    return value;
+  T noise_real = GaussRandCounterBased(value, sigma, seed, stream, 2*counter);
+  T noise_imag = GaussRandCounterBased(T(0.0), sigma, seed, stream, 2*counter+1);
+  return std::sqrt(noise_real*noise_real + noise_imag*noise_imag);
+}
+
+/** Add noise to signal using the random stream of a voxel.
+ * The noise of the same (seed, stream) is always the same, no matter which thread generates it.  */
+template < typename VectorType>
+inline VectorType
+AddNoiseCounterBased( const VectorType& signal, const int size, const double sigma, const bool is_rician, const unsigned long long seed, const unsigned long long stream)
+{
+  if (sigma<=0)
+    return signal;
+
+  VectorType result(signal);
+  for ( int i = 0; i < size; i += 1 )
+    {
+    if (is_rician)
+      result[i] = RicianRandCounterBased(signal[i],sigma, seed, stream, i);
+    else
+      result[i] = GaussRandCounterBased(signal[i],sigma, seed, stream, i);
+    }
+  return result;
+}
+
 
 /** http://en.wikipedia.org/wiki/Spherical_coordinate_system  */
 template < typename T >
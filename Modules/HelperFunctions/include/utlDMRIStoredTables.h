@@ -21,6 +21,7 @@
 
 // #include "itkSphericalHarmonicsGenerator.h"
 #include "utlNDArray.h"
+#include "utlStoredTableFile.h"
 
 
 
@@ -30,27 +31,40 @@ namespace itk
 
 typedef UnaryFunctorLookUpTable<utl::Functor::Exp<double> >       LUTExpType;
 typedef LUTExpType::Pointer                                       LUTExpPointer;
-/** use lookup table to approximate exp(-x)  */
-static  LUTExpPointer lutExp = LUTExpType::New();
 
+inline LUTExpPointer
+CreateLUTExp()
+{
+  LUTExpPointer lut = LUTExpType::New();
+  lut->SetVariableMax(0);
+  lut->SetVariableMin(-30);
+  lut->SetNumberOfBins(30*5e3);
+  lut->BuildTable();
+  return lut;
+}
+
+/** lookup table to approximate exp(x) for x in [-30,0]. 
+ * It is shared by all translation units and threads. 
+ * It is built only once in the first call, and the initialization of the local static is thread-safe in C++11. */
+inline const LUTExpType*
+GetLUTExp()
+{
+  static const LUTExpPointer lutExp = CreateLUTExp();
+  return lutExp.GetPointer();
+}
+
+/** Build the lookup table for exp. It is optional, because lutExpValue builds the table in the first call.  */
 inline void 
 InitializeLUTExp()
 {
-  if (!lutExp->IsTableBuilt())
-    {
-    lutExp = LUTExpType::New();
-    lutExp->SetVariableMax(0);
-    lutExp->SetVariableMin(-30);
-    lutExp->SetNumberOfBins(30*5e3);
-    lutExp->BuildTable();
-    }
+  GetLUTExp();
 }
 
 inline double 
 lutExpValue(const double x)
 {
   if (x<=0)
-    return lutExp->GetFunctionValue(x);
+    return GetLUTExp()->GetFunctionValue(x);
   else 
     return std::exp(x);
 }
@@ -113,15 +127,32 @@ public:
     utlSAGlobalException(tessorder<1 || tessorder>7)(tessorder).msg("wrong tess order. tessorder should be in [1,7]");
     Pointer instance = GetInstance();
     MatrixPointer mat = instance->m_GradTable[tessorder-1];
+    if (mat->Rows()>0)
+      return;
+
+    // use the memory-mapped table without copy if it is in the stored table file
+    const StoredTableFile::Pointer& store = StoredTableFile::GetInstance();
+    std::vector<unsigned> shape;
+    const double* data = store ? store->GetTable(std::string("DirectionsT")+utl::ConvertNumberToString(tessorder), shape) : NULL;
+    if (data && shape.size()==2 && shape[1]==3)
+      {
+      unsigned shapeMat[2] = {shape[0], shape[1]};
+      // the data is read-only. GetGrad always returns a copy.
+      mat = MatrixPointer(new MatrixType());
+      mat->SetData(const_cast<double*>(data), shapeMat);
+      instance->m_GradTable[tessorder-1] = mat;
+      return;
+      }
+
     switch ( tessorder )
       {
-    case 1 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT1), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 2 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT2), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 3 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT3), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 4 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT4), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 5 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT5), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 6 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT6), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
-    case 7 : {  if (mat->Rows()==0) mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT7), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 1 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT1), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 2 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT2), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 3 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT3), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 4 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT4), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 5 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT5), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 6 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT6), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
+    case 7 : {  mat = utl::ReadGrad<double>(CreateExpandedPath(DirectionsT7), DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); break;    }
     default : utlSAGlobalException(true)(tessorder).msg("wrong tess order. tessorder should be in [1,7]");   break;
       }
     instance->m_GradTable[tessorder-1] = mat;
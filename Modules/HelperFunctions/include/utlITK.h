@@ -24,6 +24,7 @@
 #include <itkVectorImage.h>
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
+#include <itkImageIOFactory.h>
 #include <itkTimeProbe.h>
 #include <itkImageRegionIteratorWithIndex.h>
 #include <itkVariableLengthVector.h>
@@ -199,6 +200,42 @@ SaveImage (const SmartPointer<ImageType>& image, const std::string& filename, co
   return true;
 }
 
+/** Save the output of a pipeline in numberOfStreamDivisions slabs. 
+ * Upstream filters only generate one slab at a time, if they support streaming and the image format supports streamed writing (e.g. nrrd, mha, uncompressed nii). 
+ * Otherwise the whole image is generated at once.  */
+template <class ImageType>
+bool 
+SaveImageInStreams (const SmartPointer<ImageType>& image, const std::string& filename, const int numberOfStreamDivisions, const std::string& printInfo="Writing Image:")
+{
+  typedef itk::ImageFileWriter<ImageType> WriterType;
+  typename WriterType::Pointer writer = WriterType::New();
+  
+  writer->SetFileName(filename);
+  writer->SetInput(image);
+  writer->SetNumberOfStreamDivisions(numberOfStreamDivisions);
+  ImageIOBase::Pointer imageIO = ImageIOFactory::CreateImageIO(filename.c_str(), ImageIOFactory::WriteMode);
+  if (imageIO)
+    {
+    imageIO->SetFileName(filename);
+    if (numberOfStreamDivisions>1 && !imageIO->CanStreamWrite())
+      std::cout << "Warning: " << filename << " does not support streamed writing. The whole image is generated at once." << std::endl << std::flush;
+    writer->SetImageIO(imageIO);
+    }
+  try 
+    {
+    if (utl::IsLogNormal())
+      std::cout << printInfo << " " << filename << " in " << numberOfStreamDivisions << " streams" << std::endl;
+    writer->Update(); 
+    } 
+  catch (itk::ExceptionObject & err) 
+    { 
+    std::cout << "ExceptionObject caught !" << std::endl; 
+    std::cout << err << std::endl; 
+    return false;
+    }
+  return true;
+}
+
 inline int
 GetImageType(const std::string& filename)
 {
@@ -182,6 +182,7 @@ type Get##name() const                      \
                                                                                          \
   typedef typename Superclass::MaskImageType            MaskImageType;                   \
   typedef typename MaskImageType::Pointer               MaskImagePointer;                \
+  typedef typename Superclass::VoxelChunkIteratorType   VoxelChunkIteratorType;          \
                                                                                          \
   typedef typename itk::Image<double,3>                 ScalarImageType;                 \
   typedef typename ScalarImageType::Pointer             ScalarImagePointer;              
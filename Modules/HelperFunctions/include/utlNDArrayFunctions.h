@@ -88,6 +88,47 @@ ToMatrix ( const Expr<EType, typename EType::ValueType>& expr )
   return mat;
 }
 
+template <class T, class T2, unsigned int Dim>
+struct NDArrayPointerConverter
+{
+  static utl_shared_ptr< NDArray<T,Dim> > Convert ( const utl_shared_ptr< NDArray<T2,Dim> >& arr )
+    {
+    if (!arr)
+      return utl_shared_ptr< NDArray<T,Dim> >();
+    return utl_shared_ptr< NDArray<T,Dim> >(new NDArray<T,Dim>(*arr));
+    }
+};
+
+template <class T, unsigned int Dim>
+struct NDArrayPointerConverter<T,T,Dim>
+{
+  static utl_shared_ptr< NDArray<T,Dim> > Convert ( const utl_shared_ptr< NDArray<T,Dim> >& arr )
+    {
+    return arr;
+    }
+};
+
+/** Convert a pointer of NDArray with value type T2 to a pointer of NDArray with value type T.
+ * If T and T2 are the same, the same pointer is returned without copy.
+ * It is used to pass double matrices to solvers in single precision.  */
+template <class T, class T2, unsigned int Dim>
+inline utl_shared_ptr< NDArray<T,Dim> >
+ConvertNDArrayPointer ( const utl_shared_ptr< NDArray<T2,Dim> >& arr )
+{
+  return NDArrayPointerConverter<T,T2,Dim>::Convert(arr);
+}
+
+/** Copy vec into vecOut in place, with casting from T2 to T. 
+ * vecOut is allocated only if its size is different, then it is used to copy vectors into preallocated buffers in voxel loops.  */
+template <class T, class T2>
+inline void
+CopyUtlVector ( const NDArray<T2,1>& vec, NDArray<T,1>& vecOut )
+{
+  vecOut.ReSize(vec.Size());
+  for ( int i = 0; i < vec.Size(); i += 1 ) 
+    vecOut[i] = static_cast<T>(vec[i]);
+}
+
 template <class T>
 std::vector<T> 
 UtlVectorToStdVector ( const NDArray<T,1>& vec )
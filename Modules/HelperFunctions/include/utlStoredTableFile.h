@@ -0,0 +1,290 @@
+/**
+ *       @file  utlStoredTableFile.h
+ *      @brief  versioned binary file of precomputed tables, which is memory-mapped and shared read-only
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __utlStoredTableFile_h
+#define __utlStoredTableFile_h
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define UTL_STOREDTABLE_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "DMRITOOLConfigure.h"
+#include "utlCoreMacro.h"
+#include "utlSmartAssert.h"
+#include "utlSTDHeaders.h"
+
+namespace utl
+{
+
+/**
+ *   \class   StoredTableFile
+ *   \brief   Read-only binary store of precomputed double tables (tessellations, SH matrices, SH triple integrals...).
+ *
+ *   The file is memory-mapped, so tables are shared by all threads and processes without parsing.
+ *   File layout (little endian, all tables are 8 bytes aligned):
+ *   - HeaderType
+ *   - NumberOfEntries x EntryType
+ *   - data of tables in row-major order
+ *
+ *   The file is generated by GenerateStoredTables, and read by utl::GradientTable, utl::InitializeSHTripleIntegrationTable, utl::ReadSHMatrix.
+ *   If the file does not exist or the version is different, the text tables are used.
+ *
+ *   \author  Jian Cheng
+ */
+class StoredTableFile
+{
+public:
+  typedef StoredTableFile                            Self;
+  typedef utl_shared_ptr<Self>                       Pointer;
+
+  /** increase it if the layout or content of the file is changed */
+  enum { Version=1, MaxDimension=3, MaxNameLength=64 };
+
+  struct HeaderType
+    {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumberOfEntries;
+    uint64_t FileSize;
+    };
+
+  struct EntryType
+    {
+    char Name[MaxNameLength];
+    uint32_t Dimension;
+    uint32_t Shape[MaxDimension];
+    /** offset in bytes of data from the beginning of the file */
+    uint64_t Offset;
+    };
+
+  ~StoredTableFile()
+    {
+#ifdef UTL_STOREDTABLE_NO_MMAP
+    delete[] m_Buffer;
+#else
+    if (m_Buffer)
+      munmap(m_Buffer, m_Size);
+#endif
+    }
+
+  /** Open the file. It returns an empty pointer if the file does not exist or it is not a valid file with the current Version.  */
+  static Pointer Open(const std::string& file)
+    {
+    Pointer store(new Self());
+    if (!store->Map(file) || !store->ReadEntries())
+      return Pointer();
+    return store;
+    }
+
+  /** The shared store used by utl functions.
+   * The file is Path_StoredTables, or the file in the environment variable DMRITOOL_STORED_TABLES.
+   * It is opened only once in a thread-safe way. It is empty if the file is not available. */
+  static const Pointer& GetInstance()
+    {
+    static const Pointer instance = Open(GetDefaultFileName());
+    return instance;
+    }
+
+  static std::string GetDefaultFileName()
+    {
+    const char* env = std::getenv("DMRITOOL_STORED_TABLES");
+    if (env && std::strlen(env)>0)
+      return std::string(env);
+    return std::string(Path_StoredTables);
+    }
+
+  /** Return the pointer to the data of a table, or NULL if the table is not in the file. shape has the size of the table in each dimension.  */
+  const double* GetTable(const std::string& name, std::vector<unsigned>& shape) const
+    {
+    std::map<std::string, const EntryType*>::const_iterator iter = m_Entries.find(name);
+    if (iter==m_Entries.end())
+      return NULL;
+    const EntryType* entry = iter->second;
+    shape.assign(entry->Shape, entry->Shape+entry->Dimension);
+    return reinterpret_cast<const double*>(m_Buffer + entry->Offset);
+    }
+
+  bool HasTable(const std::string& name) const
+    {
+    return m_Entries.find(name)!=m_Entries.end();
+    }
+
+  std::vector<std::string> GetTableNames() const
+    {
+    std::vector<std::string> names;
+    for ( std::map<std::string, const EntryType*>::const_iterator iter=m_Entries.begin(); iter!=m_Entries.end(); ++iter )
+      names.push_back(iter->first);
+    return names;
+    }
+
+  static void GetMagic(char* magic)
+    {
+    std::memcpy(magic, "DMRITBL", 8);
+    }
+
+private:
+  StoredTableFile() : m_Buffer(NULL), m_Size(0) {}
+  StoredTableFile(const Self&); //purposely not implemented
+  void operator=(const Self&); //purposely not implemented
+
+  bool Map(const std::string& file)
+    {
+#ifdef UTL_STOREDTABLE_NO_MMAP
+    std::ifstream in(file.c_str(), std::ios::binary | std::ios::ate);
+    if (!in)
+      return false;
+    m_Size = in.tellg();
+    if (m_Size<sizeof(HeaderType))
+      return false;
+    m_Buffer = new char[m_Size];
+    in.seekg(0);
+    in.read(m_Buffer, m_Size);
+    return in.good();
+#else
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd<0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st)!=0 || st.st_size<(off_t)sizeof(HeaderType))
+      {
+      close(fd);
+      return false;
+      }
+    m_Size = st.st_size;
+    void* buffer = mmap(NULL, m_Size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping is still valid after the file is closed
+    close(fd);
+    if (buffer==MAP_FAILED)
+      return false;
+    m_Buffer = static_cast<char*>(buffer);
+    return true;
+#endif
+    }
+
+  bool ReadEntries()
+    {
+    const HeaderType* header = reinterpret_cast<const HeaderType*>(m_Buffer);
+    char magic[8];
+    GetMagic(magic);
+    if (std::memcmp(header->Magic, magic, 8)!=0 || header->Version!=Version || header->FileSize!=m_Size)
+      return false;
+    if (sizeof(HeaderType)+header->NumberOfEntries*sizeof(EntryType)>m_Size)
+      return false;
+    const EntryType* entries = reinterpret_cast<const EntryType*>(m_Buffer+sizeof(HeaderType));
+    for ( int i = 0; i < header->NumberOfEntries; ++i )
+      {
+      const EntryType& entry = entries[i];
+      uint64_t size = 1;
+      for ( int d = 0; d < entry.Dimension; ++d )
+        size *= entry.Shape[d];
+      if (entry.Dimension==0 || entry.Dimension>MaxDimension || entry.Name[MaxNameLength-1]!='\0'
+        || entry.Offset%sizeof(double)!=0 || entry.Offset+size*sizeof(double)>m_Size)
+        return false;
+      m_Entries[std::string(entry.Name)] = &entry;
+      }
+    return true;
+    }
+
+  char* m_Buffer;
+  std::size_t m_Size;
+  std::map<std::string, const EntryType*> m_Entries;
+};
+
+
+/**
+ *   \class   StoredTableFileWriter
+ *   \brief   write tables into a file which can be read by StoredTableFile
+ *   \author  Jian Cheng
+ */
+class StoredTableFileWriter
+{
+public:
+  /** Add a table with the given shape. data is copied. */
+  void AddTable(const std::string& name, const double* data, const std::vector<unsigned>& shape)
+    {
+    utlSAGlobalException(name.size()>=StoredTableFile::MaxNameLength)(name).msg("name is too long");
+    utlSAGlobalException(shape.size()==0 || shape.size()>StoredTableFile::MaxDimension)(shape.size()).msg("wrong dimension");
+    std::size_t size = 1;
+    for ( int i = 0; i < shape.size(); ++i )
+      size *= shape[i];
+    m_Names.push_back(name);
+    m_Shapes.push_back(shape);
+    m_Data.push_back(std::vector<double>(data, data+size));
+    }
+
+  void Write(const std::string& file) const
+    {
+    StoredTableFile::HeaderType header;
+    std::memset(&header, 0, sizeof(header));
+    StoredTableFile::GetMagic(header.Magic);
+    header.Version = StoredTableFile::Version;
+    header.NumberOfEntries = m_Names.size();
+
+    std::vector<StoredTableFile::EntryType> entries(m_Names.size());
+    uint64_t offset = sizeof(header) + entries.size()*sizeof(StoredTableFile::EntryType);
+    offset = (offset+sizeof(double)-1)/sizeof(double)*sizeof(double);
+    const uint64_t dataStart = offset;
+    for ( int i = 0; i < m_Names.size(); ++i )
+      {
+      StoredTableFile::EntryType& entry = entries[i];
+      std::memset(&entry, 0, sizeof(entry));
+      std::strncpy(entry.Name, m_Names[i].c_str(), StoredTableFile::MaxNameLength-1);
+      entry.Dimension = m_Shapes[i].size();
+      for ( int d = 0; d < m_Shapes[i].size(); ++d )
+        entry.Shape[d] = m_Shapes[i][d];
+      entry.Offset = offset;
+      offset += m_Data[i].size()*sizeof(double);
+      }
+    header.FileSize = offset;
+
+    std::ofstream out(file.c_str(), std::ios::binary);
+    utlSAGlobalException(!out)(file).msg("cannot write the file");
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (entries.size()>0)
+      out.write(reinterpret_cast<const char*>(&entries[0]), entries.size()*sizeof(StoredTableFile::EntryType));
+    std::vector<char> padding(dataStart - sizeof(header) - entries.size()*sizeof(StoredTableFile::EntryType), 0);
+    if (padding.size()>0)
+      out.write(&padding[0], padding.size());
+    for ( int i = 0; i < m_Data.size(); ++i )
+      if (m_Data[i].size()>0)
+        out.write(reinterpret_cast<const char*>(&m_Data[i][0]), m_Data[i].size()*sizeof(double));
+    utlSAGlobalException(!out.good())(file).msg("failed to write the file");
+    }
+
+private:
+  std::vector<std::string> m_Names;
+  std::vector<std::vector<unsigned> > m_Shapes;
+  std::vector<std::vector<double> > m_Data;
+};
+
+}
+
+#endif
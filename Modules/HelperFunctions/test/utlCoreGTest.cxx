@@ -233,3 +233,33 @@ TEST(utlCore, InstanceOf)
     EXPECT_EQ(utl::IsInstanceOf<int >(intNum), true);
     }
 }
+
+TEST(utlCore, RandomCounterBased)
+{
+  // the same (seed, stream, counter) gives the same value
+  EXPECT_EQ(utl::RandomCounterBased(3, 100, 7), utl::RandomCounterBased(3, 100, 7));
+  EXPECT_NE(utl::RandomCounterBased(3, 100, 7), utl::RandomCounterBased(3, 101, 7));
+  EXPECT_NE(utl::RandomCounterBased(3, 100, 7), utl::RandomCounterBased(4, 100, 7));
+
+  const int N = 200000;
+  double mean=0, var=0;
+  for ( int i = 0; i < N; ++i )
+    {
+    double val = utl::GaussRandCounterBased(0.0, 2.0, 5, i/10, i%10);
+    mean += val;
+    var += val*val;
+    }
+  mean /= N;
+  var = var/N - mean*mean;
+  EXPECT_NEAR(0.0, mean, 0.03);
+  EXPECT_NEAR(4.0, var, 0.08);
+
+  std::vector<double> signal(30, 1.0);
+  std::vector<double> noisy1 = utl::AddNoiseCounterBased(signal, signal.size(), 0.1, true, 5, 1234);
+  std::vector<double> noisy2 = utl::AddNoiseCounterBased(signal, signal.size(), 0.1, true, 5, 1234);
+  for ( int i = 0; i < signal.size(); ++i )
+    {
+    EXPECT_EQ(noisy1[i], noisy2[i]);
+    EXPECT_GT(noisy1[i], 0.0);
+    }
+}
@@ -41,3 +41,46 @@ TEST(utlDMRIStoredTables_DeathTest, ReadGrad)
 {
   EXPECT_DEATH(utl::ReadGrad<double>(8), "");
 }
+
+TEST(utlDMRIStoredTables, StoredTableFile)
+{
+  utl::NDArray<double,2> mat(5,3);
+  for ( int i = 0; i < mat.Size(); ++i ) 
+    mat.GetData()[i] = 0.5*i-1;
+  std::vector<double> vec(7, 2.0);
+
+  utl::StoredTableFileWriter writer;
+  std::vector<unsigned> shape(2);
+  shape[0]=5, shape[1]=3;
+  writer.AddTable("Mat", mat.GetData(), shape);
+  shape.resize(1);
+  shape[0]=7;
+  writer.AddTable("Vec", &vec[0], shape);
+  std::string file = ::testing::TempDir() + "utlDMRIGTest_storedtables.bin";
+  writer.Write(file);
+
+  {
+  utl::StoredTableFile::Pointer store = utl::StoredTableFile::Open(file);
+  ASSERT_TRUE(store.get()!=NULL);
+  EXPECT_TRUE(store->HasTable("Mat"));
+  EXPECT_FALSE(store->HasTable("NoTable"));
+  EXPECT_TRUE(store->GetTable("NoTable", shape)==NULL);
+
+  const double* data = store->GetTable("Mat", shape);
+  ASSERT_EQ(shape.size(), 2);
+  EXPECT_EQ(shape[0], 5);
+  EXPECT_EQ(shape[1], 3);
+  EXPECT_EQ((std::size_t)data%sizeof(double), 0);
+  for ( int i = 0; i < mat.Size(); ++i ) 
+    EXPECT_EQ(data[i], mat.GetData()[i]);
+
+  data = store->GetTable("Vec", shape);
+  ASSERT_EQ(shape.size(), 1);
+  EXPECT_EQ(shape[0], 7);
+  for ( int i = 0; i < vec.size(); ++i ) 
+    EXPECT_EQ(data[i], vec[i]);
+  }
+  std::remove(file.c_str());
+
+  EXPECT_TRUE(utl::StoredTableFile::Open(file).get()==NULL);
+}
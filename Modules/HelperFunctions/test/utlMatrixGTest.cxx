@@ -489,6 +489,34 @@ TEST(utlMatrix, Norms)
     }
 }
 
+TEST(utlMatrix, ConvertPrecision)
+{
+  int Rows=20, Cols=10;
+  utl_shared_ptr<UtlMatrixType> mat0Utl(new UtlMatrixType(__GenerateUtlMatrix<double>(Rows, Cols, -2.0, 2.0)));
+
+  // the same pointer without copy
+  utl_shared_ptr<UtlMatrixType> matSame = utl::ConvertNDArrayPointer<double>(mat0Utl);
+  EXPECT_TRUE(matSame==mat0Utl);
+
+  typedef utl::NDArray<float,2> UtlMatrixFloatType;
+  typedef utl::NDArray<float,1> UtlVectorFloatType;
+  utl_shared_ptr<UtlMatrixFloatType> matFloat = utl::ConvertNDArrayPointer<float>(mat0Utl);
+  EXPECT_EQ(Rows, matFloat->Rows());
+  EXPECT_EQ(Cols, matFloat->Columns());
+  for ( int i = 0; i < Rows*Cols; ++i ) 
+    EXPECT_NEAR((*mat0Utl)[i], (*matFloat)[i], 1e-6);
+  EXPECT_FALSE(utl::ConvertNDArrayPointer<float>(utl_shared_ptr<UtlMatrixType>()));
+
+  // products in single precision use float blas
+  UtlVectorType v0 = __GenerateUtlVector<double>(Cols, -1.0, 1.0), r0;
+  UtlVectorFloatType vFloat, rFloat;
+  vFloat = v0;
+  utl::ProductUtlMv(*mat0Utl, v0, r0);
+  utl::ProductUtlMv(*matFloat, vFloat, rFloat);
+  for ( int i = 0; i < Rows; ++i ) 
+    EXPECT_NEAR(r0[i], rFloat[i], 1e-4*(1+std::fabs(r0[i])));
+}
+
 TEST(utlMatrix, Det_Inv_smallMatrix)
 {
   int N=4;
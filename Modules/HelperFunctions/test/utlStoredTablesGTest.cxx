@@ -0,0 +1,142 @@
+/**
+ *       @file  utlStoredTablesGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "utl.h"
+#include "utlDMRIStoredTables.h"
+#include "itkSphericalHarmonicsGenerator.h"
+
+namespace
+{
+
+/** Tables in the temporary stored table file. They are different from the text tables,
+ * thus tests know whether the store is used.  */
+struct TemporaryStoredTables
+  {
+  std::string FileName;
+  std::vector<double> Directions;
+  std::vector<double> SHMatrix;
+  std::vector<double> SH3Integral;
+
+  /** Write the file, and use it via DMRITOOL_STORED_TABLES.
+   * It is done in static initialization, before StoredTableFile::GetInstance() is called in tests.  */
+  TemporaryStoredTables()
+    {
+    FileName = ::testing::TempDir() + "utlStoredTablesGTest_storedtables.bin";
+    utl::StoredTableFileWriter writer;
+    std::vector<unsigned> shape(2);
+
+    // 4 directions, instead of 321 directions in the text table
+    double directions[12] = {1,0,0, 0,1,0, 0,0,1, 0.6,0.8,0};
+    Directions.assign(directions, directions+12);
+    shape[0]=4, shape[1]=3;
+    writer.AddTable("DirectionsT3", &Directions[0], shape);
+
+    // SH matrix with 4 rows and 28 columns (rank 6)
+    SHMatrix.resize(4*28);
+    for ( int i = 0; i < SHMatrix.size(); ++i )
+      SHMatrix[i] = 0.01*i;
+    shape[0]=4, shape[1]=28;
+    writer.AddTable("SHMatrixT3", &SHMatrix[0], shape);
+
+    // SH triple integrals with rank 2 in all dimensions
+    SH3Integral.resize(6*6*6);
+    for ( int i = 0; i < SH3Integral.size(); ++i )
+      SH3Integral[i] = 0.001*i-0.1;
+    shape.resize(3);
+    shape[0]=6, shape[1]=6, shape[2]=6;
+    writer.AddTable("SH3Integral", &SH3Integral[0], shape);
+
+    writer.Write(FileName);
+    setenv("DMRITOOL_STORED_TABLES", FileName.c_str(), 1);
+    }
+
+  ~TemporaryStoredTables()
+    {
+    std::remove(FileName.c_str());
+    }
+  };
+
+TemporaryStoredTables storedTables;
+}
+
+TEST(utlStoredTables, StoredTableFileInstance)
+{
+  EXPECT_EQ(storedTables.FileName, utl::StoredTableFile::GetDefaultFileName());
+  const utl::StoredTableFile::Pointer& store = utl::StoredTableFile::GetInstance();
+  ASSERT_TRUE(store.get()!=NULL);
+  EXPECT_TRUE(store->HasTable("DirectionsT3"));
+  EXPECT_TRUE(store->HasTable("SHMatrixT3"));
+  EXPECT_TRUE(store->HasTable("SH3Integral"));
+}
+
+TEST(utlStoredTables, GradientTable)
+{
+  utl::GradientTable<double>::Initialize(3);
+  utl_shared_ptr<utl::NDArray<double,2> > grad = utl::GradientTable<double>::GetGrad(3, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+  ASSERT_EQ(4, grad->Rows());
+  ASSERT_EQ(3, grad->Columns());
+  for ( int i = 0; i < 4; ++i )
+    for ( int j = 0; j < 3; ++j )
+      EXPECT_EQ(storedTables.Directions[3*i+j], (*grad)(i,j));
+
+  // GetGrad returns a copy, the memory-mapped table is not changed
+  (*grad)(0,0) = 2.0;
+  grad = utl::GradientTable<double>::GetGrad(3, DIRECTION_DUPLICATE, CARTESIAN_TO_CARTESIAN);
+  ASSERT_EQ(8, grad->Rows());
+  EXPECT_EQ(1.0, (*grad)(0,0));
+  EXPECT_EQ(-1.0, (*grad)(1,0));
+  EXPECT_EQ(-0.8, (*grad)(7,1));
+}
+
+TEST(utlStoredTables, SHMatrix)
+{
+  utl_shared_ptr<utl::NDArray<double,2> > shMatrix = utl::ReadSHMatrix(3, 4);
+  ASSERT_EQ(4, shMatrix->Rows());
+  ASSERT_EQ(15, shMatrix->Columns());
+  for ( int i = 0; i < 4; ++i )
+    for ( int j = 0; j < 15; ++j )
+      EXPECT_EQ(storedTables.SHMatrix[28*i+j], (*shMatrix)(i,j));
+}
+
+TEST(utlStoredTables, SH3Integral)
+{
+  // the table is shared with the memory-mapped table without copy
+  utl::SH3IntegralTable->Clear();
+  utl::InitializeSHTripleIntegrationTable(2,2,2);
+  EXPECT_TRUE(utl::SH3IntegralTable->GetIsShared());
+  const unsigned* shape = utl::SH3IntegralTable->GetShape();
+  EXPECT_EQ(6, shape[0]);
+  EXPECT_EQ(6, shape[1]);
+  EXPECT_EQ(6, shape[2]);
+  unsigned index[3];
+  for ( int i = 0; i < 6; ++i )
+    for ( int j = 0; j < 6; ++j )
+      for ( int k = 0; k < 6; ++k )
+        {
+        index[0]=i, index[1]=j, index[2]=k;
+        EXPECT_EQ(storedTables.SH3Integral[(i*6+j)*6+k], (*utl::SH3IntegralTable)(index));
+        }
+
+  // a smaller table uses the stored table
+  utl::SH3IntegralTable->Clear();
+  utl::InitializeSHTripleIntegrationTable(0,2,2);
+  EXPECT_TRUE(utl::SH3IntegralTable->GetIsShared());
+  EXPECT_EQ(6, utl::SH3IntegralTable->GetShape()[0]);
+  utl::SH3IntegralTable->Clear();
+}
@@ -0,0 +1,168 @@
+/**
+ *       @file  itkConcurrentFunctorHashTable.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkConcurrentFunctorHashTable_h
+#define __itkConcurrentFunctorHashTable_h
+
+#include "itkFunctorTableBase.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+#include "utlSTDHeaders.h"
+
+namespace itk
+{
+
+/**
+ *   \class   ConcurrentFunctorHashTable
+ *   \brief   thread-safe FunctorHashTable to memoize expensive functions in multiple threads.
+ *
+ *   The table is split into m_NumberOfShards shards. Each shard has a hash table and a lock.
+ *   A parameter is always in the same shard, thus threads only wait for each other when they access the same shard.
+ *   The functor is evaluated outside of the lock, and the value of a missed parameter is shared by all threads (and clones) after it is inserted.
+ *   The functor should be thread-safe.
+ *
+ *   \ingroup Math
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ */
+template < class TFunctor, class TParameters, class TFunctorValue = double, class THash=utl_hash<TParameters> >
+class ITK_EXPORT ConcurrentFunctorHashTable
+  : public FunctorTableBase<TFunctor, TParameters, TFunctorValue>
+{
+public:
+  /** Standard class typedefs. */
+  typedef ConcurrentFunctorHashTable         Self;
+  typedef FunctorTableBase<TFunctor, TParameters, TFunctorValue>  Superclass;
+  typedef SmartPointer<Self>                            Pointer;
+  typedef SmartPointer<const Self>                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods) */
+  itkTypeMacro( ConcurrentFunctorHashTable, FunctorTableBase );
+
+  typedef typename Superclass::ParametersType        ParametersType;
+  typedef typename Superclass::FunctorType           FunctorType;
+  typedef typename Superclass::FunctorValueType      FunctorValueType;
+
+  typedef THash                                                       HashType;
+  typedef utl_unordered_map<ParametersType,FunctorValueType, HashType >         HashTableType;
+
+  struct ShardType
+    {
+    HashTableType Hash;
+    SimpleFastMutexLock Mutex;
+    };
+  typedef std::vector<utl_shared_ptr<ShardType> >                     ShardContainerType;
+  typedef utl_shared_ptr<ShardContainerType>                          ShardContainerPointer;
+
+  /** Set the number of shards. It clears the table, so it should be called before the table is used by threads.  */
+  void SetNumberOfShards(const int num)
+    {
+    utlGlobalException(num<=0, "the number of shards should be positive");
+    m_Shards = ShardContainerPointer(new ShardContainerType(num));
+    for ( int i = 0; i < num; ++i )
+      (*m_Shards)[i] = utl_shared_ptr<ShardType>(new ShardType());
+    this->Modified();
+    }
+  int GetNumberOfShards() const
+    {
+    return m_Shards->size();
+    }
+
+  unsigned long GetTableSize() const
+    {
+    unsigned long size=0;
+    for ( int i = 0; i < m_Shards->size(); ++i )
+      {
+      MutexLockHolder<SimpleFastMutexLock> holder((*m_Shards)[i]->Mutex);
+      size += (*m_Shards)[i]->Hash.size();
+      }
+    return size;
+    }
+
+  bool IsTableBuilt() const
+    {
+    return GetTableSize()>0;
+    }
+
+  /** thread-safe  */
+  FunctorValueType GetFunctionValue ( const ParametersType& param)
+    {
+    ShardType& shard = GetShard(param);
+      {
+      MutexLockHolder<SimpleFastMutexLock> holder(shard.Mutex);
+      typename HashTableType::const_iterator iter = shard.Hash.find(param);
+      if (iter!=shard.Hash.end())
+        return iter->second;
+      }
+
+    // evaluate the functor without the lock. If another thread inserted the same parameter meanwhile, its value is kept.
+    FunctorValueType val = this->m_Functor(param);
+    MutexLockHolder<SimpleFastMutexLock> holder(shard.Mutex);
+    return shard.Hash.insert(std::pair<ParametersType, FunctorValueType> (param, val)).first->second;
+    }
+
+protected:
+  ConcurrentFunctorHashTable() : Superclass()
+    {
+    SetNumberOfShards(64);
+    }
+  virtual ~ConcurrentFunctorHashTable() {};
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE
+    {
+    Superclass::PrintSelf(os, indent);
+    PrintVar2(true, GetNumberOfShards(), GetTableSize(), os<<indent);
+    }
+
+  typename LightObject::Pointer InternalClone() const ITK_OVERRIDE
+    {
+    typename LightObject::Pointer loPtr = Superclass::InternalClone();
+    typename Self::Pointer rval = dynamic_cast<Self *>(loPtr.GetPointer());
+    if(rval.IsNull())
+      {
+      itkExceptionMacro(<< "downcast to type " << this->GetNameOfClass()<< " failed.");
+      }
+    rval->m_Shards = m_Shards;
+    return loPtr;
+    }
+
+  ShardType& GetShard(const ParametersType& param) const
+    {
+    std::size_t h = m_Hasher(param);
+    // mix bits, because the same hash value is used for buckets inside the shard
+    h ^= h >> 17;
+    h *= 0x9E3779B1u;
+    h ^= h >> 13;
+    return *(*m_Shards)[h % m_Shards->size()];
+    }
+
+  HashType m_Hasher;
+
+  /** shards are shared by clones  */
+  ShardContainerPointer m_Shards;
+
+private:
+  ConcurrentFunctorHashTable(const Self&);  //purposely not implemented
+  void operator=(const Self&);  //purposely not implemented
+};
+
+}
+
+#endif
+
@@ -18,6 +18,7 @@
 #ifndef __itkFunctorHashTable_h
 #define __itkFunctorHashTable_h
 
+#include <atomic>
 #include "itkFunctorTableBase.h"
 #include "utlSTDHeaders.h"
 
@@ -28,6 +29,12 @@ namespace itk
  *   \class   FunctorHashTable
  *   \brief   use FunctorHashTable to accelerate evaluation of functions.
  *
+ *   By default, a missed parameter is inserted into the table in GetFunctionValue(), which is not thread-safe.
+ *   For multiple threads, build the table using BuildTable(params) in one thread, then call Freeze(). 
+ *   After that the table is immutable and shared by clones, GetFunctionValue() is thread-safe without locks, 
+ *   and missed parameters are evaluated by the functor but not inserted.
+ *   Use ConcurrentFunctorHashTable if missed parameters need to be shared by threads.
+ *
  *   \ingroup Math
  *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
  */
@@ -74,8 +81,36 @@ public:
     return m_Hash->size()>0;
     }
 
+  /** Insert values of the given parameters. It should be called before Freeze().  */
+  void BuildTable(const std::vector<ParametersType>& params)
+    {
+    utlGlobalException(IsFrozen(), "the table is frozen");
+    for ( int i = 0; i < params.size(); ++i ) 
+      {
+      if (m_Hash->find(params[i])==m_Hash->end())
+        m_Hash->insert(std::pair<ParametersType, FunctorValueType> (params[i], m_Functor(params[i])));
+      }
+    }
+
+  /** Make the table immutable, and publish it to all threads.  */
+  void Freeze()
+    {
+    m_IsFrozen.store(true, std::memory_order_release);
+    }
+
+  bool IsFrozen() const
+    {
+    return m_IsFrozen.load(std::memory_order_acquire);
+    }
+
   FunctorValueType GetFunctionValue ( const ParametersType& param)
     {
+    if (IsFrozen())
+      {
+      typename HashTableType::const_iterator iterConst = m_Hash->find(param);
+      return iterConst!=m_Hash->end() ? iterConst->second : m_Functor(param);
+      }
+
     HashTableIterator iter = m_Hash->find(param);
     if ( iter!= m_Hash->end() ) 
       {
@@ -96,7 +131,8 @@ public:
   
 protected:
   FunctorHashTable() : Superclass(), 
-    m_Hash(new HashTableType())
+    m_Hash(new HashTableType()), 
+    m_IsFrozen(false)
     {
     }
   virtual ~FunctorHashTable() {};
@@ -104,6 +140,7 @@ protected:
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE
     {
     Superclass::PrintSelf(os, indent);
+    PrintVar2(true, GetTableSize(), IsFrozen(), os<<indent);
     }
   
   typename LightObject::Pointer InternalClone() const ITK_OVERRIDE
@@ -115,6 +152,7 @@ protected:
       itkExceptionMacro(<< "downcast to type " << this->GetNameOfClass()<< " failed.");
       }
     rval->m_Hash = m_Hash;
+    rval->m_IsFrozen.store(IsFrozen(), std::memory_order_release);
     return loPtr;
     }
   
@@ -122,6 +160,9 @@ protected:
 
   HashTablePointer m_Hash;
 
+  /** If it is true, m_Hash is immutable.  */
+  std::atomic<bool> m_IsFrozen;
+
   
 private:
   FunctorHashTable(const Self&);  //purposely not implemented
@@ -0,0 +1,218 @@
+/**
+ *       @file  itkSHBasisEvaluator.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkSHBasisEvaluator_h
+#define __itkSHBasisEvaluator_h
+
+#include <cmath>
+#include "utlCore.h"
+
+namespace utl
+{
+/** @addtogroup utlMath
+@{ */
+
+/**
+ *   \class   SHBasisEvaluator
+ *   \brief   Evaluate all real SH basis functions up to the even rank VRank for a direction in one pass.
+ *
+ *   The basis is the same as itk::SphericalHarmonicsGenerator::RealSH(),
+ *   and the order of the output is the same as utl::ComputeSHMatrix(), i.e. l=0,2,...,VRank, m=-l,...,l.
+ *
+ *   Normalized associated Legendre functions \f$ \bar{P}_l^m(\cos\theta) \f$ (with Condon-Shortley phase)
+ *   are computed by the three-term recurrence in l for each m,
+ *   and \f$ \cos(m\phi), \sin(m\phi) \f$ are computed by the angle addition recurrence in m.
+ *   There is no trigonometric function for Cartesian inputs, and no factorial for any input.
+ *   All loops are bounded by VRank, and coefficients of the recurrence are computed once per VRank.
+ *
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *   \ingroup Math
+ */
+template <class T, int VRank>
+class SHBasisEvaluator
+{
+public:
+  enum { Rank=VRank, Dimension=(VRank+1)*(VRank+2)/2 };
+
+  /** evaluate the basis from cos(theta), sin(theta), cos(phi), sin(phi). sh has Dimension elements.  */
+  static void EvaluateFromCosSin(const T cosTheta, const T sinTheta, const T cosPhi, const T sinPhi, T* sh)
+    {
+    const CoefficientsType& coef = GetCoefficients();
+    // cos(m*phi), sin(m*phi)
+    T cosm=1, sinm=0, tmp;
+    T pmm = coef.P00;
+    for ( int m = 0; m <= VRank; m += 1 )
+      {
+      if (m>0)
+        {
+        pmm *= coef.Pmm[m]*sinTheta;
+        tmp = cosm*cosPhi - sinm*sinPhi;
+        sinm = sinm*cosPhi + cosm*sinPhi;
+        cosm = tmp;
+        }
+      T p2=0, p1=pmm, p=pmm;
+      for ( int l = m; l <= VRank; l += 1 )
+        {
+        if (l==m+1)
+          p = coef.Pm1m[m]*cosTheta*pmm;
+        else if (l>m+1)
+          p = coef.A[l*(VRank+1)+m]*(cosTheta*p1 - coef.B[l*(VRank+1)+m]*p2);
+        if (l>m)
+          {
+          p2 = p1;
+          p1 = p;
+          }
+
+        if (l%2==0)
+          {
+          const int j = l*(l+1)/2;
+          if (m==0)
+            sh[j] = p;
+          else
+            {
+            sh[j+m] = (T)utl::SQRT2*p*sinm;
+            sh[j-m] = (T)utl::SQRT2*p*cosm;
+            }
+          }
+        }
+      }
+    }
+
+  /** evaluate the basis at (theta, phi) in spherical coordinate */
+  static void Evaluate(const T theta, const T phi, T* sh)
+    {
+    EvaluateFromCosSin(std::cos(theta), std::sin(theta), std::cos(phi), std::sin(phi), sh);
+    }
+
+  /** evaluate the basis at the direction of (x,y,z). (x,y,z) does not need to be normalized.
+   * The north pole is used if the norm is zero, which is the same as utl::cartesian2Spherical.  */
+  static void EvaluateCartesian(const T x, const T y, const T z, T* sh)
+    {
+    T rho2 = x*x+y*y;
+    T r = std::sqrt(rho2+z*z);
+    if (r<M_EPS)
+      {
+      EvaluateFromCosSin(1,0,1,0,sh);
+      return;
+      }
+    T rho = std::sqrt(rho2);
+    if (rho>0)
+      EvaluateFromCosSin(z/r, rho/r, x/rho, y/rho, sh);
+    else
+      EvaluateFromCosSin(z/r, 0, 1, 0, sh);
+    }
+
+  /** evaluate the basis for n directions in SoA layout (theta[i], phi[i]).
+   * The basis of the i-th direction is stored in sh+i*ldsh.  */
+  static void EvaluateBatch(const int n, const T* theta, const T* phi, T* sh, const int ldsh=Dimension)
+    {
+    for ( int i = 0; i < n; i += 1 )
+      Evaluate(theta[i], phi[i], sh+i*ldsh);
+    }
+
+  /** evaluate the basis for n directions in SoA layout (x[i], y[i], z[i]).
+   * The basis of the i-th direction is stored in sh+i*ldsh.  */
+  static void EvaluateBatchCartesian(const int n, const T* x, const T* y, const T* z, T* sh, const int ldsh=Dimension)
+    {
+    for ( int i = 0; i < n; i += 1 )
+      EvaluateCartesian(x[i], y[i], z[i], sh+i*ldsh);
+    }
+
+private:
+  static_assert(VRank>=0 && VRank%2==0, "VRank should be a non-negative even number");
+
+  /** coefficients in the recurrence of normalized associated Legendre functions */
+  struct CoefficientsType
+    {
+    T P00;
+    /** \f$ \bar{P}_m^m = Pmm[m] \sin\theta \bar{P}_{m-1}^{m-1} \f$ */
+    T Pmm[VRank+1];
+    /** \f$ \bar{P}_{m+1}^m = Pm1m[m] \cos\theta \bar{P}_m^m \f$ */
+    T Pm1m[VRank+1];
+    /** \f$ \bar{P}_l^m = A(l,m) (\cos\theta \bar{P}_{l-1}^m - B(l,m) \bar{P}_{l-2}^m) \f$ */
+    T A[(VRank+1)*(VRank+1)];
+    T B[(VRank+1)*(VRank+1)];
+
+    CoefficientsType()
+      {
+      P00 = 1.0/std::sqrt(4.0*M_PI);
+      for ( int m = 0; m <= VRank; m += 1 )
+        {
+        Pmm[m] = m>0 ? -std::sqrt((2.0*m+1.0)/(2.0*m)) : 1.0;
+        Pm1m[m] = std::sqrt(2.0*m+3.0);
+        for ( int l = 0; l <= VRank; l += 1 )
+          {
+          A[l*(VRank+1)+m] = 0, B[l*(VRank+1)+m] = 0;
+          if (l>=m+2)
+            {
+            double l2=l*l, m2=m*m;
+            A[l*(VRank+1)+m] = std::sqrt((4.0*l2-1.0)/(l2-m2));
+            B[l*(VRank+1)+m] = std::sqrt(((l-1.0)*(l-1.0)-m2)/(4.0*(l-1.0)*(l-1.0)-1.0));
+            }
+          }
+        }
+      }
+    };
+
+  /** coefficients are computed once and shared by threads.  */
+  static const CoefficientsType& GetCoefficients()
+    {
+    static const CoefficientsType coef;
+    return coef;
+    }
+};
+
+#define __utl_EvaluateSHBasisBatch_case(rank)                                                        \
+  case rank:                                                                                         \
+    {                                                                                                \
+    if (isCartesian)                                                                                 \
+      SHBasisEvaluator<T,rank>::EvaluateBatchCartesian(n, x0, x1, x2, sh, ldsh);                     \
+    else                                                                                             \
+      SHBasisEvaluator<T,rank>::EvaluateBatch(n, x1, x2, sh, ldsh);                                  \
+    return true;                                                                                     \
+    }
+
+/** Evaluate real SH basis with a runtime rank using the specialized SHBasisEvaluator<T,rank>.
+ * Directions are in SoA layout. If isCartesian is true, x0, x1, x2 are x, y, z. Otherwise x1, x2 are theta, phi, and x0 is not used.
+ * Return false if there is no specialized evaluator for the rank, i.e. rank is odd or larger than 16.  */
+template <class T>
+inline bool
+EvaluateSHBasisBatch ( const int rank, const int n, const T* x0, const T* x1, const T* x2, const bool isCartesian, T* sh, const int ldsh )
+{
+  switch ( rank )
+    {
+    __utl_EvaluateSHBasisBatch_case(0)
+    __utl_EvaluateSHBasisBatch_case(2)
+    __utl_EvaluateSHBasisBatch_case(4)
+    __utl_EvaluateSHBasisBatch_case(6)
+    __utl_EvaluateSHBasisBatch_case(8)
+    __utl_EvaluateSHBasisBatch_case(10)
+    __utl_EvaluateSHBasisBatch_case(12)
+    __utl_EvaluateSHBasisBatch_case(14)
+    __utl_EvaluateSHBasisBatch_case(16)
+    default :
+      return false;
+    }
+}
+
+#undef __utl_EvaluateSHBasisBatch_case
+
+/** @} */
+
+}
+
+#endif
@@ -25,8 +25,11 @@ namespace itk
  *   \class   SHCoefficientsRotation
  *   \brief   rotate SH coefficient vector by a given rotation matrix.
  *
- *  Reference: "Efficient and accurate rotation of finite spherical harmonics expansions", 
- *  Journal of Computational Physics 231 (2012) 243–250 
+ *  Real Wigner-D matrices are computed from the rotation matrix by recurrence, and applied band by band. 
+ *  The old sample-and-refit method is in GetRotatedSHCoefficientsByRefitting(). 
+ *
+ *  Reference: "Rotation Matrices for Real Spherical Harmonics. Direct Determination by Recursion", 
+ *  J. Phys. Chem. 1996, 100, 6342-6347 
  *
  *   \ingroup Math
  *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
@@ -63,7 +66,7 @@ public:
     if (m_MaxRank/2>m_SHMatrixInverse->size())
       {
       m_Grad = utl::GradientTable<double>::GetGrad(m_TessOrder, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
-      MatrixPointer shMatrix = utl::ComputeSHMatrix(m_MaxRank, *m_Grad, CARTESIAN_TO_SPHERICAL);
+      MatrixPointer shMatrix = utl::ReadSHMatrix(m_TessOrder, m_MaxRank);
       m_SHMatrixInverse = utl_shared_ptr<std::vector<MatrixType> >(new std::vector<MatrixType>(m_MaxRank/2));
       for ( int l = 2; l <= m_MaxRank; l += 2 ) 
         {
@@ -76,18 +79,68 @@ public:
   
 /**
 * @brief GetRotatedSHCoefficient 
-*        rotate SH coefficient vector by a given rotation matrix
+*        rotate SH coefficient vector by a given rotation matrix using real Wigner-D matrices. 
+*        The rotated function is \f$ f'(\mathbf{u})=f(R^T\mathbf{u}) \f$. 
 *
 * @param shInput input SH coefficients
 * @param rotationMatrix rotation matrix
 * @author Jian Cheng
 *
-*  Reference: "Efficient and accurate rotation of finite spherical harmonics expansions", 
-*  Journal of Computational Physics 231 (2012) 243–250 
-*
+*  It does not need Initialize(). 
 *  use itk::SHCoefficientsRotation for multi-thread programming
 */
   VectorType GetRotatedSHCoefficients(const VectorType& shInput, const MatrixType& rotationMatrix) const
+    {
+    int rankReal = utl::DimToRankSH(shInput.Size());
+    std::vector<MatrixType> wigner;
+    ComputeWignerMatrices(rotationMatrix, rankReal, wigner);
+    VectorType shRotated(shInput.Size()); 
+    RotateSHCoefficientsWithWignerMatrices(wigner, shInput.GetData(), shRotated.GetData(), shInput.Size());
+    return shRotated;
+    }
+
+  /** Rotate n SH coefficient vectors with the same rotation. Wigner-D matrices are computed only once. 
+   * The i-th input vector is in shInput+i*dim, the i-th output vector is in shOutput+i*dim. shInput and shOutput should not overlap. */
+  void GetRotatedSHCoefficients(const MatrixType& rotationMatrix, const int n, const double* shInput, double* shOutput, const int dim) const
+    {
+    std::vector<MatrixType> wigner;
+    ComputeWignerMatrices(rotationMatrix, utl::DimToRankSH(dim), wigner);
+    if (n==1)
+      {
+      RotateSHCoefficientsWithWignerMatrices(wigner, shInput, shOutput, dim);
+      return;
+      }
+    // each band of all vectors is rotated by one matrix-matrix product
+    shOutput[0] = shInput[0];
+    for ( int i = 1; i < n; ++i ) 
+      shOutput[i*dim] = shInput[i*dim];
+    for ( int l = 2; l/2 < wigner.size(); l += 2 ) 
+      {
+      int colstart = utl::RankToDimSH(l-2);
+      utl::cblas_gemm<double>(CblasRowMajor, CblasNoTrans, CblasTrans, n, 2*l+1, 2*l+1, 1.0, shInput+colstart, dim, wigner[l/2].GetData(), 2*l+1, 0.0, shOutput+colstart, dim);
+      }
+    }
+
+  /** Rotate n SH coefficient vectors with different rotations, e.g. for reorientation with local rotations from registration. 
+   * The i-th rotation matrix is stored in row-major order in rotationMatrices+9*i. */
+  void GetRotatedSHCoefficients(const int n, const double* rotationMatrices, const double* shInput, double* shOutput, const int dim) const
+    {
+    int rank = utl::DimToRankSH(dim);
+    std::vector<MatrixType> wigner, workspace;
+    MatrixType rotationMatrix(3,3);
+    for ( int i = 0; i < n; ++i ) 
+      {
+      utl::cblas_copy<double>(9, rotationMatrices+9*i, 1, rotationMatrix.GetData(), 1);
+      ComputeWignerMatrices(rotationMatrix, rank, wigner, workspace);
+      RotateSHCoefficientsWithWignerMatrices(wigner, shInput+i*dim, shOutput+i*dim, dim);
+      }
+    }
+
+  /** The old sample-and-refit rotation. SH basis is sampled at rotated gradients, then fitted in each band. It needs Initialize(). 
+   *
+   *  Reference: "Efficient and accurate rotation of finite spherical harmonics expansions", 
+   *  Journal of Computational Physics 231 (2012) 243–250 */
+  VectorType GetRotatedSHCoefficientsByRefitting(const VectorType& shInput, const MatrixType& rotationMatrix) const
     {
     utlSAException(m_SHMatrixInverse->size()==0).msg("need to use Initialize() first");
     int rankReal = utl::DimToRankSH(shInput.Size());
@@ -108,6 +161,97 @@ public:
     return shRotated;
     }
 
+  /** Compute real Wigner-D matrices of even bands l=0,2,...,rank for the rotation matrix. 
+   * wigner[l/2] is a (2l+1)x(2l+1) matrix which rotates the coefficients in band l. 
+   * Bands are built from l=1 by the recurrence in 
+   * Ivanic and Ruedenberg, "Rotation Matrices for Real Spherical Harmonics. Direct Determination by Recursion", J. Phys. Chem. 1996 (and the 1998 erratum), 
+   * then converted to the SH basis in itk::SphericalHarmonicsGenerator::RealSH. 
+   * workspace stores all bands (including odd bands) used in the recurrence. */
+  static void ComputeWignerMatrices(const MatrixType& rotationMatrix, const int rank, std::vector<MatrixType>& wigner, std::vector<MatrixType>& workspace)
+    {
+    utlSAException(rotationMatrix.Rows()!=3 || rotationMatrix.Columns()!=3)(rotationMatrix.Rows())(rotationMatrix.Columns()).msg("wrong size of rotation matrix");
+    utlSAException(rank<0 || rank%2!=0)(rank).msg("rank should be a non-negative even number");
+    std::vector<MatrixType>& r = workspace;
+    r.resize(rank+1);
+    for ( int l = 0; l <= rank; ++l ) 
+      r[l].ReSize(2*l+1, 2*l+1);
+    r[0](0,0) = 1.0;
+
+    if (rank>0)
+      {
+      // band 1 in the order of (y, z, x)
+      const int index[3] = {1, 2, 0};
+      for ( int m = 0; m < 3; ++m ) 
+        for ( int n = 0; n < 3; ++n ) 
+          r[1](m,n) = rotationMatrix(index[m], index[n]);
+      }
+
+    for ( int l = 2; l <= rank; ++l ) 
+      {
+      for ( int m = -l; m <= l; ++m ) 
+        {
+        int d = m==0 ? 1 : 0, absm = std::abs(m);
+        for ( int n = -l; n <= l; ++n ) 
+          {
+          double denom = std::abs(n)==l ? (2.0*l)*(2.0*l-1.0) : (double)(l+n)*(l-n);
+          double u = std::sqrt((l+m)*(l-m)/denom);
+          double v = 0.5*std::sqrt((1.0+d)*(l+absm-1.0)*(l+absm)/denom)*(1.0-2.0*d);
+          double w = -0.5*std::sqrt((l-absm-1.0)*(l-absm)/denom)*(1.0-d);
+          double val = 0;
+          if (u!=0)
+            val += u*WignerP(r, 0, l, m, n);
+          if (v!=0)
+            {
+            if (m==0)
+              val += v*(WignerP(r,1,l,1,n) + WignerP(r,-1,l,-1,n));
+            else if (m>0)
+              val += v*(WignerP(r,1,l,m-1,n)*(m==1 ? utl::SQRT2 : 1.0) - (m==1 ? 0.0 : WignerP(r,-1,l,-m+1,n)));
+            else
+              val += v*((m==-1 ? 0.0 : WignerP(r,1,l,m+1,n)) + WignerP(r,-1,l,-m-1,n)*(m==-1 ? utl::SQRT2 : 1.0));
+            }
+          if (w!=0)
+            {
+            if (m>0)
+              val += w*(WignerP(r,1,l,m+1,n) + WignerP(r,-1,l,-m-1,n));
+            else
+              val += w*(WignerP(r,1,l,m-1,n) - WignerP(r,-1,l,-m+1,n));
+            }
+          r[l](m+l,n+l) = val;
+          }
+        }
+      }
+
+    // In RealSH, Y_l^m = (-1)^m Y_l^{-m} in Ivanic and Ruedenberg's basis 
+    wigner.resize(rank/2+1);
+    for ( int l = 0; l <= rank; l += 2 ) 
+      {
+      MatrixType& mat = wigner[l/2];
+      mat.ReSize(2*l+1, 2*l+1);
+      for ( int m = -l; m <= l; ++m ) 
+        for ( int n = -l; n <= l; ++n ) 
+          mat(m+l,n+l) = (utl::IsEven(m+n) ? 1.0 : -1.0) * r[l](l-m, l-n);
+      }
+    }
+
+  static void ComputeWignerMatrices(const MatrixType& rotationMatrix, const int rank, std::vector<MatrixType>& wigner)
+    {
+    std::vector<MatrixType> workspace;
+    ComputeWignerMatrices(rotationMatrix, rank, wigner, workspace);
+    }
+
+  /** Rotate SH coefficients in shInput with dim elements band by band. shInput and shOutput should not overlap.  */
+  static void RotateSHCoefficientsWithWignerMatrices(const std::vector<MatrixType>& wigner, const double* shInput, double* shOutput, const int dim)
+    {
+    int rank = utl::DimToRankSH(dim);
+    utlSAException(rank/2>=wigner.size())(rank)(wigner.size()).msg("need Wigner-D matrices with larger rank");
+    shOutput[0] = shInput[0];
+    for ( int l = 2; l <= rank; l += 2 ) 
+      {
+      int colstart = utl::RankToDimSH(l-2);
+      utl::cblas_gemv<double>(CblasRowMajor, CblasNoTrans, 2*l+1, 2*l+1, 1.0, wigner[l/2].GetData(), 2*l+1, shInput+colstart, 1, 0.0, shOutput+colstart, 1);
+      }
+    }
+
   static Pointer GetInstance()
     {
     if (!m_Instance)
@@ -164,6 +308,19 @@ protected:
   int m_TessOrder;
 
 private:
+  /** the auxiliary function P in the recurrence of Ivanic and Ruedenberg */
+  static double WignerP(const std::vector<MatrixType>& r, const int i, const int l, const int a, const int b)
+    {
+    const MatrixType& r1 = r[1];
+    const MatrixType& rl = r[l-1];
+    if (b==-l)
+      return r1(i+1,2)*rl(a+l-1,0) + r1(i+1,0)*rl(a+l-1,2*l-2);
+    else if (b==l)
+      return r1(i+1,2)*rl(a+l-1,2*l-2) - r1(i+1,0)*rl(a+l-1,0);
+    else
+      return r1(i+1,1)*rl(a+l-1,b+l-1);
+    }
+
   SHCoefficientsRotation(const Self&);  //purposely not implemented
   void operator=(const Self&);  //purposely not implemented
 
@@ -125,10 +125,28 @@ InitializeSHTripleIntegrationTable(const int rank0=-1, const int rank1=-1, const
   if (SH3IntegralTable->Size()>0 && dim[0]==shapeOld[0] && dim[1]==shapeOld[1] && dim[2]==shapeOld[2])
     return; 
 
+  // use the memory-mapped table without copy if it is large enough
+  if (!useExactSize)
+    {
+    const utl::StoredTableFile::Pointer& store = utl::StoredTableFile::GetInstance();
+    std::vector<unsigned> shapeStored;
+    const double* data = store ? store->GetTable("SH3Integral", shapeStored) : NULL;
+    if (data && shapeStored.size()==3 && dim[0]<=shapeStored[0] && dim[1]<=shapeStored[1] && dim[2]<=shapeStored[2])
+      {
+      unsigned shape[3] = {shapeStored[0], shapeStored[1], shapeStored[2]};
+      // the data is read-only
+      SH3IntegralTable->SetData(const_cast<double*>(data), shape);
+      return;
+      }
+    }
+
   typedef itk::Image<double,3> ImageType;
   static ImageType::Pointer image = ImageType::New();
   if (itk::IsImageEmpty(image))
+    {
+    utlGlobalException(!utl::IsFileExist(utl::SH3Itegralhdr), "no SH3Itegralhdr.");
     itk::ReadImage<ImageType>(utl::SH3Itegralhdr, image);
+    }
   ImageType::RegionType region = image->GetLargestPossibleRegion();
   ImageType::SizeType size = region.GetSize();
   ImageType::IndexType pixelIndex;
@@ -141,6 +159,10 @@ InitializeSHTripleIntegrationTable(const int rank0=-1, const int rank1=-1, const
     || useExactSize 
     || (!useExactSize && SH3IntegralTable->Size()>0 && (dim[0]>SH3IntegralTable->GetShape()[0] || dim[1]>SH3IntegralTable->GetShape()[1] || dim[2]>SH3IntegralTable->GetShape()[2])) )
     {
+    // the memory-mapped table is read-only. Detach it, so that ReSize allocates a private buffer,
+    // even if the size is the same (ReSize only calls ReShape in that case).
+    if (SH3IntegralTable->GetIsShared())
+      SH3IntegralTable->Clear();
     SH3IntegralTable->ReSize(shape);
 
     unsigned index[3];
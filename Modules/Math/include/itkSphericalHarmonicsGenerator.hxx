@@ -130,8 +130,9 @@ SphericalHarmonicsGenerator<PreciseType>
   // Sqrt[2]*Re[SphericalHarmonicY[l, Abs[m], \[Theta], \[Phi]]] = 1/Sqrt[2]*(SphericalHarmonicY[l,-m,Theta,Phi]+SphericalHarmonicY[l,m,Theta,Phi])
   if (is_precalculated)
     {
-    utlException(!utl::IsFileExist(utl::SH3Itegralhdr), "no SH3Itegralhdr.");
-    utl::InitializeSHTripleIntegrationTable();
+    // the table (and the file) is checked only once, not in every call
+    if (utl::SH3IntegralTable->Size()==0)
+      utl::InitializeSHTripleIntegrationTable();
     int rank = utl::DimToRankSH(utl::SH3IntegralTable->GetShape()[0]);
     if (l1<=rank && l2<=rank && l3<=rank)
       {
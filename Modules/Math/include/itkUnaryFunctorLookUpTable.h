@@ -18,7 +18,10 @@
 #ifndef __itkUnaryFunctorLookUpTable_h
 #define __itkUnaryFunctorLookUpTable_h
 
+#include <atomic>
 #include "itkFunctorTableBase.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
 
 namespace itk
 {
@@ -27,6 +30,11 @@ namespace itk
  *   \class   UnaryFunctorLookUpTable
  *   \brief   use UnaryFunctorLookUpTable to accelerate evaluation of functions.
  *
+ *   The table is immutable after it is built.
+ *   BuildTableOnce() builds the table only once even if it is called by many threads, and publishes it to all threads.
+ *   After that, GetFunctionValue() can be called by many threads without locks.
+ *   BuildTable() rebuilds the table, and it should not be called when other threads are reading the table.
+ *
  *   \ingroup Math
  *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
  */
@@ -74,12 +82,26 @@ public:
     {
     utlGlobalException(m_NumberOfBins<=0, "need to compute m_NumberOfBins first");
     utlGlobalException(m_VariableMax<=m_VariableMin, "m_VariableMax should be larger than m_VariableMin");
-    m_Table = STDVectorPointer(new STDVectorType(m_NumberOfBins+1));
+    m_IsTableReady.store(false, std::memory_order_relaxed);
+    STDVectorPointer table(new STDVectorType(m_NumberOfBins+1));
     m_Delta = (m_VariableMax-m_VariableMin)/(double)m_NumberOfBins;
     m_DeltaInv = 1.0/m_Delta;
 
     for (int i=0; i<= m_NumberOfBins; i++)   
-      (*m_Table)[i] = this->m_Functor( m_Delta*i + m_VariableMin );
+      (*table)[i] = this->m_Functor( m_Delta*i + m_VariableMin );
+    m_Table = table;
+    // publish the table to threads which see m_IsTableReady==true
+    m_IsTableReady.store(true, std::memory_order_release);
+    }
+
+  /** Build the table if it is not built. It is thread-safe, and the table is built only once.  */
+  void BuildTableOnce()
+    {
+    if (m_IsTableReady.load(std::memory_order_acquire))
+      return;
+    MutexLockHolder<SimpleFastMutexLock> holder(m_BuildMutex);
+    if (!m_IsTableReady.load(std::memory_order_relaxed))
+      BuildTable();
     }
 
   unsigned long GetTableSize() const
@@ -89,25 +111,28 @@ public:
 
   bool IsTableBuilt() const 
     {
-    return m_NumberOfBins>0 && m_Table->size()==m_NumberOfBins+1;
+    return m_IsTableReady.load(std::memory_order_acquire) && m_NumberOfBins>0 && m_Table->size()==m_NumberOfBins+1;
     }
 
-  FunctorValueType GetFunctionValue ( const ParametersType& var)
+  /** read-only and lock-free after the table is built  */
+  FunctorValueType GetFunctionValue ( const ParametersType& var) const
     {
-    utlGlobalException(m_Table->size()==0, "need to compute m_Table first");
+    utlGlobalException(!m_IsTableReady.load(std::memory_order_acquire), "need to compute m_Table first");
+    const double* table = &(*m_Table)[0];
     if (var<=m_VariableMin)
-      return (*m_Table)[0];
+      return table[0];
     if (var>=m_VariableMax)
-      return m_Table->back();
+      return table[m_NumberOfBins];
 
     double xDouble = (var-m_VariableMin)*m_DeltaInv;
     int x = (int) std::floor(xDouble);
-    return (*m_Table)[x] + ((*m_Table)[x+1]-(*m_Table)[x])*(xDouble-x);
+    return table[x] + (table[x+1]-table[x])*(xDouble-x);
     }
 
 protected:
   UnaryFunctorLookUpTable() : Superclass(), 
-    m_Table(new STDVectorType())
+    m_Table(new STDVectorType()), 
+    m_IsTableReady(false)
     {
     m_VariableMax = 0;
     m_VariableMin = 0;
@@ -121,7 +146,8 @@ protected:
     {
     Superclass::PrintSelf(os, indent);
     PrintVar4(true, m_VariableMax, m_VariableMin, m_NumberOfBins, m_Delta, os<<indent);
-    for (int i=0; i<= m_NumberOfBins; i++)   
+    PrintVar1(true, IsTableBuilt(), os<<indent);
+    for (int i=0; i< m_Table->size(); i++)   
       utlPrintVar3(true, i, m_Delta*i+m_VariableMin, (*m_Table)[i]);
     }
   
@@ -140,6 +166,7 @@ protected:
     rval->m_NumberOfBins = m_NumberOfBins;
 
     rval->m_Table = m_Table;
+    rval->m_IsTableReady.store(m_IsTableReady.load(std::memory_order_acquire), std::memory_order_release);
     return loPtr;
     }
 
@@ -153,6 +180,12 @@ protected:
 
   /** the size of m_Table is m_NumberOfBins+1  */
   STDVectorPointer m_Table;
+
+  /** true after m_Table is built and published  */
+  std::atomic<bool> m_IsTableReady;
+
+  /** used only in BuildTableOnce()  */
+  SimpleFastMutexLock m_BuildMutex;
   
 
 private:
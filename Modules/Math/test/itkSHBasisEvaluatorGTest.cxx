@@ -0,0 +1,106 @@
+/**
+ *       @file  itkSHBasisEvaluatorGTest.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "gtest/gtest.h"
+#include "itkSHBasisEvaluator.h"
+#include "itkSphericalHarmonicsGenerator.h"
+#include "utl.h"
+
+typedef itk::SphericalHarmonicsGenerator<double> SHGenerator;
+
+TEST(itkSHBasisEvaluator, Evaluate)
+{
+  const int rank = 12;
+  typedef utl::SHBasisEvaluator<double, rank> EvaluatorType;
+  std::vector<double> sh(EvaluatorType::Dimension);
+
+  EvaluatorType::Evaluate(0.530274, 0.539671, &sh[0]);
+  EXPECT_NEAR(-0.2449497706682552, sh[utl::GetIndexSHj(2,1)], 1e-8);
+  EvaluatorType::Evaluate(M_PI/3.0, M_PI/5.0, &sh[0]);
+  EXPECT_NEAR(-0.546730845142995, sh[utl::GetIndexSHj(4,3)], 1e-8);
+
+  for ( int i = 0; i < 20; ++i ) 
+    {
+    double theta = utl::Random<double>(0,M_PI), phi=utl::Random<double>(-M_PI, M_PI);
+    EvaluatorType::Evaluate(theta, phi, &sh[0]);
+    for ( int l = 0; l <= rank; l += 2 ) 
+      for ( int m = -l; m <= l; m += 1 ) 
+        EXPECT_NEAR(SHGenerator::RealSH(l,m,theta,phi), sh[utl::GetIndexSHj(l,m)], 1e-8);
+    }
+}
+
+TEST(itkSHBasisEvaluator, EvaluateCartesian)
+{
+  typedef utl::SHBasisEvaluator<double, 8> EvaluatorType;
+  std::vector<double> sh(EvaluatorType::Dimension), sh2(EvaluatorType::Dimension);
+
+  for ( int i = 0; i < 20; ++i ) 
+    {
+    double theta = utl::Random<double>(0,M_PI), phi=utl::Random<double>(-M_PI, M_PI), x, y, z;
+    utl::spherical2Cartesian(2.0, theta, phi, x, y, z);
+    EvaluatorType::Evaluate(theta, phi, &sh[0]);
+    EvaluatorType::EvaluateCartesian(x, y, z, &sh2[0]);
+    for ( int j = 0; j < EvaluatorType::Dimension; ++j ) 
+      EXPECT_NEAR(sh[j], sh2[j], 1e-10);
+    }
+
+  // poles
+  EvaluatorType::Evaluate(0, 0, &sh[0]);
+  EvaluatorType::EvaluateCartesian(0, 0, 1, &sh2[0]);
+  for ( int j = 0; j < EvaluatorType::Dimension; ++j ) 
+    EXPECT_NEAR(sh[j], sh2[j], 1e-10);
+  EvaluatorType::Evaluate(M_PI, 0, &sh[0]);
+  EvaluatorType::EvaluateCartesian(0, 0, -3, &sh2[0]);
+  for ( int j = 0; j < EvaluatorType::Dimension; ++j ) 
+    EXPECT_NEAR(sh[j], sh2[j], 1e-10);
+}
+
+TEST(itkSHBasisEvaluator, ComputeSHMatrix)
+{
+  typedef utl::NDArray<double,2> MatrixType;
+  utl_shared_ptr<MatrixType> grad = utl::ReadGrad<double>(4, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN);
+  MatrixType gradSpherical = utl::CartesianToSpherical(*grad);
+  for ( int rank = 0; rank <= 10; rank += 2 ) 
+    {
+    utl_shared_ptr<MatrixType> shMatrix = utl::ComputeSHMatrix(rank, *grad, CARTESIAN_TO_SPHERICAL);
+    utl_shared_ptr<MatrixType> shMatrixSpherical = utl::ComputeSHMatrix(rank, gradSpherical, SPHERICAL_TO_SPHERICAL);
+    EXPECT_EQ(utl::RankToDimSH(rank), shMatrix->Columns());
+    for ( int i = 0; i < shMatrix->Rows(); ++i ) 
+      {
+      int j = 0;
+      for ( int l = 0; l <= rank; l += 2 ) 
+        for ( int m = -l; m <= l; m += 1, ++j ) 
+          {
+          double val = SHGenerator::RealSH(l,m,gradSpherical(i,1),gradSpherical(i,2));
+          EXPECT_NEAR(val, (*shMatrix)(i,j), 1e-8);
+          EXPECT_NEAR(val, (*shMatrixSpherical)(i,j), 1e-8);
+          }
+      }
+    }
+
+  // batch with a leading dimension and in float
+  typedef utl::SHBasisEvaluator<float, 4> FloatEvaluatorType;
+  const int n = grad->Rows(), ld = FloatEvaluatorType::Dimension+2;
+  std::vector<float> x(n), y(n), z(n), sh(n*ld);
+  for ( int i = 0; i < n; ++i ) 
+    x[i] = (*grad)(i,0), y[i] = (*grad)(i,1), z[i] = (*grad)(i,2);
+  FloatEvaluatorType::EvaluateBatchCartesian(n, &x[0], &y[0], &z[0], &sh[0], ld);
+  utl_shared_ptr<MatrixType> shMatrix = utl::ComputeSHMatrix(4, *grad, CARTESIAN_TO_SPHERICAL);
+  for ( int i = 0; i < n; ++i ) 
+    for ( int j = 0; j < FloatEvaluatorType::Dimension; ++j ) 
+      EXPECT_NEAR((*shMatrix)(i,j), sh[i*ld+j], 1e-5);
+}
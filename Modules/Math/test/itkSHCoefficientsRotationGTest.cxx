@@ -84,3 +84,53 @@ TEST(itkSHCoefficientsRotation, RandomRotate)
   // utl::PrintUtlVector(sfVec_2, "sfVec_2");
 }
 
+TEST(itkSHCoefficientsRotation, WignerMatrices)
+{
+  int rank = 10;
+  SHRotationFilter::Pointer shRotate = SHRotationFilter::New();
+  shRotate->SetTessOrder(4);
+  shRotate->SetMaxRank(rank);
+  shRotate->Initialize();
+
+  MatrixType rotateMatrix = __GeterateRandomRotation();
+  std::vector<MatrixType> wigner;
+  SHRotationFilter::ComputeWignerMatrices(rotateMatrix, rank, wigner);
+  EXPECT_EQ(rank/2+1, wigner.size());
+  for ( int l = 0; l <= rank; l += 2 ) 
+    {
+    // Wigner-D matrices are orthogonal
+    MatrixType eye = wigner[l/2] * wigner[l/2].GetTranspose();
+    for ( int i = 0; i < 2*l+1; ++i ) 
+      for ( int j = 0; j < 2*l+1; ++j ) 
+        EXPECT_NEAR(i==j ? 1.0 : 0.0, eye(i,j), 1e-10);
+    }
+
+  // the same as sample-and-refit
+  VectorType shVec = __GenerateRandomSH(rank);
+  VectorType shRefit = shRotate->GetRotatedSHCoefficientsByRefitting(shVec, rotateMatrix);
+  VectorType shWigner = shRotate->GetRotatedSHCoefficients(shVec, rotateMatrix);
+  EXPECT_NEAR_VECTOR(shRefit, shWigner, shVec.Size(), 1e-6);
+
+  // batch with the same rotation, and different rotations
+  const int n = 5, dim = shVec.Size();
+  MatrixType shBatch(n, dim), shBatchRotated(n, dim), rotations(n, 9);
+  std::vector<MatrixType> rotationVec(n);
+  for ( int i = 0; i < n; ++i ) 
+    {
+    shBatch.SetRow(i, __GenerateRandomSH(rank));
+    rotationVec[i] = __GeterateRandomRotation();
+    utl::cblas_copy<double>(9, rotationVec[i].GetData(), 1, rotations.GetData()+9*i, 1);
+    }
+  shRotate->GetRotatedSHCoefficients(rotateMatrix, n, shBatch.GetData(), shBatchRotated.GetData(), dim);
+  for ( int i = 0; i < n; ++i ) 
+    {
+    VectorType shRotated = shRotate->GetRotatedSHCoefficientsByRefitting(shBatch.GetRow(i), rotateMatrix);
+    EXPECT_NEAR_VECTOR(shRotated, shBatchRotated.GetRow(i), dim, 1e-6);
+    }
+  shRotate->GetRotatedSHCoefficients(n, rotations.GetData(), shBatch.GetData(), shBatchRotated.GetData(), dim);
+  for ( int i = 0; i < n; ++i ) 
+    {
+    VectorType shRotated = shRotate->GetRotatedSHCoefficientsByRefitting(shBatch.GetRow(i), rotationVec[i]);
+    EXPECT_NEAR_VECTOR(shRotated, shBatchRotated.GetRow(i), dim, 1e-6);
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ *       @file  itkSpecialFunctionBatchGTest.cxx
+ *      @brief  
+ *     Created  "10-17-2026
+ *
+ *     @author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "utlGTest.h"
+#include "itkSpecialFunctionBatch.h"
+#include "itkSphericalPolarFourierGenerator.h"
+#include "utl.h"
+
+#include <gsl/gsl_sf_exp.h>
+#include <gsl/gsl_sf_laguerre.h>
+#include <gsl/gsl_sf_legendre.h>
+
+TEST(itkSpecialFunctionBatch, ExpNegativeBatch)
+{
+  const int N = 100000;
+  std::vector<double> x(N), y(N);
+  for ( int i = 0; i < N; i += 1 ) 
+    x[i] = utl::Random<double>(-708,708);
+  // bounds and out of range values
+  x[0]=0, x[1]=708, x[2]=-708, x[3]=800, x[4]=-1e-300, x[5]=30;
+  utl::ExpNegativeBatch(N, &x[0], &y[0]);
+
+  for ( int i = 0; i < N; i += 1 ) 
+    {
+    // gsl_sf_exp calls the gsl error handler (abort) for underflow, thus std::exp is used out of range. 
+    double expected = std::fabs(x[i])<=708 ? gsl_sf_exp(-x[i]) : std::exp(-x[i]);
+    // less than 2 ULP in [-708, 708]
+    EXPECT_NEAR(expected, y[i], 5e-16*expected) << "x = " << x[i];
+    }
+}
+
+TEST(itkSpecialFunctionBatch, LaguerreBatch)
+{
+  const int nMax = 30, nx = 500;
+  std::vector<double> x(nx), out((nMax+1)*nx);
+  for ( int i = 0; i < nx; i += 1 ) 
+    x[i] = 100.0*i/(nx-1);
+
+  for ( double a = 0; a <= 4; a += 0.5 ) 
+    {
+    utl::LaguerreBatch(nMax, a, nx, &x[0], &out[0], nx);
+    for ( int n = 0; n <= nMax; n += 1 ) 
+      for ( int i = 0; i < nx; i += 1 ) 
+        {
+        double expected = gsl_sf_laguerre_n(n, a, x[i]);
+        EXPECT_NEAR(expected, out[n*nx+i], 4e-13*utl::max(1.0,std::fabs(expected))*std::exp(0.5*x[i])) << "n = " << n << ", a = " << a << ", x = " << x[i];
+        }
+    }
+}
+
+TEST(itkSpecialFunctionBatch, LegendreBatch)
+{
+  const int lMax = 100, nx = 201;
+  std::vector<double> x(nx), out((lMax+1)*nx);
+  for ( int i = 0; i < nx; i += 1 ) 
+    x[i] = -1.0 + 2.0*i/(nx-1);
+
+  utl::LegendreBatch(lMax, nx, &x[0], &out[0], nx);
+  for ( int l = 0; l <= lMax; l += 1 ) 
+    for ( int i = 0; i < nx; i += 1 ) 
+      EXPECT_NEAR(gsl_sf_legendre_Pl(l, x[i]), out[l*nx+i], 1e-14*utl::max(1,l)) << "l = " << l << ", x = " << x[i];
+}
+
+TEST(itkSpecialFunctionBatch, SPFRadialBatch)
+{
+  typedef itk::SphericalPolarFourierRadialGenerator<double> SPFGenerator;
+  SPFGenerator::Pointer spf = SPFGenerator::New();
+  spf->SetSPFType(SPFGenerator::SPF);
+
+  const int nMax = 10, nq = 50;
+  std::vector<double> q(nq), out((nMax+1)*nq);
+  for ( int i = 0; i < nq; i += 1 ) 
+    q[i] = 0.1*i;
+
+  for ( double scale = 0.5; scale < 3; scale += 1.0 ) 
+    {
+    spf->SetScale(scale);
+    utl::SPFRadialBatch(nMax, scale, nq, &q[0], &out[0], nq);
+    for ( int n = 0; n <= nMax; n += 1 ) 
+      {
+      spf->SetN(n);
+      for ( int i = 0; i < nq; i += 1 ) 
+        EXPECT_NEAR(spf->Evaluate(q[i], false), out[n*nq+i], 1e-12) << "n = " << n << ", scale = " << scale << ", q = " << q[i];
+      }
+    }
+}
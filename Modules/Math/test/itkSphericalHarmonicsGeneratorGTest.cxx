@@ -127,5 +127,32 @@ TEST(itkSphericalHarmonicsGenerator, RealTripleIntegration)
     __itkSphericalHarmonicsGenerator_RealTripleIntegration(l1,m1,l2,m2,theta,phi);
     }
     }
+
+    {
+  // the table uses shared data as a read-only memory-mapped table. 
+  // The same size with a different shape should detach the shared data, which should not be written.
+  utl::SH3IntegralTable->Clear();
+  utl::InitializeSHTripleIntegrationTable(4, 6, 8, true);
+  const unsigned* shape = utl::SH3IntegralTable->GetShape();
+  unsigned shapeShared[3] = {shape[0], shape[1], shape[2]};
+  EXPECT_EQ(15, shapeShared[0]);
+  EXPECT_EQ(45, shapeShared[2]);
+  std::vector<double> sharedData(utl::SH3IntegralTable->GetData(), utl::SH3IntegralTable->GetData()+utl::SH3IntegralTable->Size());
+  std::vector<double> sharedDataCopy(sharedData);
+  utl::SH3IntegralTable->SetData(&sharedData[0], shapeShared);
+  EXPECT_TRUE(utl::SH3IntegralTable->GetIsShared());
+
+  utl::InitializeSHTripleIntegrationTable(8, 6, 4, true);
+  EXPECT_FALSE(utl::SH3IntegralTable->GetIsShared());
+  EXPECT_EQ(45, utl::SH3IntegralTable->GetShape()[0]);
+  EXPECT_EQ(15, utl::SH3IntegralTable->GetShape()[2]);
+  for ( int i = 0; i < sharedData.size(); ++i ) 
+    ASSERT_EQ(sharedDataCopy[i], sharedData[i]);
+
+  unsigned index[3] = {30,20,10};
+  std::vector<int> v1 = utl::GetIndexSHlm(index[0]), v2 = utl::GetIndexSHlm(index[1]), v3 = utl::GetIndexSHlm(index[2]);
+  EXPECT_NEAR((*utl::SH3IntegralTable)(index), SHGenerator::RealTripleIntegration(v1[0],v1[1],v2[0],v2[1],v3[0],v3[1],false), 1e-8);
+  utl::SH3IntegralTable->Clear();
+    }
 }
 
@@ -19,6 +19,8 @@
 #include "gtest/gtest.h"
 #include "utlCore.h"
 #include "itkUnaryFunctorLookUpTable.h"
+#include "itkFunctorHashTable.h"
+#include "itkConcurrentFunctorHashTable.h"
 #include "itkFunctors.h"
 #include "utl.h"
 
@@ -141,3 +143,86 @@ TEST(itkUnaryFunctorLookUpTable, COS_TimeCost)
     }
 }
 
+TEST(itkUnaryFunctorLookUpTable, BuildTableOnce_MultiThreads)
+{
+  typedef itk::UnaryFunctorLookUpTable<utl::Functor::Exp<double> > LUTType;
+  LUTType::Pointer lut = LUTType::New();
+  lut->SetVariableMax(0);
+  lut->SetVariableMin(-30);
+  lut->SetNumberOfBins(30*5e3);
+
+  const int N = 10000;
+  std::vector<double> val(N), result(N);
+  for ( int i = 0; i < N; i += 1 ) 
+    val[i] = utl::Random<double>(-30,0);
+
+  // all threads build the table at the same time, then read it without locks
+  #pragma omp parallel for
+  for ( int i = 0; i < N; i += 1 ) 
+    {
+    lut->BuildTableOnce();
+    result[i] = lut->GetFunctionValue(val[i]);
+    }
+
+  EXPECT_TRUE(lut->IsTableBuilt());
+  for ( int i = 0; i < N; i += 1 ) 
+    EXPECT_NEAR(std::exp(val[i]), result[i], 1e-8);
+  
+  // shared lookup table for exp 
+  #pragma omp parallel for
+  for ( int i = 0; i < N; i += 1 ) 
+    result[i] = itk::lutExpValue(val[i]);
+  for ( int i = 0; i < N; i += 1 ) 
+    EXPECT_NEAR(std::exp(val[i]), result[i], 1e-8);
+}
+
+TEST(itkFunctorHashTable, Freeze_MultiThreads)
+{
+  typedef itk::FunctorHashTable<utl::Functor::Exp<double>, double, double> HashType;
+  HashType::Pointer hash = HashType::New();
+
+  const int N = 1000;
+  std::vector<double> val(N), result(2*N);
+  for ( int i = 0; i < N; i += 1 ) 
+    val[i] = utl::Random<double>(-3,3);
+  hash->BuildTable(val);
+  hash->Freeze();
+  EXPECT_TRUE(hash->IsFrozen());
+  EXPECT_EQ(hash->GetTableSize(), N);
+
+  #pragma omp parallel for
+  for ( int i = 0; i < 2*N; i += 1 ) 
+    result[i] = hash->GetFunctionValue(i<N ? val[i] : val[i-N]+10.0);
+
+  // missed parameters are not inserted in the frozen table
+  EXPECT_EQ(hash->GetTableSize(), N);
+  for ( int i = 0; i < N; i += 1 ) 
+    {
+    EXPECT_NEAR(std::exp(val[i]), result[i], 1e-10);
+    EXPECT_NEAR(std::exp(val[i]+10.0), result[i+N], 1e-10*std::exp(val[i]+10.0));
+    }
+}
+
+TEST(itkConcurrentFunctorHashTable, MultiThreads)
+{
+  typedef itk::ConcurrentFunctorHashTable<utl::Functor::Exp<double>, double, double> HashType;
+  HashType::Pointer hash = HashType::New();
+  hash->SetNumberOfShards(8);
+  HashType::Pointer hashClone = hash->Clone();
+
+  const int N = 500;
+  std::vector<double> val(N), result(4*N);
+  for ( int i = 0; i < N; i += 1 ) 
+    val[i] = i*0.01-2.0;
+
+  // the same parameters are evaluated and inserted by different threads
+  #pragma omp parallel for
+  for ( int i = 0; i < 4*N; i += 1 ) 
+    result[i] = (i%2==0 ? hash : hashClone)->GetFunctionValue(val[i%N]);
+
+  // clones share the shards
+  EXPECT_EQ(hash->GetTableSize(), N);
+  EXPECT_EQ(hashClone->GetTableSize(), N);
+  for ( int i = 0; i < 4*N; i += 1 ) 
+    EXPECT_NEAR(std::exp(val[i%N]), result[i], 1e-10);
+}
@@ -0,0 +1,525 @@
+/**
+ *       @file  itkMOCBranchAndBoundSolver.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkMOCBranchAndBoundSolver_h
+#define __itkMOCBranchAndBoundSolver_h
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkMutexLockHolder.h"
+#include "itkRealTimeClock.h"
+#include "itksys/SystemTools.hxx"
+#include "utlNDArray.h"
+
+namespace itk
+{
+
+/**
+ *   \class   MOCBranchAndBoundSolver
+ *   \brief   Exact branch-and-bound solver of the covering problem in single/multi-shell sampling scheme design.
+ *
+ *   Given candidate orientations and separation angles, it finds NumbersInShell[s] orientations in each shell s,
+ *   such that the antipodally symmetric angle between two orientations in shell s is no less than angles[s],
+ *   and the angle between two orientations in all shells is no less than angles.back() (only for multi-shell case).
+ *   It is the 0-1 program that was exported to Gurobi, with a binary variable for each (shell, orientation) pair,
+ *   and a constraint for each pair of conflicting variables.
+ *
+ *   - Bounds. At most one variable in a clique of conflicts is set to 1.
+ *     In each node, free variables are greedily partitioned into cliques, and the number of cliques is the objective
+ *     of a dual feasible solution of the LP relaxation with clique constraints.
+ *     It bounds the number of variables which can still be set to 1, in each shell and in all shells.
+ *     The LP relaxation itself is not solved. The clique cover bound stands in for the LP bound. 
+ *     It is cheaper, but it is not tighter than the optimal LP bound.
+ *   - Branching. The clique with the fewest free variables in the shell with the smallest slack is chosen.
+ *     A child sets one free variable in the clique to 1, and the last child sets all of them to 0.
+ *   - Symmetry breaking. Antipodal (and repeated) candidates are the same orientation, and they are merged before the search.
+ *   - Parallel tree search. Threads run depth first search using their own stacks.
+ *     When some threads are idle, busy threads move their shallowest open nodes to a shared pool.
+ *   - Anytime. The search stops with TIMEOUT after TimeLimit seconds.
+ *
+ *   The conflict matrix has (S*N)^2 bits for S shells and N candidates, thus it is used for up to several thousand candidates.
+ *
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *   \ingroup SamplingScheme
+ */
+class MOCBranchAndBoundSolver
+{
+public:
+  typedef MOCBranchAndBoundSolver             Self;
+  typedef utl_shared_ptr<Self>                Pointer;
+
+  typedef utl::NDArray<double,2>              MatrixType;
+  typedef std::vector<double>                 STDVectorType;
+  typedef std::vector<int>                    IndexVectorType;
+  typedef std::vector<IndexVectorType>        Index2DVectorType;
+  typedef std::vector<uint64_t>               BitSetType;
+
+  typedef enum
+    {
+    FEASIBLE=0,
+    INFEASIBLE,
+    TIMEOUT
+    } StatusType;
+
+  MOCBranchAndBoundSolver() : m_NumberOfThreads(-1), m_TimeLimit(-1), m_NumberOfNodes(0) {}
+
+  /** Set candidate orientations (N x 3 in cartesian format). Antipodal and repeated orientations are merged.  */
+  void SetOrientations(const MatrixType& orientations)
+    {
+    utlGlobalException(orientations.Columns()!=3, "orientations should be a Nx3 matrix");
+    m_Points.clear();
+    m_PointIndices.clear();
+    for ( int i = 0; i < orientations.Rows(); ++i )
+      {
+      double x=orientations(i,0), y=orientations(i,1), z=orientations(i,2);
+      double norm = std::sqrt(x*x+y*y+z*z);
+      utlGlobalException(norm<1e-10, "zero orientation");
+      x/=norm, y/=norm, z/=norm;
+      bool isRepeated = false;
+      for ( int j = 0; j < m_PointIndices.size(); ++j )
+        {
+        if (std::fabs(x*m_Points[3*j]+y*m_Points[3*j+1]+z*m_Points[3*j+2]) > 1-1e-10)
+          {
+          isRepeated = true;
+          break;
+          }
+        }
+      if (isRepeated)
+        continue;
+      m_Points.push_back(x), m_Points.push_back(y), m_Points.push_back(z);
+      m_PointIndices.push_back(i);
+      }
+    }
+
+  void SetNumbersInShell(const IndexVectorType& numbers) {m_NumbersInShell = numbers;}
+  const IndexVectorType& GetNumbersInShell() const {return m_NumbersInShell;}
+
+  /** The number of threads. If it is not positive, the default number of threads in MultiThreader is used.  */
+  void SetNumberOfThreads(const int num) {m_NumberOfThreads = num;}
+  int GetNumberOfThreads() const {return m_NumberOfThreads;}
+
+  /** Time limit (in seconds) of Solve(). If it is not positive, there is no time limit.  */
+  void SetTimeLimit(const double timeLimit) {m_TimeLimit = timeLimit;}
+  double GetTimeLimit() const {return m_TimeLimit;}
+
+  /** number of unique candidate orientations  */
+  int GetNumberOfCandidates() const {return m_PointIndices.size();}
+
+  /** number of nodes in the last search  */
+  long GetNumberOfNodes() const {return m_NumberOfNodes;}
+
+  /** Indices (rows in SetOrientations()) in shells of the solution, if Solve() returns FEASIBLE.  */
+  const Index2DVectorType& GetIndicesInShells() const {return m_IndicesInShells;}
+
+  /** Find a scheme with the separation angles (in radian).
+   * angles[s] is for shell s. For multi-shell case, angles.back() is for all shells, and angles.size() is the number of shells plus 1. */
+  StatusType Solve(const STDVectorType& angles)
+    {
+    int numberOfShells = m_NumbersInShell.size();
+    utlGlobalException(numberOfShells==0, "need to set numbers of samples in shells");
+    utlSAGlobalException(angles.size()!=(numberOfShells==1?1:numberOfShells+1))(angles.size())(numberOfShells).msg("wrong size of angles");
+    utlGlobalException(m_PointIndices.size()==0, "need to set candidate orientations");
+
+    m_IndicesInShells.clear();
+    m_NumberOfNodes = 0;
+    for ( int s = 0; s < numberOfShells; ++s )
+      {
+      // no scheme if there are not enough candidates
+      if (m_NumbersInShell[s]>(int)m_PointIndices.size())
+        return INFEASIBLE;
+      }
+
+    BuildConflicts(angles);
+
+    NodeType root;
+    root.Free.assign(m_NumberOfWords, 0);
+    root.NumbersChosen.assign(numberOfShells, 0);
+    for ( int s = 0; s < numberOfShells; ++s )
+      {
+      if (m_NumbersInShell[s]>0)
+        {
+        for ( int v = s*GetNumberOfPoints(); v < (s+1)*GetNumberOfPoints(); ++v )
+          SetBit(root.Free, v);
+        }
+      }
+
+    m_Pool.clear();
+    m_Pool.push_back(root);
+    m_NumberOfIdleThreads = 0;
+    m_Status = RUNNING;
+
+    RealTimeClock::Pointer clock = RealTimeClock::New();
+    m_Deadline = m_TimeLimit>0 ? clock->GetTimeInSeconds()+m_TimeLimit : -1;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    if (m_NumberOfThreads>0)
+      threader->SetNumberOfThreads(m_NumberOfThreads);
+    m_NumberOfThreadsInSearch = threader->GetNumberOfThreads();
+    threader->SetSingleMethod(this->SearchThreaderCallback, this);
+    threader->SingleMethodExecute();
+
+    m_Pool.clear();
+    int status = m_Status;
+    return status==RUNNING ? INFEASIBLE : (StatusType)status;
+    }
+
+protected:
+  /** a node of the search tree  */
+  struct NodeType
+    {
+    /** variables which are not fixed  */
+    BitSetType Free;
+    /** variables which are set to 1  */
+    IndexVectorType Chosen;
+    /** numbers of chosen variables in shells  */
+    IndexVectorType NumbersChosen;
+    };
+
+  /** m_Status is RUNNING during the search  */
+  static const int RUNNING = -1;
+
+  int GetNumberOfPoints() const {return m_PointIndices.size();}
+
+  static bool GetBit(const BitSetType& bits, const int i) {return (bits[i>>6]>>(i&63)) & 1;}
+  static void SetBit(BitSetType& bits, const int i) {bits[i>>6] |= (uint64_t)1<<(i&63);}
+  static void ClearBit(BitSetType& bits, const int i) {bits[i>>6] &= ~((uint64_t)1<<(i&63));}
+
+  bool IsConflict(const int v0, const int v1) const
+    {
+    return (m_Conflicts[(std::size_t)v0*m_NumberOfWords+(v1>>6)]>>(v1&63)) & 1;
+    }
+  void SetConflict(const int v0, const int v1)
+    {
+    m_Conflicts[(std::size_t)v0*m_NumberOfWords+(v1>>6)] |= (uint64_t)1<<(v1&63);
+    m_Conflicts[(std::size_t)v1*m_NumberOfWords+(v0>>6)] |= (uint64_t)1<<(v0&63);
+    }
+
+  /** variable v=s*N+i is the i-th candidate in shell s  */
+  void BuildConflicts(const STDVectorType& angles)
+    {
+    int numberOfShells = m_NumbersInShell.size();
+    int N = GetNumberOfPoints();
+    int numberOfVariables = numberOfShells*N;
+    m_NumberOfWords = (numberOfVariables+63)/64;
+    m_Conflicts.assign((std::size_t)numberOfVariables*m_NumberOfWords, 0);
+    m_ShellMasks.assign(numberOfShells, BitSetType(m_NumberOfWords, 0));
+    for ( int s = 0; s < numberOfShells; ++s )
+      for ( int v = s*N; v < (s+1)*N; ++v )
+        SetBit(m_ShellMasks[s], v);
+
+    // two orientations conflict if their angle is less than the separation angle, i.e. |dot|>cos(angle).
+    const double eps = 1e-12;
+    STDVectorType cosAngles(angles.size());
+    for ( int i = 0; i < angles.size(); ++i )
+      cosAngles[i] = std::cos(angles[i]) + eps;
+    double cosAll = numberOfShells>1 ? cosAngles.back() : 2.0;
+
+    for ( int i = 0; i < N; ++i )
+      {
+      const double* pi = &m_Points[3*i];
+      // the same orientation in different shells
+      for ( int s = 0; s < numberOfShells; ++s )
+        for ( int t = s+1; t < numberOfShells; ++t )
+          SetConflict(s*N+i, t*N+i);
+
+      for ( int j = i+1; j < N; ++j )
+        {
+        const double* pj = &m_Points[3*j];
+        double dot = std::fabs(pi[0]*pj[0]+pi[1]*pj[1]+pi[2]*pj[2]);
+        if (dot>cosAll)
+          {
+          for ( int s = 0; s < numberOfShells; ++s )
+            for ( int t = 0; t < numberOfShells; ++t )
+              SetConflict(s*N+i, t*N+j);
+          }
+        else
+          {
+          for ( int s = 0; s < numberOfShells; ++s )
+            {
+            if (dot>cosAngles[s])
+              SetConflict(s*N+i, s*N+j);
+            }
+          }
+        }
+      }
+    }
+
+  static int GetLowestBit(const uint64_t bits)
+    {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int i=0;
+    while (!((bits>>i) & 1))
+      i++;
+    return i;
+#endif
+    }
+
+  /** Greedily partition free variables (in mask) into cliques of conflicts.
+   * Return the number of cliques and the smallest clique. */
+  int PartitionIntoCliques(const BitSetType& free, const BitSetType* mask, IndexVectorType& smallestClique) const
+    {
+    // only words with free variables are used
+    int w0=0, w1=m_NumberOfWords;
+    while (w0<w1 && (free[w0] & (mask ? (*mask)[w0] : ~(uint64_t)0))==0)
+      w0++;
+    while (w1>w0 && (free[w1-1] & (mask ? (*mask)[w1-1] : ~(uint64_t)0))==0)
+      w1--;
+    int size = w1-w0;
+    BitSetType rest(size), candidates(size);
+    for ( int k = 0; k < size; ++k )
+      rest[k] = free[w0+k] & (mask ? (*mask)[w0+k] : ~(uint64_t)0);
+
+    IndexVectorType clique;
+    smallestClique.clear();
+    int numberOfCliques=0;
+    for ( int w = 0; w < size; ++w )
+      {
+      while (rest[w])
+        {
+        int v = (w0+w)*64 + GetLowestBit(rest[w]);
+        rest[w] &= rest[w]-1;
+        clique.assign(1, v);
+        // words before w in rest are empty
+        const uint64_t* conflicts_v = &m_Conflicts[(std::size_t)v*m_NumberOfWords+w0];
+        for ( int k = w; k < size; ++k )
+          candidates[k] = rest[k] & conflicts_v[k];
+        for ( int k = w; k < size; ++k )
+          {
+          while (candidates[k])
+            {
+            int bit = GetLowestBit(candidates[k]);
+            int u = (w0+k)*64 + bit;
+            clique.push_back(u);
+            rest[k] &= ~((uint64_t)1<<bit);
+            candidates[k] &= ~((uint64_t)1<<bit);
+            const uint64_t* conflicts_u = &m_Conflicts[(std::size_t)u*m_NumberOfWords+w0];
+            for ( int j = k; j < size; ++j )
+              candidates[j] &= conflicts_u[j];
+            }
+          }
+        numberOfCliques++;
+        if (smallestClique.empty() || clique.size()<smallestClique.size())
+          smallestClique = clique;
+        }
+      }
+    return numberOfCliques;
+    }
+
+  /** set variable v to 1 in node  */
+  void ChooseVariable(NodeType& node, const int v) const
+    {
+    int N = GetNumberOfPoints();
+    int s = v/N;
+    node.Chosen.push_back(v);
+    node.NumbersChosen[s]++;
+    const uint64_t* conflicts = &m_Conflicts[(std::size_t)v*m_NumberOfWords];
+    for ( int w = 0; w < m_NumberOfWords; ++w )
+      node.Free[w] &= ~conflicts[w];
+    ClearBit(node.Free, v);
+    // the shell is full
+    if (node.NumbersChosen[s]==m_NumbersInShell[s])
+      {
+      for ( int u = s*N; u < (s+1)*N; ++u )
+        ClearBit(node.Free, u);
+      }
+    }
+
+  /** Bound and branch a node. Children are pushed to stack. Return true if the node is a solution. */
+  bool ProcessNode(const NodeType& node, std::vector<NodeType>& stack) const
+    {
+    int numberOfShells = m_NumbersInShell.size();
+    int totalNeed = 0;
+    int slackBranch=-1;
+    IndexVectorType clique, cliqueBranch;
+    for ( int s = 0; s < numberOfShells; ++s )
+      {
+      int need = m_NumbersInShell[s]-node.NumbersChosen[s];
+      if (need<=0)
+        continue;
+      totalNeed += need;
+
+      int numberOfCliques = PartitionIntoCliques(node.Free, &m_ShellMasks[s], clique);
+      if (numberOfCliques<need)
+        return false;
+      if (slackBranch<0 || numberOfCliques-need<slackBranch)
+        {
+        slackBranch = numberOfCliques-need;
+        cliqueBranch.swap(clique);
+        }
+      }
+
+    if (totalNeed==0)
+      return true;
+
+    if (numberOfShells>1 && PartitionIntoCliques(node.Free, NULL, clique)<totalNeed)
+      return false;
+
+    // Without slack, setting all variables in the clique to 0 violates the bound, thus the child is not generated.
+    if (slackBranch>0)
+      {
+      stack.push_back(node);
+      for ( int k = 0; k < cliqueBranch.size(); ++k )
+        ClearBit(stack.back().Free, cliqueBranch[k]);
+      }
+    // variables in a clique conflict, thus children are disjoint. The first variable is visited first.
+    for ( int k = cliqueBranch.size()-1; k >= 0; --k )
+      {
+      stack.push_back(node);
+      ChooseVariable(stack.back(), cliqueBranch[k]);
+      }
+    return false;
+    }
+
+  void SetSolution(const NodeType& node)
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_SolutionMutex);
+    int status = RUNNING;
+    if (!m_Status.compare_exchange_strong(status, (int)FEASIBLE))
+      return;
+    int N = GetNumberOfPoints();
+    m_IndicesInShells.assign(m_NumbersInShell.size(), IndexVectorType());
+    for ( int k = 0; k < node.Chosen.size(); ++k )
+      m_IndicesInShells[node.Chosen[k]/N].push_back(m_PointIndices[node.Chosen[k]%N]);
+    for ( int s = 0; s < m_IndicesInShells.size(); ++s )
+      std::sort(m_IndicesInShells[s].begin(), m_IndicesInShells[s].end());
+    }
+
+  /** Get a node from the shared pool when the stack of a thread is empty. Return false if the search is finished. */
+  bool GetNodeFromPool(std::vector<NodeType>& stack)
+    {
+    bool isIdle = false;
+    while (true)
+      {
+        {
+        MutexLockHolder<SimpleFastMutexLock> holder(m_PoolMutex);
+        if (!m_Pool.empty())
+          {
+          stack.push_back(m_Pool.back());
+          m_Pool.pop_back();
+          if (isIdle)
+            m_NumberOfIdleThreads--;
+          return true;
+          }
+        if (!isIdle)
+          {
+          isIdle = true;
+          m_NumberOfIdleThreads++;
+          }
+        // all threads are idle and no open node, then the tree is exhausted
+        if (m_NumberOfIdleThreads==m_NumberOfThreadsInSearch)
+          return false;
+        }
+      if (m_Status!=RUNNING)
+        return false;
+      itksys::SystemTools::Delay(1);
+      }
+    }
+
+  /** move the shallowest half of open nodes to the shared pool  */
+  void DonateNodes(std::vector<NodeType>& stack)
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(m_PoolMutex);
+    int numberOfDonated = stack.size()/2;
+    for ( int i = 0; i < numberOfDonated; ++i )
+      m_Pool.push_back(stack[i]);
+    stack.erase(stack.begin(), stack.begin()+numberOfDonated);
+    }
+
+  void ThreadedSearch()
+    {
+    std::vector<NodeType> stack;
+    RealTimeClock::Pointer clock = RealTimeClock::New();
+    long numberOfNodes = 0;
+    while (m_Status==RUNNING)
+      {
+      if (stack.empty())
+        {
+        if (!GetNodeFromPool(stack))
+          break;
+        continue;
+        }
+
+      NodeType node;
+      node.Free.swap(stack.back().Free);
+      node.Chosen.swap(stack.back().Chosen);
+      node.NumbersChosen.swap(stack.back().NumbersChosen);
+      stack.pop_back();
+      if (ProcessNode(node, stack))
+        SetSolution(node);
+      numberOfNodes++;
+
+      if ((numberOfNodes & 15)==0 && m_NumberOfIdleThreads>0 && stack.size()>1)
+        DonateNodes(stack);
+      if ((numberOfNodes & 255)==0 && m_Deadline>0 && clock->GetTimeInSeconds()>m_Deadline)
+        {
+        int status = RUNNING;
+        m_Status.compare_exchange_strong(status, (int)TIMEOUT);
+        }
+      }
+
+    MutexLockHolder<SimpleFastMutexLock> holder(m_PoolMutex);
+    m_NumberOfNodes += numberOfNodes;
+    }
+
+  static ITK_THREAD_RETURN_TYPE SearchThreaderCallback(void *arg)
+    {
+    MultiThreader::ThreadInfoStruct* info = (MultiThreader::ThreadInfoStruct *)(arg);
+    Self* solver = (Self *)(info->UserData);
+    solver->ThreadedSearch();
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  IndexVectorType m_NumbersInShell;
+  int m_NumberOfThreads;
+  double m_TimeLimit;
+
+  /** unique candidate orientations (3N), and their rows in SetOrientations()  */
+  STDVectorType m_Points;
+  IndexVectorType m_PointIndices;
+
+  /** conflict matrix of variables in bits  */
+  BitSetType m_Conflicts;
+  int m_NumberOfWords;
+  /** variables in shells  */
+  std::vector<BitSetType> m_ShellMasks;
+
+  /** shared states of the parallel search  */
+  std::vector<NodeType> m_Pool;
+  SimpleFastMutexLock m_PoolMutex;
+  std::atomic<int> m_NumberOfIdleThreads;
+  int m_NumberOfThreadsInSearch;
+  std::atomic<int> m_Status;
+  double m_Deadline;
+  long m_NumberOfNodes;
+
+  SimpleFastMutexLock m_SolutionMutex;
+  Index2DVectorType m_IndicesInShells;
+
+private:
+  MOCBranchAndBoundSolver(const Self&);  //purposely not implemented
+  void operator=(const Self&);  //purposely not implemented
+};
+
+}
+
+#endif
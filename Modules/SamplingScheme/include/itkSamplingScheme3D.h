@@ -214,6 +214,12 @@ public:
   double CalculateElectrostaticEnergy(const double order=2.0, const bool isNormalize=true, const bool countHalf=true ) const;
   double CalculateElectrostaticEnergyInShell(const unsigned int shellIndex, const double order=2.0, const bool isNormalize=true, const bool countHalf=true ) const;
 
+  /** calculate the electrostatic energy between a given point and all samples except the sample with index excludedIndex. 
+   *  If sample i moves from p to q, the energy (isNormalize=false, countHalf=true) changes by 
+   *  CalculateElectrostaticEnergyOfPoint(q,i)-CalculateElectrostaticEnergyOfPoint(p,i), which is O(N) instead of O(N^2).  
+   *  */
+  double CalculateElectrostaticEnergyOfPoint(const PointType& point, const int excludedIndex=-1, const double order=2.0) const;
+
   /** calculate an upper bound of the minimal distance for a given number of points. 
    *  If isSphericalDistance is true, return spherical distance instead of Euclidean distance. 
    *  http://mathworld.wolfram.com/SphericalCode.html 
@@ -228,6 +234,15 @@ protected:
  
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
 
+  /** minimal distances of samples in indices. 
+   * For a large number of samples, a kd-tree of the samples (and their antipodal points if isSymmetric is true) 
+   * is used to find the nearest neighbor of each sample. 
+   * */
+  STDVectorType CalculateMinDistanceInSubset(const IndexVectorType& indices, const bool isSymmetric=true) const;
+
+  /** electrostatic energy of samples in indices.  */
+  double CalculateElectrostaticEnergyInSubset(const IndexVectorType& indices, const double order=2.0, const bool isNormalize=true, const bool countHalf=true ) const;
+
   /** tau value  */
   double m_Tau;
   
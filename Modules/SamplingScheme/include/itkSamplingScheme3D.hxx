@@ -21,8 +21,12 @@
 
 
 #include "itkSamplingScheme3D.h"
+#include "itkListSample.h"
+#include "itkKdTreeGenerator.h"
 #include "utl.h"
 
+#include <numeric>
+
 namespace itk
 {
 
@@ -798,7 +802,7 @@ double
 SamplingScheme3D<TPixelType>
 ::CalculateMinDistanceInShell(const unsigned int sampleIndex, const unsigned int shellIndex, const bool isSymmetric) const
 {
-  double dotMax = CalculateMaxDotInShell(index, isSymmetric);
+  double dotMax = CalculateMaxDotInShell(sampleIndex, shellIndex, isSymmetric);
   double angle=0;
   if(dotMax >= -1.0 - M_EPS && dotMax <= -1.0 + M_EPS)
     angle = M_PI;
@@ -812,31 +816,119 @@ SamplingScheme3D<TPixelType>
 template <class TPixelType>
 typename SamplingScheme3D<TPixelType>::STDVectorType
 SamplingScheme3D<TPixelType>
-::CalculateMinDistance(const bool isSymmetric) const
+::CalculateMinDistanceInSubset(const IndexVectorType& indices, const bool isSymmetric) const
 {
-  STDVectorType angleVec;
-  for(unsigned int i = 0; i < GetNumberOfSamples(); i++) 
+  typedef Point<double,3>                                     MeasurementVectorType;
+  typedef Statistics::ListSample< MeasurementVectorType >     SampleType;
+  typedef Statistics::KdTreeGenerator< SampleType >           TreeGeneratorType;
+  typedef TreeGeneratorType::KdTreeType                       TreeType;
+
+  unsigned int num = indices.size();
+  if (num==0)
+    return STDVectorType();
+  utlGlobalException(num<2, "No enough points!");
+
+  STDVectorType dotMaxVec(num, -3.0);
+  if (num<=64)
+    {
+    // all-pairs search is faster for a small number of samples
+    for(unsigned int i = 0; i < num; i++) 
+      {
+      double x = (*this)[indices[i]][0];
+      double y = (*this)[indices[i]][1];
+      double z = (*this)[indices[i]][2];
+      for ( unsigned int j = 0; j < num; ++j ) 
+        {
+        if (j==i)
+          continue;
+        double dot = x*(*this)[indices[j]][0] + y*(*this)[indices[j]][1] + z*(*this)[indices[j]][2];
+        if (isSymmetric && dot<0 )
+          dot = -dot;
+        if (dot>dotMaxVec[i])
+          dotMaxVec[i] = dot;
+        }
+      }
+    }
+  else
+    {
+    // antipodal points are also added for symmetric distance, then the sample of the n-th point is n/step
+    unsigned int step = isSymmetric ? 2 : 1;
+    SampleType::Pointer sample = SampleType::New();
+    sample->SetMeasurementVectorSize( 3 );
+    MeasurementVectorType mv;
+    for ( unsigned int i = 0; i < num; ++i ) 
+      {
+      for ( int d = 0; d < 3; ++d ) 
+        mv[d] = (*this)[indices[i]][d];
+      sample->PushBack( mv );
+      if (isSymmetric)
+        {
+        for ( int d = 0; d < 3; ++d ) 
+          mv[d] = -mv[d];
+        sample->PushBack( mv );
+        }
+      }
+
+    TreeGeneratorType::Pointer treeGenerator = TreeGeneratorType::New();
+    treeGenerator->SetSample( sample );
+    treeGenerator->SetBucketSize( 16 );
+    treeGenerator->Update();
+    TreeType::Pointer tree = treeGenerator->GetOutput();
+
+    TreeType::InstanceIdentifierVectorType neighbors;
+    for ( unsigned int i = 0; i < num; ++i ) 
+      {
+      const MeasurementVectorType& queryPoint = sample->GetMeasurementVector(i*step);
+      // the point itself (or a repeated point) is one of the 2 nearest neighbors
+      tree->Search( queryPoint, 2, neighbors );
+      for ( unsigned int n = 0; n < neighbors.size(); ++n ) 
+        {
+        if (neighbors[n]/step==i)
+          continue;
+        const MeasurementVectorType& point = sample->GetMeasurementVector(neighbors[n]);
+        double dot = queryPoint[0]*point[0] + queryPoint[1]*point[1] + queryPoint[2]*point[2];
+        if (isSymmetric && dot<0 )
+          dot = -dot;
+        if (dot>dotMaxVec[i])
+          dotMaxVec[i] = dot;
+        }
+      }
+    }
+
+  STDVectorType angleVec(num);
+  for ( unsigned int i = 0; i < num; ++i ) 
     {
-    double angle = CalculateMinDistance(i, isSymmetric);
-    angleVec.push_back(angle);
+    double dotMax = dotMaxVec[i];
+    utlGlobalException(dotMax<-1.0-M_EPS || dotMax>1+M_EPS, "wrong dot, not in [-1,1]");
+    if(dotMax >= -1.0 - M_EPS && dotMax <= -1.0 + M_EPS)
+      angleVec[i] = M_PI;
+    else if(dotMax <= 1.0 + M_EPS && dotMax >= 1.0 - M_EPS)
+      angleVec[i] = 0;
+    else 
+      angleVec[i] = std::acos(dotMax);
     }
   return angleVec;
 }
 
+template <class TPixelType>
+typename SamplingScheme3D<TPixelType>::STDVectorType
+SamplingScheme3D<TPixelType>
+::CalculateMinDistance(const bool isSymmetric) const
+{
+  IndexVectorType indices(GetNumberOfSamples());
+  for(unsigned int i = 0; i < indices.size(); i++) 
+    indices[i] = i;
+  return CalculateMinDistanceInSubset(indices, isSymmetric);
+}
+
 template <class TPixelType>
 typename SamplingScheme3D<TPixelType>::STDVectorType
 SamplingScheme3D<TPixelType>
 ::CalculateMinDistanceInShell(const unsigned int shellIndex, const bool isSymmetric) const
 {
-  STDVectorType angleVec;
-  unsigned int num = GetNumberOfSamplesInShell(shellIndex);
-  for(unsigned int i = 0; i < num; i++) 
-    {
-    unsigned int ii = (*m_IndicesInShells)[shellIndex][i];
-    double angle = CalculateMinDistanceInShell(ii, shellIndex, isSymmetric);
-    angleVec.push_back(angle);
-    }
-  return angleVec;
+  if (shellIndex>=GetNumberOfShells())
+    return STDVectorType();
+  return CalculateMinDistanceInSubset((*m_IndicesInShells)[shellIndex], isSymmetric);
 }
 
 template <class TPixelType>
@@ -875,70 +967,114 @@ SamplingScheme3D<TPixelType>
 template <class TPixelType>
 double
 SamplingScheme3D<TPixelType>
-::CalculateElectrostaticEnergy(const double order, const bool isNormalize, const bool countHalf ) const
+::CalculateElectrostaticEnergyInSubset(const IndexVectorType& indices, const double order, const bool isNormalize, const bool countHalf ) const
 {
-  double result = 0;
-  double xi, yi, zi, xj, yj, zj;
-  int kk=0;
-  unsigned int num = GetNumberOfSamples();
-  for(unsigned int i = 0; i < num; i++) 
+  int num = indices.size();
+  if (num<2)
+    return 0;
+
+  // coordinates in contiguous arrays, then the inner loop can be vectorized 
+  STDVectorType xVec(num), yVec(num), zVec(num);
+  for ( int i = 0; i < num; ++i ) 
     {
-    xi = (*this)[i][0];
-    yi = (*this)[i][1];
-    zi = (*this)[i][2];
-    for ( unsigned int j = 0; (countHalf? (j < i) : (j< num) ); j += 1 ) 
+    xVec[i] = (*this)[indices[i]][0];
+    yVec[i] = (*this)[indices[i]][1];
+    zVec[i] = (*this)[indices[i]][2];
+    }
+  const double *x=&xVec[0], *y=&yVec[0], *z=&zVec[0];
+
+  // energy and minimal squared distance between the i-th sample and samples before it 
+  bool orderEqual2 = std::abs(order-2)<1e-8 ? true : false;
+  STDVectorType energyVec(num, 0.0), distMinVec(num, std::numeric_limits<double>::max());
+  int i;
+#pragma omp parallel for private(i) schedule(dynamic, 16)
+  for ( i = 1; i < num; ++i ) 
+    {
+    double xi = x[i], yi = y[i], zi = z[i];
+    double energy=0, distMin=std::numeric_limits<double>::max();
+    if (orderEqual2)
       {
-      if (i==j)
-        continue;
-      xj = (*this)[j][0];
-      yj = (*this)[j][1];
-      zj = (*this)[j][2];
-      double result1 = (xi-xj)*(xi-xj) + (yi-yj)*(yi-yj) + (zi-zj)*(zi-zj);
-      double result2 = (xi+xj)*(xi+xj) + (yi+yj)*(yi+yj) + (zi+zj)*(zi+zj);
-      utlWarning(result1<1e-8 || result2<1e-8, "identical directions, d1=("<<xi<<","<<yi<<","<<zi<<") , d2=("<<xj<<","<<yj<<","<<zj<<")");
-      double temp = (order!=2) ? (1.0/std::pow(result1, order*0.5) + 1.0/std::pow(result2, order*0.5)) : (1.0/result1 + 1.0/result2);  
-      result += temp; 
-      kk++;
+#pragma omp simd reduction(+:energy) reduction(min:distMin)
+      for ( int j = 0; j < i; ++j ) 
+        {
+        double result1 = (xi-x[j])*(xi-x[j]) + (yi-y[j])*(yi-y[j]) + (zi-z[j])*(zi-z[j]);
+        double result2 = (xi+x[j])*(xi+x[j]) + (yi+y[j])*(yi+y[j]) + (zi+z[j])*(zi+z[j]);
+        energy += 1.0/result1 + 1.0/result2;
+        distMin = std::min(distMin, std::min(result1, result2));
+        }
       }
+    else
+      {
+      double halfOrder = order*0.5;
+      for ( int j = 0; j < i; ++j ) 
+        {
+        double result1 = (xi-x[j])*(xi-x[j]) + (yi-y[j])*(yi-y[j]) + (zi-z[j])*(zi-z[j]);
+        double result2 = (xi+x[j])*(xi+x[j]) + (yi+y[j])*(yi+y[j]) + (zi+z[j])*(zi+z[j]);
+        energy += 1.0/std::pow(result1, halfOrder) + 1.0/std::pow(result2, halfOrder);
+        distMin = std::min(distMin, std::min(result1, result2));
+        }
+      }
+    energyVec[i] = energy;
+    distMinVec[i] = distMin;
     }
-  if (isNormalize && kk>0)
-    result /= double(kk);
+
+  utlWarning(*std::min_element(distMinVec.begin(), distMinVec.end())<1e-8, "identical or antipodal directions");
+
+  double result = std::accumulate(energyVec.begin(), energyVec.end(), 0.0);
+  double kk = 0.5*num*(num-1);
+  if (!countHalf)
+    {
+    // each pair is counted twice
+    result *= 2.0;
+    kk *= 2.0;
+    }
+  if (isNormalize)
+    result /= kk;
   return result;
 }
 
+template <class TPixelType>
+double
+SamplingScheme3D<TPixelType>
+::CalculateElectrostaticEnergy(const double order, const bool isNormalize, const bool countHalf ) const
+{
+  IndexVectorType indices(GetNumberOfSamples());
+  for(unsigned int i = 0; i < indices.size(); i++) 
+    indices[i] = i;
+  return CalculateElectrostaticEnergyInSubset(indices, order, isNormalize, countHalf);
+}
+
 template <class TPixelType>
 double
 SamplingScheme3D<TPixelType>
 ::CalculateElectrostaticEnergyInShell(const unsigned int shellIndex, const double order, const bool isNormalize, const bool countHalf ) const
+{
+  if (shellIndex>=GetNumberOfShells())
+    return 0;
+  return CalculateElectrostaticEnergyInSubset((*m_IndicesInShells)[shellIndex], order, isNormalize, countHalf);
+}
+
+template <class TPixelType>
+double
+SamplingScheme3D<TPixelType>
+::CalculateElectrostaticEnergyOfPoint(const PointType& point, const int excludedIndex, const double order) const
 {
   double result = 0;
-  double xi, yi, zi, xj, yj, zj;
-  int kk=0;
-  unsigned int num = GetNumberOfSamplesInShell(shellIndex);
-  for(unsigned int i = 0; i < num; i++) 
+  double xi=point[0], yi=point[1], zi=point[2], xj, yj, zj;
+  unsigned int num = GetNumberOfSamples();
+  bool orderEqual2 = std::abs(order-2)<1e-8 ? true : false;
+  for ( unsigned int j = 0; j < num; ++j ) 
     {
-    unsigned int ii = (*m_IndicesInShells)[shellIndex][i];
-    xi = (*this)[ii][0];
-    yi = (*this)[ii][1];
-    zi = (*this)[ii][2];
-    for ( unsigned int j = 0; (countHalf? (j < i) : (j< num) ); j += 1 ) 
-      {
-      if (i==j)
-        continue;
-      unsigned int jj = (*m_IndicesInShells)[shellIndex][j];
-      xj = (*this)[jj][0];
-      yj = (*this)[jj][1];
-      zj = (*this)[jj][2];
-      double result1 = (xi-xj)*(xi-xj) + (yi-yj)*(yi-yj) + (zi-zj)*(zi-zj);
-      double result2 = (xi+xj)*(xi+xj) + (yi+yj)*(yi+yj) + (zi+zj)*(zi+zj);
-      utlWarning(result1<1e-8 || result2<1e-8, "identical directions, d1=("<<xi<<","<<yi<<","<<zi<<") , d2=("<<xj<<","<<yj<<","<<zj<<")");
-      double temp = (order!=2) ? (1.0/std::pow(result1, order*0.5) + 1.0/std::pow(result2, order*0.5)) : (1.0/result1 + 1.0/result2);  
-      result += temp;
-      kk++;
-      }
+    if ((int)j==excludedIndex)
+      continue;
+    xj = (*this)[j][0];
+    yj = (*this)[j][1];
+    zj = (*this)[j][2];
+    double result1 = (xi-xj)*(xi-xj) + (yi-yj)*(yi-yj) + (zi-zj)*(zi-zj);
+    double result2 = (xi+xj)*(xi+xj) + (yi+yj)*(yi+yj) + (zi+zj)*(zi+zj);
+    utlWarning(result1<1e-8 || result2<1e-8, "identical directions, d1=("<<xi<<","<<yi<<","<<zi<<") , d2=("<<xj<<","<<yj<<","<<zj<<")");
+    result += (!orderEqual2) ? (1.0/std::pow(result1, order*0.5) + 1.0/std::pow(result2, order*0.5)) : (1.0/result1 + 1.0/result2);  
     }
-  if (isNormalize && kk>0)
-    result /= double(kk);
   return result;
 }
 
@@ -19,6 +19,7 @@
 
 #include "itkSamplingSchemeQSpaceEstimationFilter.h"
 #include "itkSamplingScheme3D.h"
+#include "itkSphereTessellator.h"
 
 #include "itkListSample.h"
 #include "itkKdTreeGenerator.h"
@@ -31,6 +32,13 @@ namespace itk
  *   \class   SamplingSchemeQSpaceIMOCEstimationFilter
  *   \brief   Estimation of single/multi-shell orientations using Iterative Maximum Overlap Construction (IMOC)
  *
+ *   For each tested separation angle, neighbors of all fine samples are precomputed as compressed sparse row (CSR) lists using the kd-tree, 
+ *   if the total number of stored neighbors is not larger than MaxNumberOfStoredNeighbors. 
+ *   Otherwise, neighbors of candidates are searched in the kd-tree and cached with the rest of the memory. 
+ *   Overlap sums of all candidates in each greedy step are evaluated in parallel using OpenMP. 
+ *   The result is the same as the serial greedy construction.
+ *   The fine scheme is read from stored tables for TessellationOrder<=7, and generated by SphereTessellator for higher orders.
+ *
  *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
  *   \ingroup SamplingScheme
  */
@@ -67,6 +75,8 @@ public:
   itkTypeMacro(SamplingSchemeQSpaceIMOCEstimationFilter, SamplingSchemeQSpaceEstimationFilter);
   itkNewMacro(Self);
   
+  /** The order of tessellation for the fine scheme. Orders larger than 7 are generated by SphereTessellator 
+   * (e.g. 81921 samples in hemisphere for order 8). */
   itkSetGetMacro(TessellationOrder, unsigned int);
   
   itkSetGetMacro(FineOrientations, MatrixPointer);
@@ -75,6 +85,10 @@ public:
 
   itkSetGetMacro(ChooseMinimalCoverageShell, bool);
 
+  /** The maximal total number of neighbors stored in lists for all shells in each step. 
+   * The default value 2^28 uses 1GB for indices. */
+  itkSetGetMacro(MaxNumberOfStoredNeighbors, std::size_t);
+
   void GenerateData() ITK_OVERRIDE;
 
 protected:
@@ -84,6 +98,40 @@ protected:
   void Initialization() ITK_OVERRIDE;
 
   bool IsSatisfiedSeparationAngles(const std::vector<double>& angles);
+
+  /** neighbors of all samples in m_FineScheme within a Euclidean distance Radius, in compressed sparse row (CSR) format. 
+   * Neighbors of the i-th sample are Indices[Offsets[i]], ..., Indices[Offsets[i+1]-1]. 
+   * Indices are sample indices in m_FineScheme, i.e. antipodal points in the kd-tree are merged. 
+   * If Offsets is empty, neighbors are not stored for all samples, and Cache has neighbors of touched samples. */
+  struct NeighborListType
+    {
+    std::vector<std::size_t> Offsets;
+    std::vector<int> Indices;
+    double Radius=0;
+
+    std::vector<std::vector<int> > Cache;
+    std::size_t NumberOfCachedNeighbors=0;
+    std::size_t MaxNumberOfCachedNeighbors=0;
+
+    bool IsStored() const {return Offsets.size()>0;}
+    };
+
+  /** Compute neighbor lists of all fine samples in parallel. 
+   * Neighbors are stored only if their total number is not larger than maxNumberOfNeighbors, which is checked using an estimation before the search. 
+   * Return the number of stored neighbors.  */
+  std::size_t ComputeNeighborList(const double radius, const std::size_t maxNumberOfNeighbors, NeighborListType& neighborList) const;
+
+  /** Search and cache neighbors of candidates which have not been evaluated (sumOverlaps[candidate]<0) in parallel, if neighbors are not stored in neighborList. 
+   * Other candidates whose overlap sums are evaluated again use cached lists, or search the kd-tree if the lists are released.  */
+  void CacheNeighbors(const IndexVectorType& candidates, const IndexVectorType& sumOverlaps, NeighborListType& neighborList) const;
+
+  /** Get neighbors of the i-th sample and return the number of neighbors. 
+   * If neighbors are not stored or cached in neighborList, they are searched in the kd-tree and saved in buffer.  */
+  int GetNeighbors(const NeighborListType& neighborList, const int i, const int*& neighbors, std::vector<int>& buffer) const;
+
+  /** Find the first candidate with the maximal sumOverlap. Negative sumOverlap means it is not a candidate. 
+   * Return true if sumMaxOverlap is increased. */
+  static bool FindMaxOverlap(const IndexVectorType& candidates, const IndexVectorType& sumOverlaps, int& indexMaxOverlap, int& sumMaxOverlap, int& numberOfCandidates);
   
   /** the order of tessellation for the orignal fine mesh  */
   unsigned int m_TessellationOrder=7;
@@ -107,6 +155,9 @@ protected:
    * */
   bool m_ChooseMinimalCoverageShell=true;
 
+  /** Neighbor lists for order 8 and large separation angles (about 11k neighbors per sample at 15 degrees) would take more than 10GB.  */
+  std::size_t m_MaxNumberOfStoredNeighbors=std::size_t(1)<<28;
+
 private:
   SamplingSchemeQSpaceIMOCEstimationFilter(const Self &); //purposely not implemented
   void operator=(const Self &);         //purposely not implemented
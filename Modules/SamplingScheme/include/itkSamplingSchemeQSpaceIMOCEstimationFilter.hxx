@@ -22,6 +22,7 @@
 #include "utl.h"
 
 #include <numeric>
+#include <algorithm>
 
 namespace itk
 {
@@ -42,7 +43,21 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
   // SamplingType* input = const_cast< SamplingType * >( this->GetInput() );
   if (this->m_FineOrientations->Size()==0)
     {
-    this->m_FineOrientations = utl::ReadGrad<double>(this->m_TessellationOrder, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); // catesian
+    if (this->m_TessellationOrder<=7)
+      this->m_FineOrientations = utl::ReadGrad<double>(this->m_TessellationOrder, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); // catesian
+    else
+      {
+      // stored tables are up to order 7. Use the same hemisphere as SphereTessellator --hemisphere
+      typedef SphereTessellator<double> TessellatorType;
+      TessellatorType::Pointer tessellator = TessellatorType::New();
+      tessellator->SetOrder(this->m_TessellationOrder);
+      tessellator->TessellateSphere();
+      TessellatorType::PointsMatrixType points = tessellator->GetPointsMatrixInHemisphere();
+      this->m_FineOrientations = MatrixPointer(new MatrixType(points.rows(), 3));
+      for ( int i = 0; i < points.rows(); ++i ) 
+        for ( int j = 0; j < 3; ++j ) 
+          (*this->m_FineOrientations)(i,j) = points(i,j);
+      }
     }
   m_FineScheme->SetOrientationsCartesian(m_FineOrientations);
   // utl::PrintUtlMatrix(*m_FineOrientations, "m_FineOrientations");
@@ -74,6 +89,159 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
   m_KDTree = m_TreeGenerator->GetOutput();
 }
 
+template< class TSamplingType >
+std::size_t
+SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
+::ComputeNeighborList(const double radius, const std::size_t maxNumberOfNeighbors, NeighborListType& neighborList) const
+{
+  int numberOfSamples = m_FineScheme->GetNumberOfSamples();
+  neighborList.Radius = radius;
+  neighborList.Indices.clear();
+  neighborList.Offsets.clear();
+  neighborList.Cache.clear();
+  neighborList.NumberOfCachedNeighbors = 0;
+
+  // The fine scheme is almost uniform, then the number of neighbors is about 2N*(area of the ball)/(area of the sphere) for N samples, 
+  // where the tree has 2N points, and the area of the ball with Euclidean radius r is pi*r^2. 
+  // The radius is enlarged by the distance in the fine scheme, which gives an upper bound without the counting pass. 
+  double radiusUpper = radius + m_MinDistanceInFineScheme;
+  double numberOfNeighborsEstimated = (double)numberOfSamples * 2.0*numberOfSamples*utl::min(1.0, radiusUpper*radiusUpper/4.0);
+  if (numberOfNeighborsEstimated>maxNumberOfNeighbors)
+    {
+    neighborList.Cache.resize(numberOfSamples);
+    return 0;
+    }
+
+  neighborList.Offsets.assign(numberOfSamples+1, 0);
+
+  // Radius search does not modify the kd-tree, thus the tree is shared by threads. 
+  // The first pass counts neighbors and the second pass fills them, which avoids temporary lists for all samples. 
+  int i=0;
+#pragma omp parallel for private(i) schedule(dynamic, 256)
+  for ( i = 0; i < numberOfSamples; ++i ) 
+    {
+    typename TreeType::InstanceIdentifierVectorType neighbors;
+    MeasurementVectorType queryPoint = (*m_FineScheme)[i];
+    m_KDTree->Search( queryPoint, radius, neighbors );
+    neighborList.Offsets[i+1] = neighbors.size();
+    }
+
+  for ( i = 0; i < numberOfSamples; ++i ) 
+    neighborList.Offsets[i+1] += neighborList.Offsets[i];
+
+  // It only happens if the fine scheme is not uniform. 
+  if (neighborList.Offsets[numberOfSamples]>maxNumberOfNeighbors)
+    {
+    std::vector<std::size_t>().swap(neighborList.Offsets);
+    neighborList.Cache.resize(numberOfSamples);
+    return 0;
+    }
+
+  neighborList.Indices.resize(neighborList.Offsets[numberOfSamples]);
+
+#pragma omp parallel for private(i) schedule(dynamic, 256)
+  for ( i = 0; i < numberOfSamples; ++i ) 
+    {
+    typename TreeType::InstanceIdentifierVectorType neighbors;
+    MeasurementVectorType queryPoint = (*m_FineScheme)[i];
+    m_KDTree->Search( queryPoint, radius, neighbors );
+    // samples 2*j and 2*j+1 in the tree are j-th sample and its antipodal point
+    for ( int k = 0; k < neighbors.size(); ++k ) 
+      neighborList.Indices[neighborList.Offsets[i]+k] = neighbors[k]/2;
+    }
+  return neighborList.Indices.size();
+}
+
+template< class TSamplingType >
+int
+SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
+::GetNeighbors(const NeighborListType& neighborList, const int i, const int*& neighbors, std::vector<int>& buffer) const
+{
+  if (neighborList.IsStored())
+    {
+    neighbors = neighborList.Indices.data()+neighborList.Offsets[i];
+    return neighborList.Offsets[i+1]-neighborList.Offsets[i];
+    }
+  // the sample itself is always in its neighbors, then an empty list is not cached
+  if (neighborList.Cache[i].size()>0)
+    {
+    neighbors = neighborList.Cache[i].data();
+    return neighborList.Cache[i].size();
+    }
+
+  typename TreeType::InstanceIdentifierVectorType neighborsInTree;
+  MeasurementVectorType queryPoint = (*m_FineScheme)[i];
+  m_KDTree->Search( queryPoint, neighborList.Radius, neighborsInTree );
+  buffer.resize(neighborsInTree.size());
+  for ( int k = 0; k < neighborsInTree.size(); ++k ) 
+    buffer[k] = neighborsInTree[k]/2;
+  neighbors = buffer.data();
+  return buffer.size();
+}
+
+template< class TSamplingType >
+void
+SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
+::CacheNeighbors(const IndexVectorType& candidates, const IndexVectorType& sumOverlaps, NeighborListType& neighborList) const
+{
+  if (neighborList.IsStored())
+    return;
+
+  // all cached lists are released if the cache is full. Lists of new candidates are always cached, 
+  // thus the cache may be larger than MaxNumberOfCachedNeighbors by the lists in one step. 
+  if (neighborList.NumberOfCachedNeighbors>neighborList.MaxNumberOfCachedNeighbors)
+    {
+    for ( int k = 0; k < neighborList.Cache.size(); ++k ) 
+      std::vector<int>().swap(neighborList.Cache[k]);
+    neighborList.NumberOfCachedNeighbors = 0;
+    }
+
+  // candidates which have not been evaluated. Candidates are unique, then threads write different lists. 
+  IndexVectorType samples;
+  for ( int c = 0; c < candidates.size(); ++c ) 
+    {
+    if (sumOverlaps[candidates[c]]<0 && neighborList.Cache[candidates[c]].size()==0)
+      samples.push_back(candidates[c]);
+    }
+
+  std::size_t numberOfNewNeighbors = 0;
+  int i=0;
+#pragma omp parallel for private(i) schedule(dynamic, 16) reduction(+:numberOfNewNeighbors)
+  for ( i = 0; i < (int)samples.size(); ++i ) 
+    {
+    std::vector<int>& neighbors = neighborList.Cache[samples[i]];
+    typename TreeType::InstanceIdentifierVectorType neighborsInTree;
+    MeasurementVectorType queryPoint = (*m_FineScheme)[samples[i]];
+    m_KDTree->Search( queryPoint, neighborList.Radius, neighborsInTree );
+    neighbors.resize(neighborsInTree.size());
+    for ( int k = 0; k < neighborsInTree.size(); ++k ) 
+      neighbors[k] = neighborsInTree[k]/2;
+    numberOfNewNeighbors += neighbors.size();
+    }
+  neighborList.NumberOfCachedNeighbors += numberOfNewNeighbors;
+}
+
+template< class TSamplingType >
+bool
+SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
+::FindMaxOverlap(const IndexVectorType& candidates, const IndexVectorType& sumOverlaps, int& indexMaxOverlap, int& sumMaxOverlap, int& numberOfCandidates)
+{
+  bool isIncreased = false;
+  for ( int i = 0; i < candidates.size(); ++i ) 
+    {
+    if (sumOverlaps[i]<0)
+      continue;
+    if (sumMaxOverlap<sumOverlaps[i])
+      {
+      indexMaxOverlap = candidates[i];
+      sumMaxOverlap = sumOverlaps[i];
+      isIncreased = true;
+      }
+    numberOfCandidates++;
+    }
+  return isIncreased;
+}
+
 template< class TSamplingType >
 bool
 SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
@@ -103,20 +271,52 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
     }
   bool needCoverageInshells = m_ChooseMinimalCoverageShell && !isSameAngle;
 
-  MeasurementVectorType queryPoint, queryCandidate;
+  MeasurementVectorType queryPoint;
   typedef typename TreeType::InstanceIdentifierVectorType InstanceIdentifierVectorType;
-  InstanceIdentifierVectorType neighbors, neighbors_1, candidates, candidates_1, neighbors_jj;
-  InstanceIdentifierVectorType candidateNumbersInOverlap;
+  InstanceIdentifierVectorType candidates, candidates_1;
     
   Index2DVectorPointer indices = this->m_FineScheme->GetIndicesInShells();
   indices->clear();
     
   Index2DVectorType chosenIndices(numberOfShells);
 
-  typedef utl_unordered_map<int, InstanceIdentifierVectorType> NeighborMapType;
-  typedef typename NeighborMapType::const_iterator NeighborMapIterator;
-  NeighborMapType neighborMap;
-  int indexDistPair;
+  if (numberOfShells>1)
+    {
+    for ( int s = 0; s < numberOfShells; ++s ) 
+      {
+      // It is impossible that the seperation angle in the combined shell is larger than the seperation angle in individual shell.
+      if (euclideanDistances[s]<= euclideanDistances.back())
+        return false;
+      }
+    }
+
+  // neighbors of all fine samples for the separation angle of each shell (and the combined shell)
+  // The memory is bounded by m_MaxNumberOfStoredNeighbors. Lists are stored from the smallest radius, 
+  // and lists with large radii which are not stored use caches of touched samples with the rest of the memory. 
+  std::vector<NeighborListType> neighborLists(angles.size());
+  std::vector<std::pair<double,int> > radiusOrder(angles.size());
+  for ( int i = 0; i < angles.size(); ++i ) 
+    radiusOrder[i] = std::pair<double,int>(euclideanDistances[i], i);
+  std::sort(radiusOrder.begin(), radiusOrder.end());
+  std::size_t numberOfStoredNeighbors = 0;
+  int numberOfCachedLists = 0;
+  for ( int k = 0; k < radiusOrder.size(); ++k ) 
+    {
+    NeighborListType& neighborList = neighborLists[radiusOrder[k].second];
+    numberOfStoredNeighbors += ComputeNeighborList(radiusOrder[k].first, m_MaxNumberOfStoredNeighbors-numberOfStoredNeighbors, neighborList);
+    if (!neighborList.IsStored())
+      numberOfCachedLists++;
+    }
+  for ( int i = 0; i < neighborLists.size(); ++i ) 
+    {
+    if (!neighborLists[i].IsStored())
+      neighborLists[i].MaxNumberOfCachedNeighbors = (m_MaxNumberOfStoredNeighbors-numberOfStoredNeighbors)/numberOfCachedLists;
+    }
+  std::vector<int> neighborBuffer, neighborBuffer_1;
+
+  // candidates in the current step, and their overlap sums which are evaluated in parallel
+  IndexVectorType candidateVec, sumOverlaps;
+  int c=0;
 
   if (numberOfShells==1)
     {
@@ -129,29 +329,17 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
 
     while (chosenIndices[0].size()< this->m_NumbersInShell[0] )
       {
-      // std::cout << "\n chosenIndices[0.size()=" << chosenIndices[0.size() << std::endl << std::flush;
-
       hasChosen[currentIndex]=0;
       chosenIndices[0].push_back(currentIndex);
       queryPoint = (*m_FineScheme)[currentIndex];
-      // std::cout << "queryPoint = " << queryPoint << std::endl << std::flush;
       
-      indexDistPair=currentIndex;
-
-      NeighborMapIterator mapIter = neighborMap.find(indexDistPair);
-      if (mapIter==neighborMap.end())
-        {
-        m_KDTree->Search( queryPoint, euclideanDistances[0], neighbors );
-        neighborMap[indexDistPair] = neighbors;
-        }
-      else
-        neighbors = mapIter->second;
-      for ( int i = 0; i < neighbors.size(); ++i ) 
-        hasChosen[neighbors[i]/2] = 0;
+      const int* neighbors = NULL;
+      int numberOfNeighbors = GetNeighbors(neighborLists[0], currentIndex, neighbors, neighborBuffer);
+      for ( int i = 0; i < numberOfNeighbors; ++i ) 
+        hasChosen[neighbors[i]] = 0;
 
       m_KDTree->Search( queryPoint, euclideanDistances[0]+1*m_MinDistanceInFineScheme, candidates );
-      utlException(candidates.size()<=neighbors.size(), "the size of candidates should be larger than the size of neighbors.");
-      // utlPrintVar2(true, neighbors.size(), candidates.size());
+      utlException(candidates.size()<=numberOfNeighbors, "the size of candidates should be larger than the size of neighbors.");
       for ( int i = 0; i < candidates.size(); ++i ) 
         {
         int jj = candidates[i]/2;
@@ -159,59 +347,53 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
           nextCandidateIndices.insert(jj);
         }
 
-      int indexMaxOverlap=-1;
-      int sumMaxOverlap=-1;
-      int numberOfCandidates=0, numberSearch=0;
-      // utl::Tic(std::cout<<"time");
-// #pragma omp parallel shared(indexMaxOverlap, sumMaxOverlap) private(iter, neighbors_jj, queryCandidate) firstprivate(indexMaxOverlap_ii, sumMaxOverlap_ii)
-      for ( typename std::set<int>::iterator iter = nextCandidateIndices.begin(); iter!=nextCandidateIndices.end(); ++iter ) 
+      // covered samples are never candidates again, then they are removed
+      candidateVec.clear();
+      for ( typename std::set<int>::iterator iter = nextCandidateIndices.begin(); iter!=nextCandidateIndices.end(); ) 
         {
-        int jj = *iter;
-        if (hasChosen[jj]==-1)
-          {
-          queryCandidate = (*m_FineScheme)[jj];
-          bool overlapBall = true;
-          double innerProduct = 0;
-          for ( int kk = 0; kk < 3; ++kk ) 
-            innerProduct+= queryPoint[kk]*queryCandidate[kk];
-          if (std::fabs(innerProduct) < overlapBallsInnerProduct[0])
-            overlapBall = false;
-            
-          int sumOverlap = 0;
-          if (sumOverlapVec[0][jj]>=0 && !overlapBall)
-            sumOverlap = sumOverlapVec[0][jj];
-          else
-            {
-          //  sumOverlapVec[0][jj]<0 || (sumOverlapVec[0][jj]>=0 && overlapBall) 
-            // m_KDTree->Search( queryCandidate, euclideanDistances[0], neighbors_jj );
-            indexDistPair=jj;
-            NeighborMapIterator mapIter = neighborMap.find(indexDistPair);
-            if (mapIter==neighborMap.end())
-              {
-              m_KDTree->Search( queryCandidate, euclideanDistances[0], neighbors_jj );
-              neighborMap[indexDistPair] = neighbors_jj;
-              }
-            else
-              neighbors_jj = mapIter->second;
-            numberSearch++;
-            for ( int k = 0; k < neighbors_jj.size(); ++k ) 
-              {
-              if (hasChosen[neighbors_jj[k]/2]==0)
-                sumOverlap++;
-              }
-            sumOverlapVec[0][jj]=sumOverlap;
-            }
+        if (hasChosen[*iter]==-1)
+          candidateVec.push_back(*(iter++));
+        else
+          nextCandidateIndices.erase(iter++);
+        }
 
-          if (sumMaxOverlap<sumOverlap)
+      CacheNeighbors(candidateVec, sumOverlapVec[0], neighborLists[0]);
+      sumOverlaps.assign(candidateVec.size(), -1);
+#pragma omp parallel for private(c) schedule(dynamic, 16)
+      for ( c = 0; c < (int)candidateVec.size(); ++c ) 
+        {
+        int jj = candidateVec[c];
+        MeasurementVectorType queryCandidate = (*m_FineScheme)[jj];
+        bool overlapBall = true;
+        double innerProduct = 0;
+        for ( int kk = 0; kk < 3; ++kk ) 
+          innerProduct+= queryPoint[kk]*queryCandidate[kk];
+        if (std::fabs(innerProduct) < overlapBallsInnerProduct[0])
+          overlapBall = false;
+          
+        int sumOverlap = 0;
+        if (sumOverlapVec[0][jj]>=0 && !overlapBall)
+          sumOverlap = sumOverlapVec[0][jj];
+        else
+          {
+          // the buffer is used only if neighbors are not stored
+          std::vector<int> neighborBuffer_jj;
+          const int* neighbors_jj = NULL;
+          int numberOfNeighbors_jj = GetNeighbors(neighborLists[0], jj, neighbors_jj, neighborBuffer_jj);
+          for ( int k = 0; k < numberOfNeighbors_jj; ++k ) 
             {
-            indexMaxOverlap = jj;
-            sumMaxOverlap = sumOverlap;
+            if (hasChosen[neighbors_jj[k]]==0)
+              sumOverlap++;
             }
-          numberOfCandidates++;
+          sumOverlapVec[0][jj]=sumOverlap;
           }
+        sumOverlaps[c] = sumOverlap;
         }
-      // utl::Toc();
-      // utlPrintVar2(true, numberOfCandidates, numberSearch);
+
+      int indexMaxOverlap=-1;
+      int sumMaxOverlap=-1;
+      int numberOfCandidates=0;
+      FindMaxOverlap(candidateVec, sumOverlaps, indexMaxOverlap, sumMaxOverlap, numberOfCandidates);
 
       if (numberOfCandidates==0)
         break;
@@ -229,20 +411,9 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
     }
   else
     {
-
-    // utl::PrintVector(this->m_NumbersInShell, "this->m_NumbersInShell");
-    // utlPrintVar1(true, totalNumberOfSamples);
-    // utl::PrintVector(euclideanDistances, "euclideanDistances 11");
-    // utl::PrintVector(angles, "angles 11");
-    for ( int s = 0; s < numberOfShells; ++s ) 
-      {
-      // It is impossible that the seperation angle in the combined shell is larger than the seperation angle in individual shell.
-      if (euclideanDistances[s]<= euclideanDistances.back())
-        return false;
-      }
-
     Index2DVectorType hasChosen(numberOfSamples, IndexVectorType(angles.size(),-1));
     std::vector<std::set<int> > nextCandidateIndices(numberOfShells+1);
+    NeighborListType& neighborList_1 = neighborLists[numberOfShells];
 
     // the first sample in each shell
     int currentIndex = 0;
@@ -254,41 +425,24 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
       chosenIndices[s].push_back(currentIndex);
       queryPoint = (*m_FineScheme)[currentIndex];
 
-      // utlPrintVar1(true, currentIndex);
-      // std::cout << "queryPoint=" << queryPoint << std::endl << std::flush;
-      
-      indexDistPair=currentIndex + s*numberOfSamples;
-      NeighborMapIterator mapIter = neighborMap.find(indexDistPair);
-      if (mapIter==neighborMap.end())
-        {
-        m_KDTree->Search( queryPoint, euclideanDistances[s], neighbors );
-        neighborMap[indexDistPair] = neighbors;
-        }
-      else
-        neighbors = mapIter->second;
-      for ( int i = 0; i < neighbors.size(); ++i ) 
-        hasChosen[neighbors[i]/2][s] = 0;
+      const int* neighbors = NULL;
+      int numberOfNeighbors = GetNeighbors(neighborLists[s], currentIndex, neighbors, neighborBuffer);
+      for ( int i = 0; i < numberOfNeighbors; ++i ) 
+        hasChosen[neighbors[i]][s] = 0;
       // update coverages
       if (needCoverageInshells)
-        coverageInShells[s] += neighbors.size();
+        coverageInShells[s] += numberOfNeighbors;
 
-      indexDistPair=currentIndex + numberOfShells*numberOfSamples;
-      mapIter = neighborMap.find(indexDistPair);
-      if (mapIter==neighborMap.end())
-        {
-        m_KDTree->Search( queryPoint, euclideanDistances.back(), neighbors_1 );
-        neighborMap[indexDistPair] = neighbors_1;
-        }
-      else
-        neighbors_1 = mapIter->second;
-      for ( int i = 0; i < neighbors_1.size(); ++i ) 
-        hasChosen[neighbors_1[i]/2][numberOfShells] = s;
+      const int* neighbors_1 = NULL;
+      int numberOfNeighbors_1 = GetNeighbors(neighborList_1, currentIndex, neighbors_1, neighborBuffer_1);
+      for ( int i = 0; i < numberOfNeighbors_1; ++i ) 
+        hasChosen[neighbors_1[i]][numberOfShells] = s;
             
       m_KDTree->Search( queryPoint, euclideanDistances[s]+1*m_MinDistanceInFineScheme, candidates );
-      utlException(candidates.size()<=neighbors.size(), "the size of candidates should be larger than the size of neighbors.");
+      utlException(candidates.size()<=numberOfNeighbors, "the size of candidates should be larger than the size of neighbors.");
 
       m_KDTree->Search( queryPoint, euclideanDistances.back()+1*m_MinDistanceInFineScheme, candidates_1 );
-      utlException(candidates_1.size()<=neighbors_1.size(), "the size of candidates should be larger than the size of neighbors.");
+      utlException(candidates_1.size()<=numberOfNeighbors_1, "the size of candidates should be larger than the size of neighbors.");
 
       for ( int i = 0; i < candidates.size(); ++i ) 
         {
@@ -311,74 +465,66 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
           }
         }
 
-      int indexMaxOverlap=-1;
-      int sumMaxOverlap=-1;
-      int numberOfCandidates=0, numberSearch=0;
+      std::set<int>& candidateSet = nextCandidateIndices[numberOfShells];
+      candidateVec.clear();
+      for ( typename std::set<int>::iterator iter = candidateSet.begin(); iter!=candidateSet.end(); ) 
+        {
+        if (hasChosen[*iter][numberOfShells]==-1)
+          candidateVec.push_back(*(iter++));
+        else
+          candidateSet.erase(iter++);
+        }
 
-      for ( typename std::set<int>::iterator iter = nextCandidateIndices[numberOfShells].begin(); iter!=nextCandidateIndices[numberOfShells].end(); ++iter ) 
+      CacheNeighbors(candidateVec, sumOverlapVec[numberOfShells], neighborList_1);
+      sumOverlaps.assign(candidateVec.size(), -1);
+#pragma omp parallel for private(c) schedule(dynamic, 16)
+      for ( c = 0; c < (int)candidateVec.size(); ++c ) 
         {
-        int jj = *iter;
-        if (hasChosen[jj][numberOfShells]==-1)
+        int jj = candidateVec[c];
+        MeasurementVectorType queryCandidate = (*m_FineScheme)[jj];
+        bool overlapBall = true;
+        double innerProduct = 0;
+        for ( int kk = 0; kk < 3; ++kk ) 
+          innerProduct+= queryPoint[kk]*queryCandidate[kk];
+        if (std::fabs(innerProduct) < overlapBallsInnerProduct[numberOfShells])
+          overlapBall = false;
+
+        int sumOverlap = 0;
+        if (sumOverlapVec[numberOfShells][jj]>=0 && !overlapBall)
+          sumOverlap = sumOverlapVec[numberOfShells][jj];
+        else
           {
-          queryCandidate = (*m_FineScheme)[jj];
-          bool overlapBall = true;
-          double innerProduct = 0;
-          for ( int kk = 0; kk < 3; ++kk ) 
-            innerProduct+= queryPoint[kk]*queryCandidate[kk];
-          if (std::fabs(innerProduct) < overlapBallsInnerProduct[numberOfShells])
-            overlapBall = false;
-
-          int sumOverlap = 0;
-          if (sumOverlapVec[numberOfShells][jj]>=0 && !overlapBall)
-            sumOverlap = sumOverlapVec[numberOfShells][jj];
-          else
-            {
-          //  sumOverlapVec[numberOfShells][jj]<0 || (sumOverlapVec[numberOfShells][jj]>=0 && overlapBall) 
-            // m_KDTree->Search( queryCandidate, euclideanDistances.back(), neighbors_jj );
-            indexDistPair = jj + numberOfShells*numberOfSamples;
-            mapIter = neighborMap.find(indexDistPair);
-            if (mapIter==neighborMap.end())
-              {
-              m_KDTree->Search( queryCandidate, euclideanDistances.back(), neighbors_jj );
-              neighborMap[indexDistPair] = neighbors_jj;
-              }
-            else
-              neighbors_jj = mapIter->second;
-            numberSearch++;
-            for ( int k = 0; k < neighbors_jj.size(); ++k ) 
-              {
-              if (hasChosen[neighbors_jj[k]/2][numberOfShells]>=0)
-                sumOverlap++;
-              }
-            sumOverlapVec[numberOfShells][jj]=sumOverlap;
-            }
-
-          if (sumMaxOverlap<sumOverlap)
+          // the buffer is used only if neighbors are not stored
+          std::vector<int> neighborBuffer_jj;
+          const int* neighbors_jj = NULL;
+          int numberOfNeighbors_jj = GetNeighbors(neighborList_1, jj, neighbors_jj, neighborBuffer_jj);
+          for ( int k = 0; k < numberOfNeighbors_jj; ++k ) 
             {
-            indexMaxOverlap = jj;
-            sumMaxOverlap = sumOverlap;
+            if (hasChosen[neighbors_jj[k]][numberOfShells]>=0)
+              sumOverlap++;
             }
-          numberOfCandidates++;
+          sumOverlapVec[numberOfShells][jj]=sumOverlap;
           }
+        sumOverlaps[c] = sumOverlap;
         }
 
+      int indexMaxOverlap=-1;
+      int sumMaxOverlap=-1;
+      int numberOfCandidates=0;
+      FindMaxOverlap(candidateVec, sumOverlaps, indexMaxOverlap, sumMaxOverlap, numberOfCandidates);
+
       currentIndex = indexMaxOverlap;
       }
 
-    // for ( int i = 0; i < chosenIndices.size(); ++i ) 
-    //   utl::PrintVector(chosenIndices[i], "chosenIndices[i]");
-
     // all other samples 
     MeasurementVectorType queryPointLast(queryPoint);
-    int indexShellMaxOverlap=-1, indexShellMaxOverlapLast=-1, shellIndexMinCoverage=-1;
+    int indexShellMaxOverlap=-1, shellIndexMinCoverage=-1;
 
     for ( unsigned int n = numberOfShells; n < totalNumberOfSamples; ++n ) 
       {
-      // std::cout << "n = " << n << std::endl << std::flush;
-
       int indexMaxOverlap=-1;
       int sumMaxOverlap=-1;
-      int numberOfCandidates=0, numberSearch=0;
+      int numberOfCandidates=0;
 
       if (needCoverageInshells)
         {
@@ -403,60 +549,54 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
 
         if (chosenIndices[s].size() < this->m_NumbersInShell[s])
           {
+          std::set<int>& candidateSet = nextCandidateIndices[s];
+          candidateVec.clear();
+          for ( typename std::set<int>::iterator iter = candidateSet.begin(); iter!=candidateSet.end(); ) 
+            {
+            if (hasChosen[*iter][s]==-1 && hasChosen[*iter][numberOfShells]==-1)
+              candidateVec.push_back(*(iter++));
+            else
+              candidateSet.erase(iter++);
+            }
 
-          for ( typename std::set<int>::iterator iter = nextCandidateIndices[s].begin(); iter!=nextCandidateIndices[s].end(); ++iter ) 
+          CacheNeighbors(candidateVec, sumOverlapVec[s], neighborLists[s]);
+          sumOverlaps.assign(candidateVec.size(), -1);
+#pragma omp parallel for private(c) schedule(dynamic, 16)
+          for ( c = 0; c < (int)candidateVec.size(); ++c ) 
             {
-            int jj = *iter;
-            if (hasChosen[jj][s]==-1 && hasChosen[jj][numberOfShells]==-1)
+            int jj = candidateVec[c];
+            MeasurementVectorType queryCandidate = (*m_FineScheme)[jj];
+            bool overlapBall = true;
+            if (n>numberOfShells)
               {
-              queryCandidate = (*m_FineScheme)[jj];
-              bool overlapBall = true;
-              if (n>numberOfShells)
-                {
-                double innerProduct = 0;
-                for ( int kk = 0; kk < 3; ++kk ) 
-                  innerProduct+= queryPointLast[kk]*queryCandidate[kk];
-                // if ( ( std::fabs(innerProduct) < overlapBallsInnerProduct[numberOfShells]) 
-                //   || (indexShellMaxOverlapLast==s && std::fabs(innerProduct) < overlapBallsInnerProduct[s]) )
-                if ( std::fabs(innerProduct) < overlapBallsInnerProduct[s] )
-                  overlapBall = false;
-                }
-
-              int sumOverlap = 0;
-              if (sumOverlapVec[s][jj]>=0 && !overlapBall)
-                sumOverlap = sumOverlapVec[s][jj];
-              else
-                {
-                 // sumOverlapVec[s][jj]<0 || (sumOverlapVec[s][jj]>=0 && overlapBall) 
-                indexDistPair=jj + s*numberOfSamples;
-                NeighborMapIterator mapIter = neighborMap.find(indexDistPair);
-                if (mapIter==neighborMap.end())
-                  {
-                  m_KDTree->Search( queryCandidate, euclideanDistances[s], neighbors_jj );
-                  neighborMap[indexDistPair] = neighbors_jj;
-                  }
-                else
-                  neighbors_jj = mapIter->second;
-                numberSearch++;
-                for ( int k = 0; k < neighbors_jj.size(); ++k ) 
-                  {
-                  if (hasChosen[neighbors_jj[k]/2][s]>=0 || hasChosen[neighbors_jj[k]/2][numberOfShells]>=0)
-                    sumOverlap++;
-                  }
-                sumOverlapVec[s][jj]=sumOverlap;
-                }
+              double innerProduct = 0;
+              for ( int kk = 0; kk < 3; ++kk ) 
+                innerProduct+= queryPointLast[kk]*queryCandidate[kk];
+              if ( std::fabs(innerProduct) < overlapBallsInnerProduct[s] )
+                overlapBall = false;
+              }
 
-              // utlPrintVar3(true, s, jj, sumOverlap);
-              if (sumMaxOverlap<sumOverlap)
+            int sumOverlap = 0;
+            if (sumOverlapVec[s][jj]>=0 && !overlapBall)
+              sumOverlap = sumOverlapVec[s][jj];
+            else
+              {
+              // the buffer is used only if neighbors are not stored
+              std::vector<int> neighborBuffer_jj;
+              const int* neighbors_jj = NULL;
+              int numberOfNeighbors_jj = GetNeighbors(neighborLists[s], jj, neighbors_jj, neighborBuffer_jj);
+              for ( int k = 0; k < numberOfNeighbors_jj; ++k ) 
                 {
-                indexShellMaxOverlap = s;
-                indexMaxOverlap = jj;
-                sumMaxOverlap = sumOverlap;
+                if (hasChosen[neighbors_jj[k]][s]>=0 || hasChosen[neighbors_jj[k]][numberOfShells]>=0)
+                  sumOverlap++;
                 }
-              numberOfCandidates++;
+              sumOverlapVec[s][jj]=sumOverlap;
               }
+            sumOverlaps[c] = sumOverlap;
             }
 
+          if (FindMaxOverlap(candidateVec, sumOverlaps, indexMaxOverlap, sumMaxOverlap, numberOfCandidates))
+            indexShellMaxOverlap = s;
           }
         }
 
@@ -464,7 +604,6 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
         break;
 
       currentIndex = indexMaxOverlap;
-      indexShellMaxOverlapLast = indexMaxOverlap;
 
       hasChosen[currentIndex][indexShellMaxOverlap]=0;
       hasChosen[currentIndex][numberOfShells]=indexShellMaxOverlap;
@@ -472,43 +611,29 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
       queryPoint = (*m_FineScheme)[currentIndex];
       queryPointLast = queryPoint;
 
-      indexDistPair=currentIndex+indexShellMaxOverlap*numberOfSamples;
-      NeighborMapIterator mapIter = neighborMap.find(indexDistPair);
-      if (mapIter==neighborMap.end())
-        {
-        m_KDTree->Search( queryPoint, euclideanDistances[indexShellMaxOverlap], neighbors );
-        neighborMap[indexDistPair] = neighbors;
-        }
-      else
-        neighbors = mapIter->second;
-      for ( int i = 0; i < neighbors.size(); ++i ) 
+      const int* neighbors = NULL;
+      int numberOfNeighbors = GetNeighbors(neighborLists[indexShellMaxOverlap], currentIndex, neighbors, neighborBuffer);
+      for ( int i = 0; i < numberOfNeighbors; ++i ) 
         {
         // update coverages
         if (needCoverageInshells)
           {
-          if (hasChosen[neighbors[i]/2][indexShellMaxOverlap]==-1)
+          if (hasChosen[neighbors[i]][indexShellMaxOverlap]==-1)
             coverageInShells[indexShellMaxOverlap]++;
           }
-        hasChosen[neighbors[i]/2][indexShellMaxOverlap] = 0;
+        hasChosen[neighbors[i]][indexShellMaxOverlap] = 0;
         }
 
-      indexDistPair=currentIndex+numberOfShells*numberOfSamples;
-      mapIter = neighborMap.find(indexDistPair);
-      if (mapIter==neighborMap.end())
-        {
-        m_KDTree->Search( queryPoint, euclideanDistances.back(), neighbors_1 );
-        neighborMap[indexDistPair] = neighbors_1;
-        }
-      else
-        neighbors_1 = mapIter->second;
-      for ( int i = 0; i < neighbors_1.size(); ++i ) 
-        hasChosen[neighbors_1[i]/2][numberOfShells] = indexShellMaxOverlap;
+      const int* neighbors_1 = NULL;
+      int numberOfNeighbors_1 = GetNeighbors(neighborList_1, currentIndex, neighbors_1, neighborBuffer_1);
+      for ( int i = 0; i < numberOfNeighbors_1; ++i ) 
+        hasChosen[neighbors_1[i]][numberOfShells] = indexShellMaxOverlap;
 
       m_KDTree->Search( queryPoint, euclideanDistances[indexShellMaxOverlap]+1*m_MinDistanceInFineScheme, candidates );
-      utlException(candidates.size()<=neighbors.size(), "the size of candidates should be larger than the size of neighbors.");
+      utlException(candidates.size()<=numberOfNeighbors, "the size of candidates should be larger than the size of neighbors.");
 
       m_KDTree->Search( queryPoint, euclideanDistances.back()+1*m_MinDistanceInFineScheme, candidates_1 );
-      utlException(candidates_1.size()<=neighbors_1.size(), "the size of candidates should be larger than the size of neighbors.");
+      utlException(candidates_1.size()<=numberOfNeighbors_1, "the size of candidates should be larger than the size of neighbors.");
 
       for ( int i = 0; i < candidates.size(); ++i ) 
         {
@@ -533,8 +658,6 @@ SamplingSchemeQSpaceIMOCEstimationFilter< TSamplingType >
 
       }
 
-    // for ( int i = 0; i < chosenIndices.size(); ++i ) 
-    //   utl::PrintVector(chosenIndices[i], "chosenIndices[i]");
     for ( int i = 0; i < chosenIndices.size(); ++i ) 
       {
       if (chosenIndices[i].size()!=this->m_NumbersInShell[i])
@@ -75,6 +75,15 @@ protected:
   ~SamplingSchemeQSpaceIncrementalEstimationFilter(){}
   
   void Initialization() ITK_OVERRIDE;
+
+  /** Update running values between candidates and chosen samples, after the sample sampleIndex is added in the shell shellIndex. 
+   * The values are maximal absolute dots for DISTANCE, and energies for ELECTROSTATIC. 
+   * values[s] is for the s-th shell, and values.back() is for all shells. 
+   * */
+  void UpdateCandidateValues(const MatrixType& orientations, const std::vector<char>& hasChosen, const int sampleIndex, const int shellIndex, std::vector<STDVectorType>& values) const;
+
+  /** index of the candidate (not chosen) with the minimal value  */
+  static int ArgminInCandidates(const STDVectorType& values, const std::vector<char>& hasChosen);
   
   /** the order of tessellation for the orignal fine mesh  */
   unsigned int m_TessellationOrder;
@@ -90,6 +90,66 @@ SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
 //     }
 // }
 
+template< class TSamplingType >
+void
+SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
+::UpdateCandidateValues(const MatrixType& orientations, const std::vector<char>& hasChosen, const int sampleIndex, const int shellIndex, std::vector<STDVectorType>& values) const
+{
+  int numberOfSamples = orientations.Rows();
+  int allShellIndex = values.size()-1;
+  bool isDistance = this->m_CriteriaType==Self::DISTANCE;
+  bool orderEqual2 = std::abs(this->m_ElectrostaticOrder-2)<1e-8 ? true : false;
+  double x = orientations(sampleIndex,0);
+  double y = orientations(sampleIndex,1);
+  double z = orientations(sampleIndex,2);
+
+  int j;
+#pragma omp parallel for private(j)
+  for ( j = 0; j < numberOfSamples; ++j ) 
+    {
+    if (hasChosen[j])
+      continue;
+    double dot = x*orientations(j,0) + y*orientations(j,1) + z*orientations(j,2);
+    if (isDistance)
+      {
+      if (dot<0)
+        dot = -dot;
+      if (shellIndex<allShellIndex && dot>values[shellIndex][j])
+        values[shellIndex][j] = dot;
+      if (dot>values[allShellIndex][j])
+        values[allShellIndex][j] = dot;
+      }
+    else
+      {
+      double result1 = 2+2*dot;
+      double result2 = 2-2*dot;
+      double value = (!orderEqual2) ? (1.0/std::pow(result1, this->m_ElectrostaticOrder*0.5) + 1.0/std::pow(result2, this->m_ElectrostaticOrder*0.5)) : (1.0/result1 + 1.0/result2);  
+      if (shellIndex<allShellIndex)
+        values[shellIndex][j] += value;
+      values[allShellIndex][j] += value;
+      }
+    }
+}
+
+template< class TSamplingType >
+int
+SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
+::ArgminInCandidates(const STDVectorType& values, const std::vector<char>& hasChosen)
+{
+  int index=-1;
+  double minValue=std::numeric_limits<double>::max();
+  for ( unsigned int j = 0; j < values.size(); j += 1 ) 
+    {
+    if (hasChosen[j]==0 && values[j] < minValue)
+      {
+      minValue = values[j];
+      index = j;
+      }
+    }
+  utlGlobalException(index<0, "no candidate left. Use a finer tessellation.");
+  return index;
+}
+
 template< class TSamplingType >
 void
 SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
@@ -97,6 +157,9 @@ SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
 {
   Initialization();
 
+  utlGlobalException(this->m_CriteriaType!=Self::DISTANCE && this->m_CriteriaType!=Self::ELECTROSTATIC, "wrong m_CriteriaType");
+  utlGlobalException(this->m_NumbersInShell.size()==0, "need to set this->m_NumbersInShell");
+
   unsigned int numberOfShells = this->m_NumbersInShell.size();
   unsigned int numberInitialSamples = 0;
   if (this->m_InitialOrientations) 
@@ -109,414 +172,107 @@ SamplingSchemeQSpaceIncrementalEstimationFilter< TSamplingType >
   unsigned int numberOfSamples = output->GetNumberOfSamples();
   MatrixPointer outputMatrix = output->GetOrientationsCartesian();
 
-  // itk::TimeProbe clock;
-  // clock.Start();
-  // MatrixPointer dotMatrix (new MatrixType()); 
-  // MatrixPointer elecMatrix (new MatrixType()); 
-  // if (numberOfShells>1)
-  //   {
-  //   if (this->m_CriteriaType==Self::DISTANCE)
-  //     dotMatrix = output->CalculateInnerProductMatrix(true);
-  //   else if (this->m_CriteriaType==Self::ELECTROSTATIC)
-  //     elecMatrix = output->CalculateElectrostaticEnergyMatrix(this->m_ElectrostaticOrder);
-  //   }
-  // clock.Stop();
-  // std::cout << "after matrix calculation: " << clock.GetTotal() << std::endl;
-
-  utlGlobalException(this->m_NumbersInShell.size()==0, "need to set this->m_NumbersInShell");
   unsigned int totalNumbers=0;
   for ( unsigned int i = 0; i < this->m_NumbersInShell.size(); i += 1 ) 
     {
     totalNumbers += this->m_NumbersInShell[i];
     }
 
-  std::vector<int> chosenIndex;
   std::vector<char> hasChosen(numberOfSamples, 0);
   std::cout << "numberOfShells = " << numberOfShells << std::endl << std::flush;
   std::cout << "numberOfSamples = " << numberOfSamples << std::endl << std::flush;
 
   if (!this->m_InitialOrientations)
     {
-    // first two points
-    int d0, d1;
-    // clock.Start();
-    // if (numberOfShells>1)
-    //   {
-    //   if (this->m_CriteriaType==Self::DISTANCE)
-    //     utl::ArgminSymmetricMatrix<MatrixType>(*dotMatrix, numberOfSamples, d0, d1, false);
-    //   else if (this->m_CriteriaType==Self::ELECTROSTATIC)
-    //     utl::ArgminSymmetricMatrix<MatrixType>(*elecMatrix, numberOfSamples, d0, d1, false);
-    //   }
-
-    IndexVectorType indexTmp;
-    // utlPrintVar2(true, d0, d1);
-    // clock.Stop();
-    // std::cout << "after matrix minimal: " << clock.GetTotal() << std::endl;
-    if (numberOfShells==1)
-      {
-      d0=0;
-      indexTmp.push_back(d0);
-      // indexTmp.push_back(d1);
-      indices->push_back(indexTmp);
-      }
-    else
-      {
-      d0=0;
-      indexTmp.push_back(d0);
-      indices->push_back(indexTmp);
-      // indexTmp[0] = d1;
-      // indices->push_back(indexTmp);
-      }
-    chosenIndex.push_back(d0);
-    // chosenIndex.push_back(d1);
-    hasChosen[d0] = 1; 
-    // hasChosen[d1] = 1;
+    // first point
+    IndexVectorType indexTmp(1, 0);
+    indices->push_back(indexTmp);
     }
 
+  // Running maximal absolute dots (DISTANCE) or energies (ELECTROSTATIC) between each candidate and the chosen samples, 
+  // in each shell and in all shells (the last row). There is only one row for single shell. 
+  // When a sample is accepted, the rows are updated in O(numberOfSamples), instead of recalculated from all chosen samples. 
+  bool isDistance = this->m_CriteriaType==Self::DISTANCE;
+  std::vector<STDVectorType> values(numberOfShells==1 ? 1 : numberOfShells+1, STDVectorType(numberOfSamples, isDistance ? -1.0 : 0.0));
+
   for ( unsigned int i = 0; i < indices->size(); i += 1 ) 
     for ( unsigned int j = 0; j < (*indices)[i].size(); j += 1 ) 
-      {
-      int ii = (*indices)[i][j];
-      chosenIndex.push_back(ii);
-      hasChosen[ii] = 1;
-      }
+      hasChosen[(*indices)[i][j]] = 1;
+  // NOTE: each chosen sample contributes once. The first point is not counted twice in energies. 
+  for ( unsigned int i = 0; i < indices->size(); i += 1 ) 
+    for ( unsigned int j = 0; j < (*indices)[i].size(); j += 1 ) 
+      UpdateCandidateValues(*outputMatrix, hasChosen, (*indices)[i][j], i, values);
 
   if (numberOfShells==1)
     {
-
-    if (this->m_CriteriaType==Self::DISTANCE)
-      {
-      double x,y,z,x1,y1,z1;
-      std::vector<double> maxDots(numberOfSamples, -1); 
-      // clock.Start();
-      for ( unsigned int i = (this->m_InitialOrientations?numberInitialSamples:1); i < totalNumbers; i += 1 ) 
-        {
-        int index=-1;
-        double minValue=std::numeric_limits<double>::max();
-        for ( unsigned int j = 0; j < numberOfSamples; j += 1 ) 
-          {
-          if (hasChosen[j]==0)
-            {
-            double maxValue_j = -std::numeric_limits<double>::max();
-            x = output->operator[](j)[0];
-            y = output->operator[](j)[1];
-            z = output->operator[](j)[2];
-            if (maxDots[j]< 0 )
-              {
-              for ( unsigned int k = 0; k < chosenIndex.size(); k += 1 ) 
-                {
-                unsigned int kk = chosenIndex[k];
-                // double value = dotMatrix->operator()(j,kk);
-                x1 = output->operator[](kk)[0];
-                y1 = output->operator[](kk)[1];
-                z1 = output->operator[](kk)[2];
-                double value = x*x1 + y*y1 + z*z1;
-                if (value<0)
-                  value = -value;
-                if (value>maxValue_j)
-                  maxValue_j = value;
-                }
-              maxDots[j] = maxValue_j;
-              }
-            else
-              {
-              unsigned int kk = chosenIndex.back();
-              // double value = dotMatrix->operator()(j,kk);
-              x1 = output->operator[](kk)[0];
-              y1 = output->operator[](kk)[1];
-              z1 = output->operator[](kk)[2];
-              double value = x*x1 + y*y1 + z*z1;
-              if (value<0)
-                value = -value;
-              if (value > maxDots[j] )
-                maxDots[j] = value;
-              maxValue_j = maxDots[j];
-              }
-
-            if (maxValue_j < minValue )
-              {
-              minValue = maxValue_j;
-              index = j;
-              }
-            }
-          }
-
-        chosenIndex.push_back(index);
-        hasChosen[index] = 1;
-        indices->operator[](0).push_back(index);
-        }
-    // clock.Stop();
-    // std::cout << "after loop: " << clock.GetTotal() << std::endl;
-      }
-    else if (this->m_CriteriaType==Self::ELECTROSTATIC)
+    // minimize the maximal dot or the energy
+    for ( unsigned int i = (this->m_InitialOrientations?numberInitialSamples:1); i < totalNumbers; i += 1 ) 
       {
-      double x,y,z,x1,y1,z1;
-      bool orderEqual2 = std::abs(this->m_ElectrostaticOrder-2)<1e-8 ? true : false;
-      std::vector<double> energy(numberOfSamples,0.0);
-      // clock.Start();
-      for ( unsigned int i = (this->m_InitialOrientations?numberInitialSamples:1); i < totalNumbers; i += 1 ) 
-        {
-        int index=-1;
-        double minValue=std::numeric_limits<double>::max();
-        for ( unsigned int j = 0; j < numberOfSamples; j += 1 ) 
-          {
-          if (hasChosen[j]==0)
-            {
-            x = output->operator[](j)[0];
-            y = output->operator[](j)[1];
-            z = output->operator[](j)[2];
-            if (energy[j]<1e-10)
-              {
-              for ( unsigned int k = 0; k < chosenIndex.size(); k += 1 ) 
-                {
-                unsigned int kk = chosenIndex[k];
-                // double value = elecMatrix->operator()(j,kk);
-                x1 = output->operator[](kk)[0];
-                y1 = output->operator[](kk)[1];
-                z1 = output->operator[](kk)[2];
-                double dot = x*x1 + y*y1 + z*z1;
-                double result1 = 2+2*dot;
-                double result2 = 2-2*dot;
-                double value = (!orderEqual2) ? (1.0/std::pow(result1, this->m_ElectrostaticOrder*0.5) + 1.0/std::pow(result2, this->m_ElectrostaticOrder*0.5)) : (1.0/result1 + 1.0/result2);  
-                energy[j] += value;
-                }
-              }
-            else
-              {
-              unsigned int kk = chosenIndex.back();
-              // double value = dotMatrix->operator()(j,kk);
-              x1 = output->operator[](kk)[0];
-              y1 = output->operator[](kk)[1];
-              z1 = output->operator[](kk)[2];
-              double dot = x*x1 + y*y1 + z*z1;
-              double result1 = 2+2*dot;
-              double result2 = 2-2*dot;
-              double value = (!orderEqual2) ? (1.0/std::pow(result1, this->m_ElectrostaticOrder*0.5) + 1.0/std::pow(result2, this->m_ElectrostaticOrder*0.5)) : (1.0/result1 + 1.0/result2);  
-              energy[j] += value;
-              }
-            if (energy[j] < minValue )
-              {
-              minValue = energy[j];
-              index = j;
-              }
-            }
-          }
-        chosenIndex.push_back(index);
-        hasChosen[index] = 1;
-        indices->operator[](0).push_back(index);
-        }
-      // clock.Stop();
-      // std::cout << "after loop: " << clock.GetTotal() << std::endl;
+      int index = ArgminInCandidates(values[0], hasChosen);
+      hasChosen[index] = 1;
+      indices->operator[](0).push_back(index);
+      UpdateCandidateValues(*outputMatrix, hasChosen, index, 0, values);
       }
-    else
-      utlGlobalException(true, "wrong m_CriteriaType");
-
     }
   else
     {
 
-    if (this->m_CriteriaType==Self::DISTANCE)
+    /**************************************************************************************/
+    // first several points for the shell without initialization. 
+    unsigned startI = (this->m_InitialOrientations?numberInitialSamples:1);
+    for ( ; startI < numberOfShells; startI += 1 ) 
       {
+      int index = ArgminInCandidates(values.back(), hasChosen);
+      hasChosen[index] = 1;
+      IndexVectorType tmp(1, index);
+      indices->push_back(tmp);
+      UpdateCandidateValues(*outputMatrix, hasChosen, index, indices->size()-1, values);
+      }
 
-      double x,y,z,x1,y1,z1;
-      std::vector< std::vector<double> > maxDotsVec;
-      for ( int i = 0; i < numberOfShells+1; i += 1 ) 
-        {
-        std::vector<double> dotTemp(numberOfSamples,-1);
-        maxDotsVec.push_back(dotTemp);
-        }
+    utlException(indices->size()!=numberOfShells, "Logic ERROR!");
 
-      /**************************************************************************************/
-      // first several points for the shell without initialization. 
-      unsigned startI = (this->m_InitialOrientations?numberInitialSamples:1);
-      for ( ; startI < numberOfShells; startI += 1 ) 
+    /**************************************************************************************/
+    // other points
+    STDVectorType costVec(numberOfSamples);
+    IndexVectorType shellVec(numberOfSamples, -1);
+    for ( unsigned int i = startI; i < totalNumbers; i += 1 ) 
+      {
+      int j;
+#pragma omp parallel for private(j)
+      for ( j = 0; j < (int)numberOfSamples; j += 1 ) 
         {
-        int index=-1;
-        double minValue=std::numeric_limits<double>::max();
-        for ( unsigned int j = 0; j < numberOfSamples; j += 1 ) 
-          {
-          if (hasChosen[j]==0)
-            {
-            double maxValue_j = -std::numeric_limits<double>::max();
-            x = output->operator[](j)[0];
-            y = output->operator[](j)[1];
-            z = output->operator[](j)[2];
-            if (maxDotsVec[numberOfShells][j]< 0 )
-              {
-              for ( unsigned int k = 0; k < chosenIndex.size(); k += 1 ) 
-                {
-                unsigned int kk = chosenIndex[k];
-                // double value = dotMatrix->operator()(j,kk);
-                x1 = output->operator[](kk)[0];
-                y1 = output->operator[](kk)[1];
-                z1 = output->operator[](kk)[2];
-                double value = x*x1 + y*y1 + z*z1;
-                if (value<0)
-                  value = -value;
-                if (value>maxValue_j)
-                  maxValue_j = value;
-                }
-              maxDotsVec[numberOfShells][j] = maxValue_j;
-              }
-            else
-              {
-              unsigned int kk = chosenIndex.back();
-              // double value = dotMatrix->operator()(j,kk);
-              x1 = output->operator[](kk)[0];
-              y1 = output->operator[](kk)[1];
-              z1 = output->operator[](kk)[2];
-              double value = x*x1 + y*y1 + z*z1;
-              if (value<0)
-                value = -value;
-              if (value > maxDotsVec[numberOfShells][j] )
-                maxDotsVec[numberOfShells][j] = value;
-              maxValue_j = maxDotsVec[numberOfShells][j];
-              }
-
-            if (maxValue_j < minValue )
-              {
-              minValue = maxValue_j;
-              index = j;
-              }
-            }
-          }
-        chosenIndex.push_back(index);
-        hasChosen[index] = 1;
-        IndexVectorType tmp;
-        tmp.push_back(index);
-        indices->push_back(tmp);
-        }
+        if (hasChosen[j])
+          continue;
 
-      utlException(indices->size()!=numberOfShells, "Logic ERROR!");
-      // utlPrintVar1(true, startI);
-      // utl::Save2DVector(*indices, std::cout<<"indices = ");
-
-      /**************************************************************************************/
-      // other points
-      int chosedShellIndex_final = -1;
-      int chosedShellIndex_final_last = -1;
-      for ( unsigned int i = startI; i < totalNumbers; i += 1 ) 
-        {
-        int index=-1;
-        double maxDist = -std::numeric_limits<double>::max();
+        // choose the shell with minimal maximal dot (or minimal energy)
         int chosedShellIndex = -1;
-
-        for ( unsigned int j = 0; j < numberOfSamples; j += 1 ) 
+        double chosedShellValue = std::numeric_limits<double>::max();
+        for ( unsigned int s = 0; s < numberOfShells; s += 1 ) 
           {
-          if (hasChosen[j]==0)
+          if ( (*indices)[s].size()==this->m_NumbersInShell[s])
+            continue;
+          if (values[s][j] < chosedShellValue)
             {
-
-            // maximal dots in single shells
-            std::vector<double> maxValue_j(numberOfShells+1, -std::numeric_limits<double>::max()); 
-            x = output->operator[](j)[0];
-            y = output->operator[](j)[1];
-            z = output->operator[](j)[2];
-
-            // utlPrintVar1(true, chosedShellIndex_final);
-            if (chosedShellIndex_final_last>=0)
-              {
-              // update stored maxDotsVec based on last added point
-              unsigned int kk = chosenIndex.back();
-              // double value = dotMatrix->operator()(j,kk);
-              x1 = output->operator[](kk)[0];
-              y1 = output->operator[](kk)[1];
-              z1 = output->operator[](kk)[2];
-              double value = x*x1 + y*y1 + z*z1;
-              if (value<0)
-                value = -value;
-              if (value > maxDotsVec[chosedShellIndex_final_last][j] )
-                maxDotsVec[chosedShellIndex_final_last][j] = value;
-              if (value > maxDotsVec[numberOfShells][j] )
-                maxDotsVec[numberOfShells][j] = value;
-              }
-
-            for ( unsigned int s = 0; s < numberOfShells; s += 1 ) 
-              {
-              int numbers = (*indices)[s].size();
-              if (numbers < this->m_NumbersInShell[s])
-                {
-                // only add point if there is no enough number 
-                if (maxDotsVec[s][j]<0)
-                  {
-                  // only calculate all dots in the first begining
-                  for ( unsigned int k = 0; k < numbers; k += 1 ) 
-                    {
-                    unsigned int kk = (*indices)[s][k];
-                    // double value = dotMatrix->operator()(j,kk);
-                    x1 = output->operator[](kk)[0];
-                    y1 = output->operator[](kk)[1];
-                    z1 = output->operator[](kk)[2];
-                    double value = x*x1 + y*y1 + z*z1;
-                    if (value<0)
-                      value = -value;
-                    if (value>maxValue_j[s])
-                      maxValue_j[s] = value;
-                    }
-                  maxDotsVec[s][j] = maxValue_j[s];
-                  if (maxValue_j[s]>maxDotsVec[numberOfShells][j])
-                    maxDotsVec[numberOfShells][j] = maxValue_j[s];
-                  }
-                else
-                  {
-                  maxValue_j[s] = maxDotsVec[s][j];
-                  }
-                }
-              }
-
-            // maximal dot in whole shell, which is the maxinmal value amoung maximal dots in each shell
-            // for ( unsigned int s = 0; s < numberOfShells; s += 1 ) 
-            //   {
-            //   if (maxDotsVec[s][j] > maxValue_j[numberOfShells])
-            //     maxValue_j[numberOfShells] = maxDotsVec[s][j];
-            //   }
-            
-            // maximal dot in whole shell
-            maxValue_j[numberOfShells] = maxDotsVec[numberOfShells][j];
-
-
-            // choose the shell with minimal maximal dot
-            chosedShellIndex = -1;
-            double chosedShellDot = std::numeric_limits<double>::max();
-            for ( unsigned int s = 0; s < numberOfShells; s += 1 ) 
-              {
-              if ( (*indices)[s].size()==this->m_NumbersInShell[s])
-                continue;
-              if (maxValue_j[s] < chosedShellDot)
-                {
-                chosedShellIndex = s;
-                chosedShellDot = maxValue_j[s];
-                }
-              }
-            // utlPrintVar2(true, j, chosedShellIndex);
-            // utl::PrintVector(maxValue_j, "maxValue_j");
-
-            // distance in cost function which combines whole shell and the chosed shell
-            double costDist = (1-this->m_WeightForSingleShell)*std::acos(maxValue_j[numberOfShells]) 
-                  + this->m_WeightForSingleShell*std::acos(maxValue_j[chosedShellIndex]);
-            if (costDist > maxDist )
-              {
-              maxDist = costDist;
-              index = j;
-              chosedShellIndex_final = chosedShellIndex;
-              }
-
+            chosedShellIndex = s;
+            chosedShellValue = values[s][j];
             }
           }
-
-        chosenIndex.push_back(index);
-        hasChosen[index] = 1;
-        indices->operator[](chosedShellIndex_final).push_back(index);
-        chosedShellIndex_final_last = chosedShellIndex_final;
+        shellVec[j] = chosedShellIndex;
+
+        // cost function which combines whole shell and the chosed shell. 
+        // The distance is maximized, thus its negative value is used as the cost. 
+        if (isDistance)
+          costVec[j] = -( (1-this->m_WeightForSingleShell)*std::acos(values.back()[j]) 
+                + this->m_WeightForSingleShell*std::acos(values[chosedShellIndex][j]) );
+        else
+          costVec[j] = (1-this->m_WeightForSingleShell)*values.back()[j] + this->m_WeightForSingleShell*values[chosedShellIndex][j];
         }
-      
-      }
-    else if (this->m_CriteriaType==Self::ELECTROSTATIC)
-      {
 
-      utlGlobalException(true, "TODO");
+      int index = ArgminInCandidates(costVec, hasChosen);
+      hasChosen[index] = 1;
+      indices->operator[](shellVec[index]).push_back(index);
+      UpdateCandidateValues(*outputMatrix, hasChosen, index, shellVec[index], values);
       }
-    else
-      utlGlobalException(true, "wrong m_CriteriaType");
 
     }
 }
@@ -0,0 +1,142 @@
+/**
+ *       @file  itkSamplingSchemeQSpaceMOCEstimationFilter.h
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkSamplingSchemeQSpaceMOCEstimationFilter_h
+#define __itkSamplingSchemeQSpaceMOCEstimationFilter_h
+
+#include "itkSamplingSchemeQSpaceEstimationFilter.h"
+#include "itkSamplingScheme3D.h"
+#include "itkMOCBranchAndBoundSolver.h"
+
+
+namespace itk
+{
+
+/**
+ *   \class   SamplingSchemeQSpaceMOCEstimationFilter
+ *   \brief   Estimation of single/multi-shell orientations by exactly solving the mixed integer program of MOC
+ *
+ *   Orientations are chosen from a fine scheme.
+ *   Separation angles are found by bisection as in SamplingSchemeQSpaceIMOCEstimationFilter,
+ *   and for each tested angles, the 0-1 program is solved by MOCBranchAndBoundSolver, instead of the greedy IMOC.
+ *   The solver bounds nodes by clique covers instead of the LP relaxation.
+ *   If TimeLimit is set, the best scheme found before the time limit is the output.
+ *   Proving infeasibility near the optimal angles is NP-hard and may take very long. 
+ *   If StepTimeLimit is set, a tested angles whose solve reaches the limit is treated as infeasible in bisection, 
+ *   then the output may not have the maximal separation angles.
+ *
+ *   \author  Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *   \ingroup SamplingScheme
+ */
+template <class TSamplingType>
+class ITK_EXPORT SamplingSchemeQSpaceMOCEstimationFilter
+  : public SamplingSchemeQSpaceEstimationFilter<TSamplingType>
+{
+
+public:
+  /** Standard class typedefs. */
+  typedef SamplingSchemeQSpaceMOCEstimationFilter Self;
+  typedef SamplingSchemeQSpaceEstimationFilter<TSamplingType>                 Superclass;
+  typedef SmartPointer< Self >                                Pointer;
+  typedef SmartPointer< const Self >                          ConstPointer;
+
+  typedef TSamplingType                                       SamplingType;
+  typedef typename SamplingType::Pointer                      SamplingPointer;
+
+  typedef typename Superclass::ValueType                    ValueType;
+  typedef typename Superclass::MatrixType                   MatrixType;
+  typedef typename Superclass::MatrixPointer                MatrixPointer;
+  typedef typename Superclass::STDVectorType                STDVectorType;
+  typedef typename Superclass::STDVectorPointer             STDVectorPointer;
+  typedef typename Superclass::IndexVectorType              IndexVectorType;
+  typedef typename Superclass::Index2DVectorType            Index2DVectorType;
+  typedef typename Superclass::Index2DVectorPointer         Index2DVectorPointer;
+
+  typedef MOCBranchAndBoundSolver                           SolverType;
+  typedef SolverType::Pointer                               SolverPointer;
+
+  /** Standard Macros */
+  itkTypeMacro(SamplingSchemeQSpaceMOCEstimationFilter, SamplingSchemeQSpaceEstimationFilter);
+  itkNewMacro(Self);
+
+  /** The order of tessellation for the fine scheme. The number of variables is the number of shells times the number of fine orientations.  */
+  itkSetGetMacro(TessellationOrder, unsigned int);
+
+  itkSetGetMacro(FineOrientations, MatrixPointer);
+
+  itkSetGetMacro(AngleMinChange, double);
+
+  /** Time limit in seconds for the whole estimation. If it is not positive, there is no time limit.  */
+  itkSetGetMacro(TimeLimit, double);
+
+  /** Time limit in seconds for each tested angles in bisection. If it is not positive, there is no limit.  */
+  itkSetGetMacro(StepTimeLimit, double);
+
+  /** Number of threads in the tree search. If it is not positive, the default number of threads is used.  */
+  itkSetGetMacro(NumberOfThreads, int);
+
+  /** If true, a time limit is reached and the output may not have the maximal separation angles.  */
+  itkGetMacro(IsTimeOut, bool);
+
+  /** separation angles of the output scheme  */
+  itkGetMacro(Angles, STDVectorType);
+
+  void GenerateData() ITK_OVERRIDE;
+
+protected:
+  SamplingSchemeQSpaceMOCEstimationFilter();
+  ~SamplingSchemeQSpaceMOCEstimationFilter(){}
+
+  void Initialization() ITK_OVERRIDE;
+
+  void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
+
+  /** the order of tessellation for the orignal fine mesh  */
+  unsigned int m_TessellationOrder=5;
+
+  /** It is generated from m_TessellationOrder  */
+  MatrixPointer m_FineOrientations;
+  SamplingPointer m_FineScheme = SamplingType::New();
+
+  double m_AngleMinChange=0.0001;
+
+  double m_TimeLimit=-1;
+
+  double m_StepTimeLimit=-1;
+
+  int m_NumberOfThreads=-1;
+
+  bool m_IsTimeOut=false;
+
+  STDVectorType m_Angles;
+
+  SolverPointer m_Solver;
+
+private:
+  SamplingSchemeQSpaceMOCEstimationFilter(const Self &); //purposely not implemented
+  void operator=(const Self &);         //purposely not implemented
+
+};
+
+}
+
+#if !defined(ITK_MANUAL_INSTANTIATION) && !defined(__itkSamplingSchemeQSpaceMOCEstimationFilter_hxx)
+#include "itkSamplingSchemeQSpaceMOCEstimationFilter.hxx"
+#endif
+
+
+#endif
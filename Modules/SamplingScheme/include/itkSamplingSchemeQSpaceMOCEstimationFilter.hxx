@@ -0,0 +1,157 @@
+/**
+ *       @file  itkSamplingSchemeQSpaceMOCEstimationFilter.hxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __itkSamplingSchemeQSpaceMOCEstimationFilter_hxx
+#define __itkSamplingSchemeQSpaceMOCEstimationFilter_hxx
+
+
+#include "itkSamplingSchemeQSpaceMOCEstimationFilter.h"
+#include "itkRealTimeClock.h"
+#include "utl.h"
+
+#include <numeric>
+
+namespace itk
+{
+
+template< class TSamplingType >
+SamplingSchemeQSpaceMOCEstimationFilter< TSamplingType >
+::SamplingSchemeQSpaceMOCEstimationFilter()
+  : Superclass(),
+  m_FineOrientations(new MatrixType()),
+  m_Solver(new SolverType())
+{
+}
+
+template< class TSamplingType >
+void
+SamplingSchemeQSpaceMOCEstimationFilter< TSamplingType >
+::Initialization()
+{
+  if (this->m_FineOrientations->Size()==0)
+    this->m_FineOrientations = utl::ReadGrad<double>(this->m_TessellationOrder, DIRECTION_NODUPLICATE, CARTESIAN_TO_CARTESIAN); // catesian
+  m_FineScheme->SetOrientationsCartesian(m_FineOrientations);
+
+  m_Solver->SetOrientations(*m_FineOrientations);
+  m_Solver->SetNumbersInShell(this->m_NumbersInShell);
+  m_Solver->SetNumberOfThreads(m_NumberOfThreads);
+}
+
+template< class TSamplingType >
+void
+SamplingSchemeQSpaceMOCEstimationFilter< TSamplingType >
+::GenerateData()
+{
+  utlGlobalException(this->m_CriteriaType!=Self::DISTANCE, "m_CriteriaType should be DISTANCE");
+  utlGlobalException(this->m_NumbersInShell.size()==0, "need to set the numbers of samples in shells");
+
+  Initialization();
+
+  int numberOfShells = this->m_NumbersInShell.size();
+  int totalNumberOfSamples = std::accumulate(this->m_NumbersInShell.begin(), this->m_NumbersInShell.end(), 0);
+  int angleSize = numberOfShells==1?1:(numberOfShells+1);
+  STDVectorType angles(angleSize,-1.0), anglesUpperBound(angleSize,-1.0), anglesLowerBound(angleSize,0.0);
+
+  for ( int i = 0; i < numberOfShells; ++i )
+    anglesUpperBound[i] = SamplingType::CalculateMinDistanceUpperBound(2*this->m_NumbersInShell[i]);
+  if (numberOfShells>1)
+    anglesUpperBound[numberOfShells] = SamplingType::CalculateMinDistanceUpperBound(2*totalNumberOfSamples);
+
+  RealTimeClock::Pointer clock = RealTimeClock::New();
+  double startTime = clock->GetTimeInSeconds();
+
+  // bisection of all angles. The scheme of the last feasible angles is the output.
+  STDVectorType angle_0(anglesLowerBound), angle_1(anglesUpperBound);
+  Index2DVectorType indicesFeasible;
+  m_IsTimeOut = false;
+  m_Angles.clear();
+  while (true)
+    {
+    for ( int i = 0; i < angleSize; ++i )
+      angles[i] = (angle_0[i]+angle_1[i])*0.5;
+
+    // the time limit of this step is the smaller one of m_StepTimeLimit and the time left
+    double timeLimit = m_StepTimeLimit;
+    bool isStepLimited = m_StepTimeLimit>0;
+    if (m_TimeLimit>0)
+      {
+      double timeLeft = m_TimeLimit - (clock->GetTimeInSeconds()-startTime);
+      if (timeLeft<=0)
+        {
+        m_IsTimeOut = true;
+        break;
+        }
+      if (!isStepLimited || timeLeft<timeLimit)
+        {
+        timeLimit = timeLeft;
+        isStepLimited = false;
+        }
+      }
+    m_Solver->SetTimeLimit(timeLimit);
+
+    SolverType::StatusType status = m_Solver->Solve(angles);
+    if (this->GetDebug())
+      {
+      utl::PrintVector(angles, "angles");
+      utlPrintVar(true, status, m_Solver->GetNumberOfNodes());
+      }
+
+    if (status==SolverType::FEASIBLE)
+      {
+      angle_0 = angles;
+      m_Angles = angles;
+      indicesFeasible = m_Solver->GetIndicesInShells();
+      }
+    else if (status==SolverType::INFEASIBLE)
+      angle_1 = angles;
+    else if (isStepLimited)
+      {
+      // not proven infeasible, but treated as infeasible
+      m_IsTimeOut = true;
+      angle_1 = angles;
+      }
+    else
+      {
+      m_IsTimeOut = true;
+      break;
+      }
+
+    if (angle_1[0]-angle_0[0] < m_AngleMinChange*angle_1[0])
+      break;
+    }
+
+  utlGlobalException(indicesFeasible.size()==0, "no feasible scheme is found in the time limit. Use a larger time limit or less fine orientations.");
+
+  *m_FineScheme->GetIndicesInShells() = indicesFeasible;
+  this->m_OutputOrientations = m_FineScheme;
+}
+
+template< class TSamplingType >
+void
+SamplingSchemeQSpaceMOCEstimationFilter< TSamplingType >
+::PrintSelf(std::ostream& os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  PrintVar5(true, m_TessellationOrder, m_AngleMinChange, m_TimeLimit, m_NumberOfThreads, m_IsTimeOut, os<<indent);
+  PrintVar1(true, m_StepTimeLimit, os<<indent);
+  utl::PrintVector(m_Angles, "m_Angles", " ", os<<indent);
+}
+
+}
+
+
+#endif
@@ -18,6 +18,10 @@
 #include <itkObjectFactory.h>
 #include <vnl/vnl_matrix.h>
 #include <vnl/vnl_vector.h>
+#include <map>
+#include "itkSimpleFastMutexLock.h"
+#include "utlSTDHeaders.h"
+#include "utlITKMacro.h"
 
 namespace itk
 {
@@ -29,6 +33,10 @@ namespace itk
  * inspired by source code written by Jon Leech
  * (http://www.cs.unc.edu/~jon/sphere.html)
  *
+ * Midpoints of edges are found in a hash map, thus each subdivision is linear in the number of edges.
+ * Tessellations are cached for each (basic shape, order), and shared by all tessellators in the process, 
+ * e.g. in mesh filters and their clones. 
+ *
  * \author Pew-Thian Yap, UNC-CH
  * \ingroup SamplingScheme Visualization DiffusionModels
  */
@@ -59,6 +67,12 @@ public:
   /** Generate basis. */
   void TessellateSphere();
 
+  /** If true (default), TessellateSphere() uses the cached tessellation of the same basic shape and order.  */
+  itkSetGetBooleanMacro(UseCache);
+
+  /** release all cached tessellations  */
+  static void ClearCache();
+
   /** Get/Set basic shape for subdivision */
   typedef enum {TETRAHEDRON, OCTAHEDRON, ICOSAHEDRON} BasicShapeType;
   
@@ -80,22 +94,24 @@ public:
     return m_Points;
   }
   
+  /** Points in the hemisphere z>0 (y<0 if z=0, x>0 if y=z=0). 
+   * It is one point of each antipodal pair for octahedron and icosahedron.  */
   PointsMatrixType GetPointsMatrixInHemisphere()
   {
-  PointsMatrixType points(m_Points.rows()/2, 3);
+  PointsMatrixType points(m_Points.rows(), 3);
   int j=0;
-  for ( int i = 0; i < m_NumberOfVertices; i += 1 )
+  for ( int i = 0; i < m_Points.rows(); i += 1 )
     {
-    if ( points(i,2)>0
-      || (std::abs(points(i,2))<1e-20 && points(i,1)<0)
-      || (std::abs(points(i,2))<1e-20 && std::abs(points(i,1))<1e-20 && points(i,0)>0))
+    if ( m_Points(i,2)>0
+      || (std::abs(m_Points(i,2))<1e-20 && m_Points(i,1)<0)
+      || (std::abs(m_Points(i,2))<1e-20 && std::abs(m_Points(i,1))<1e-20 && m_Points(i,0)>0))
       {
       for ( int kk = 0; kk < 3; ++kk ) 
-        points(j,3) = m_Points(i,3);
+        points(j,kk) = m_Points(i,kk);
       j++;
       }
     }
-  return points;
+  return points.extract(j, 3);
   }
 
   CellsMatrixType GetCellsMatrix()
@@ -138,10 +154,24 @@ private:
   double *vertices;
   int *faces; 
 
-  unsigned int edge_walk; 
-  int *start; 
-  int *end; 
-  int *midpoint; 
+  /** midpoints of edges which are only visited once, the key is (min index, max index)  */
+  typedef utl_unordered_map<unsigned long long, int> EdgeMidpointMapType;
+  EdgeMidpointMapType edge_midpoints;
+
+  /** the tessellation of a basic shape and an order, which is not modified after it is cached  */
+  struct TessellationType
+    {
+    PointsMatrixType Points;
+    CellsMatrixType Cells;
+    unsigned int NumberOfEdges;
+    };
+  typedef utl_shared_ptr<const TessellationType>                           TessellationPointer;
+  typedef std::map<std::pair<int, unsigned int>, TessellationPointer>     TessellationCacheType;
+
+  static TessellationCacheType& GetTessellationCache();
+  static SimpleFastMutexLock& GetTessellationCacheMutex();
+
+  bool m_UseCache;
 
   PointsMatrixType m_Points;
   CellsMatrixType m_Cells;
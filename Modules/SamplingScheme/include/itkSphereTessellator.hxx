@@ -20,6 +20,7 @@
 #include <cmath>
  
 #include "itkSphereTessellator.h"
+#include "itkMutexLockHolder.h"
 
 namespace itk
 {
@@ -33,9 +34,7 @@ SphereTessellator< TElement >
   
   vertices = NULL;
   faces = NULL; 
-  start = NULL; 
-  end = NULL; 
-  midpoint = NULL; 
+  m_UseCache = true;
   
   m_NumberOfVertices = 0;
   m_NumberOfFaces = 0;
@@ -192,26 +191,19 @@ int
 SphereTessellator< TElement >
 ::SearchMidpoint (int index_start, int index_end) 
 { 
-  unsigned int i;
-  for (i=0; i<edge_walk; i++) 
-    if ((start[i] == index_start && end[i] == index_end) || 
-      (start[i] == index_end && end[i] == index_start)) 
-      {
-      int res = midpoint[i];
-
-      /* update the arrays */
-      start[i]    = start[edge_walk-1];
-      end[i]      = end[edge_walk-1];
-      midpoint[i] = midpoint[edge_walk-1];
-      edge_walk--;
-
-      return res; 
-      }
+  unsigned long long key = index_start<index_end ? 
+    ((unsigned long long)index_start << 32) | (unsigned int)index_end : ((unsigned long long)index_end << 32) | (unsigned int)index_start;
+  typename EdgeMidpointMapType::iterator iter = edge_midpoints.find(key);
+  if (iter!=edge_midpoints.end())
+    {
+    int res = iter->second;
+    /* an edge is shared by two faces, then it is not needed any more */
+    edge_midpoints.erase(iter);
+    return res; 
+    }
 
   /* vertex not in the list, so we add it */
-  start[edge_walk] = index_start;
-  end[edge_walk] = index_end; 
-  midpoint[edge_walk] = n_vertices; 
+  edge_midpoints[key] = n_vertices;
 
   /* create new vertex */ 
   vertices[3*n_vertices]   = (vertices[3*index_start] + vertices[3*index_end]) / 2.0;
@@ -228,8 +220,7 @@ SphereTessellator< TElement >
   vertices[3*n_vertices+2] *= length;
 
   n_vertices++;
-  edge_walk++;
-  return midpoint[edge_walk-1];
+  return n_vertices-1;
 } 
 
 template <typename TElement>
@@ -237,15 +228,14 @@ void
 SphereTessellator< TElement >
 ::Subdivide (void) 
 { 
-  unsigned int n_vertices_new = n_vertices+2*n_edges; 
+  /* each edge adds a vertex, and is split into 2 edges. Each face adds 3 edges. */
+  unsigned int n_vertices_new = n_vertices+n_edges; 
   unsigned int n_faces_new = 4*n_faces; 
   unsigned int i; 
 
-  edge_walk = 0; 
-  n_edges = 2*n_vertices + 3*n_faces; 
-  start = (int*)malloc(n_edges*sizeof (int)); 
-  end = (int*)malloc(n_edges*sizeof (int)); 
-  midpoint = (int*)malloc(n_edges*sizeof (int)); 
+  edge_midpoints.clear();
+  edge_midpoints.rehash(n_edges);
+  n_edges = 2*n_edges + 3*n_faces; 
 
   int *faces_old = (int*)malloc (3*n_faces*sizeof(int)); 
   faces_old = (int*)memcpy((void*)faces_old, (void*)faces, 3*n_faces*sizeof(int)); 
@@ -281,12 +271,37 @@ SphereTessellator< TElement >
       n_faces_new++; 
     } 
   n_faces = n_faces_new; 
-  free (start); 
-  free (end); 
-  free (midpoint); 
+  edge_midpoints.clear();
   free (faces_old); 
 } 
 
+template <typename TElement>
+typename SphereTessellator< TElement >::TessellationCacheType&
+SphereTessellator< TElement >
+::GetTessellationCache()
+{
+  static TessellationCacheType cache;
+  return cache;
+}
+
+template <typename TElement>
+SimpleFastMutexLock&
+SphereTessellator< TElement >
+::GetTessellationCacheMutex()
+{
+  static SimpleFastMutexLock mutex;
+  return mutex;
+}
+
+template <typename TElement>
+void
+SphereTessellator< TElement >
+::ClearCache()
+{
+  MutexLockHolder<SimpleFastMutexLock> holder(GetTessellationCacheMutex());
+  GetTessellationCache().clear();
+}
+
 /**
  * Do actual work in generating the basis.
  */
@@ -295,6 +310,28 @@ void
 SphereTessellator< TElement >
 ::TessellateSphere(void)
 {
+  std::pair<int, unsigned int> key(m_BasicShape, m_Order);
+  TessellationPointer tessellation;
+  if (m_UseCache)
+    {
+    MutexLockHolder<SimpleFastMutexLock> holder(GetTessellationCacheMutex());
+    typename TessellationCacheType::const_iterator iter = GetTessellationCache().find(key);
+    if (iter!=GetTessellationCache().end())
+      tessellation = iter->second;
+    }
+  if (tessellation)
+    {
+    m_Points = tessellation->Points;
+    m_Cells = tessellation->Cells;
+    m_NumberOfVertices = m_Points.rows();
+    m_NumberOfFaces = m_Cells.rows();
+    m_NumberOfEdges = tessellation->NumberOfEdges;
+    return;
+    }
+
+  if (vertices) free (vertices); 
+  if (faces) free (faces); 
+
   switch (m_BasicShape)
     {
   case TETRAHEDRON:
@@ -312,6 +349,17 @@ SphereTessellator< TElement >
     Subdivide ();
 
   OutputSphere ();
+
+  if (m_UseCache)
+    {
+    utl_shared_ptr<TessellationType> tess(new TessellationType());
+    tess->Points = m_Points;
+    tess->Cells = m_Cells;
+    tess->NumberOfEdges = m_NumberOfEdges;
+    // if another thread has cached the same tessellation, it is kept
+    MutexLockHolder<SimpleFastMutexLock> holder(GetTessellationCacheMutex());
+    GetTessellationCache().insert(std::make_pair(key, TessellationPointer(tess)));
+    }
 }
 
 template <typename TElement>
@@ -348,6 +396,7 @@ SphereTessellator< TElement >
 {
   Superclass::PrintSelf(os,indent);
   os << indent << "tessellation order = " << m_Order << std::endl;
+  os << indent << "UseCache = " << m_UseCache << std::endl;
 }
 
 } // end namespace itk
@@ -0,0 +1,202 @@
+/**
+ *       @file  itkMOCBranchAndBoundSolverGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "itkMOCBranchAndBoundSolver.h"
+#include "utlCore.h"
+
+namespace
+{
+typedef itk::MOCBranchAndBoundSolver       SolverType;
+typedef SolverType::MatrixType             MatrixType;
+typedef SolverType::IndexVectorType        IndexVectorType;
+typedef SolverType::Index2DVectorType      Index2DVectorType;
+typedef SolverType::STDVectorType          STDVectorType;
+
+/** 6 antipodal pairs of icosahedron vertices, the optimal 6 orientations with separation angle atan(2)  */
+MatrixType
+IcosahedronOrientations()
+{
+  const double p = (1+std::sqrt(5.0))/2;
+  const double vertices[18] = {0,1,p, 0,1,-p, 1,p,0, 1,-p,0, p,0,1, -p,0,1};
+  MatrixType mat(6,3);
+  for ( int i = 0; i < 6; ++i )
+    for ( int j = 0; j < 3; ++j )
+      mat(i,j) = vertices[3*i+j];
+  return mat;
+}
+
+/** fixed random orientations, then the orientations in inputs are appended  */
+MatrixType
+RandomOrientations(const int num, const unsigned long long seed, const MatrixType& appended=MatrixType())
+{
+  MatrixType mat(num+appended.Rows(), 3);
+  for ( int i = 0; i < num; ++i )
+    for ( int j = 0; j < 3; ++j )
+      mat(i,j) = utl::GaussRandCounterBased<double>(0.0, 1.0, seed, i, j);
+  for ( int i = 0; i < appended.Rows(); ++i )
+    for ( int j = 0; j < 3; ++j )
+      mat(num+i,j) = appended(i,j);
+  return mat;
+}
+
+/** antipodally symmetric angle between the i-th and j-th orientations  */
+double
+GetAngle(const MatrixType& mat, const int i, const int j)
+{
+  double dot=0, norm_i=0, norm_j=0;
+  for ( int k = 0; k < 3; ++k )
+    {
+    dot += mat(i,k)*mat(j,k);
+    norm_i += mat(i,k)*mat(i,k);
+    norm_j += mat(j,k)*mat(j,k);
+    }
+  return std::acos(utl::min(1.0, std::fabs(dot)/std::sqrt(norm_i*norm_j)));
+}
+
+/** check numbers in shells and separation angles in each shell and in all shells  */
+void
+CheckSolution(const MatrixType& mat, const IndexVectorType& numbers, const STDVectorType& angles, const Index2DVectorType& indices)
+{
+  const double eps = 1e-8;
+  ASSERT_EQ(numbers.size(), indices.size());
+  IndexVectorType indicesAll;
+  for ( int s = 0; s < indices.size(); ++s )
+    {
+    EXPECT_EQ(numbers[s], (int)indices[s].size());
+    for ( int i = 0; i < indices[s].size(); ++i )
+      {
+      for ( int j = i+1; j < indices[s].size(); ++j )
+        EXPECT_GE(GetAngle(mat, indices[s][i], indices[s][j]), angles[s]-eps) << "shell " << s;
+      indicesAll.push_back(indices[s][i]);
+      }
+    }
+  if (numbers.size()>1)
+    {
+    for ( int i = 0; i < indicesAll.size(); ++i )
+      for ( int j = i+1; j < indicesAll.size(); ++j )
+        {
+        EXPECT_NE(indicesAll[i], indicesAll[j]);
+        EXPECT_GE(GetAngle(mat, indicesAll[i], indicesAll[j]), angles.back()-eps) << "all shells";
+        }
+    }
+}
+
+SolverType::StatusType
+Solve(const MatrixType& mat, const IndexVectorType& numbers, const STDVectorType& angles, const int numberOfThreads, Index2DVectorType& indices, const double timeLimit=-1)
+{
+  SolverType solver;
+  solver.SetOrientations(mat);
+  solver.SetNumbersInShell(numbers);
+  solver.SetNumberOfThreads(numberOfThreads);
+  solver.SetTimeLimit(timeLimit);
+  SolverType::StatusType status = solver.Solve(angles);
+  indices = solver.GetIndicesInShells();
+  return status;
+}
+}
+
+TEST(itkMOCBranchAndBoundSolver, SingleShellIcosahedron)
+{
+  // atan(2) is the largest separation angle of 6 orientations, and 7 orientations can not reach it
+  const double angle = std::atan(2.0)-1e-6;
+  MatrixType mat = RandomOrientations(200, 1, IcosahedronOrientations());
+
+  for ( int numberOfThreads = 1; numberOfThreads <= 4; numberOfThreads *= 2 )
+    {
+    Index2DVectorType indices;
+    EXPECT_EQ(SolverType::FEASIBLE, Solve(mat, IndexVectorType(1,6), STDVectorType(1,angle), numberOfThreads, indices));
+    CheckSolution(mat, IndexVectorType(1,6), STDVectorType(1,angle), indices);
+
+    EXPECT_EQ(SolverType::INFEASIBLE, Solve(mat, IndexVectorType(1,7), STDVectorType(1,angle), numberOfThreads, indices));
+    EXPECT_TRUE(indices.empty());
+    }
+}
+
+TEST(itkMOCBranchAndBoundSolver, SingleShellOrthogonal)
+{
+  // only 3 orientations are orthogonal to each other
+  const double angle = M_PI/2-1e-6;
+  MatrixType axes(3,3,0.0);
+  for ( int i = 0; i < 3; ++i )
+    axes(i,i) = 1.0;
+  MatrixType mat = RandomOrientations(100, 5, axes);
+
+  Index2DVectorType indices;
+  EXPECT_EQ(SolverType::FEASIBLE, Solve(mat, IndexVectorType(1,3), STDVectorType(1,angle), 4, indices));
+  CheckSolution(mat, IndexVectorType(1,3), STDVectorType(1,angle), indices);
+  EXPECT_EQ(SolverType::INFEASIBLE, Solve(mat, IndexVectorType(1,4), STDVectorType(1,angle), 4, indices));
+}
+
+TEST(itkMOCBranchAndBoundSolver, TwoShells)
+{
+  const double angle = std::atan(2.0)-1e-6;
+  MatrixType mat = IcosahedronOrientations();
+  // repeated and antipodal candidates are merged
+  MatrixType matRepeated(12,3);
+  for ( int i = 0; i < 6; ++i )
+    for ( int j = 0; j < 3; ++j )
+      matRepeated(i,j) = mat(i,j), matRepeated(6+i,j) = -mat(i,j);
+
+  for ( int numberOfThreads = 1; numberOfThreads <= 4; numberOfThreads *= 2 )
+    {
+    Index2DVectorType indices;
+    IndexVectorType numbers(2,3);
+    STDVectorType angles(3,angle);
+    EXPECT_EQ(SolverType::FEASIBLE, Solve(matRepeated, numbers, angles, numberOfThreads, indices));
+    CheckSolution(matRepeated, numbers, angles, indices);
+
+    // 7 orientations in all shells
+    numbers[1] = 4;
+    EXPECT_EQ(SolverType::INFEASIBLE, Solve(matRepeated, numbers, angles, numberOfThreads, indices));
+    }
+
+  // a larger angle in the first shell than in all shells
+  MatrixType matRandom = RandomOrientations(300, 2);
+  IndexVectorType numbers(2);
+  numbers[0]=4, numbers[1]=6;
+  STDVectorType angles(3);
+  angles[0]=1.0, angles[1]=0.8, angles[2]=0.5;
+  Index2DVectorType indices;
+  EXPECT_EQ(SolverType::FEASIBLE, Solve(matRandom, numbers, angles, 4, indices));
+  CheckSolution(matRandom, numbers, angles, indices);
+}
+
+TEST(itkMOCBranchAndBoundSolver, TimeLimit)
+{
+  // the search of this instance takes much longer than the time limit
+  MatrixType mat = RandomOrientations(2000, 3);
+  const double timeLimit = 0.2;
+  for ( int numberOfThreads = 1; numberOfThreads <= 4; numberOfThreads *= 2 )
+    {
+    SolverType solver;
+    solver.SetOrientations(mat);
+    solver.SetNumbersInShell(IndexVectorType(1,40));
+    solver.SetNumberOfThreads(numberOfThreads);
+    solver.SetTimeLimit(timeLimit);
+
+    itk::RealTimeClock::Pointer clock = itk::RealTimeClock::New();
+    double start = clock->GetTimeInSeconds();
+    EXPECT_EQ(SolverType::TIMEOUT, solver.Solve(STDVectorType(1,0.45)));
+    double elapsed = clock->GetTimeInSeconds()-start;
+    EXPECT_GE(elapsed, timeLimit);
+    EXPECT_LT(elapsed, timeLimit+1.0);
+    EXPECT_TRUE(solver.GetIndicesInShells().empty());
+    EXPECT_GT(solver.GetNumberOfNodes(), 0);
+    }
+}
@@ -0,0 +1,178 @@
+/**
+ *       @file  itkSamplingScheme3DGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "itkSamplingScheme3D.h"
+#include "utl.h"
+
+namespace
+{
+typedef itk::SamplingScheme3D<double>          SamplingType;
+typedef SamplingType::IndexVectorType          IndexVectorType;
+typedef SamplingType::Index2DVectorType        Index2DVectorType;
+typedef SamplingType::STDVectorType            STDVectorType;
+
+/** random unit vectors  */
+SamplingType::Pointer
+RandomScheme(const int numberOfSamples)
+{
+  SamplingType::Pointer scheme = SamplingType::New();
+  for ( int i = 0; i < numberOfSamples; ++i )
+    {
+    double x=0, y=0, z=0, norm=0;
+    while (norm<0.1)
+      {
+      x = utl::Random<double>(-1,1), y = utl::Random<double>(-1,1), z = utl::Random<double>(-1,1);
+      norm = std::sqrt(x*x+y*y+z*z);
+      }
+    scheme->AppendOrientation(x/norm, y/norm, z/norm);
+    }
+  return scheme;
+}
+
+/** minimal angles of samples in indices, using all pairs  */
+STDVectorType
+MinDistanceUsingAllPairs(const SamplingType* scheme, const IndexVectorType& indices, const bool isSymmetric)
+{
+  STDVectorType angles(indices.size());
+  for ( int i = 0; i < indices.size(); ++i )
+    {
+    double dotMax = -3;
+    for ( int j = 0; j < indices.size(); ++j )
+      {
+      if (j==i)
+        continue;
+      double dot = 0;
+      for ( int d = 0; d < 3; ++d )
+        dot += (*scheme)[indices[i]][d] * (*scheme)[indices[j]][d];
+      if (isSymmetric)
+        dot = std::fabs(dot);
+      dotMax = std::max(dotMax, dot);
+      }
+    angles[i] = std::acos(std::min(dotMax, 1.0));
+    }
+  return angles;
+}
+
+/** electrostatic energy of samples in indices, using all pairs  */
+double
+ElectrostaticEnergyUsingAllPairs(const SamplingType* scheme, const IndexVectorType& indices, const double order, const bool isNormalize, const bool countHalf)
+{
+  double energy = 0;
+  for ( int i = 0; i < indices.size(); ++i )
+    for ( int j = 0; j < i; ++j )
+      {
+      double result1 = 0, result2 = 0;
+      for ( int d = 0; d < 3; ++d )
+        {
+        double pi = (*scheme)[indices[i]][d], pj = (*scheme)[indices[j]][d];
+        result1 += (pi-pj)*(pi-pj);
+        result2 += (pi+pj)*(pi+pj);
+        }
+      energy += 1.0/std::pow(result1, 0.5*order) + 1.0/std::pow(result2, 0.5*order);
+      }
+  double numberOfPairs = 0.5*indices.size()*(indices.size()-1);
+  if (!countHalf)
+    energy *= 2.0, numberOfPairs *= 2.0;
+  return isNormalize ? energy/numberOfPairs : energy;
+}
+
+IndexVectorType
+AllIndices(const int numberOfSamples)
+{
+  IndexVectorType indices(numberOfSamples);
+  for ( int i = 0; i < numberOfSamples; ++i )
+    indices[i] = i;
+  return indices;
+}
+}
+
+TEST(itkSamplingScheme3D, CalculateMinDistance)
+{
+  // 40 samples use the all-pairs search, 200 samples use the kd-tree
+  int numbers[2] = {40, 200};
+  for ( int n = 0; n < 2; ++n )
+    {
+    SamplingType::Pointer scheme = RandomScheme(numbers[n]);
+    IndexVectorType indices = AllIndices(numbers[n]);
+    for ( int s = 0; s < 2; ++s )
+      {
+      bool isSymmetric = s==0;
+      STDVectorType angles = scheme->CalculateMinDistance(isSymmetric);
+      STDVectorType anglesAllPairs = MinDistanceUsingAllPairs(scheme, indices, isSymmetric);
+      ASSERT_EQ(numbers[n], angles.size());
+      for ( int i = 0; i < numbers[n]; ++i )
+        {
+        EXPECT_NEAR(anglesAllPairs[i], angles[i], 1e-10) << "n=" << numbers[n] << ", isSymmetric=" << isSymmetric << ", i=" << i;
+        EXPECT_NEAR(scheme->CalculateMinDistance(i, isSymmetric), angles[i], 1e-10);
+        }
+      }
+    }
+}
+
+TEST(itkSamplingScheme3D, CalculateMinDistanceInShell)
+{
+  // shell 0 with 150 samples uses the kd-tree, shell 1 with 50 samples uses the all-pairs search
+  SamplingType::Pointer scheme = RandomScheme(200);
+  Index2DVectorType::value_type shell0, shell1;
+  for ( int i = 0; i < 200; ++i )
+    {
+    if (i%4==0)
+      shell1.push_back(i);
+    else
+      shell0.push_back(i);
+    }
+  SamplingType::Index2DVectorPointer indicesInShells(new Index2DVectorType());
+  indicesInShells->push_back(shell0);
+  indicesInShells->push_back(shell1);
+  scheme->SetIndicesInShells(indicesInShells);
+
+  for ( int shell = 0; shell < 2; ++shell )
+    {
+    const IndexVectorType& indices = (*indicesInShells)[shell];
+    for ( int s = 0; s < 2; ++s )
+      {
+      bool isSymmetric = s==0;
+      STDVectorType angles = scheme->CalculateMinDistanceInShell(shell, isSymmetric);
+      STDVectorType anglesAllPairs = MinDistanceUsingAllPairs(scheme, indices, isSymmetric);
+      ASSERT_EQ(indices.size(), angles.size());
+      for ( int i = 0; i < indices.size(); ++i )
+        EXPECT_NEAR(anglesAllPairs[i], angles[i], 1e-10) << "shell=" << shell << ", isSymmetric=" << isSymmetric << ", i=" << i;
+      }
+
+    double energy = scheme->CalculateElectrostaticEnergyInShell(shell);
+    double energyAllPairs = ElectrostaticEnergyUsingAllPairs(scheme, indices, 2.0, true, true);
+    EXPECT_NEAR(energyAllPairs, energy, 1e-10*energyAllPairs);
+    }
+}
+
+TEST(itkSamplingScheme3D, CalculateElectrostaticEnergy)
+{
+  SamplingType::Pointer scheme = RandomScheme(200);
+  IndexVectorType indices = AllIndices(200);
+  // order 2 uses the vectorized loop, other orders use std::pow
+  double orders[2] = {2.0, 1.5};
+  for ( int o = 0; o < 2; ++o )
+    for ( int k = 0; k < 4; ++k )
+      {
+      bool isNormalize = k%2==0, countHalf = k/2==0;
+      double energy = scheme->CalculateElectrostaticEnergy(orders[o], isNormalize, countHalf);
+      double energyAllPairs = ElectrostaticEnergyUsingAllPairs(scheme, indices, orders[o], isNormalize, countHalf);
+      EXPECT_NEAR(energyAllPairs, energy, 1e-10*energyAllPairs) << "order=" << orders[o] << ", isNormalize=" << isNormalize << ", countHalf=" << countHalf;
+      }
+}
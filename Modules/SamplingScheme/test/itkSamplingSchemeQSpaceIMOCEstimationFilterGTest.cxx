@@ -0,0 +1,112 @@
+/**
+ *       @file  itkSamplingSchemeQSpaceIMOCEstimationFilterGTest.cxx
+ *      @brief
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+
+#include "gtest/gtest.h"
+#include "itkSamplingSchemeQSpace.h"
+#include "itkSamplingSchemeQSpaceIMOCEstimationFilter.h"
+#include "itkSphereTessellator.h"
+#include "utl.h"
+
+namespace
+{
+typedef itk::SamplingSchemeQSpace<double>                              SamplingType;
+typedef itk::SamplingSchemeQSpaceIMOCEstimationFilter<SamplingType>    EstimationType;
+typedef EstimationType::IndexVectorType                                IndexVectorType;
+typedef EstimationType::Index2DVectorType                              Index2DVectorType;
+
+/** 1281 orientations in the hemisphere from the icosahedron tessellation of order 5  */
+EstimationType::MatrixPointer
+FineOrientations()
+{
+  typedef itk::SphereTessellator<double> TessellatorType;
+  TessellatorType::Pointer tessellator = TessellatorType::New();
+  tessellator->SetBasicShape(TessellatorType::ICOSAHEDRON);
+  tessellator->SetOrder(5);
+  tessellator->TessellateSphere();
+  TessellatorType::PointsMatrixType points = tessellator->GetPointsMatrixInHemisphere();
+  EstimationType::MatrixPointer mat(new EstimationType::MatrixType(points.rows(), 3));
+  for ( int i = 0; i < points.rows(); ++i )
+    for ( int j = 0; j < 3; ++j )
+      (*mat)(i,j) = points(i,j);
+  return mat;
+}
+
+/** indices in shells estimated using numberOfThreads OpenMP threads. 
+ * If maxNumberOfStoredNeighbors is 0, neighbors are not stored, and they are cached for candidates.  */
+Index2DVectorType
+EstimateIndices(const IndexVectorType& numbers, const int numberOfThreads, const std::size_t maxNumberOfStoredNeighbors)
+{
+  utl::InitializeOpenMP(numberOfThreads);
+  EstimationType::Pointer estimator = EstimationType::New();
+  estimator->SetNumbersInShell(numbers);
+  estimator->SetFineOrientations(FineOrientations());
+  estimator->SetMaxNumberOfStoredNeighbors(maxNumberOfStoredNeighbors);
+  estimator->SetChooseMinimalCoverageShell(true);
+  estimator->UpdateOutputData();
+  return *estimator->GetOutputOrientations()->GetIndicesInShells();
+}
+}
+
+TEST(itkSamplingSchemeQSpaceIMOCEstimationFilter, TessellatorHemisphere)
+{
+  typedef itk::SphereTessellator<double> TessellatorType;
+  TessellatorType::Pointer tessellator = TessellatorType::New();
+  tessellator->SetBasicShape(TessellatorType::ICOSAHEDRON);
+  tessellator->SetOrder(3);
+  tessellator->TessellateSphere();
+  TessellatorType::PointsMatrixType points = tessellator->GetPointsMatrix();
+  TessellatorType::PointsMatrixType pointsHemisphere = tessellator->GetPointsMatrixInHemisphere();
+  ASSERT_EQ(points.rows()/2, pointsHemisphere.rows());
+  for ( int i = 0; i < pointsHemisphere.rows(); ++i )
+    {
+    EXPECT_TRUE(pointsHemisphere(i,2)>0 || (std::abs(pointsHemisphere(i,2))<1e-20 && pointsHemisphere(i,1)<=0));
+    // no antipodal pair in the hemisphere
+    for ( int j = i+1; j < pointsHemisphere.rows(); ++j )
+      {
+      double dot = 0;
+      for ( int k = 0; k < 3; ++k )
+        dot += pointsHemisphere(i,k)*pointsHemisphere(j,k);
+      EXPECT_GT(1-1e-8, std::fabs(dot));
+      }
+    }
+}
+
+TEST(itkSamplingSchemeQSpaceIMOCEstimationFilter, ParallelSameAsSerial)
+{
+  std::vector<IndexVectorType> numbersVec(2);
+  numbersVec[0] = IndexVectorType(1,30);
+  numbersVec[1] = IndexVectorType(2);
+  numbersVec[1][0]=10, numbersVec[1][1]=20;
+
+  for ( int n = 0; n < numbersVec.size(); ++n )
+    {
+    Index2DVectorType indicesSerial = EstimateIndices(numbersVec[n], 1, std::size_t(1)<<28);
+    ASSERT_EQ(numbersVec[n].size(), indicesSerial.size());
+    for ( int s = 0; s < numbersVec[n].size(); ++s )
+      EXPECT_EQ(numbersVec[n][s], (int)indicesSerial[s].size());
+
+    // neighbor lists are stored
+    Index2DVectorType indicesParallel = EstimateIndices(numbersVec[n], 4, std::size_t(1)<<28);
+    EXPECT_EQ(indicesSerial, indicesParallel);
+
+    // neighbor lists are not stored, and the cache is released in every step
+    indicesParallel = EstimateIndices(numbersVec[n], 4, 0);
+    EXPECT_EQ(indicesSerial, indicesParallel);
+    }
+  utl::InitializeOpenMP(-1);
+}
@@ -18,6 +18,7 @@
 #ifndef __itkIterativeSolverBase_h
 #define __itkIterativeSolverBase_h
 
+#include <deque>
 #include "itkSolverBase.h"
 
 namespace itk
@@ -94,6 +95,9 @@ public:
 
   void Initialize(const VectorType& xInitial=VectorType()) ITK_OVERRIDE; 
   virtual void Iterate() {}
+
+  /** reserve the history of the cost function  */
+  void AllocateWorkspace() ITK_OVERRIDE;
   
   /** Update history information and monitor stop conditions  */
   virtual void HistoryUpdateAndConvergenceCheck() {}
@@ -108,6 +112,10 @@ protected:
   
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
   virtual typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
+
+  /** Return the i-th vector in m_Workspace with size n. 
+   * Allocation only happens when the size is changed, and references of other vectors are still valid.  */
+  VectorType& GetWorkspace(const int i, const int n) const;
   
   ValueContainerType m_CostFunction;
   ValueContainerType m_DifferenceNormOfPrimalResidual;
@@ -129,6 +137,9 @@ protected:
   UpdateInfomationType m_UpdateInformation;
   int m_NumberOfChangeLessThanThreshold;
 
+  /** Preallocated vectors used in iterations. They are not shared by clones. */
+  mutable std::deque<VectorType> m_Workspace;
+
 private:
   IterativeSolverBase(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
@@ -68,6 +68,28 @@ IterativeSolverBase<TPrecision>
   m_NumberOfChangeLessThanThreshold=0;
 }
 
+template < class TPrecision >
+void
+IterativeSolverBase<TPrecision>
+::AllocateWorkspace ( ) 
+{
+  Superclass::AllocateWorkspace();
+  // Initialize() clears the containers, but keeps the capacity
+  this->m_CostFunction.reserve(m_MaxNumberOfIterations+2);
+}
+
+template < class TPrecision >
+typename IterativeSolverBase<TPrecision>::VectorType&
+IterativeSolverBase<TPrecision>
+::GetWorkspace ( const int i, const int n ) const
+{
+  // NOTE: resize of std::deque at the end does not invalidate references of existing elements
+  if (m_Workspace.size()<=i)
+    m_Workspace.resize(i+1);
+  m_Workspace[i].ReSize(n);
+  return m_Workspace[i];
+}
+
 template < class TPrecision >
 void
 IterativeSolverBase<TPrecision>
@@ -66,6 +66,29 @@ public:
   typedef typename Superclass::UpdateInfomationType UpdateInfomationType;
   typedef L2RegularizedLeastSquaresSolver<TPrecision>  L2SolverType;
   
+  /** Immutable data which only depends on m_A. 
+   * It is computed once when m_A is set, and it is shared by clones and solvers with the same m_A. */
+  struct ProblemContextType
+    {
+    MatrixPointer A;
+    MatrixPointer At;
+    MatrixPointer AtA;
+    /** 0.5/L, where L=min(||AtA||_F, ||AtA||_inf) is an upper bound of the largest eigenvalue of AtA */
+    ValueType Step;
+    ProblemContextType() : A(new MatrixType()), At(new MatrixType()), AtA(new MatrixType()), Step(-1)
+      {
+      }
+    };
+  typedef utl_shared_ptr<const ProblemContextType>  ProblemContextPointer;
+
+  /** Compute At, AtA and the step size for a copy of mat. The step uses an upper bound of the largest eigenvalue of AtA. */
+  static ProblemContextPointer CreateProblemContext(const MatrixPointer& mat);
+
+  /** m_A is set as the matrix in the context  */
+  void SetProblemContext(const ProblemContextPointer& context);
+  itkGetMacro(ProblemContext, ProblemContextPointer);
+
+  /** A new problem context is created only if mat is different from the current m_A  */
   void SetA(const MatrixPointer& mat);
   itkGetMacro(A, MatrixPointer);
   void Setw(const VectorPointer& w);
@@ -73,10 +96,38 @@ public:
   itkGetMacro(w, VectorPointer);
   void Setb(const VectorPointer& b);
   itkGetMacro(b, VectorPointer);
+
+  /** m_b and m_Atb are updated in place, no allocation after the first call  */
+  void SetbFromData(const ValueType* b, const int size, const int stride=1) ITK_OVERRIDE;
+
+  /** allocate m_b, m_Atb owned by this solver, and vectors used in iterations  */
+  void AllocateWorkspace() ITK_OVERRIDE;
   
   itkSetMacro(UseL2SolverForInitialization,bool);
   itkGetMacro(UseL2SolverForInitialization,bool);
   itkBooleanMacro(UseL2SolverForInitialization);
+
+  /** The L2 solver for initialization. Its pseudo-inverse for the current m_A can be cached outside and set by SetLS.  */
+  itkGetMacro(L2Solver, typename L2SolverType::Pointer);
+
+  /** Use gap safe screening rules to remove coefficients which are proven to be zero in the solution. 
+   * Iterations are performed on the compacted sub-matrix of AtA with the remaining coefficients. */
+  itkSetMacro(UseGapSafeScreening,bool);
+  itkGetMacro(UseGapSafeScreening,bool);
+  itkBooleanMacro(UseGapSafeScreening);
+
+  /** Solve a sequence of sub-problems in a growing working set of coefficients. 
+   * The working set is enlarged by coefficients which violate the optimality condition, until no violation. */
+  itkSetMacro(UseActiveSet,bool);
+  itkGetMacro(UseActiveSet,bool);
+  itkBooleanMacro(UseActiveSet);
+
+  /** number of iterations between two screening (or active set) checks  */
+  itkSetMacro(ScreeningFrequency,int);
+  itkGetMacro(ScreeningFrequency,int);
+
+  /** number of coefficients in the last sub-problem when screening or active set is used, otherwise it is N  */
+  itkGetMacro(NumberOfActiveCoefficients,int);
   
   int GetXDimension() const ITK_OVERRIDE
     {
@@ -88,8 +139,8 @@ public:
   void Clear() ITK_OVERRIDE
     { 
     Superclass::Clear(); 
-    m_A=MatrixPointer(new MatrixType()); 
-    m_AtA=MatrixPointer(new MatrixType()); 
+    m_ProblemContext=ProblemContextPointer(new ProblemContextType());
+    m_A=m_ProblemContext->A; 
     m_Atb=VectorPointer(new VectorType()); 
     m_b=VectorPointer(new VectorType()); 
     m_w=VectorPointer(new VectorType()); 
@@ -97,8 +148,8 @@ public:
     }
   void ClearA() 
     { 
-    m_A=MatrixPointer(new MatrixType()); 
-    m_AtA=MatrixPointer(new MatrixType()); 
+    m_ProblemContext=ProblemContextPointer(new ProblemContextType());
+    m_A=m_ProblemContext->A; 
     m_Atb=VectorPointer(new VectorType()); 
     m_L2Solver->ClearA();
     }
@@ -117,9 +168,19 @@ public:
   /** Update history information and monitor stop conditions  */
   void HistoryUpdateAndConvergenceCheck() ITK_OVERRIDE;
 
+  /** Update history information using the cost function fValue and the relative change of x  */
+  void HistoryUpdateAndConvergenceCheck(const ValueType fValue, const ValueType changePercentage_x);
+
   void VerifyInputs() const ITK_OVERRIDE;
   
   void Solve(const VectorType& xInitial=VectorType()) ITK_OVERRIDE; 
+
+  /** Solve using xWarm (e.g. the solution of a similar problem) as the initialization. 
+   * xWarm is rejected if its cost function is larger than the cost function of the L2 initialization, 
+   * then the L2 initialization is used. It needs m_UseL2SolverForInitialization. 
+   * Return true if xWarm is used. */
+  bool SolveWithWarmStart(const VectorType& xWarm);
+
   void Iterate() ITK_OVERRIDE; 
   void Initialize(const VectorType& xInitial=VectorType()) ITK_OVERRIDE; 
   
@@ -133,7 +194,26 @@ protected:
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
 
   virtual typename LightObject::Pointer InternalClone() const ITK_OVERRIDE;
-  
+
+  /** FISTA iterations on the compacted problem with gap safe screening and/or active set  */
+  void IterateWithScreening();
+
+  /** Compute the duality gap when the coefficients not in the working set (the first numberOfWorkingCoefficients in m_ActiveIndices) are zero. 
+   * Scores (lambda_i - |a_i^T theta|) / ||a_i|| for all active coefficients are stored in the workspace, 
+   * where theta is the feasible dual point from the residual. The radius of the gap safe sphere is sqrt(2*gap). 
+   * NOTE: the gap is for the cost function 0.5*||Ax-b||^2 + 0.5*|wx|. */
+  ValueType ComputeDualityGapAndScores(const int numberOfWorkingCoefficients, const ValueType bSquaredNorm);
+
+  /** Gather the compacted AtA, Atb and w for the working set  */
+  void GatherWorkingProblem(const int numberOfWorkingCoefficients);
+
+  /** Remove coefficients whose scores are larger than radius (except unpenalized coefficients).
+   * m_ActiveIndices, scores, and x, y in the working set are compacted in place. Return the new size of the working set. */
+  int RemoveScreenedCoefficients(const int numberOfWorkingCoefficients, const ValueType radius);
+
+  /** Move numberOfAddedCoefficients active coefficients out of the working set with the smallest scores to the end of the working set.  */
+  void AddCoefficientsToWorkingSet(const int numberOfWorkingCoefficients, const int numberOfAddedCoefficients);
+
   /** MxN matrix  */
   MatrixPointer m_A;
   /** Mx1 vector  */
@@ -144,19 +224,39 @@ protected:
 
   bool m_UseL2SolverForInitialization;
 
+  bool m_UseGapSafeScreening;
+  bool m_UseActiveSet;
+  int m_ScreeningFrequency;
+  int m_NumberOfActiveCoefficients;
+
 private:
   L1RegularizedLeastSquaresFISTASolver(const Self&); //purposely not implemented
   void operator=(const Self&); //purposely not implemented
 
-  MatrixPointer m_At;
-  MatrixPointer m_AtA;
+  /** shared by clones, only per-voxel vectors are owned by each clone */
+  ProblemContextPointer m_ProblemContext;
   VectorPointer m_Atb;
-  double m_Step;
   
   // private members
   VectorPointer m_xOld;
 
+  /** true if m_b and m_Atb are not shared with other solvers, then they can be modified in place */
+  bool m_IsbOwned;
+
   typename L2SolverType::Pointer m_L2Solver;
+
+  /** Indices of coefficients which are not screened. The first m_NumberOfActiveCoefficients are in the working set. */
+  std::vector<int> m_ActiveIndices;
+  /** compacted AtA for the working set, stored in the first n*n elements */
+  MatrixType m_ActiveAtA;
+
+  /** coefficients without L1 regularization (w_i=0), which are always in the working set, 
+   * and the pseudo-inverse of their Gram matrix to project the residual for a feasible dual point. 
+   * They are computed only when m_w or m_ProblemContext is changed. */
+  std::vector<int> m_UnpenalizedIndices;
+  MatrixType m_UnpenalizedGramInverse;
+  VectorPointer m_UnpenalizedW;
+  ProblemContextPointer m_UnpenalizedContext;
 };
 
 } // end namespace itk
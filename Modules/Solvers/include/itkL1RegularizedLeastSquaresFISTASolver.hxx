@@ -21,6 +21,7 @@
 #include "itkL1RegularizedLeastSquaresFISTASolver.h"
 #include "utl.h"
 #include "utlVNLBlas.h"
+#include "utlProximalOperators.h"
 
 namespace itk
 {
@@ -31,45 +32,70 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
   m_A(new MatrixType()),
   m_b(new VectorType()),
   m_w(new VectorType()),
-  m_At(new MatrixType()),
-  m_AtA(new MatrixType()),
+  m_ProblemContext(new ProblemContextType()),
   m_Atb(new VectorType()),
   m_xOld(new VectorType())
 {
-  m_Step=-1;
+  m_IsbOwned = false;
   m_L2Solver = L2SolverType::New();
   m_UseL2SolverForInitialization = false;
+  m_UseGapSafeScreening = false;
+  m_UseActiveSet = false;
+  m_ScreeningFrequency = 10;
+  m_NumberOfActiveCoefficients = 0;
+}
+
+template < class TPrecision >
+typename L1RegularizedLeastSquaresFISTASolver<TPrecision>::ProblemContextPointer
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::CreateProblemContext (const MatrixPointer& mat) 
+{
+  utl_shared_ptr<ProblemContextType> context(new ProblemContextType());
+  // NOTE: use value copy because mat can be changed outside, while the context is immutable.
+  *context->A = *mat;
+  *context->At = context->A->GetTranspose();
+  utl::ProductUtlXtX(*context->A, *context->AtA);
+  // The step needs an upper bound of the largest eigenvalue of AtA, otherwise FISTA may diverge. 
+  // Power iteration converges from below, thus it is not used. 
+  // Both the Frobenius norm and the infinity norm (maximal absolute row sum) are upper bounds.
+  ValueType maxEigenValue = utl::min<ValueType>(context->AtA->GetTwoNorm(), context->AtA->GetInfNorm());
+  context->Step = maxEigenValue>0 ? 0.5/maxEigenValue : -1;
+  return context;
 }
 
 template < class TPrecision >
 void
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
-::SetA (const MatrixPointer& mat) 
+::SetProblemContext (const ProblemContextPointer& context) 
 {
-  itkDebugMacro("setting A to " << *mat);
-  if ( *this->m_A != *mat )
+  if (m_ProblemContext!=context)
     {
-    m_A=MatrixPointer(new MatrixType());
-    m_At=MatrixPointer(new MatrixType());
-    m_AtA=MatrixPointer(new MatrixType());
-    *this->m_A = *mat;
-    // utl::MatrixCopy(*mat, *this->m_A, 1.0, 'N');
+    m_ProblemContext = context;
+    m_A = m_ProblemContext->A;
     this->Modified();
-    *this->m_At = this->m_A->GetTranspose();
-    // utl::MatrixCopy(*this->m_A, *m_At, 1.0, 'T');
-    utl::ProductUtlXtX(*m_A, *m_AtA);
-    m_Step = 0.5/m_AtA->GetTwoNorm();
     if (m_b->Size()>0)
       {
       utlException(m_A->Rows()!=m_b->Size(), "wrong size of m_A");
       m_Atb=VectorPointer(new VectorType());
-      utl::ProductUtlMv(*m_At, *m_b, *m_Atb);
+      utl::ProductUtlMv(*m_ProblemContext->At, *m_b, *m_Atb);
       }
     }
   if (m_UseL2SolverForInitialization)
     m_L2Solver->SetA(m_A);
 }
 
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::SetA (const MatrixPointer& mat) 
+{
+  itkDebugMacro("setting A to " << *mat);
+  if ( m_A!=mat && *this->m_A != *mat )
+    SetProblemContext(CreateProblemContext(mat));
+  else if (m_UseL2SolverForInitialization)
+    m_L2Solver->SetA(m_A);
+}
+
 template < class TPrecision >
 void
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
@@ -83,22 +109,58 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
     this->Modified();
     if (m_A->Size()>0)
       {
-      utlException(m_At->Columns()!=m_b->Size(), "wrong size of m_A");
+      utlException(m_ProblemContext->At->Columns()!=m_b->Size(), "wrong size of m_A");
       m_Atb=VectorPointer(new VectorType());
-      utl::ProductUtlMv(*m_At, *m_b, *m_Atb);
+      utl::ProductUtlMv(*m_ProblemContext->At, *m_b, *m_Atb);
       }
     }
   if (m_UseL2SolverForInitialization)
     m_L2Solver->Setb(m_b);
 }
 
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::AllocateWorkspace () 
+{
+  Superclass::AllocateWorkspace();
+  int N = this->GetXDimension();
+  int M = m_A->Rows();
+  m_b=VectorPointer(new VectorType(M));
+  m_b->Fill(0.0);
+  m_Atb=VectorPointer(new VectorType(N));
+  m_Atb->Fill(0.0);
+  m_IsbOwned = true;
+  m_xOld->ReSize(N);
+  // y, xg, w_new, tmp in Iterate() (tmp is reused in HistoryUpdateAndConvergenceCheck()), and the residual in EvaluateCostFunction()
+  for ( int i = 0; i < 4; i += 1 ) 
+    this->GetWorkspace(i, N);
+  this->GetWorkspace(4, M);
+  if (m_UseL2SolverForInitialization)
+    m_L2Solver->Setb(m_b);
+}
+
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::SetbFromData (const ValueType* b, const int size, const int stride) 
+{
+  utlException(m_A->Rows()!=size, "wrong size of b! m_A->Rows()="<<m_A->Rows()<<", size="<<size);
+  if (!m_IsbOwned || m_b->Size()!=size || m_Atb->Size()!=m_A->Columns())
+    AllocateWorkspace();
+  // NOTE: Modified() is not called, because m_b is changed for each voxel
+  utl::cblas_copy<ValueType>(size, b, stride, m_b->GetData(), 1);
+  utl::ProductUtlMv(*m_ProblemContext->At, *m_b, *m_Atb);
+}
+
 template < class TPrecision >
 void
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
 ::Setw (const VectorPointer& w) 
 {
   itkDebugMacro("setting w to " << *w);
-  if ( this->m_w != w )
+  // compare values, because the same weights are set as a new vector in each update of filters
+  if ( this->m_w != w && *this->m_w != *w )
     {
     this->m_w = w;
     this->Modified();
@@ -115,8 +177,11 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
   lambda->Fill(0.0);
   lambda->SetDiagonal(*w);
   utlException(!m_UseL2SolverForInitialization, "need to set m_UseL2SolverForInitialization");
+  // m_L2Solver is only modified if lambda is changed
+  ModifiedTimeType mtime = m_L2Solver->GetMTime();
   m_L2Solver->SetLambda(lambda);
-  this->Modified();
+  if (m_L2Solver->GetMTime()!=mtime)
+    this->Modified();
 }
 
 template < class TPrecision >
@@ -145,11 +210,15 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
   rval->m_A = m_A;
   rval->m_b = m_b;
   rval->m_w = m_w;
-  rval->m_At = m_At;
-  rval->m_AtA = m_AtA;
+  // NOTE: the problem context is immutable, thus it is shared, not copied
+  rval->m_ProblemContext = m_ProblemContext;
   rval->m_Atb = m_Atb;
-  rval->m_Step = m_Step;
+  // m_b and m_Atb are shared, thus they will be re-allocated in SetbFromData 
+  rval->m_IsbOwned = false;
   rval->m_UseL2SolverForInitialization = m_UseL2SolverForInitialization;
+  rval->m_UseGapSafeScreening = m_UseGapSafeScreening;
+  rval->m_UseActiveSet = m_UseActiveSet;
+  rval->m_ScreeningFrequency = m_ScreeningFrequency;
   rval->m_L2Solver = m_L2Solver->Clone();
   return loPtr;
 }
@@ -167,7 +236,7 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
     if (m_L2Solver->GetLambda()->Size()==0)
       SetwForInitialization(this->m_w);
     m_L2Solver->Solve();
-    this->m_x = m_L2Solver->Getx();
+    utl::CopyUtlVector(m_L2Solver->Getx(), this->m_x);
     // m_L2Solver->Print(std::cout<<"m_L2Solver : ");
     }
   if (this->GetDebug())
@@ -186,20 +255,45 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
   // EndSolve();
 }
 
+template < class TPrecision >
+bool
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::SolveWithWarmStart ( const VectorType& xWarm) 
+{
+  utlShowPosition(this->GetDebug());
+  this->VerifyInputs();
+  // L2 initialization
+  Initialize();
+  bool isWarmStartUsed = false;
+  if (xWarm.Size()==this->m_x.Size())
+    {
+    ValueType funcL2 = EvaluateCostFunction();
+    ValueType funcWarm = EvaluateCostFunction(xWarm);
+    if (this->GetDebug())
+      utlPrintVar2(true, funcL2, funcWarm);
+    if (funcWarm<=funcL2)
+      {
+      utl::cblas_copy(this->m_x.Size(), xWarm.GetData(), 1, this->m_x.GetData(), 1);
+      isWarmStartUsed = true;
+      }
+    }
+  Iterate();
+  return isWarmStartUsed;
+}
+
 template < class TPrecision >
 typename L1RegularizedLeastSquaresFISTASolver<TPrecision>::ValueType
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
 ::EvaluateCostFunction (const VectorType& x) const 
 {
   const VectorType* xx = (x.Size()!=0? (&x) : (&this->m_x));
-  VectorPointer e(new VectorType());
-  utl::ProductUtlMv(*m_A, *xx, *e);
-  utl::vSub(e->Size(), e->GetData(), m_b->GetData(), e->GetData());
+  int N = xx->Size();
+  VectorType& e = this->GetWorkspace(4, m_A->Rows());
+  utl::ProductUtlMv(*m_A, *xx, e);
+  utl::vSub(e.Size(), e.GetData(), m_b->GetData(), e.GetData());
   // *e -= *m_b;
-  double eNorm = utl::cblas_nrm2(e->Size(), e->GetData(), 1);
-  VectorType tmp(e->Size());
-  utl::vMul(e->Size(), m_w->GetData(), (double*)xx->GetData(), tmp.GetData());
-  ValueType func = eNorm*eNorm + utl::cblas_asum(e->Size(), tmp.GetData(),1);
+  ValueType eNorm = utl::cblas_nrm2<ValueType>(e.Size(), e.GetData(), 1);
+  ValueType func = eNorm*eNorm + utl::WeightedL1Norm<ValueType>(N, xx->GetData(), m_w->GetData());
   // ValueType func = e->squared_magnitude() + element_product(*m_w, *xx).one_norm();
   return func;
 }
@@ -209,19 +303,31 @@ void
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
 ::HistoryUpdateAndConvergenceCheck ( ) 
 {
-  ValueType fValue = EvaluateCostFunction(), changePercentage=0, changePercentage_x=0;
-  this->m_CostFunction.push_back(fValue);
-  int size = this->m_CostFunction.size();
-  VectorType tmp(this->m_x.Size());
-  if (size>=2)
+  ValueType fValue = EvaluateCostFunction(), changePercentage_x=0;
+  VectorType& tmp = this->GetWorkspace(3, this->m_x.Size());
+  if (this->m_CostFunction.size()>=1)
     {
-    changePercentage = (this->m_CostFunction[size-2] - this->m_CostFunction[size-1])/this->m_CostFunction[size-2];
-    double xOldNorm = utl::cblas_nrm2(this->m_xOld->Size(), this->m_xOld->GetData(), 1);
+    ValueType xOldNorm = utl::cblas_nrm2<ValueType>(this->m_xOld->Size(), this->m_xOld->GetData(), 1);
     if (xOldNorm>0)
       {
       utl::vSub(this->m_x.Size(), this->m_x.GetData(), m_xOld->GetData(), tmp.GetData());
-      changePercentage_x = utl::cblas_nrm2(tmp.Size(), tmp.GetData(), 1) / xOldNorm;
+      changePercentage_x = utl::cblas_nrm2<ValueType>(tmp.Size(), tmp.GetData(), 1) / xOldNorm;
       }
+    }
+  HistoryUpdateAndConvergenceCheck(fValue, changePercentage_x);
+}
+
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::HistoryUpdateAndConvergenceCheck (const ValueType fValue, const ValueType changePercentage_x) 
+{
+  ValueType changePercentage=0;
+  this->m_CostFunction.push_back(fValue);
+  int size = this->m_CostFunction.size();
+  if (size>=2)
+    {
+    changePercentage = (this->m_CostFunction[size-2] - this->m_CostFunction[size-1])/this->m_CostFunction[size-2];
     if (changePercentage <= this->m_MinRelativeChangeOfCostFunction && changePercentage>=0 && changePercentage_x<=this->m_MinRelativeChangeOfPrimalResidual)
       {
       this->m_UpdateInformation = Self::CONTINUE;
@@ -252,12 +358,28 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
 {
   utlShowPosition(this->GetDebug());
 
-  VectorType y=this->m_x, xg=this->m_x;
-  double t = 1.0, t_new=1.0, func=-1.0;
-  VectorType w_new = (*m_w) % m_Step, tmp(xg.Size());
-  this->m_CostFunction.push_back(EvaluateCostFunction());
+  if (m_UseGapSafeScreening || m_UseActiveSet)
+    {
+    IterateWithScreening();
+    return;
+    }
 
   int N = GetXDimension();
+  m_NumberOfActiveCoefficients = N;
+  // no allocation if the workspace has been allocated
+  VectorType& y = this->GetWorkspace(0, N);
+  VectorType& xg = this->GetWorkspace(1, N);
+  VectorType& w_new = this->GetWorkspace(2, N);
+  VectorType& tmp = this->GetWorkspace(3, N);
+  y = this->m_x;
+  xg = this->m_x;
+  ValueType t = 1.0, t_new=1.0;
+  const MatrixType& AtA = *m_ProblemContext->AtA;
+  const ValueType step = m_ProblemContext->Step;
+  utl::cblas_copy<ValueType>(N, m_w->GetData(), 1, w_new.GetData(), 1);
+  utl::cblas_scal<ValueType>(N, step, w_new.GetData(), 1);
+  this->m_CostFunction.push_back(EvaluateCostFunction());
+
   this->m_NumberOfIterations=0;
   int num_change_less = 0;
   m_xOld->ReSize(this->m_x.Size());
@@ -271,19 +393,17 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
       }
   
     // FISTA
-    utl::ProductUtlMv(*m_AtA, y, tmp);
+    utl::ProductUtlMv(AtA, y, tmp);
     utl::vSub(tmp.Size(), tmp.GetData(), m_Atb->GetData(), tmp.GetData());
-    utl::cblas_scal<double>(tmp.Size(), m_Step*2, tmp.GetData(), 1);
+    utl::cblas_scal<ValueType>(tmp.Size(), step*2, tmp.GetData(), 1);
     utl::vSub(y.Size(), y.GetData(), tmp.GetData(), xg.GetData());
-    // xg = y - m_Step*2*(tmp - *m_Atb);
-    for ( int j = 0; j < N; j += 1 ) 
-      {
-      xg[j] = xg[j]>w_new[j] ? (xg[j]-w_new[j]) : (xg[j]<-w_new[j] ? (xg[j]+w_new[j]) : 0 ); 
-      }
+    // xg = y - step*2*(tmp - *m_Atb);
+    // soft thresholding, xg[j] = sign(xg[j]) max(|xg[j]|-w_new[j], 0)
+    utl::ProximalWeightedL1<ValueType>(N, xg.GetData(), w_new.GetData(), xg.GetData());
     t_new = 0.5+0.5*std::sqrt(1+4*t*t);
 
     utl::vSub(xg.Size(), xg.GetData(), this->m_x.GetData(), tmp.GetData());
-    utl::cblas_scal<double>(xg.Size(), (t-1)/t_new, tmp.GetData(), 1);
+    utl::cblas_scal<ValueType>(xg.Size(), (t-1)/t_new, tmp.GetData(), 1);
     utl::vAdd(xg.Size(), xg.GetData(), tmp.GetData(), y.GetData());
     // y = xg + (t-1)/t_new * (xg-this->m_x);
 
@@ -307,6 +427,339 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
     }
 }
 
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::GatherWorkingProblem (const int numberOfWorkingCoefficients) 
+{
+  int N = GetXDimension();
+  int n = numberOfWorkingCoefficients;
+  const MatrixType& AtA = *m_ProblemContext->AtA;
+  const ValueType step = m_ProblemContext->Step;
+  VectorType& Atb = this->GetWorkspace(5, N);
+  VectorType& w_new = this->GetWorkspace(6, N);
+  if (m_ActiveAtA.Rows()!=N || m_ActiveAtA.Columns()!=N)
+    m_ActiveAtA.ReSize(N, N);
+  // row major nxn matrix in the first n*n elements
+  ValueType* data = m_ActiveAtA.GetData();
+  for ( int r = 0; r < n; ++r ) 
+    {
+    int i = m_ActiveIndices[r];
+    Atb[r] = (*m_Atb)[i];
+    w_new[r] = step*(*m_w)[i];
+    for ( int c = 0; c < n; ++c ) 
+      data[r*n+c] = AtA(i, m_ActiveIndices[c]);
+    }
+}
+
+template < class TPrecision >
+typename L1RegularizedLeastSquaresFISTASolver<TPrecision>::ValueType
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::ComputeDualityGapAndScores (const int numberOfWorkingCoefficients, const ValueType bSquaredNorm) 
+{
+  int N = GetXDimension();
+  int nW = numberOfWorkingCoefficients;
+  int nS = m_ActiveIndices.size();
+  int nU = m_UnpenalizedIndices.size();
+  const MatrixType& AtA = *m_ProblemContext->AtA;
+  const VectorType& x = this->GetWorkspace(7, N);
+  VectorType& g = this->GetWorkspace(12, N);
+  VectorType& scores = this->GetWorkspace(13, N);
+
+  // g = A^T (b-Ax) for active coefficients, x is zero out of the working set
+  for ( int p = 0; p < nS; ++p ) 
+    {
+    int i = m_ActiveIndices[p];
+    ValueType sum = (*m_Atb)[i];
+    for ( int k = 0; k < nW; ++k ) 
+      sum -= AtA(i, m_ActiveIndices[k]) * x[k];
+    g[p] = sum;
+    }
+  ValueType xAtb=0, xg=0, l1=0;
+  for ( int k = 0; k < nW; ++k ) 
+    {
+    int i = m_ActiveIndices[k];
+    xAtb += x[k]*(*m_Atb)[i];
+    xg += x[k]*g[k];
+    l1 += (*m_w)[i]*std::fabs(x[k]);
+    }
+  // ||Ax-b||^2 = ||b||^2 - x^T A^T b - x^T A^T (b-Ax)
+  ValueType residualNorm2 = utl::max<ValueType>(bSquaredNorm - xAtb - xg, 0);
+  ValueType thetaNorm2 = residualNorm2, thetab = bSquaredNorm - xAtb;
+
+  if (nU>0)
+    {
+    // theta = r - A_U z, z = (A_U^T A_U)^+ A_U^T r, such that A_U^T theta = 0 for unpenalized coefficients
+    VectorType& gU = this->GetWorkspace(14, N);
+    VectorType& z = this->GetWorkspace(15, N);
+    for ( int u = 0; u < nU; ++u ) 
+      {
+      int i = m_UnpenalizedIndices[u];
+      ValueType sum = (*m_Atb)[i];
+      for ( int k = 0; k < nW; ++k ) 
+        sum -= AtA(i, m_ActiveIndices[k]) * x[k];
+      gU[u] = sum;
+      }
+    for ( int u = 0; u < nU; ++u ) 
+      {
+      ValueType sum=0;
+      for ( int v = 0; v < nU; ++v ) 
+        sum += m_UnpenalizedGramInverse(u,v)*gU[v];
+      z[u] = sum;
+      }
+    for ( int p = 0; p < nS; ++p ) 
+      {
+      int i = m_ActiveIndices[p];
+      for ( int u = 0; u < nU; ++u ) 
+        g[p] -= AtA(i, m_UnpenalizedIndices[u]) * z[u];
+      }
+    for ( int u = 0; u < nU; ++u ) 
+      {
+      thetaNorm2 -= z[u]*gU[u];
+      thetab -= z[u]*(*m_Atb)[m_UnpenalizedIndices[u]];
+      }
+    thetaNorm2 = utl::max<ValueType>(thetaNorm2, 0);
+    }
+
+  // scale theta such that |a_i^T theta| <= lambda_i, lambda_i = 0.5*w_i
+  ValueType s = 1.0;
+  for ( int p = 0; p < nS; ++p ) 
+    {
+    ValueType lambda = 0.5*(*m_w)[m_ActiveIndices[p]];
+    ValueType gAbs = std::fabs(g[p]);
+    if (lambda>0 && gAbs*s>lambda)
+      s = lambda/gAbs;
+    }
+
+  // primal 0.5*||Ax-b||^2 + 0.5*|wx|, dual 0.5*||b||^2 - 0.5*||theta-b||^2
+  ValueType primal = 0.5*residualNorm2 + 0.5*l1;
+  ValueType dual = s*thetab - 0.5*s*s*thetaNorm2;
+  ValueType gap = utl::max<ValueType>(primal-dual, 0);
+
+  for ( int p = 0; p < nS; ++p ) 
+    {
+    int i = m_ActiveIndices[p];
+    ValueType lambda = 0.5*(*m_w)[i];
+    ValueType colNorm = std::sqrt(AtA(i,i));
+    if (lambda<=0)
+      scores[p] = -std::numeric_limits<ValueType>::max();
+    else
+      scores[p] = colNorm>0 ? (lambda - s*std::fabs(g[p]))/colNorm : std::numeric_limits<ValueType>::max();
+    }
+
+  if (this->GetDebug())
+    utlPrintVar5(true, nS, nW, primal, dual, gap);
+  return gap;
+}
+
+template < class TPrecision >
+int
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::RemoveScreenedCoefficients (const int numberOfWorkingCoefficients, const ValueType radius) 
+{
+  int N = GetXDimension();
+  int nW = numberOfWorkingCoefficients;
+  int nS = m_ActiveIndices.size();
+  VectorType& x = this->GetWorkspace(7, N);
+  VectorType& y = this->GetWorkspace(8, N);
+  VectorType& g = this->GetWorkspace(12, N);
+  VectorType& scores = this->GetWorkspace(13, N);
+  // the order is kept, thus the working set is still the first part
+  int q=0, nWNew=0;
+  for ( int p = 0; p < nS; ++p ) 
+    {
+    if (scores[p]>radius)
+      continue;
+    m_ActiveIndices[q] = m_ActiveIndices[p];
+    scores[q] = scores[p];
+    g[q] = g[p];
+    if (p<nW)
+      {
+      x[q] = x[p];
+      y[q] = y[p];
+      nWNew++;
+      }
+    q++;
+    }
+  m_ActiveIndices.resize(q);
+  return nWNew;
+}
+
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::AddCoefficientsToWorkingSet (const int numberOfWorkingCoefficients, const int numberOfAddedCoefficients) 
+{
+  int N = GetXDimension();
+  int nS = m_ActiveIndices.size();
+  VectorType& x = this->GetWorkspace(7, N);
+  VectorType& y = this->GetWorkspace(8, N);
+  VectorType& g = this->GetWorkspace(12, N);
+  VectorType& scores = this->GetWorkspace(13, N);
+  // partial selection sort, numberOfAddedCoefficients is small
+  for ( int j = numberOfWorkingCoefficients; j < numberOfWorkingCoefficients+numberOfAddedCoefficients && j<nS; ++j ) 
+    {
+    int jMin = j;
+    for ( int p = j+1; p < nS; ++p ) 
+      {
+      if (scores[p]<scores[jMin])
+        jMin = p;
+      }
+    std::swap(m_ActiveIndices[j], m_ActiveIndices[jMin]);
+    std::swap(scores[j], scores[jMin]);
+    std::swap(g[j], g[jMin]);
+    x[j] = 0;
+    y[j] = 0;
+    }
+}
+
+template < class TPrecision >
+void
+L1RegularizedLeastSquaresFISTASolver<TPrecision>
+::IterateWithScreening () 
+{
+  int N = GetXDimension();
+  const MatrixType& AtA = *m_ProblemContext->AtA;
+  const ValueType step = m_ProblemContext->Step;
+
+  if (m_UnpenalizedW!=m_w || m_UnpenalizedContext!=m_ProblemContext)
+    {
+    m_UnpenalizedIndices.clear();
+    for ( int i = 0; i < N; ++i ) 
+      {
+      if ((*m_w)[i]<=0)
+        m_UnpenalizedIndices.push_back(i);
+      }
+    int nU = m_UnpenalizedIndices.size();
+    if (nU>0)
+      {
+      MatrixType gram(nU, nU);
+      for ( int u = 0; u < nU; ++u ) 
+        for ( int v = 0; v < nU; ++v ) 
+          gram(u,v) = AtA(m_UnpenalizedIndices[u], m_UnpenalizedIndices[v]);
+      m_UnpenalizedGramInverse = utl::PInverseSymmericMatrix(gram);
+      }
+    m_UnpenalizedW = m_w;
+    m_UnpenalizedContext = m_ProblemContext;
+    }
+  const int nU = m_UnpenalizedIndices.size();
+
+  // variables in the working set are stored in the first nW elements
+  const VectorType& Atb = this->GetWorkspace(5, N);
+  const VectorType& w_new = this->GetWorkspace(6, N);
+  VectorType& x = this->GetWorkspace(7, N);
+  VectorType& y = this->GetWorkspace(8, N);
+  VectorType& xg = this->GetWorkspace(9, N);
+  VectorType& tmp = this->GetWorkspace(10, N);
+  VectorType& xOld = this->GetWorkspace(11, N);
+  const VectorType& g = this->GetWorkspace(12, N);
+  const ValueType bSquaredNorm = utl::cblas_dot<ValueType>(m_b->Size(), m_b->GetData(), 1, m_b->GetData(), 1);
+
+  // all coefficients are active at the beginning
+  m_ActiveIndices.resize(N);
+  for ( int i = 0; i < N; ++i ) 
+    m_ActiveIndices[i] = i;
+  utl::cblas_copy<ValueType>(N, this->m_x.GetData(), 1, x.GetData(), 1);
+  int nW = N;
+  this->m_CostFunction.push_back(EvaluateCostFunction());
+  this->m_NumberOfIterations=0;
+
+  ValueType gap = ComputeDualityGapAndScores(nW, bSquaredNorm);
+  if (m_UseGapSafeScreening)
+    nW = RemoveScreenedCoefficients(nW, std::sqrt(2*gap));
+  if (m_UseActiveSet)
+    {
+    // start from unpenalized coefficients and coefficients with the smallest scores, 
+    // i.e. coefficients nearest to the boundary of the dual feasible set
+    int nS = m_ActiveIndices.size();
+    AddCoefficientsToWorkingSet(0, utl::min<int>(nS, nU+10));
+    nW = utl::min<int>(nS, nU+10);
+    // x in the new working set from the initialization, zeros for others
+    for ( int k = 0; k < nW; ++k ) 
+      x[k] = this->m_x[m_ActiveIndices[k]];
+    }
+  GatherWorkingProblem(nW);
+
+  ValueType t = 1.0, t_new = 1.0;
+  utl::cblas_copy<ValueType>(nW, x.GetData(), 1, y.GetData(), 1);
+  while ( this->m_NumberOfIterations <= this->m_MaxNumberOfIterations ) 
+    {
+    const int lda = utl::max<int>(nW, 1);
+    // FISTA iterations in the working set 
+    for ( int iter = 0; iter < m_ScreeningFrequency && this->m_NumberOfIterations <= this->m_MaxNumberOfIterations; ++iter ) 
+      {
+      utl::cblas_copy<ValueType>(nW, x.GetData(), 1, xOld.GetData(), 1);
+      utl::cblas_gemv<ValueType>(CblasRowMajor, CblasNoTrans, nW, nW, 1.0, m_ActiveAtA.GetData(), lda, y.GetData(), 1, 0.0, tmp.GetData(), 1);
+      utl::vSub(nW, tmp.GetData(), Atb.GetData(), tmp.GetData());
+      utl::cblas_scal<ValueType>(nW, step*2, tmp.GetData(), 1);
+      utl::vSub(nW, y.GetData(), tmp.GetData(), xg.GetData());
+      utl::ProximalWeightedL1<ValueType>(nW, xg.GetData(), w_new.GetData(), xg.GetData());
+      t_new = 0.5+0.5*std::sqrt(1+4*t*t);
+
+      utl::vSub(nW, xg.GetData(), x.GetData(), tmp.GetData());
+      utl::cblas_scal<ValueType>(nW, (t-1)/t_new, tmp.GetData(), 1);
+      utl::vAdd(nW, xg.GetData(), tmp.GetData(), y.GetData());
+      utl::cblas_copy<ValueType>(nW, xg.GetData(), 1, x.GetData(), 1);
+      t = t_new;
+      this->m_NumberOfIterations++;
+
+      // ||Ax-b||^2 + |wx| = ||b||^2 - 2 x^T A^T b + x^T A^T A x + |wx| 
+      utl::cblas_gemv<ValueType>(CblasRowMajor, CblasNoTrans, nW, nW, 1.0, m_ActiveAtA.GetData(), lda, x.GetData(), 1, 0.0, tmp.GetData(), 1);
+      ValueType fValue = bSquaredNorm - 2*utl::cblas_dot<ValueType>(nW, x.GetData(), 1, Atb.GetData(), 1) 
+        + utl::cblas_dot<ValueType>(nW, x.GetData(), 1, tmp.GetData(), 1) + utl::WeightedL1Norm<ValueType>(nW, x.GetData(), w_new.GetData())/step;
+      ValueType changePercentage_x = 0;
+      ValueType xOldNorm = utl::cblas_nrm2<ValueType>(nW, xOld.GetData(), 1);
+      if (xOldNorm>0)
+        {
+        utl::vSub(nW, x.GetData(), xOld.GetData(), tmp.GetData());
+        changePercentage_x = utl::cblas_nrm2<ValueType>(nW, tmp.GetData(), 1) / xOldNorm;
+        }
+      HistoryUpdateAndConvergenceCheck(fValue, changePercentage_x);
+      if (this->m_UpdateInformation==Self::STOP_MIN_CHANGE)
+        break;
+      }
+
+    bool isConverged = this->m_UpdateInformation==Self::STOP_MIN_CHANGE;
+    int nWOld = nW;
+    gap = ComputeDualityGapAndScores(nW, bSquaredNorm);
+    if (m_UseGapSafeScreening)
+      nW = RemoveScreenedCoefficients(nW, std::sqrt(2*gap));
+    int nS = m_ActiveIndices.size();
+
+    if (this->m_NumberOfIterations > this->m_MaxNumberOfIterations || (isConverged && (!m_UseActiveSet || nW==nS)))
+      break;
+
+    if (isConverged)
+      {
+      // enlarge the working set by coefficients which violate the optimality condition |a_i^T (b-Ax)| <= lambda_i
+      int numberOfViolations = 0;
+      for ( int p = nW; p < nS; ++p ) 
+        {
+        if (std::fabs(g[p]) > 0.5*(*m_w)[m_ActiveIndices[p]]*(1+1e-6))
+          numberOfViolations++;
+        }
+      if (numberOfViolations==0)
+        break;
+      int numberOfAdded = utl::min<int>(numberOfViolations, utl::max<int>(nW, 10));
+      AddCoefficientsToWorkingSet(nW, numberOfAdded);
+      nW += numberOfAdded;
+      GatherWorkingProblem(nW);
+      // restart FISTA in the new working set
+      t = 1.0;
+      utl::cblas_copy<ValueType>(nW, x.GetData(), 1, y.GetData(), 1);
+      this->m_NumberOfChangeLessThanThreshold = 0;
+      this->m_UpdateInformation = Self::CONTINUE;
+      }
+    else if (nW!=nWOld)
+      GatherWorkingProblem(nW);
+    }
+
+  this->m_x.Fill(0.0);
+  for ( int k = 0; k < nW; ++k ) 
+    this->m_x[m_ActiveIndices[k]] = x[k];
+  m_NumberOfActiveCoefficients = nW;
+}
+
 template <class TPrecision>
 void
 L1RegularizedLeastSquaresFISTASolver<TPrecision>
@@ -316,7 +769,8 @@ L1RegularizedLeastSquaresFISTASolver<TPrecision>
   utl::PrintUtlMatrix(*m_A, "m_A", " ", os<<indent);
   utl::PrintUtlVector(*m_b, "m_b", " ", os<<indent);
   utl::PrintUtlVector(*m_w, "m_w", " ", os<<indent);
-  PrintVar2(true, m_Step, m_UseL2SolverForInitialization, os<<indent);
+  PrintVar2(true, m_ProblemContext->Step, m_UseL2SolverForInitialization, os<<indent);
+  PrintVar4(true, m_UseGapSafeScreening, m_UseActiveSet, m_ScreeningFrequency, m_NumberOfActiveCoefficients, os<<indent);
   if (m_L2Solver)
     m_L2Solver->Print(os<<indent<< "m_L2Solver for initialization = ");
 }
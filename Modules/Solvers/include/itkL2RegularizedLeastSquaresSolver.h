@@ -68,10 +68,17 @@ public:
   itkGetMacro(A, MatrixPointer);
   void SetLambda(const MatrixPointer& mat);
   itkGetMacro(Lambda, MatrixPointer);
-  itkSetMacro(b, VectorPointer);
+  /** b is shared, not copied  */
+  void Setb(const VectorPointer& b);
   itkGetMacro(b, VectorPointer);
   
+  /** m_b is updated in place if it is owned by this solver  */
+  void SetbFromData(const ValueType* b, const int size, const int stride=1) ITK_OVERRIDE;
+  
   itkGetMacro(LS, MatrixPointer);
+  /** Set a precomputed m_LS which must be computed from the current m_A and m_Lambda, e.g. GetLS() of another solver with the same inputs. 
+   * The matrix is shared, not copied. */
+  void SetLS(const MatrixPointer& mat);
   itkGetMacro(ConditionNumber, ValueType);
 
   int GetXDimension() const ITK_OVERRIDE
@@ -99,12 +106,18 @@ public:
   void Clearb() 
     { 
     m_b=VectorPointer(new VectorType()); 
+    m_IsbOwned=true;
     }
 
   void VerifyInputs() const ITK_OVERRIDE;
   
   void Solve(const VectorType& xInitial=VectorType()) ITK_OVERRIDE; 
   void Initialize(const VectorType& xInitial=VectorType()) ITK_OVERRIDE; 
+
+  /** Solve the problems for multiple b vectors which share the same m_A and m_Lambda. 
+   * Each row of bMatrix is a b vector, and each row of xMatrix is the corresponding solution. 
+   * It uses one gemm with the cached m_LS, i.e. \f$ X = B * LS^T \f$.  */
+  void SolveBatch(const MatrixType& bMatrix, MatrixType& xMatrix);
   
   ValueType EvaluateCostFunction(const VectorType& x=VectorType()) const ITK_OVERRIDE;
 
@@ -125,6 +138,9 @@ protected:
   MatrixPointer m_Lambda;
 
   bool m_IsLambdaSymmetric;
+
+  /** true if m_b is not shared with others, then it can be modified in place */
+  bool m_IsbOwned;
   
 
 private:
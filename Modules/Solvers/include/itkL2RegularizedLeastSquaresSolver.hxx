@@ -39,6 +39,35 @@ L2RegularizedLeastSquaresSolver<TPrecision>
   m_ConditionNumber = -1;
   // empty matrix is symmetric
   m_IsLambdaSymmetric = true;
+  m_IsbOwned = true;
+}
+
+template <class TPrecision>
+void
+L2RegularizedLeastSquaresSolver<TPrecision>
+::Setb(const VectorPointer& b)
+{
+  if ( this->m_b != b )
+    {
+    this->m_b = b;
+    m_IsbOwned = false;
+    this->Modified();
+    }
+}
+
+template <class TPrecision>
+void
+L2RegularizedLeastSquaresSolver<TPrecision>
+::SetbFromData(const ValueType* b, const int size, const int stride)
+{
+  utlException(m_A->Rows()!=size, "wrong size of b! m_A->Rows()="<<m_A->Rows()<<", size="<<size);
+  if (!m_IsbOwned || m_b->Size()!=size)
+    {
+    m_b = VectorPointer(new VectorType(size));
+    m_IsbOwned = true;
+    }
+  // NOTE: Modified() is not called, because m_b is changed for each voxel
+  utl::cblas_copy<ValueType>(size, b, stride, m_b->GetData(), 1);
 }
 
 template <class TPrecision>
@@ -75,6 +104,16 @@ L2RegularizedLeastSquaresSolver<TPrecision>
     }
 }
 
+template <class TPrecision>
+void
+L2RegularizedLeastSquaresSolver<TPrecision>
+::SetLS(const MatrixPointer& mat)
+{
+  utlGlobalException(mat->Rows()!=m_A->Columns() || mat->Columns()!=m_A->Rows(), "wrong size of m_LS! m_LS should be the pseudo-inverse of the current m_A");
+  m_LS = mat;
+  m_ConditionNumber=-1;
+}
+
 template <class TPrecision>
 void
 L2RegularizedLeastSquaresSolver<TPrecision>
@@ -112,20 +151,23 @@ L2RegularizedLeastSquaresSolver<TPrecision>
   Superclass::Initialize(xInitial);
   if (m_LS->Size()==0)
     {
-    m_LS = MatrixPointer(new MatrixType());
+    // NOTE: the pseudo-inverse is always computed in double, because AtA squares the condition number of A, 
+    // which is too large for single precision solvers. 
+    typedef utl::NDArray<double,2> DoubleMatrixType;
+    DoubleMatrixType A(*m_A), AtA, tmp, ls;
     // utl::ProductVnlMtM(*m_A, *m_A, *m_LS);
-    utl::ProductUtlXtX(*m_A, *m_LS);
+    utl::ProductUtlXtX(A, AtA);
     if (m_Lambda->Size()>0)
-      *m_LS += *m_Lambda;
+      AtA += DoubleMatrixType(*m_Lambda);
       // utl::vAdd(m_LS->Size(),m_LS->data_block(), m_Lambda->data_block(), m_LS->data_block());
-    m_ConditionNumber = m_LS->GetInfNorm();
-    MatrixPointer tmp(new MatrixType());
+    m_ConditionNumber = AtA.GetInfNorm();
     if (m_IsLambdaSymmetric)
-      *tmp = m_LS->PInverseSymmericMatrix();
+      tmp = AtA.PInverseSymmericMatrix();
     else
-      *tmp = m_LS->PInverseMatrix();
-    m_ConditionNumber *= tmp->GetInfNorm();
-    utl::ProductUtlMMt(*tmp, *m_A, *m_LS);
+      tmp = AtA.PInverseMatrix();
+    m_ConditionNumber *= tmp.GetInfNorm();
+    utl::ProductUtlMMt(tmp, A, ls);
+    m_LS = MatrixPointer(new MatrixType(ls));
     }
 }
 
@@ -139,6 +181,19 @@ L2RegularizedLeastSquaresSolver<TPrecision>
   utl::ProductUtlMv(*m_LS, *m_b, this->m_x);
 }
 
+template <class TPrecision>
+void
+L2RegularizedLeastSquaresSolver<TPrecision>
+::SolveBatch(const MatrixType& bMatrix, MatrixType& xMatrix)
+{
+  int N = GetXDimension();
+  int M = m_A->Rows();
+  utlGlobalException(M<=0 || N<=0, "need to set m_A" );
+  utlGlobalException(M!=bMatrix.Columns(), "wrong size of bMatrix! m_A->Rows()="<<m_A->Rows() <<", bMatrix.Columns()="<<bMatrix.Columns());
+  Initialize();
+  utl::ProductUtlMMt(bMatrix, *m_LS, xMatrix);
+}
+
 template <class TPrecision>
 typename L2RegularizedLeastSquaresSolver<TPrecision>::ValueType
 L2RegularizedLeastSquaresSolver<TPrecision>
@@ -147,7 +202,7 @@ L2RegularizedLeastSquaresSolver<TPrecision>
   const VectorType* xx = (x.Size()!=0? (&x) : (&this->m_x));
   VectorType tmp;
   utl::ProductUtlMv(*m_A, *xx, tmp);
-  ValueType cost = utl::ToVector<double>(tmp - *m_b)->GetSquaredTwoNorm();
+  ValueType cost = utl::ToVector<ValueType>(tmp - *m_b)->GetSquaredTwoNorm();
   if (m_Lambda->Size()>0)
     {
     utl::ProductUtlvM(*xx, *m_Lambda, tmp);
@@ -74,6 +74,16 @@ public:
   
   virtual void Solve(const VectorType& xInitial=VectorType()); 
   
+  /** Set b from a raw pointer with stride. The data is copied into a vector owned by the solver, 
+   * which is allocated only when its size is changed. It is used to solve problems in voxels without heap allocations. */
+  virtual void SetbFromData(const ValueType* b, const int size, const int stride=1)
+    {
+    utlGlobalException(true, "SetbFromData is not implemented in " << this->GetNameOfClass());
+    }
+
+  /** Preallocate all vectors used in Solve() for the current sizes of the problem.  */
+  virtual void AllocateWorkspace() {}
+  
   virtual void Solve(const MatrixType& xInitial=MatrixType())
     {
     this->VerifyInputs();
@@ -68,12 +68,12 @@ public:
   typedef typename Superclass::MatrixPointer   MatrixPointer;
   typedef typename Superclass::VectorPointer   VectorPointer;
   
-  typedef typename spams::Matrix<double>       SpamsMatrixType;
-  typedef typename spams::SpMatrix<double>     SpamsSpMatrixType;
-  typedef typename spams::Vector<double>       SpamsVectorType;
-  typedef typename utl_shared_ptr<spams::Matrix<double> >    SpamsMatrixPointer;
-  typedef typename utl_shared_ptr<spams::SpMatrix<double> >  SpamsSpMatrixPointer;
-  typedef typename utl_shared_ptr<spams::Vector<double> >    SpamsVectorPointer;
+  typedef typename spams::Matrix<ValueType>       SpamsMatrixType;
+  typedef typename spams::SpMatrix<ValueType>     SpamsSpMatrixType;
+  typedef typename spams::Vector<ValueType>       SpamsVectorType;
+  typedef typename utl_shared_ptr<spams::Matrix<ValueType> >    SpamsMatrixPointer;
+  typedef typename utl_shared_ptr<spams::SpMatrix<ValueType> >  SpamsSpMatrixPointer;
+  typedef typename utl_shared_ptr<spams::Vector<ValueType> >    SpamsVectorPointer;
 
   typedef enum 
     {
@@ -23,6 +23,7 @@
 #include "utlCore.h"
 // #include "utlITKSpams.h"
 #include "utlSpams.h"
+#include "utlProximalOperators.h"
 
 namespace itk
 {
@@ -115,7 +116,7 @@ SpamsWeightedLassoSolver<TPrecision>
   itkDebugMacro("setting W to " << *w);
   MatrixPointer W( new MatrixType(w->Size(),1) );
   W->SetColumn(0, *w);
-  if ( this->m_W != W )
+  if ( *this->m_W != *W )
     {
     m_W = W;
     m_Ws = SpamsMatrixPointer(new SpamsMatrixType());
@@ -205,7 +206,7 @@ SpamsWeightedLassoSolver<TPrecision>
     // std::cout << "mode = " << mode << std::endl << std::flush;
     // std::cout << "m_Positive = " << m_Positive << std::endl << std::flush;
     m_Xs= SpamsSpMatrixPointer(new SpamsSpMatrixType()); 
-    spams::lassoWeight<double>(*m_Bs,*m_As,*m_Ws,*m_Xs,utl::min(m_A->Columns(), m_A->Rows()), 0.5*m_Lambda, mode,m_Positive,m_NumberOfThreads);
+    spams::lassoWeight<ValueType>(*m_Bs,*m_As,*m_Ws,*m_Xs,utl::min(m_A->Columns(), m_A->Rows()), ValueType(0.5*m_Lambda), mode,m_Positive,m_NumberOfThreads);
     }
   else 
     utlGlobalException(true, "wrong m_ConstraintType");
@@ -225,7 +226,8 @@ SpamsWeightedLassoSolver<TPrecision>
   utlException(x.Size()==0, "need to give a vector");
   const VectorType* xx = &x;
   VectorType e = (*m_A) * (*xx)-m_B->GetColumn(col);
-  ValueType func = e.GetSquaredTwoNorm() + m_Lambda* utl::ToVector<double>(m_W->GetColumn(col) % (*xx))->GetOneNorm();
+  VectorType w = m_W->GetColumn(col);
+  ValueType func = e.GetSquaredTwoNorm() + m_Lambda* utl::WeightedL1Norm<ValueType>(xx->Size(), xx->GetData(), w.GetData());
   return func;
 }
 
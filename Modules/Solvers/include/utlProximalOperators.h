@@ -0,0 +1,315 @@
+/**
+ *       @file  utlProximalOperators.h
+ *      @brief  proximal operators for L1 type regularizations
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#ifndef __utlProximalOperators_h
+#define __utlProximalOperators_h
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "utlCoreMacro.h"
+#include "utlBlas.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTL_USE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define UTL_USE_X86_SIMD 0
+#endif
+
+/** \addtogroup utlMath
+@{ */
+
+namespace utl
+{
+
+/** SIMD instruction sets used in kernels  */
+typedef enum
+{
+  SIMD_SCALAR=0,
+  SIMD_AVX2,
+  SIMD_AVX512
+} SIMDType;
+
+/** Detect the best SIMD instruction set supported by the cpu.
+ * It is detected only once, and the result is used for all following calls.
+ * The instruction sets are chosen at run time, thus the code does not need to be built with -mavx2. */
+inline SIMDType
+GetSIMDTypeSupportedByCPU()
+{
+#if UTL_USE_X86_SIMD
+  static const SIMDType simdType = __builtin_cpu_supports("avx512f") ? SIMD_AVX512 : (__builtin_cpu_supports("avx2") ? SIMD_AVX2 : SIMD_SCALAR);
+  return simdType;
+#else
+  return SIMD_SCALAR;
+#endif
+}
+
+/** The SIMD type used in kernels. It is the type supported by cpu by default, and can be set to a lower level, e.g. for tests.  */
+inline SIMDType&
+SIMDTypeInKernels()
+{
+  static SIMDType simdType = GetSIMDTypeSupportedByCPU();
+  return simdType;
+}
+
+inline void
+SetSIMDTypeInKernels(const SIMDType simdType)
+{
+  SIMDTypeInKernels() = std::min(simdType, GetSIMDTypeSupportedByCPU());
+}
+
+namespace simd
+{
+
+/** scalar kernels, which are used for the remainders in SIMD kernels  */
+template <class T>
+inline void
+ProximalWeightedL1Scalar(const int N, const T* x, const T* w, T* y)
+{
+  for ( int i = 0; i < N; ++i )
+    {
+    // branch free: sign(x) max(|x|-w, 0)
+    T a = std::max(std::fabs(x[i])-w[i], T(0));
+    y[i] = x[i]<0 ? -a : a;
+    }
+}
+
+template <class T>
+inline void
+ProximalNonNegativeWeightedL1Scalar(const int N, const T* x, const T* w, T* y)
+{
+  for ( int i = 0; i < N; ++i )
+    y[i] = std::max(x[i]-w[i], T(0));
+}
+
+template <class T>
+inline T
+WeightedL1NormScalar(const int N, const T* x, const T* w)
+{
+  T sum=0;
+  for ( int i = 0; i < N; ++i )
+    sum += std::fabs(w[i]*x[i]);
+  return sum;
+}
+
+#if UTL_USE_X86_SIMD
+
+__attribute__((target("avx2"))) inline void
+ProximalWeightedL1AVX2(const int N, const double* x, const double* w, double* y)
+{
+  const __m256d signMask = _mm256_set1_pd(-0.0), zero = _mm256_setzero_pd();
+  int i=0;
+  for ( ; i+4 <= N; i+=4 )
+    {
+    __m256d vx = _mm256_loadu_pd(x+i);
+    __m256d a = _mm256_max_pd(_mm256_sub_pd(_mm256_andnot_pd(signMask, vx), _mm256_loadu_pd(w+i)), zero);
+    _mm256_storeu_pd(y+i, _mm256_or_pd(a, _mm256_and_pd(signMask, vx)));
+    }
+  ProximalWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx2"))) inline void
+ProximalWeightedL1AVX2(const int N, const float* x, const float* w, float* y)
+{
+  const __m256 signMask = _mm256_set1_ps(-0.0f), zero = _mm256_setzero_ps();
+  int i=0;
+  for ( ; i+8 <= N; i+=8 )
+    {
+    __m256 vx = _mm256_loadu_ps(x+i);
+    __m256 a = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(signMask, vx), _mm256_loadu_ps(w+i)), zero);
+    _mm256_storeu_ps(y+i, _mm256_or_ps(a, _mm256_and_ps(signMask, vx)));
+    }
+  ProximalWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx2"))) inline void
+ProximalNonNegativeWeightedL1AVX2(const int N, const double* x, const double* w, double* y)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  int i=0;
+  for ( ; i+4 <= N; i+=4 )
+    _mm256_storeu_pd(y+i, _mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(w+i)), zero));
+  ProximalNonNegativeWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx2"))) inline void
+ProximalNonNegativeWeightedL1AVX2(const int N, const float* x, const float* w, float* y)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  int i=0;
+  for ( ; i+8 <= N; i+=8 )
+    _mm256_storeu_ps(y+i, _mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(x+i), _mm256_loadu_ps(w+i)), zero));
+  ProximalNonNegativeWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx512f"))) inline void
+ProximalWeightedL1AVX512(const int N, const double* x, const double* w, double* y)
+{
+  const __m512i signMask = _mm512_set1_epi64(0x8000000000000000LL);
+  const __m512d zero = _mm512_setzero_pd();
+  int i=0;
+  for ( ; i+8 <= N; i+=8 )
+    {
+    __m512i vx = _mm512_castpd_si512(_mm512_loadu_pd(x+i));
+    __m512d ax = _mm512_castsi512_pd(_mm512_andnot_epi64(signMask, vx));
+    __m512d a = _mm512_max_pd(_mm512_sub_pd(ax, _mm512_loadu_pd(w+i)), zero);
+    __m512i r = _mm512_or_epi64(_mm512_castpd_si512(a), _mm512_and_epi64(signMask, vx));
+    _mm512_storeu_pd(y+i, _mm512_castsi512_pd(r));
+    }
+  ProximalWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx512f"))) inline void
+ProximalWeightedL1AVX512(const int N, const float* x, const float* w, float* y)
+{
+  const __m512i signMask = _mm512_set1_epi32(0x80000000);
+  const __m512 zero = _mm512_setzero_ps();
+  int i=0;
+  for ( ; i+16 <= N; i+=16 )
+    {
+    __m512i vx = _mm512_castps_si512(_mm512_loadu_ps(x+i));
+    __m512 ax = _mm512_castsi512_ps(_mm512_andnot_epi32(signMask, vx));
+    __m512 a = _mm512_max_ps(_mm512_sub_ps(ax, _mm512_loadu_ps(w+i)), zero);
+    __m512i r = _mm512_or_epi32(_mm512_castps_si512(a), _mm512_and_epi32(signMask, vx));
+    _mm512_storeu_ps(y+i, _mm512_castsi512_ps(r));
+    }
+  ProximalWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx512f"))) inline void
+ProximalNonNegativeWeightedL1AVX512(const int N, const double* x, const double* w, double* y)
+{
+  const __m512d zero = _mm512_setzero_pd();
+  int i=0;
+  for ( ; i+8 <= N; i+=8 )
+    _mm512_storeu_pd(y+i, _mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(w+i)), zero));
+  ProximalNonNegativeWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+__attribute__((target("avx512f"))) inline void
+ProximalNonNegativeWeightedL1AVX512(const int N, const float* x, const float* w, float* y)
+{
+  const __m512 zero = _mm512_setzero_ps();
+  int i=0;
+  for ( ; i+16 <= N; i+=16 )
+    _mm512_storeu_ps(y+i, _mm512_max_ps(_mm512_sub_ps(_mm512_loadu_ps(x+i), _mm512_loadu_ps(w+i)), zero));
+  ProximalNonNegativeWeightedL1Scalar(N-i, x+i, w+i, y+i);
+}
+
+#endif
+
+}
+
+/**
+ * Proximal operator of the weighted L1 norm (soft thresholding),
+ * \f$ y = \arg\min_{y} \frac{1}{2}\|y-x\|^2 + \sum_i w_i |y_i| \f$, i.e. \f$ y_i = sign(x_i) \max(|x_i|-w_i, 0) \f$.
+ * x and y can be the same array. w should be non-negative.
+ * */
+template <class T>
+inline void
+ProximalWeightedL1(const int N, const T* x, const T* w, T* y)
+{
+  simd::ProximalWeightedL1Scalar(N, x, w, y);
+}
+
+/**
+ * Proximal operator of the weighted L1 norm with non-negative constraint,
+ * \f$ y_i = \max(x_i-w_i, 0) \f$.
+ * */
+template <class T>
+inline void
+ProximalNonNegativeWeightedL1(const int N, const T* x, const T* w, T* y)
+{
+  simd::ProximalNonNegativeWeightedL1Scalar(N, x, w, y);
+}
+
+#if UTL_USE_X86_SIMD
+
+#define utlProximalKernelSIMD(funcName, T)                                   \
+template <>                                                                  \
+inline void                                                                  \
+funcName<T>(const int N, const T* x, const T* w, T* y)                       \
+{                                                                            \
+  SIMDType simdType = SIMDTypeInKernels();                                   \
+  if (simdType==SIMD_AVX512)                                                 \
+    simd::funcName##AVX512(N, x, w, y);                                      \
+  else if (simdType==SIMD_AVX2)                                              \
+    simd::funcName##AVX2(N, x, w, y);                                        \
+  else                                                                       \
+    simd::funcName##Scalar(N, x, w, y);                                      \
+}
+
+utlProximalKernelSIMD(ProximalWeightedL1, double)
+utlProximalKernelSIMD(ProximalWeightedL1, float)
+utlProximalKernelSIMD(ProximalNonNegativeWeightedL1, double)
+utlProximalKernelSIMD(ProximalNonNegativeWeightedL1, float)
+
+#undef utlProximalKernelSIMD
+
+#endif
+
+/** weighted L1 norm \f$ \sum_i |w_i x_i| \f$  */
+template <class T>
+inline T
+WeightedL1Norm(const int N, const T* x, const T* w)
+{
+  return simd::WeightedL1NormScalar(N, x, w);
+}
+
+/**
+ * Proximal operator of the group L1 norm, \f$ \sum_g w_g \|x_g\|_2 \f$,
+ * i.e. \f$ y_g = x_g \max(1-w_g/\|x_g\|_2, 0) \f$.
+ * The g-th group is [groupOffsets[g], groupOffsets[g+1]), thus groupOffsets has numberOfGroups+1 elements.
+ * */
+template <class T>
+inline void
+ProximalGroupL1(const int numberOfGroups, const int* groupOffsets, const T* x, const T* w, T* y)
+{
+  for ( int g = 0; g < numberOfGroups; ++g )
+    {
+    int start = groupOffsets[g], size = groupOffsets[g+1]-groupOffsets[g];
+    T norm = utl::cblas_nrm2<T>(size, x+start, 1);
+    T scale = norm>w[g] ? (1-w[g]/norm) : T(0);
+    if (x!=y)
+      utl::cblas_copy<T>(size, x+start, 1, y+start, 1);
+    utl::cblas_scal<T>(size, scale, y+start, 1);
+    }
+}
+
+/**
+ * Offsets of groups for coefficients of even order SH basis, e.g. SPF coefficients with index j=n*numberOfSH + shIndex.
+ * Coefficients with the same radial index n and the same SH order l are in one group.
+ * */
+inline std::vector<int>
+GetGroupOffsetsOfSHOrders(const int shRank, const int numberOfRadialBasis=1)
+{
+  std::vector<int> offsets(1, 0);
+  for ( int n = 0; n < numberOfRadialBasis; ++n )
+    {
+    for ( int l = 0; l <= shRank; l+=2 )
+      offsets.push_back(offsets.back()+2*l+1);
+    }
+  return offsets;
+}
+
+}
+
+/** @}  */
+
+#endif
@@ -83,6 +83,104 @@ main (int argc, char const* argv[])
   std::cout << "x = " << x << std::endl << std::flush;
   std::cout << "cost = " << solver->EvaluateCostFunction() << std::endl << std::flush;
 
+  std::cout << "warm start using the previous solution" << std::endl << std::flush;
+  int numberOfIterationsL2 = solver->GetNumberOfIterations();
+  double costL2 = solver->EvaluateCostFunction();
+  bool isWarmStartUsed = solver->SolveWithWarmStart(x);
+  utlPrintVar3(true, isWarmStartUsed, numberOfIterationsL2, solver->GetNumberOfIterations());
+  utlGlobalException(!isWarmStartUsed, "the converged solution should be accepted");
+  utlGlobalException(solver->GetNumberOfIterations()>numberOfIterationsL2, "warm start should not need more iterations");
+  utlGlobalException(solver->EvaluateCostFunction()>costL2*(1+1e-3), "wrong cost function");
+  
+  std::cout << "warm start using a bad initialization" << std::endl << std::flush;
+  isWarmStartUsed = solver->SolveWithWarmStart(x0);
+  utlGlobalException(isWarmStartUsed, "the bad initialization should be rejected");
+
+  std::cout << "problem context shared by clones" << std::endl << std::flush;
+  FISTASolverType::Pointer solverClone = solver->Clone();
+  utlGlobalException(solverClone->GetProblemContext()!=solver->GetProblemContext(), "the problem context should be shared");
+  solverClone->SetA(MatrixPointer(new MatrixType(A)));
+  utlGlobalException(solverClone->GetProblemContext()!=solver->GetProblemContext(), "the same m_A should not create a new problem context");
+  solverClone->Solve();
+  VectorType xDiff = solverClone->Getx();
+  xDiff -= solver->Getx();
+  utlGlobalException(xDiff.GetTwoNorm()>1e-8, "wrong solution of the clone");
+
+  std::cout << "set b from raw data with stride" << std::endl << std::flush;
+  VectorType bStride(6);
+  for ( int i = 0; i < 3; i += 1 ) 
+    bStride[2*i] = b[i], bStride[2*i+1] = -100;
+  solverClone->SetbFromData(bStride.GetData(), 3, 2);
+  solverClone->Solve();
+  xDiff = solverClone->Getx();
+  xDiff -= solver->Getx();
+  utlGlobalException(xDiff.GetTwoNorm()>1e-8, "wrong solution using SetbFromData");
+
+  std::cout << "gap safe screening and active set in a sparse problem" << std::endl << std::flush;
+  {
+  const int M=60, N=40;
+  std::srand(1);
+  MatrixType As(M, N);
+  for ( int i = 0; i < M*N; i += 1 ) 
+    As.GetData()[i] = (double)std::rand()/RAND_MAX - 0.5;
+  VectorType xTrue(N), bs, ws(N), xs0(N);
+  xTrue.Fill(0.0);
+  xTrue[3]=2, xTrue[10]=-1.5, xTrue[25]=1;
+  utl::ProductUtlMv(As, xTrue, bs);
+  for ( int i = 0; i < M; i += 1 ) 
+    bs[i] += 0.01*((double)std::rand()/RAND_MAX - 0.5);
+  // the first two coefficients are not regularized
+  ws.Fill(2.0);
+  ws[0]=0, ws[1]=0;
+  xs0.Fill(0.1);
+
+  FISTASolverType::Pointer solverFull = FISTASolverType::New();
+  solverFull->SetA(MatrixPointer(new MatrixType(As)));
+  solverFull->Setb(VectorPointer(new VectorType(bs)));
+  solverFull->Setw(VectorPointer(new VectorType(ws)));
+  solverFull->SetMinRelativeChangeOfCostFunction(1e-6);
+  solverFull->SetMinRelativeChangeOfPrimalResidual(1e-6);
+  solverFull->SetMaxNumberOfIterations(5000);
+  solverFull->Solve(xs0);
+  VectorType xFull = solverFull->Getx();
+  double costFull = solverFull->EvaluateCostFunction();
+  utlPrintVar2(true, solverFull->GetNumberOfIterations(), costFull);
+
+  for ( int mode = 0; mode < 3; mode += 1 ) 
+    {
+    FISTASolverType::Pointer solverScreening = solverFull->Clone();
+    solverScreening->Setb(VectorPointer(new VectorType(bs)));
+    solverScreening->SetUseGapSafeScreening(mode!=1);
+    solverScreening->SetUseActiveSet(mode!=0);
+    solverScreening->Solve(xs0);
+    xDiff = solverScreening->Getx();
+    xDiff -= xFull;
+    double cost = solverScreening->EvaluateCostFunction();
+    utlPrintVar5(true, mode, solverScreening->GetNumberOfIterations(), solverScreening->GetNumberOfActiveCoefficients(), cost, xDiff.GetInfNorm());
+    utlGlobalException(xDiff.GetInfNorm()>1e-4, "wrong solution with screening or active set");
+    utlGlobalException(cost>costFull*(1+1e-5), "wrong cost function with screening or active set");
+    utlGlobalException(solverScreening->GetNumberOfActiveCoefficients()>=N, "no coefficient is removed");
+    for ( int i = 0; i < 2; i += 1 ) 
+      utlGlobalException(solverScreening->Getx()[i]==0, "unpenalized coefficients should not be removed");
+    }
+
+  std::cout << "single precision" << std::endl << std::flush;
+  typedef itk::L1RegularizedLeastSquaresFISTASolver<float> FloatFISTASolverType;
+  typedef utl::NDArray<float,2> FloatMatrixType;
+  typedef utl::NDArray<float,1> FloatVectorType;
+  FloatFISTASolverType::Pointer solverFloat = FloatFISTASolverType::New();
+  solverFloat->SetA(utl_shared_ptr<FloatMatrixType>(new FloatMatrixType(As)));
+  solverFloat->Setb(utl_shared_ptr<FloatVectorType>(new FloatVectorType(bs)));
+  solverFloat->Setw(utl_shared_ptr<FloatVectorType>(new FloatVectorType(ws)));
+  solverFloat->SetMinRelativeChangeOfCostFunction(1e-5);
+  solverFloat->SetMinRelativeChangeOfPrimalResidual(1e-5);
+  solverFloat->SetMaxNumberOfIterations(5000);
+  solverFloat->Solve(FloatVectorType(xs0));
+  xDiff = solverFloat->Getx();
+  xDiff -= xFull;
+  utlPrintVar2(true, solverFloat->GetNumberOfIterations(), xDiff.GetInfNorm());
+  utlGlobalException(xDiff.GetInfNorm()>1e-3, "wrong solution in single precision");
+  }
   
   return 0;
 }
@@ -0,0 +1,101 @@
+/**
+ *       @file  utlProximalOperatorsTest.cxx
+ *      @brief  
+ *
+ *
+ *     @author  Dr. Jian Cheng (JC), jian.cheng.1983@gmail.com
+ *
+ *   @internal
+ *     Created  "10-17-2026
+ *    Revision  1.0
+ *    Compiler  gcc/g++
+ *     Company  IDEA@UNC-CH
+ *   Copyright  Copyright (c) 2026, Jian Cheng
+ *
+ * =====================================================================================
+ */
+
+#include "utlProximalOperators.h"
+#include "utl.h"
+
+template <class T>
+void
+TestProximalOperators(const int N, const utl::SIMDType simdType)
+{
+  std::vector<T> x(N), w(N), y(N), yNonNeg(N), xInPlace(N);
+  for ( int i = 0; i < N; i += 1 ) 
+    {
+    x[i] = (T)(std::rand()/(double)RAND_MAX*2-1);
+    w[i] = (T)(std::rand()/(double)RAND_MAX*0.5);
+    }
+  // values on the thresholds
+  if (N>2)
+    {
+    x[0]=w[0], x[1]=-w[1], x[2]=0;
+    }
+
+  utl::SetSIMDTypeInKernels(simdType);
+  utl::ProximalWeightedL1<T>(N, &x[0], &w[0], &y[0]);
+  utl::ProximalNonNegativeWeightedL1<T>(N, &x[0], &w[0], &yNonNeg[0]);
+  xInPlace = x;
+  utl::ProximalWeightedL1<T>(N, &xInPlace[0], &w[0], &xInPlace[0]);
+
+  for ( int i = 0; i < N; i += 1 ) 
+    {
+    T yRef = x[i]>w[i] ? (x[i]-w[i]) : (x[i]<-w[i] ? (x[i]+w[i]) : 0 );
+    T yNonNegRef = x[i]>w[i] ? (x[i]-w[i]) : 0;
+    utlGlobalException(std::fabs(y[i]-yRef)>1e-6, "wrong ProximalWeightedL1, simdType="<<simdType<<", N="<<N<<", i="<<i<<", y[i]="<<y[i]<<", yRef="<<yRef);
+    utlGlobalException(std::fabs(xInPlace[i]-yRef)>1e-6, "wrong in-place ProximalWeightedL1, simdType="<<simdType<<", N="<<N<<", i="<<i);
+    utlGlobalException(std::fabs(yNonNeg[i]-yNonNegRef)>1e-6, "wrong ProximalNonNegativeWeightedL1, simdType="<<simdType<<", N="<<N<<", i="<<i);
+    }
+  utl::SetSIMDTypeInKernels(utl::GetSIMDTypeSupportedByCPU());
+}
+
+/**
+ * \brief  test proximal operators in utlProximalOperators.h
+ */
+int 
+main (int argc, char const* argv[])
+{
+  std::cout << "SIMD type supported by cpu: " << utl::GetSIMDTypeSupportedByCPU() << std::endl << std::flush;
+
+  // different sizes for the remainders in SIMD kernels
+  const int sizes[] = {1, 3, 7, 8, 15, 16, 17, 33, 100};
+  for ( int s = 0; s < 9; s += 1 ) 
+    {
+    for ( int t = utl::SIMD_SCALAR; t <= utl::SIMD_AVX512; t += 1 ) 
+      {
+      TestProximalOperators<double>(sizes[s], (utl::SIMDType)t);
+      TestProximalOperators<float>(sizes[s], (utl::SIMDType)t);
+      }
+    }
+
+  // group L1 using groups of SH orders with rank 4 and 2 radial bases
+  std::vector<int> offsets = utl::GetGroupOffsetsOfSHOrders(4, 2);
+  utlGlobalException(offsets.size()!=7 || offsets.back()!=30, "wrong GetGroupOffsetsOfSHOrders");
+  int numberOfGroups = offsets.size()-1;
+  std::vector<double> x(30), y(30), wg(numberOfGroups, 0.5);
+  for ( int i = 0; i < 30; i += 1 ) 
+    x[i] = std::rand()/(double)RAND_MAX*0.4-0.2;
+  x[1] = 1.0;
+  utl::ProximalGroupL1<double>(numberOfGroups, &offsets[0], &x[0], &wg[0], &y[0]);
+  for ( int g = 0; g < numberOfGroups; g += 1 ) 
+    {
+    double norm=0;
+    for ( int i = offsets[g]; i < offsets[g+1]; i += 1 ) 
+      norm += x[i]*x[i];
+    norm = std::sqrt(norm);
+    double scale = norm>wg[g] ? 1-wg[g]/norm : 0;
+    for ( int i = offsets[g]; i < offsets[g+1]; i += 1 ) 
+      utlGlobalException(std::fabs(y[i]-scale*x[i])>1e-10, "wrong ProximalGroupL1, g="<<g<<", i="<<i);
+    }
+
+  std::vector<double> w(30, 2.0);
+  double l1 = utl::WeightedL1Norm<double>(30, &x[0], &w[0]), l1Ref=0;
+  for ( int i = 0; i < 30; i += 1 ) 
+    l1Ref += 2.0*std::fabs(x[i]);
+  utlGlobalException(std::fabs(l1-l1Ref)>1e-10, "wrong WeightedL1Norm");
+
+  std::cout << "all tests passed" << std::endl << std::flush;
+  return 0;
+}